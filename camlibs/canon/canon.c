@@ -3490,6 +3490,43 @@ canon_int_get_file (Camera *camera, const char *name, unsigned char **data, unsi
         }
 }
 
+/**
+ * canon_int_stream_file:
+ * @camera:
+ * @name: name of file to fetch
+ * @file: #CameraFile to append the file data to
+ * @length: length of the file
+ * @context: context for error reporting
+ *
+ * Gets a file like #canon_int_get_file(), but hands the data on to
+ * @file while it is received where the connection allows it.
+ *
+ * Returns: gphoto2 error code, length of file in @length.
+ *
+ */
+int
+canon_int_stream_file (Camera *camera, const char *name, CameraFile *file, unsigned int *length,
+                       GPContext *context)
+{
+        unsigned char *data = NULL;
+        int res;
+
+        switch (camera->port->type) {
+                case GP_PORT_USB:
+                        return canon_usb_stream_file (camera, name, file, length, context);
+                        break;
+                case GP_PORT_SERIAL:
+                        data = canon_serial_get_file (camera, name, length, context);
+                        if (!data)
+                                return GP_ERROR_OS_FAILURE;
+                        res = gp_file_append (file, (char *)data, *length);
+                        free (data);
+                        return res;
+                        break;
+                GP_PORT_DEFAULT
+        }
+}
+
 /**
  * canon_int_get_thumbnail:
  * @camera: camera to work with
@@ -784,8 +784,10 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 	/* fetch file/thumbnail/exif/audio/whatever */
 	switch (type) {
 		case GP_FILE_TYPE_NORMAL:
-			ret = canon_int_get_file (camera, canon_path, &data, &datalen,
-						  context);
+			/* movies can be big, pass them on while they come in */
+			gp_file_set_mime_type (file, filename2mimetype (filename));
+			ret = canon_int_stream_file (camera, canon_path, file, &datalen,
+						     context);
 			if (ret == GP_OK) {
 				/* 0 also marks image as downloaded */
 				uint8_t attr = 0;
@@ -814,8 +816,9 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 		case GP_FILE_TYPE_AUDIO:
 			if (*audioname != '\0') {
 				/* extra audio file */
-				ret = canon_int_get_file (camera, audioname, &data, &datalen,
-							  context);
+				gp_file_set_mime_type (file, GP_MIME_WAV);
+				ret = canon_int_stream_file (camera, audioname, file, &datalen,
+							     context);
 			} else {
 				/* internal audio file; not handled yet */
 				ret = GP_ERROR_NOT_SUPPORTED;
@@ -893,10 +896,6 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 		return ret;
 	}
 
-	if (data == NULL) {
-		GP_DEBUG ("get_file_func: Fatal error: data == NULL");
-		return GP_ERROR_CORRUPTED_DATA;
-	}
 	/* 256 is picked out of the blue, I figured no JPEG with EXIF header
 	 * (not all canon cameras produces EXIF headers I think, but still)
 	 * should be less than 256 bytes long.
@@ -904,6 +903,17 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 	if (datalen < 256) {
 		GP_DEBUG ("get_file_func: datalen < 256 (datalen = %i = 0x%x)", datalen,
 			  datalen);
+		if (data)
+			free (data);
+		return GP_ERROR_CORRUPTED_DATA;
+	}
+
+	/* files and audio annotations already went into file */
+	if ((type == GP_FILE_TYPE_NORMAL) || (type == GP_FILE_TYPE_AUDIO))
+		return GP_OK;
+
+	if (data == NULL) {
+		GP_DEBUG ("get_file_func: Fatal error: data == NULL");
 		return GP_ERROR_CORRUPTED_DATA;
 	}
 
@@ -938,15 +948,6 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 			gp_file_set_mime_type (file, GP_MIME_JPEG);	/* always */
 			break;
 
-		case GP_FILE_TYPE_AUDIO:
-			gp_file_set_mime_type (file, GP_MIME_WAV);
-			gp_file_set_data_and_size (file, (char *)data, datalen);
-			break;
-
-		case GP_FILE_TYPE_NORMAL:
-			gp_file_set_mime_type (file, filename2mimetype (filename));
-			gp_file_set_data_and_size (file, (char *)data, datalen);
-			break;
 #ifdef HAVE_LIBEXIF
 		case GP_FILE_TYPE_EXIF:
 			if ( !is_cr2 ( filename ) )
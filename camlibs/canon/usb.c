@@ -1724,35 +1724,22 @@ canon_usb_dialogue (Camera *camera, canonCommandIndex canon_funct, unsigned int
 }
 
 
-/**
- * canon_usb_long_dialogue:
- * @camera: the Camera to work with
- * @canon_funct: integer constant that identifies function we are execute
- * @data: Pointer to pointer to allocated memory holding the data returned from the camera
- * @data_length: Pointer to where you want the number of bytes read from the camera
- * @max_data_size: Max realistic data size so that we can abort if something goes wrong
- * @payload: data we are to send to the camera
- * @payload_length: length of #payload
- * @display_status: Whether you want progress bar for this operation or not
- * @context: context for error reporting
- *
- * This function is used to invoke camera commands which return L (long) data.
- * It calls #canon_usb_dialogue(), if it gets a good response it will malloc()
- * memory and read the entire returned data into this malloc'd memory and store
- * a pointer to the malloc'd memory in 'data'.
- *
- * Returns: gphoto2 error code
- *
+/*
+ * Does the work of canon_usb_long_dialogue() and
+ * canon_usb_get_file_into(): the data goes either into a buffer
+ * malloc()ed for all of it (@file is NULL) or chunk by chunk into @file.
  */
-int
-canon_usb_long_dialogue (Camera *camera, canonCommandIndex canon_funct, unsigned char **data,
-                         unsigned int *data_length, unsigned int max_data_size, const unsigned char *payload,
-                         unsigned int payload_length, int display_status, GPContext *context)
+static int
+canon_usb_long_dialogue_into (Camera *camera, canonCommandIndex canon_funct, unsigned char **data,
+                              CameraFile *file, unsigned int *data_length, unsigned int max_data_size,
+                              const unsigned char *payload, unsigned int payload_length,
+                              int display_status, GPContext *context)
 {
-        int bytes_read;
+        int bytes_read, res;
 	unsigned int dialogue_len;
         unsigned int total_data_size = 0, bytes_received = 0, read_bytes = camera->pl->xfer_length;
         unsigned char *lpacket;         /* "length packet" */
+        unsigned char *chunk = NULL, *dest;
         unsigned int id = 0;
 
         /* indicate there is no data if we bail out somewhere */
@@ -1791,13 +1778,22 @@ canon_usb_long_dialogue (Camera *camera, canonCommandIndex canon_funct, unsigned
                 GP_DEBUG ("canon_usb_long_dialogue: ERROR: Packet of size %i is too big "
                           "(max reasonable size specified is %i)", total_data_size,
                           max_data_size);
-                return GP_ERROR_CORRUPTED_DATA;
+                res = GP_ERROR_CORRUPTED_DATA;
+                goto out;
         }
-        *data = malloc (total_data_size);
-        if (!*data) {
-                GP_DEBUG ("canon_usb_long_dialogue: "
-                          "ERROR: Could not allocate %i bytes of memory", total_data_size);
-                return GP_ERROR_NO_MEMORY;
+        if (!file) {
+                *data = malloc (total_data_size);
+                if (!*data) {
+                        GP_DEBUG ("canon_usb_long_dialogue: "
+                                  "ERROR: Could not allocate %i bytes of memory", total_data_size);
+                        res = GP_ERROR_NO_MEMORY;
+                        goto out;
+                }
+        } else {
+                /* memory files get all of it at once instead of growing */
+                res = gp_file_reserve (file, total_data_size);
+                if (res < 0)
+                        goto out;
         }
 
         bytes_received = 0;
@@ -1815,12 +1811,29 @@ canon_usb_long_dialogue (Camera *camera, canonCommandIndex canon_funct, unsigned
                 GP_DEBUG ("canon_usb_long_dialogue: total_data_size = %i, "
                           "bytes_received = %i, read_bytes = %i (0x%x)", total_data_size,
                           bytes_received, read_bytes, read_bytes);
-                bytes_read = gp_port_read (camera->port, (char *)*data + bytes_received, read_bytes);
+
+                /* Read straight into memory files, through a chunk
+                 * sized buffer into the others. */
+                if (!file)
+                        dest = *data + bytes_received;
+                else if (gp_file_get_append_buffer (file, read_bytes, (char **)&dest) != GP_OK) {
+                        if (!chunk) {
+                                chunk = malloc (camera->pl->xfer_length);
+                                if (!chunk) {
+                                        res = GP_ERROR_NO_MEMORY;
+                                        goto out;
+                                }
+                        }
+                        dest = chunk;
+                }
+                bytes_read = gp_port_read (camera->port, (char *)dest, read_bytes);
                 if (bytes_read < 1) {
                         GP_DEBUG ("canon_usb_long_dialogue: gp_port_read() returned error (%i) or no data",
                                   bytes_read);
-                        free (*data);
-                        *data = NULL;
+                        if (!file) {
+                                free (*data);
+                                *data = NULL;
+                        }
 
                         /* here, it is an error to get 0 bytes from gp_port_read()
                          * too, but 0 is GP_OK so if bytes_read is 0 return GP_ERROR_CORRUPTED_DATA
@@ -1828,41 +1841,70 @@ canon_usb_long_dialogue (Camera *camera, canonCommandIndex canon_funct, unsigned
                          * error code returned by gp_port_read()
                          */
                         if (bytes_read < 0)
-                                return bytes_read;
+                                res = bytes_read;
                         else
-                                return GP_ERROR_CORRUPTED_DATA;
+                                res = GP_ERROR_CORRUPTED_DATA;
+                        goto out;
                 } else if ((unsigned int)bytes_read < read_bytes)
                         GP_DEBUG ("canon_usb_long_dialogue: WARNING: gp_port_read() resulted in short read "
                                   "(returned %i bytes, expected %i)", bytes_read, read_bytes);
+                if (file) {
+                        res = gp_file_append (file, (char *)dest, bytes_read);
+                        if (res < 0)
+                                goto out;
+                }
                 bytes_received += bytes_read;
 
                 if (display_status)
                         gp_context_progress_update (context, id, bytes_received);
         }
-        if (display_status)
-                gp_context_progress_stop (context, id);
-
         *data_length = total_data_size;
+        res = GP_OK;
 
-        return GP_OK;
+out:
+        if (display_status)
+                gp_context_progress_stop (context, id);
+        free (chunk);
+        return res;
 }
 
 /**
- * canon_usb_get_file:
- * @camera: camera to use
- * @name: name of file to fetch
- * @data: to receive image data
- * @length: to receive length of image data
+ * canon_usb_long_dialogue:
+ * @camera: the Camera to work with
+ * @canon_funct: integer constant that identifies function we are execute
+ * @data: Pointer to pointer to allocated memory holding the data returned from the camera
+ * @data_length: Pointer to where you want the number of bytes read from the camera
+ * @max_data_size: Max realistic data size so that we can abort if something goes wrong
+ * @payload: data we are to send to the camera
+ * @payload_length: length of #payload
+ * @display_status: Whether you want progress bar for this operation or not
  * @context: context for error reporting
  *
- * Get a file from a USB-connected Canon camera.
+ * This function is used to invoke camera commands which return L (long) data.
+ * It calls #canon_usb_dialogue(), if it gets a good response it will malloc()
+ * memory and read the entire returned data into this malloc'd memory and store
+ * a pointer to the malloc'd memory in 'data'.
  *
- * Returns: gphoto2 error code, length in @length, and image data in @data.
+ * Returns: gphoto2 error code
  *
  */
 int
-canon_usb_get_file (Camera *camera, const char *name, unsigned char **data, unsigned int *length,
-                    GPContext *context)
+canon_usb_long_dialogue (Camera *camera, canonCommandIndex canon_funct, unsigned char **data,
+                         unsigned int *data_length, unsigned int max_data_size, const unsigned char *payload,
+                         unsigned int payload_length, int display_status, GPContext *context)
+{
+        return canon_usb_long_dialogue_into (camera, canon_funct, data, NULL, data_length,
+                                             max_data_size, payload, payload_length,
+                                             display_status, context);
+}
+
+/*
+ * Does the work of canon_usb_get_file() and canon_usb_stream_file(),
+ * the data goes into @data if @file is NULL.
+ */
+static int
+canon_usb_get_file_into (Camera *camera, const char *name, unsigned char **data, CameraFile *file,
+                         unsigned int *length, GPContext *context)
 {
         char payload[100];
         int payload_length, res, offset;
@@ -1903,9 +1945,9 @@ canon_usb_get_file (Camera *camera, const char *name, unsigned char **data, unsi
         }
 
         /* the 1 is to show status */
-        res = canon_usb_long_dialogue (camera, CANON_USB_FUNCTION_GET_FILE, data, length,
-                                       camera->pl->md->max_movie_size, (unsigned char *)payload,
-                                       payload_length, 1, context);
+        res = canon_usb_long_dialogue_into (camera, CANON_USB_FUNCTION_GET_FILE, data, file,
+                                            length, camera->pl->md->max_movie_size,
+                                            (unsigned char *)payload, payload_length, 1, context);
         if (res != GP_OK) {
                 GP_DEBUG ("canon_usb_get_file: canon_usb_long_dialogue() "
                           "returned error (%i).", res);
@@ -1915,6 +1957,47 @@ canon_usb_get_file (Camera *camera, const char *name, unsigned char **data, unsi
         return GP_OK;
 }
 
+/**
+ * canon_usb_get_file:
+ * @camera: camera to use
+ * @name: name of file to fetch
+ * @data: to receive image data
+ * @length: to receive length of image data
+ * @context: context for error reporting
+ *
+ * Get a file from a USB-connected Canon camera.
+ *
+ * Returns: gphoto2 error code, length in @length, and image data in @data.
+ *
+ */
+int
+canon_usb_get_file (Camera *camera, const char *name, unsigned char **data, unsigned int *length,
+                    GPContext *context)
+{
+        return canon_usb_get_file_into (camera, name, data, NULL, length, context);
+}
+
+/**
+ * canon_usb_stream_file:
+ * @camera: camera to use
+ * @name: name of file to fetch
+ * @file: #CameraFile to append the image data to
+ * @length: to receive length of image data
+ * @context: context for error reporting
+ *
+ * Get a file from a USB-connected Canon camera, passing it on to @file
+ * chunk by chunk as it is received.
+ *
+ * Returns: gphoto2 error code, length in @length.
+ *
+ */
+int
+canon_usb_stream_file (Camera *camera, const char *name, CameraFile *file, unsigned int *length,
+                       GPContext *context)
+{
+        return canon_usb_get_file_into (camera, name, NULL, file, length, context);
+}
+
 /**
  * canon_usb_get_thumbnail:
  * @camera: camera to use
@@ -264,6 +264,7 @@ int canon_usb_long_dialogue (Camera *camera, canonCommandIndex canon_funct, unsi
 		unsigned int *data_length, unsigned int max_data_size, const unsigned char *payload,
 		unsigned int payload_length, int display_status, GPContext *context);
 int canon_usb_get_file (Camera *camera, const char *name, unsigned char **data, unsigned int *length, GPContext *context);
+int canon_usb_stream_file (Camera *camera, const char *name, CameraFile *file, unsigned int *length, GPContext *context);
 int canon_usb_get_thumbnail (Camera *camera, const char *name, unsigned char **data, unsigned int *length, GPContext *context);
 int canon_usb_get_captured_image (Camera *camera, const int key, unsigned char **data, unsigned int *length, GPContext *context);
 int canon_usb_get_captured_secondary_image (Camera *camera, const int key, unsigned char **data, unsigned int *length, GPContext *context);
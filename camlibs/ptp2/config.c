@@ -105,7 +105,7 @@ camera_prepare_canon_powershot_capture(Camera *camera, GPContext *context) {
 	ret = ptp_getdevicepropvalue(params, PTP_DPC_CANON_SizeOfInputDataToCamera, &propval, PTP_DTC_UINT32);
 	gp_log (GP_LOG_DEBUG, "ptp", "prop PTP_DPC_CANON_SizeOfInputDataToCamera value is %d, ret 0x%x",propval.u32, ret);
 
-	ret = ptp_getdeviceinfo (params, &params->deviceinfo);
+	ptp_free_DI (&params->deviceinfo);
 	ret = ptp_getdeviceinfo (params, &params->deviceinfo);
 	fixup_cached_deviceinfo (camera, &params->deviceinfo);
 
@@ -113,6 +113,7 @@ camera_prepare_canon_powershot_capture(Camera *camera, GPContext *context) {
 	gp_log (GP_LOG_DEBUG, "ptp", "prop PTP_DPC_CANON_SizeOfOutputDataFromCamera value is %d, ret 0x%x",propval.u32, ret);
 	ret = ptp_getdevicepropvalue(params, PTP_DPC_CANON_SizeOfInputDataToCamera, &propval, PTP_DTC_UINT32);
 	gp_log (GP_LOG_DEBUG, "ptp", "prop PTP_DPC_CANON_SizeOfInputDataToCamera value is %d, ret x0%x",propval.u32,ret);
+	ptp_free_DI (&params->deviceinfo);
 	ret = ptp_getdeviceinfo (params, &params->deviceinfo);
 	fixup_cached_deviceinfo (camera, &params->deviceinfo);
 	ret = ptp_getdevicepropvalue(params, PTP_DPC_CANON_EventEmulateMode, &propval, PTP_DTC_UINT16);
@@ -180,6 +181,7 @@ camera_prepare_canon_powershot_capture(Camera *camera, GPContext *context) {
 
 
 	/* Reget device info, they change on the Canons. */
+	ptp_free_DI (&camera->pl->params.deviceinfo);
 	ptp_getdeviceinfo(&camera->pl->params, &camera->pl->params.deviceinfo);
 	fixup_cached_deviceinfo (camera, &camera->pl->params.deviceinfo);
 	gp_port_set_timeout (camera->port, oldtimeout);
@@ -394,6 +396,7 @@ camera_unprepare_canon_powershot_capture(Camera *camera, GPContext *context) {
 		}
 	}
 	/* Reget device info, they change on the Canons. */
+	ptp_free_DI (&params->deviceinfo);
 	ptp_getdeviceinfo(params, &params->deviceinfo);
 	fixup_cached_deviceinfo (camera, &params->deviceinfo);
 	return GP_OK;
@@ -471,31 +474,25 @@ nikon_wait_busy(PTPParams *params, int waitms, int timeout) {
 
 static int
 have_prop(Camera *camera, uint16_t vendor, uint16_t prop) {
-	unsigned int i;
+	PTPParams	*params = &camera->pl->params;
 
 	/* prop 0 matches */
-	if (!prop && (camera->pl->params.deviceinfo.VendorExtensionID==vendor))
+	if (!prop && (params->deviceinfo.VendorExtensionID==vendor))
 		return 1;
 
 	if ((prop & 0x7000) == 0x5000) { /* properties */
-		for (i=0; i<camera->pl->params.deviceinfo.DevicePropertiesSupported_len; i++) {
-			if (prop != camera->pl->params.deviceinfo.DevicePropertiesSupported[i])
-				continue;
-			if ((prop & 0xf000) == 0x5000) /* generic property */
-				return 1;
-			if (camera->pl->params.deviceinfo.VendorExtensionID==vendor)
-				return 1;
-		}
+		if (!ptp_property_issupported (params, prop))
+			return 0;
+		if ((prop & 0xf000) == 0x5000) /* generic property */
+			return 1;
+		return params->deviceinfo.VendorExtensionID==vendor;
 	}
 	if ((prop & 0x7000) == 0x1000) { /* commands */
-		for (i=0; i<camera->pl->params.deviceinfo.OperationsSupported_len; i++) {
-			if (prop != camera->pl->params.deviceinfo.OperationsSupported[i])
-				continue;
-			if ((prop & 0xf000) == 0x1000) /* generic property */
-				return 1;
-			if (camera->pl->params.deviceinfo.VendorExtensionID==vendor)
-				return 1;
-		}
+		if (!ptp_operation_issupported (params, prop))
+			return 0;
+		if ((prop & 0xf000) == 0x1000) /* generic property */
+			return 1;
+		return params->deviceinfo.VendorExtensionID==vendor;
 	}
 	return 0;
 }
@@ -509,6 +506,8 @@ have_eos_prop(Camera *camera, uint16_t vendor, uint16_t prop) {
 	    (vendor != PTP_VENDOR_CANON)
 	)
 		return 0;
+	if (camera->pl->params.canon_props_bitset)
+		return PTP_BITSET_ISSET(camera->pl->params.canon_props_bitset, prop);
 	for (i=0;i<camera->pl->params.nrofcanon_props;i++)
 		if (camera->pl->params.canon_props[i].proptype == prop)
 			return 1;
@@ -5940,20 +5939,12 @@ static struct menu menus[] = {
 	{ N_("WIFI profiles"), "wifiprofiles", 0, 0, NULL, _get_wifi_profiles_menu, _put_wifi_profiles_menu },
 };
 
-int
-camera_get_config (Camera *camera, CameraWidget **window, GPContext *context)
+static int
+_prepare_get_config (Camera *camera, GPContext *context)
 {
-	CameraWidget	*section, *widget;
-	unsigned int	menuno, submenuno;
-	int 		ret;
-	uint16_t	*setprops = NULL;
-	int		i, nrofsetprops = 0;
 	PTPParams	*params = &camera->pl->params;
-	CameraAbilities	ab;
+	int		ret;
 
-	SET_CONTEXT(camera, context);
-	memset (&ab, 0, sizeof(ab));
-	gp_camera_get_abilities (camera, &ab);
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
 		ptp_operation_issupported(&camera->pl->params, PTP_OC_CANON_EOS_RemoteRelease)
 	) {
@@ -5964,7 +5955,334 @@ camera_get_config (Camera *camera, CameraWidget **window, GPContext *context)
 		ret = ptp_canon_eos_keepdeviceon (params);
 		if (ret != PTP_RC_OK)
 			return translate_ptp_result (ret);
+	} else {
+		/* pending property changes invalidate cached descriptors */
+		ptp_check_propchange_events (params);
+	}
+	return GP_OK;
+}
+
+static int
+_get_generic_prop_widget (Camera *camera, uint16_t propid, CameraWidget **widget)
+{
+	PTPParams		*params = &camera->pl->params;
+	char			buf[20], *label;
+	PTPDevicePropDesc	dpd;
+	CameraWidgetType	type;
+
+	if (ptp_generic_getdevicepropdesc (params,propid,&dpd) != PTP_RC_OK)
+		return GP_ERROR_NOT_SUPPORTED;
+
+	label = (char*)ptp_get_property_description(params, propid);
+	if (!label) {
+		sprintf (buf, N_("PTP Property 0x%04x"), propid);
+		label = buf;
+	}
+	switch (dpd.FormFlag) {
+	case PTP_DPFF_None:
+		type = GP_WIDGET_TEXT;
+		break;
+	case PTP_DPFF_Range:
+		type = GP_WIDGET_RANGE;
+		switch (dpd.DataType) {
+		/* simple ranges might just be enumerations */
+#define X(dtc,val) 							\
+		case dtc: 					\
+			if (	((dpd.FORM.Range.MaximumValue.val - dpd.FORM.Range.MinimumValue.val) < 128) &&	\
+				(dpd.FORM.Range.StepSize.val == 1)) {						\
+				type = GP_WIDGET_MENU;								\
+			} \
+			break;
+
+	X(PTP_DTC_INT8,i8)
+	X(PTP_DTC_UINT8,u8)
+	X(PTP_DTC_INT16,i16)
+	X(PTP_DTC_UINT16,u16)
+	X(PTP_DTC_INT32,i32)
+	X(PTP_DTC_UINT32,u32)
+#undef X
+		default:break;
+		}
+		break;
+	case PTP_DPFF_Enumeration:
+		type = GP_WIDGET_MENU;
+		break;
+	default:
+		type = GP_WIDGET_TEXT;
+		break;
+	}
+	gp_widget_new (type, _(label), widget);
+	sprintf(buf,"%04x", propid); gp_widget_set_name (*widget, buf);
+	switch (dpd.FormFlag) {
+	case PTP_DPFF_None: break;
+	case PTP_DPFF_Range:
+		switch (dpd.DataType) {
+#define X(dtc,val) 										\
+		case dtc: 								\
+			if (type == GP_WIDGET_RANGE) {					\
+				gp_widget_set_range ( *widget, (float) dpd.FORM.Range.MinimumValue.val, (float) dpd.FORM.Range.MaximumValue.val, (float) dpd.FORM.Range.StepSize.val);\
+			} else {							\
+				int k;							\
+				for (k=dpd.FORM.Range.MinimumValue.val;k<=dpd.FORM.Range.MaximumValue.val;k+=dpd.FORM.Range.StepSize.val) { \
+					sprintf (buf, "%d", k); 			\
+					gp_widget_add_choice (*widget, buf);		\
+				}							\
+			} 								\
+			break;
+
+	X(PTP_DTC_INT8,i8)
+	X(PTP_DTC_UINT8,u8)
+	X(PTP_DTC_INT16,i16)
+	X(PTP_DTC_UINT16,u16)
+	X(PTP_DTC_INT32,i32)
+	X(PTP_DTC_UINT32,u32)
+#undef X
+		default:break;
+		}
+		break;
+	case PTP_DPFF_Enumeration:
+		switch (dpd.DataType) {
+#define X(dtc,val) 									\
+		case dtc: { 							\
+			int k;							\
+			for (k=0;k<dpd.FORM.Enum.NumberOfValues;k++) {		\
+				sprintf (buf, "%d", dpd.FORM.Enum.SupportedValue[k].val); \
+				gp_widget_add_choice (*widget, buf);		\
+			}							\
+			break;							\
+		}
+
+	X(PTP_DTC_INT8,i8)
+	X(PTP_DTC_UINT8,u8)
+	X(PTP_DTC_INT16,i16)
+	X(PTP_DTC_UINT16,u16)
+	X(PTP_DTC_INT32,i32)
+	X(PTP_DTC_UINT32,u32)
+#undef X
+		case PTP_DTC_STR: {
+			int k;
+			for (k=0;k<dpd.FORM.Enum.NumberOfValues;k++)
+				gp_widget_add_choice (*widget, dpd.FORM.Enum.SupportedValue[k].str);
+			break;
+		}
+		default:break;
+		}
+		break;
+	}
+	switch (dpd.DataType) {
+#define X(dtc,val) 							\
+	case dtc:						\
+		if (type == GP_WIDGET_RANGE) {			\
+			float f = dpd.CurrentValue.val;		\
+			gp_widget_set_value (*widget, &f);	\
+		} else {					\
+			sprintf (buf, "%d", dpd.CurrentValue.val);	\
+			gp_widget_set_value (*widget, buf);	\
+		}\
+		break;
+
+	X(PTP_DTC_INT8,i8)
+	X(PTP_DTC_UINT8,u8)
+	X(PTP_DTC_INT16,i16)
+	X(PTP_DTC_UINT16,u16)
+	X(PTP_DTC_INT32,i32)
+	X(PTP_DTC_UINT32,u32)
+#undef X
+	case PTP_DTC_STR:
+		gp_widget_set_value (*widget, dpd.CurrentValue.str);
+		break;
+	default:
+		break;
+	}
+	if (dpd.GetSet == PTP_DPGS_Get)
+		gp_widget_set_readonly (*widget, 1);
+	ptp_free_devicepropdesc(&dpd);
+	return GP_OK;
+}
+
+static int
+_get_submenu_widget (Camera *camera, struct submenu *cursub, CameraWidget **widget)
+{
+	PTPParams	*params = &camera->pl->params;
+	int		ret;
+
+	if (	have_prop(camera,cursub->vendorid,cursub->propid) ||
+		((cursub->propid == 0) && have_prop(camera,cursub->vendorid,cursub->type))
+	) {
+		if ((cursub->propid & 0x7000) == 0x5000) {
+			PTPDevicePropDesc	dpd;
+
+			gp_log (GP_LOG_DEBUG, "camera_get_config", "Getting property '%s' / 0x%04x", _(cursub->label), cursub->propid );
+			memset(&dpd,0,sizeof(dpd));
+			ptp_generic_getdevicepropdesc(params,cursub->propid,&dpd);
+			ret = cursub->getfunc (camera, widget, cursub, &dpd);
+			if ((ret == GP_OK) && (dpd.GetSet == PTP_DPGS_Get))
+				gp_widget_set_readonly (*widget, 1);
+			ptp_free_devicepropdesc(&dpd);
+		} else {
+			/* if it is a OPC, check for its presence. Otherwise just create the widget. */
+			if (	((cursub->type & 0x7000) == 0x1000) &&
+				!ptp_operation_issupported(params, cursub->type)
+			)
+				return GP_ERROR_NOT_SUPPORTED;
+			gp_log (GP_LOG_DEBUG, "camera_get_config", "Getting function prop '%s' / 0x%04x", _(cursub->label), cursub->type );
+			ret = cursub->getfunc (camera, widget, cursub, NULL);
+		}
+	} else if (have_eos_prop(camera,cursub->vendorid,cursub->propid)) {
+		PTPDevicePropDesc	dpd;
+
+		gp_log (GP_LOG_DEBUG, "camera_get_config", "Getting property '%s' / 0x%04x", _(cursub->label), cursub->propid );
+		memset(&dpd,0,sizeof(dpd));
+		ptp_canon_eos_getdevicepropdesc (params,cursub->propid, &dpd);
+		ret = cursub->getfunc (camera, widget, cursub, &dpd);
+		ptp_free_devicepropdesc(&dpd);
+	} else
+		return GP_ERROR_NOT_SUPPORTED;
+
+	if (ret != GP_OK)
+		gp_log (GP_LOG_DEBUG, "camera_get_config", "Failed to parse value of property '%s' / 0x%04x: ret %d", _(cursub->label), cursub->propid, ret);
+	return ret;
+}
+
+static int
+_put_submenu_widget (Camera *camera, struct submenu *cursub, CameraWidget *widget, GPContext *context)
+{
+	PTPParams		*params = &camera->pl->params;
+	PTPPropertyValue	propval;
+	uint16_t		ret2;
+	int			ret;
+
+	if (	have_prop(camera,cursub->vendorid,cursub->propid) ||
+		((cursub->propid == 0) && have_prop(camera,cursub->vendorid,cursub->type))
+	) {
+		gp_widget_changed (widget); /* clear flag */
+		gp_log (GP_LOG_DEBUG, "camera_set_config", "Setting property '%s' / 0x%04x", _(cursub->label), cursub->propid );
+		if ((cursub->propid & 0x7000) == 0x5000) {
+			PTPDevicePropDesc dpd;
+
+			memset(&dpd,0,sizeof(dpd));
+			ptp_generic_getdevicepropdesc(params,cursub->propid,&dpd);
+			if (dpd.GetSet == PTP_DPGS_GetSet) {
+				ret = cursub->putfunc (camera, widget, &propval, &dpd);
+			} else {
+				gp_context_error (context, _("Sorry, the property '%s' / 0x%04x is currently ready-only."), _(cursub->label), cursub->propid);
+				ret = GP_ERROR_NOT_SUPPORTED;
+			}
+			if (ret == GP_OK) {
+				ret2 = ptp_setdevicepropvalue (params, cursub->propid, &propval, cursub->type);
+				if (ret2 != PTP_RC_OK) {
+					gp_context_error (context, _("The property '%s' / 0x%04x was not set, PTP errorcode 0x%04x."), _(cursub->label), cursub->propid, ret2);
+					ret = translate_ptp_result (ret2);
+				}
+			}
+			ptp_free_devicepropvalue (cursub->type, &propval);
+			ptp_free_devicepropdesc(&dpd);
+		} else {
+			ret = cursub->putfunc (camera, widget, NULL, NULL);
+			/* vendor operations might change any property */
+			ptp_invalidate_devicepropdesc (params, 0);
+		}
+		return ret;
+	}
+	if (have_eos_prop(camera,cursub->vendorid,cursub->propid)) {
+		PTPDevicePropDesc	dpd;
+
+		gp_widget_changed (widget); /* clear flag */
+		gp_log (GP_LOG_DEBUG, "camera_set_config", "Setting property '%s' / 0x%04x", _(cursub->label), cursub->propid);
+		memset(&dpd,0,sizeof(dpd));
+		ptp_canon_eos_getdevicepropdesc (params,cursub->propid, &dpd);
+		ret = cursub->putfunc (camera, widget, &propval, &dpd);
+		if (ret == GP_OK) {
+			ret2 = ptp_canon_eos_setdevicepropvalue (params, cursub->propid, &propval, cursub->type);
+			if (ret2 != PTP_RC_OK) {
+				gp_context_error (context, _("The property '%s' / 0x%04x was not set, PTP errorcode 0x%04x."), _(cursub->label), cursub->propid, ret2);
+				ret = translate_ptp_result (ret2);
+			}
+		} else
+			gp_context_error (context, _("Parsing the value of widget '%s' / 0x%04x failed with %d!"), _(cursub->label), cursub->propid, ret);
+		ptp_free_devicepropdesc(&dpd);
+		ptp_free_devicepropvalue(cursub->type, &propval);
+		return ret;
 	}
+	return GP_ERROR_NOT_SUPPORTED;
+}
+
+/* Sets a property of the "other" section, dpd is its current descriptor */
+static int
+_put_generic_prop_widget (Camera *camera, uint16_t propid, const char *label, CameraWidget *widget, PTPDevicePropDesc *dpd, GPContext *context)
+{
+	PTPParams		*params = &camera->pl->params;
+	PTPPropertyValue	propval;
+	CameraWidgetType	type;
+	char			*xval;
+	uint16_t		ret2;
+	int			ret;
+
+	if (dpd->GetSet != PTP_DPGS_GetSet) {
+		gp_context_error (context, _("Sorry, the property '%s' / 0x%04x is currently ready-only."), _(label), propid);
+		return GP_ERROR_NOT_SUPPORTED;
+	}
+
+	gp_widget_get_type (widget, &type);
+	memset (&propval,0,sizeof(propval));
+	switch (dpd->DataType) {
+#define X(dtc,val) 							\
+	case dtc:						\
+		if (type == GP_WIDGET_RANGE) {			\
+			float f;				\
+			gp_widget_get_value (widget, &f);	\
+			propval.val = f;			\
+		} else {					\
+			long x;					\
+			ret = gp_widget_get_value (widget, &xval);	\
+			sscanf (xval, "%ld", &x);		\
+			propval.val = x;			\
+		}\
+		break;
+
+	X(PTP_DTC_INT8,i8)
+	X(PTP_DTC_UINT8,u8)
+	X(PTP_DTC_INT16,i16)
+	X(PTP_DTC_UINT16,u16)
+	X(PTP_DTC_INT32,i32)
+	X(PTP_DTC_UINT32,u32)
+#undef X
+	case PTP_DTC_STR: {
+		char *val;
+		gp_widget_get_value (widget, &val);
+		propval.str = strdup(val);
+		break;
+	}
+	default:
+		break;
+	}
+	ret2 = ptp_setdevicepropvalue (params, propid, &propval, dpd->DataType);
+	if (ret2 != PTP_RC_OK) {
+		gp_context_error (context, _("The property '%s' / 0x%04x was not set, PTP errorcode 0x%04x."), _(label), propid, ret2);
+		ret = translate_ptp_result (ret2);
+	} else
+		ret = GP_OK;
+	ptp_free_devicepropvalue (dpd->DataType, &propval);
+	return ret;
+}
+
+int
+camera_get_config (Camera *camera, CameraWidget **window, GPContext *context)
+{
+	CameraWidget	*section, *widget;
+	unsigned int	menuno, submenuno;
+	int 		ret;
+	uint16_t	*setprops = NULL;
+	int		i, nrofsetprops = 0;
+	PTPParams	*params = &camera->pl->params;
+	CameraAbilities	ab;
+
+	SET_CONTEXT(camera, context);
+	memset (&ab, 0, sizeof(ab));
+	gp_camera_get_abilities (camera, &ab);
+	ret = _prepare_get_config (camera, context);
+	if (ret != GP_OK)
+		return ret;
 
 	gp_widget_new (GP_WIDGET_WINDOW, _("Camera and Driver Configuration"), window);
 	gp_widget_set_name (*window, "main");
@@ -6020,49 +6338,10 @@ camera_get_config (Camera *camera, CameraWidget **window, GPContext *context)
 					if (setprops) /* handle oom */
 						setprops[nrofsetprops++] = cursub->propid;
 				}
-				/* ok, looking good */
-				if ((cursub->propid & 0x7000) == 0x5000) {
-					PTPDevicePropDesc	dpd;
-
-					gp_log (GP_LOG_DEBUG, "camera_get_config", "Getting property '%s' / 0x%04x", _(cursub->label), cursub->propid );
-					memset(&dpd,0,sizeof(dpd));
-					ptp_getdevicepropdesc(params,cursub->propid,&dpd);
-					ret = cursub->getfunc (camera, &widget, cursub, &dpd);
-					if ((ret == GP_OK) && (dpd.GetSet == PTP_DPGS_Get))
-						gp_widget_set_readonly (widget, 1);
-					ptp_free_devicepropdesc(&dpd);
-				} else {
-					/* if it is a OPC, check for its presence. Otherwise just create the widget. */
-					if (	((cursub->type & 0x7000) != 0x1000) ||
-						 ptp_operation_issupported(params, cursub->type)
-					) {
-						gp_log (GP_LOG_DEBUG, "camera_get_config", "Getting function prop '%s' / 0x%04x", _(cursub->label), cursub->type );
-						ret = cursub->getfunc (camera, &widget, cursub, NULL);
-					} else
-						continue;
-				}
-				if (ret != GP_OK) {
-					gp_log (GP_LOG_DEBUG, "camera_get_config", "Failed to parse value of property '%s' / 0x%04x: ret %d", _(cursub->label), cursub->propid, ret);
-					continue;
-				}
-				gp_widget_append (section, widget);
-				continue;
 			}
-			if (have_eos_prop(camera,cursub->vendorid,cursub->propid)) {
-				PTPDevicePropDesc	dpd;
-
-				gp_log (GP_LOG_DEBUG, "camera_get_config", "Getting property '%s' / 0x%04x", _(cursub->label), cursub->propid );
-				memset(&dpd,0,sizeof(dpd));
-				ptp_canon_eos_getdevicepropdesc (params,cursub->propid, &dpd);
-				ret = cursub->getfunc (camera, &widget, cursub, &dpd);
-				ptp_free_devicepropdesc(&dpd);
-				if (ret != GP_OK) {
-					gp_log (GP_LOG_DEBUG, "camera_get_config", "Failed to parse value of property '%s' / 0x%04x: ret %d", _(cursub->label), cursub->propid, ret);
-					continue;
-				}
-				gp_widget_append (section, widget);
+			if (_get_submenu_widget (camera, cursub, &widget) != GP_OK)
 				continue;
-			}
+			gp_widget_append (section, widget);
 		}
 	}
 
@@ -6076,10 +6355,7 @@ camera_get_config (Camera *camera, CameraWidget **window, GPContext *context)
 
 	for (i=0;i<params->deviceinfo.DevicePropertiesSupported_len;i++) {
 		uint16_t		propid = params->deviceinfo.DevicePropertiesSupported[i];
-		char			buf[20], *label;
-		PTPDevicePropDesc	dpd;
-		CameraWidgetType	type;
-		int j;
+		int			j;
 
 		for (j=0;j<nrofsetprops;j++)
 			if (setprops[j] == propid)
@@ -6092,135 +6368,9 @@ camera_get_config (Camera *camera, CameraWidget **window, GPContext *context)
 #endif
 
 
-		ret = ptp_getdevicepropdesc (params,propid,&dpd);
-		if (ret != PTP_RC_OK)
+		if (_get_generic_prop_widget (camera, propid, &widget) != GP_OK)
 			continue;
-
-		label = (char*)ptp_get_property_description(params, propid);
-		if (!label) {
-			sprintf (buf, N_("PTP Property 0x%04x"), propid);
-			label = buf;
-		}
-		switch (dpd.FormFlag) {
-		case PTP_DPFF_None:
-			type = GP_WIDGET_TEXT;
-			break;
-		case PTP_DPFF_Range:
-			type = GP_WIDGET_RANGE;
-			switch (dpd.DataType) {
-			/* simple ranges might just be enumerations */
-#define X(dtc,val) 							\
-			case dtc: 					\
-				if (	((dpd.FORM.Range.MaximumValue.val - dpd.FORM.Range.MinimumValue.val) < 128) &&	\
-					(dpd.FORM.Range.StepSize.val == 1)) {						\
-					type = GP_WIDGET_MENU;								\
-				} \
-				break;
-
-		X(PTP_DTC_INT8,i8)
-		X(PTP_DTC_UINT8,u8)
-		X(PTP_DTC_INT16,i16)
-		X(PTP_DTC_UINT16,u16)
-		X(PTP_DTC_INT32,i32)
-		X(PTP_DTC_UINT32,u32)
-#undef X
-			default:break;
-			}
-			break;
-		case PTP_DPFF_Enumeration:
-			type = GP_WIDGET_MENU;
-			break;
-		default:
-			type = GP_WIDGET_TEXT;
-			break;
-		}
-		gp_widget_new (type, _(label), &widget);
-		sprintf(buf,"%04x", propid); gp_widget_set_name (widget, buf);
-		switch (dpd.FormFlag) {
-		case PTP_DPFF_None: break;
-		case PTP_DPFF_Range:
-			switch (dpd.DataType) {
-#define X(dtc,val) 										\
-			case dtc: 								\
-				if (type == GP_WIDGET_RANGE) {					\
-					gp_widget_set_range ( widget, (float) dpd.FORM.Range.MinimumValue.val, (float) dpd.FORM.Range.MaximumValue.val, (float) dpd.FORM.Range.StepSize.val);\
-				} else {							\
-					int k;							\
-					for (k=dpd.FORM.Range.MinimumValue.val;k<=dpd.FORM.Range.MaximumValue.val;k+=dpd.FORM.Range.StepSize.val) { \
-						sprintf (buf, "%d", k); 			\
-						gp_widget_add_choice (widget, buf);		\
-					}							\
-				} 								\
-				break;
-
-		X(PTP_DTC_INT8,i8)
-		X(PTP_DTC_UINT8,u8)
-		X(PTP_DTC_INT16,i16)
-		X(PTP_DTC_UINT16,u16)
-		X(PTP_DTC_INT32,i32)
-		X(PTP_DTC_UINT32,u32)
-#undef X
-			default:break;
-			}
-			break;
-		case PTP_DPFF_Enumeration:
-			switch (dpd.DataType) {
-#define X(dtc,val) 									\
-			case dtc: { 							\
-				int k;							\
-				for (k=0;k<dpd.FORM.Enum.NumberOfValues;k++) {		\
-					sprintf (buf, "%d", dpd.FORM.Enum.SupportedValue[k].val); \
-					gp_widget_add_choice (widget, buf);		\
-				}							\
-				break;							\
-			}
-
-		X(PTP_DTC_INT8,i8)
-		X(PTP_DTC_UINT8,u8)
-		X(PTP_DTC_INT16,i16)
-		X(PTP_DTC_UINT16,u16)
-		X(PTP_DTC_INT32,i32)
-		X(PTP_DTC_UINT32,u32)
-#undef X
-			case PTP_DTC_STR: {
-				int k;
-				for (k=0;k<dpd.FORM.Enum.NumberOfValues;k++)
-					gp_widget_add_choice (widget, dpd.FORM.Enum.SupportedValue[k].str);
-				break;
-			}
-			default:break;
-			}
-			break;
-		}
-		switch (dpd.DataType) {
-#define X(dtc,val) 							\
-		case dtc:						\
-			if (type == GP_WIDGET_RANGE) {			\
-				float f = dpd.CurrentValue.val;		\
-				gp_widget_set_value (widget, &f);	\
-			} else {					\
-				sprintf (buf, "%d", dpd.CurrentValue.val);	\
-				gp_widget_set_value (widget, buf);	\
-			}\
-			break;
-
-		X(PTP_DTC_INT8,i8)
-		X(PTP_DTC_UINT8,u8)
-		X(PTP_DTC_INT16,i16)
-		X(PTP_DTC_UINT16,u16)
-		X(PTP_DTC_INT32,i32)
-		X(PTP_DTC_UINT32,u32)
-#undef X
-		case PTP_DTC_STR:
-			gp_widget_set_value (widget, dpd.CurrentValue.str);
-			break;
-		default:
-			break;
-		}
-		if (dpd.GetSet == PTP_DPGS_Get)
-			gp_widget_set_readonly (widget, 1);
 		gp_widget_append (section, widget);
-		ptp_free_devicepropdesc(&dpd);
 	}
 	free (setprops);
 	return GP_OK;
@@ -6230,11 +6380,9 @@ int
 camera_set_config (Camera *camera, CameraWidget *window, GPContext *context)
 {
 	CameraWidget		*section, *widget, *subwindow;
-	uint16_t		ret2;
 	unsigned int		menuno, submenuno;
 	int			ret;
 	PTPParams		*params = &camera->pl->params;
-	PTPPropertyValue	propval;
 	unsigned int		i;
 	CameraAbilities		ab;
 
@@ -6243,6 +6391,8 @@ camera_set_config (Camera *camera, CameraWidget *window, GPContext *context)
 	memset (&ab, 0, sizeof(ab));
 	gp_camera_get_abilities (camera, &ab);
 
+	/* the capture target or live view might change under a prepared trigger */
+	camera->pl->trigger_prepared = 0;
 	camera->pl->checkevents = TRUE;
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
 		ptp_operation_issupported(&camera->pl->params, PTP_OC_CANON_EOS_RemoteRelease)
@@ -6287,54 +6437,12 @@ camera_set_config (Camera *camera, CameraWidget *window, GPContext *context)
 			/* restore the "changed flag" */
 			gp_widget_set_changed (widget, TRUE);
 
-			if (	have_prop(camera,cursub->vendorid,cursub->propid) ||
-				((cursub->propid == 0) && have_prop(camera,cursub->vendorid,cursub->type))
-			) {
-				gp_widget_changed (widget); /* clear flag */
-				gp_log (GP_LOG_DEBUG, "camera_set_config", "Setting property '%s' / 0x%04x", _(cursub->label), cursub->propid );
-				if ((cursub->propid & 0x7000) == 0x5000) {
-					PTPDevicePropDesc dpd;
-
-					memset(&dpd,0,sizeof(dpd));
-					ptp_getdevicepropdesc(params,cursub->propid,&dpd);
-					if (dpd.GetSet == PTP_DPGS_GetSet) {
-						ret = cursub->putfunc (camera, widget, &propval, &dpd);
-					} else {
-						gp_context_error (context, _("Sorry, the property '%s' / 0x%04x is currently ready-only."), _(cursub->label), cursub->propid);
-						ret = GP_ERROR_NOT_SUPPORTED;
-					}
-					if (ret == GP_OK) {
-						ret2 = ptp_setdevicepropvalue (params, cursub->propid, &propval, cursub->type);
-						if (ret2 != PTP_RC_OK) {
-							gp_context_error (context, _("The property '%s' / 0x%04x was not set, PTP errorcode 0x%04x."), _(cursub->label), cursub->propid, ret2);
-							ret = translate_ptp_result (ret2);
-						}
-					}
-					ptp_free_devicepropvalue (cursub->type, &propval);
-					ptp_free_devicepropdesc(&dpd);
-				} else {
-					ret = cursub->putfunc (camera, widget, NULL, NULL);
-				}
-			}
-			if (have_eos_prop(camera,cursub->vendorid,cursub->propid)) {
-				PTPDevicePropDesc	dpd;
-
-				gp_widget_changed (widget); /* clear flag */
-				gp_log (GP_LOG_DEBUG, "camera_set_config", "Setting property '%s' / 0x%04x", _(cursub->label), cursub->propid);
-				memset(&dpd,0,sizeof(dpd));
-				ptp_canon_eos_getdevicepropdesc (params,cursub->propid, &dpd);
-				ret = cursub->putfunc (camera, widget, &propval, &dpd);
-				if (ret == GP_OK) {
-					ret2 = ptp_canon_eos_setdevicepropvalue (params, cursub->propid, &propval, cursub->type);
-					if (ret2 != PTP_RC_OK) {
-						gp_context_error (context, _("The property '%s' / 0x%04x was not set, PTP errorcode 0x%04x."), _(cursub->label), cursub->propid, ret2);
-						ret = translate_ptp_result (ret2);
-					}
-				} else
-					gp_context_error (context, _("Parsing the value of widget '%s' / 0x%04x failed with %d!"), _(cursub->label), cursub->propid, ret);
-				ptp_free_devicepropdesc(&dpd);
-				ptp_free_devicepropvalue(cursub->type, &propval);
-			}
+			if (	!have_prop(camera,cursub->vendorid,cursub->propid) &&
+				!((cursub->propid == 0) && have_prop(camera,cursub->vendorid,cursub->type)) &&
+				!have_eos_prop(camera,cursub->vendorid,cursub->propid)
+			)
+				continue;
+			ret = _put_submenu_widget (camera, cursub, widget, context);
 			if (ret != GP_OK)
 				return ret;
 		}
@@ -6350,8 +6458,7 @@ camera_set_config (Camera *camera, CameraWidget *window, GPContext *context)
 	/* Generic property setter */
 	for (i=0;i<params->deviceinfo.DevicePropertiesSupported_len;i++) {
 		uint16_t		propid = params->deviceinfo.DevicePropertiesSupported[i];
-		CameraWidgetType	type;
-		char			buf[20], *label, *xval;
+		char			buf[20], *label;
 		PTPDevicePropDesc	dpd;
 
 		label = (char*)ptp_get_property_description(params, propid);
@@ -6365,54 +6472,150 @@ camera_set_config (Camera *camera, CameraWidget *window, GPContext *context)
 		if (!gp_widget_changed (widget))
 			continue;
 
-		gp_widget_get_type (widget, &type);
-
 		memset (&dpd,0,sizeof(dpd));
-		memset (&propval,0,sizeof(propval));
-		ret = ptp_getdevicepropdesc (params,propid,&dpd);
-		if (ret != PTP_RC_OK)
+		if (ptp_generic_getdevicepropdesc (params,propid,&dpd) != PTP_RC_OK)
 			continue;
-		if (dpd.GetSet != PTP_DPGS_GetSet) {
-			gp_context_error (context, _("Sorry, the property '%s' / 0x%04x is currently ready-only."), _(label), propid);
-			return GP_ERROR_NOT_SUPPORTED;
+		/* a failed set is reported, but the others are still set */
+		ret = _put_generic_prop_widget (camera, propid, label, widget, &dpd, context);
+		if ((ret != GP_OK) && (dpd.GetSet != PTP_DPGS_GetSet)) {
+			ptp_free_devicepropdesc (&dpd);
+			return ret;
 		}
+		ptp_free_devicepropdesc (&dpd);
+	}
+	return GP_OK;
+}
 
-		switch (dpd.DataType) {
-#define X(dtc,val) 							\
-		case dtc:						\
-			if (type == GP_WIDGET_RANGE) {			\
-				float f;				\
-				gp_widget_get_value (widget, &f);	\
-				propval.val = f;			\
-			} else {					\
-				long x;					\
-				ret = gp_widget_get_value (widget, &xval);	\
-				sscanf (xval, "%ld", &x);		\
-				propval.val = x;			\
-			}\
-			break;
+/* Finds the generic device property a widget name of the "other" section
+ * refers to, these are named by their hexadecimal property code. */
+static int
+_lookup_generic_prop (PTPParams *params, const char *name, uint16_t *propid)
+{
+	unsigned int	i, prop;
+	char		*end;
 
-		X(PTP_DTC_INT8,i8)
-		X(PTP_DTC_UINT8,u8)
-		X(PTP_DTC_INT16,i16)
-		X(PTP_DTC_UINT16,u16)
-		X(PTP_DTC_INT32,i32)
-		X(PTP_DTC_UINT32,u32)
-#undef X
-		case PTP_DTC_STR: {
-			char *val;
-			gp_widget_get_value (widget, &val);
-			propval.str = strdup(val);
-			break;
+	prop = strtoul (name, &end, 16);
+	if ((strlen (name) != 4) || *end)
+		return GP_ERROR_BAD_PARAMETERS;
+	for (i=0;i<params->deviceinfo.DevicePropertiesSupported_len;i++) {
+		if (params->deviceinfo.DevicePropertiesSupported[i] == prop) {
+			*propid = prop;
+			return GP_OK;
 		}
-		default:
-			break;
+	}
+	return GP_ERROR_BAD_PARAMETERS;
+}
+
+static int
+_menu_applies (struct menu *menu, CameraAbilities *ab)
+{
+	if ((menu->usb_vendorid == 0) || (ab->port != GP_PORT_USB))
+		return 1;
+	if (menu->usb_vendorid != ab->usb_vendor)
+		return 0;
+	if (menu->usb_productid && (menu->usb_productid != ab->usb_product))
+		return 0;
+	return 1;
+}
+
+int
+camera_get_single_config (Camera *camera, const char *name, CameraWidget **widget, GPContext *context)
+{
+	unsigned int	menuno, submenuno;
+	int 		ret;
+	uint16_t	propid;
+	PTPParams	*params = &camera->pl->params;
+	CameraAbilities	ab;
+
+	SET_CONTEXT(camera, context);
+	memset (&ab, 0, sizeof(ab));
+	gp_camera_get_abilities (camera, &ab);
+	ret = _prepare_get_config (camera, context);
+	if (ret != GP_OK)
+		return ret;
+
+	for (menuno = 0; menuno < sizeof(menus)/sizeof(menus[0]) ; menuno++ ) {
+		if (!menus[menuno].submenus) /* Custom menus are only handled as a whole */
+			continue;
+		if (!_menu_applies (&menus[menuno], &ab))
+			continue;
+		for (submenuno = 0; menus[menuno].submenus[submenuno].name ; submenuno++ ) {
+			struct submenu *cursub = menus[menuno].submenus+submenuno;
+
+			if (strcmp (cursub->name, name))
+				continue;
+			/* vendor specific menus might carry another entry of
+			 * the same name, keep looking if this one is absent. */
+			*widget = NULL;
+			ret = _get_submenu_widget (camera, cursub, widget);
+			if (ret == GP_ERROR_NOT_SUPPORTED)
+				continue;
+			return ret;
 		}
-		ret = ptp_setdevicepropvalue (params, propid, &propval, dpd.DataType);
-		if (ret != PTP_RC_OK) {
-			gp_context_error (context, _("The property '%s' / 0x%04x was not set, PTP errorcode 0x%04x."), _(label), propid, ret);
-			ret = GP_ERROR;
+	}
+	if (_lookup_generic_prop (params, name, &propid) == GP_OK)
+		return _get_generic_prop_widget (camera, propid, widget);
+	/* might still be part of a custom menu, let the core use the tree */
+	gp_log (GP_LOG_DEBUG, "camera_get_single_config", "No single configuration value named '%s'.", name);
+	return GP_ERROR_NOT_SUPPORTED;
+}
+
+int
+camera_set_single_config (Camera *camera, const char *name, CameraWidget *widget, GPContext *context)
+{
+	unsigned int	menuno, submenuno;
+	uint16_t	propid;
+	PTPParams	*params = &camera->pl->params;
+	CameraAbilities	ab;
+
+	SET_CONTEXT(camera, context);
+	memset (&ab, 0, sizeof(ab));
+	gp_camera_get_abilities (camera, &ab);
+
+	/* the capture target or live view might change under a prepared trigger */
+	camera->pl->trigger_prepared = 0;
+	camera->pl->checkevents = TRUE;
+	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+		ptp_operation_issupported(&camera->pl->params, PTP_OC_CANON_EOS_RemoteRelease)
+	) {
+		if (!params->eos_captureenabled)
+			camera_prepare_capture (camera, context);
+		ptp_check_eos_events (params);
+	}
+
+	for (menuno = 0; menuno < sizeof(menus)/sizeof(menus[0]) ; menuno++ ) {
+		if (!menus[menuno].submenus) /* Custom menus are only handled as a whole */
+			continue;
+		if (!_menu_applies (&menus[menuno], &ab))
+			continue;
+		for (submenuno = 0; menus[menuno].submenus[submenuno].name ; submenuno++ ) {
+			struct submenu *cursub = menus[menuno].submenus+submenuno;
+
+			if (strcmp (cursub->name, name))
+				continue;
+			if (	!have_prop(camera,cursub->vendorid,cursub->propid) &&
+				!((cursub->propid == 0) && have_prop(camera,cursub->vendorid,cursub->type)) &&
+				!have_eos_prop(camera,cursub->vendorid,cursub->propid)
+			)
+				continue;
+			return _put_submenu_widget (camera, cursub, widget, context);
 		}
 	}
-	return GP_OK;
+	if (_lookup_generic_prop (params, name, &propid) == GP_OK) {
+		const char		*label = ptp_get_property_description (params, propid);
+		PTPDevicePropDesc	dpd;
+		uint16_t		ret2;
+		int			ret;
+
+		memset (&dpd,0,sizeof(dpd));
+		ret2 = ptp_generic_getdevicepropdesc (params,propid,&dpd);
+		if (ret2 != PTP_RC_OK)
+			return translate_ptp_result (ret2);
+		ret = _put_generic_prop_widget (camera, propid, label ? label : name, widget, &dpd, context);
+		ptp_free_devicepropdesc (&dpd);
+		return ret;
+	}
+	/* might still be part of a custom menu, let the core use the tree */
+	gp_log (GP_LOG_DEBUG, "camera_set_single_config", "No single configuration value named '%s'.", name);
+	return GP_ERROR_NOT_SUPPORTED;
 }
@@ -311,6 +311,7 @@ fixup_cached_deviceinfo (Camera *camera, PTPDeviceInfo *di) {
 		uint16_t	ret;
 		unsigned int	i;
 
+		ptp_free_DI (&params->outer_deviceinfo);
 		ret = ptp_getdeviceinfo (params, &params->outer_deviceinfo);
 		if (ret != PTP_RC_OK)
 			return;
@@ -344,10 +345,15 @@ fixup_cached_deviceinfo (Camera *camera, PTPDeviceInfo *di) {
 		DI_MERGE(DevicePropertiesSupported);
 		DI_MERGE(CaptureFormats);
 		DI_MERGE(ImageFormats);
+		newdi.OperationsBitset = NULL;
+		newdi.EventsBitset = NULL;
+		newdi.DevicePropertiesBitset = NULL;
+		ptp_deviceinfo_index (&newdi);
 
 		gp_log (GP_LOG_DEBUG, "olympus", "Dumping Olympus Deviceinfo");
 
 		print_debug_deviceinfo (&camera->pl->params, &newdi);
+		ptp_free_DI (&ndi);
 		ptp_free_DI (di);
 		memcpy (di, &newdi, sizeof(newdi));
 		return;
@@ -411,6 +417,7 @@ fixup_cached_deviceinfo (Camera *camera, PTPDeviceInfo *di) {
 				for (i=0;i<xsize;i++)
 					di->DevicePropertiesSupported[i+di->DevicePropertiesSupported_len] = xprops[i];
 				di->DevicePropertiesSupported_len += xsize;
+				ptp_deviceinfo_index (di);
 				free (xprops);
 			} else {
 				gp_log (GP_LOG_ERROR, "ptp2/fixup", "ptp_nikon_get_vendorpropcodes() failed with 0x%04x", ret);
@@ -1734,6 +1741,16 @@ ptp_error_func (void *data, const char *format, va_list args)
 	gp_context_error (ptp_data->context, "%s", buf);
 }
 
+static void
+ptp_transaction_func (PTPParams *params, uint16_t code, uint16_t ret,
+		      uint64_t usec, unsigned int retries)
+{
+	PTPData *ptp_data = params->data;
+
+	gp_camera_record_operation (ptp_data->camera, code, usec,
+				    translate_ptp_result (ret), retries);
+}
+
 static int
 is_mtp_capable(Camera *camera) {
 	PTPParams *params = &camera->pl->params;
@@ -1873,18 +1890,21 @@ camera_exit (Camera *camera, GPContext *context)
 {
 	if (camera->pl!=NULL) {
 		PTPParams *params = &camera->pl->params;
-		PTPContainer event;
+		PTPContainer events[16];
+		unsigned int i, n;
 		SET_CONTEXT_P(params, context);
 		/* Disable EOS capture now, also end viewfinder mode. */
 		if (params->eos_captureenabled) {
 			if (camera->pl->checkevents) {
-				PTPCanon_changes_entry entry;
+				PTPCanon_changes_entry entries[16];
 
 				ptp_check_eos_events (params);
-				while (ptp_get_one_eos_event (params, &entry)) {
-					gp_log (GP_LOG_DEBUG, "camera_exit", "missed EOS ptp type %d", entry.type);
-					if (entry.type == PTP_CANON_EOS_CHANGES_TYPE_UNKNOWN)
-						free (entry.u.info);
+				while ((n = ptp_get_eos_events (params, entries, 16))) {
+					for (i=0;i<n;i++) {
+						gp_log (GP_LOG_DEBUG, "camera_exit", "missed EOS ptp type %d", entries[i].type);
+						if (entries[i].type == PTP_CANON_EOS_CHANGES_TYPE_UNKNOWN)
+							free (entries[i].u.info);
+					}
 				}
 				camera->pl->checkevents = 0;
 			}
@@ -1895,8 +1915,9 @@ camera_exit (Camera *camera, GPContext *context)
 
 		if (camera->pl->checkevents)
 			ptp_check_event (params);
-		while (ptp_get_one_event (params, &event))
-			gp_log (GP_LOG_DEBUG, "camera_exit", "missed ptp event 0x%x (param1=%x)", event.Code, event.Param1);
+		while ((n = ptp_get_events (params, events, 16)))
+			for (i=0;i<n;i++)
+				gp_log (GP_LOG_DEBUG, "camera_exit", "missed ptp event 0x%x (param1=%x)", events[i].Code, events[i].Param1);
 		/* close ptp session */
 		ptp_closesession (params);
 		ptp_free_params(params);
@@ -1908,6 +1929,7 @@ camera_exit (Camera *camera, GPContext *context)
 #endif
 
 		free (params->data);
+		free (camera->pl->preview_buf);
 		free (camera->pl); /* also frees params */
 		params = NULL;
 		camera->pl = NULL;
@@ -1957,20 +1979,164 @@ add_object (Camera *camera, uint32_t handle, GPContext *context)
 	return translate_ptp_result (ptp_object_want (params, handle, 0, &ob));
 }
 
+/* The preview images are received into a buffer of the camera that is
+ * kept between the frames, so fetching a live view image does not need
+ * to allocate once the buffer has grown to the image size.
+ */
+static uint16_t
+previewbuf_grow (CameraPrivateLibrary *pl, unsigned long wantlen)
+{
+	unsigned char	*newbuf;
+	unsigned long	newalloc;
+
+	if (pl->preview_size + wantlen <= pl->preview_alloc)
+		return PTP_RC_OK;
+	newalloc = pl->preview_alloc ? pl->preview_alloc : 65536;
+	while (newalloc < pl->preview_size + wantlen)
+		newalloc *= 2;
+	newbuf = realloc (pl->preview_buf, newalloc);
+	if (!newbuf)
+		return PTP_RC_GeneralError;
+	pl->preview_buf   = newbuf;
+	pl->preview_alloc = newalloc;
+	return PTP_RC_OK;
+}
+
+static uint16_t
+previewbuf_putfunc (PTPParams *params, void *xpriv,
+	unsigned long sendlen, unsigned char *bytes,
+	unsigned long *written
+) {
+	CameraPrivateLibrary *pl = (CameraPrivateLibrary*)xpriv;
+
+	/* Data read in place via previewbuf_getbuffunc() */
+	if (bytes != pl->preview_buf + pl->preview_size) {
+		if (previewbuf_grow (pl, sendlen) != PTP_RC_OK)
+			return PTP_RC_GeneralError;
+		memcpy (pl->preview_buf + pl->preview_size, bytes, sendlen);
+	}
+	pl->preview_size += sendlen;
+	*written = sendlen;
+	return PTP_RC_OK;
+}
+
+static uint16_t
+previewbuf_getbuffunc (PTPParams *params, void *xpriv,
+	unsigned long wantlen, unsigned char **bytes
+) {
+	CameraPrivateLibrary *pl = (CameraPrivateLibrary*)xpriv;
+
+	if (previewbuf_grow (pl, wantlen) != PTP_RC_OK)
+		return PTP_RC_GeneralError;
+	*bytes = pl->preview_buf + pl->preview_size;
+	return PTP_RC_OK;
+}
+
+static void
+ptp_init_previewbuf_handler (PTPDataHandler *handler, CameraPrivateLibrary *pl) {
+	handler->priv = pl;
+	handler->getfunc = NULL;
+	handler->putfunc = previewbuf_putfunc;
+	handler->getbuffunc = previewbuf_getbuffunc;
+	pl->preview_size = 0;
+}
+
+/* Finds the JPEG image between the SOI and EOI markers in the data
+ * returned by the Nikon GetLiveViewImg operation.
+ */
 static int
-camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
+nikon_preview_jpeg (unsigned char *data, unsigned long size,
+		    unsigned char **jpgStart, unsigned char **jpgEnd)
+{
+	unsigned char	*jpgStartPtr, *jpgEndPtr;
+
+	/* look for the JPEG SOI marker (0xFFD8) in data */
+	jpgStartPtr = (unsigned char*)memchr(data, 0xff, size);
+	while(jpgStartPtr && ((jpgStartPtr+1) < (data + size))) {
+		if(*(jpgStartPtr + 1) == 0xd8) { /* SOI found */
+			break;
+		} else { /* go on looking (starting at next byte) */
+			jpgStartPtr++;
+			jpgStartPtr = (unsigned char*)memchr(jpgStartPtr, 0xff, data + size - jpgStartPtr);
+		}
+	}
+	if(!jpgStartPtr) /* no SOI -> no JPEG */
+		return GP_ERROR;
+	/* if SOI found, start looking for EOI marker (0xFFD9) one byte after SOI
+	   (just to be sure we will not go beyond the end of the data array) */
+	jpgEndPtr = (unsigned char*)memchr(jpgStartPtr+1, 0xff, data+size-jpgStartPtr-1);
+	while(jpgEndPtr && ((jpgEndPtr+1) < (data + size))) {
+		if(*(jpgEndPtr + 1) == 0xd9) { /* EOI found */
+			jpgEndPtr += 2;
+			break;
+		} else { /* go on looking (starting at next byte) */
+			jpgEndPtr++;
+			jpgEndPtr = (unsigned char*)memchr(jpgEndPtr, 0xff, data + size - jpgEndPtr);
+		}
+	}
+	if(!jpgEndPtr) /* no EOI -> no JPEG */
+		return GP_ERROR;
+	*jpgStart = jpgStartPtr;
+	*jpgEnd = jpgEndPtr;
+	return GP_OK;
+}
+
+/* Finds the JPEG blob in the data returned by the Canon EOS
+ * GetViewFinderData operation.
+ */
+static int
+eos_preview_jpeg (PTPParams *params, unsigned char *data, unsigned long size,
+		  unsigned char **jpeg, unsigned long *jpeglen)
+{
+	unsigned char	*xdata = data;
+	int		found = 0;
+
+	/* returns multiple blobs, they are usually structured as
+	 * uint32 len
+	 * uint32 type
+	 * ... data ... 
+	 *
+	 * 1: JPEG preview
+	 */
+	gp_log (GP_LOG_DEBUG,"ptp2_capture_eos_preview", "total size: len=%ld", size);
+	while ((xdata-data) + 8 <= size) {
+		uint32_t	len  = dtoh32a(xdata);
+		uint32_t	type = dtoh32a(xdata+4);
+
+		gp_log (GP_LOG_DEBUG,"ptp2_capture_eos_preview", "get_viewfinder_image header: len=%d type=%d", len, type);
+		if (len > (size-(xdata-data))) {
+			gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview", "len=%d larger than rest size %ld", len, (size-(xdata-data)));
+			break;
+		}
+		if (len < 8)
+			break;
+		if ((type == 1) && !found) {
+			*jpeg = xdata+8;
+			*jpeglen = len-8;
+			found = 1;
+		} else
+			gp_log_data ("ptp2_capture_eos_preview", (char*)xdata, len);
+		xdata = xdata+len;
+	}
+	return found ? GP_OK : GP_ERROR;
+}
+
+/* Switches on the viewfinder / live view, the part of getting a preview
+ * that only needs to be done once for a series of preview images.
+ */
+static int
+preview_prepare (Camera *camera, GPContext *context)
 {
-	unsigned char	*data = NULL, *jpgStartPtr = NULL, *jpgEndPtr = NULL;
-	uint32_t	size = 0;
 	int ret;
 	PTPParams *params = &camera->pl->params;
 
-	camera->pl->checkevents = TRUE;
+	/* The viewfinder changes what a trigger needs to do */
+	camera->pl->trigger_prepared = 0;
+
 	switch (params->deviceinfo.VendorExtensionID) {
 	case PTP_VENDOR_CANON:
 		/* Canon PowerShot / IXUS preview mode */
 		if (ptp_operation_issupported(params, PTP_OC_CANON_ViewfinderOn)) {
-			SET_CONTEXT_P(params, context);
 			/* check if we need to prepare capture */
 			if (!params->canon_event_mode) {
 				ret = camera_prepare_capture (camera, context);
@@ -1981,36 +2147,17 @@ camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 				ret = ptp_canon_viewfinderon (params);
 				if (ret != PTP_RC_OK) {
 					gp_context_error (context, _("Canon enable viewfinder failed: %d"), ret);
-					SET_CONTEXT_P(params, NULL);
 					return translate_ptp_result (ret);
 				}
 				params->canon_viewfinder_on = 1;
 			}
-			ret = ptp_canon_getviewfinderimage (params, &data, &size);
-			if (ret != PTP_RC_OK) {
-				gp_context_error (context, _("Canon get viewfinder image failed: %d"), ret);
-				SET_CONTEXT_P(params, NULL);
-				return translate_ptp_result (ret);
-			}
-			gp_file_append ( file, (char*)data, size );
-			free (data);
-			gp_file_set_mime_type (file, GP_MIME_JPEG);     /* always */
-			/* Add an arbitrary file name so caller won't crash */
-			gp_file_set_name (file, "canon_preview.jpg");
-			gp_file_set_mtime (file, time(NULL));
-			SET_CONTEXT_P(params, NULL);
 			return GP_OK;
 		}
 		/* Canon EOS DSLR preview mode */
 		if (ptp_operation_issupported(params, PTP_OC_CANON_EOS_GetViewFinderData)) {
 			PTPPropertyValue	val;
-			/* FIXME: this might cause a focusing pass and take seconds. 20 was not
-			 * enough. */
-			int 			tries = 100;
 			PTPDevicePropDesc       dpd;
 
-			SET_CONTEXT_P(params, context);
-
 			if (!params->eos_captureenabled)
 				camera_prepare_capture (camera, context);
 			memset (&dpd,0,sizeof(dpd));
@@ -2022,6 +2169,7 @@ camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 				ret = ptp_canon_eos_setdevicepropvalue (params, PTP_DPC_CANON_EOS_EVFOutputDevice, &val, PTP_DTC_UINT32);
 				if (ret != PTP_RC_OK) {
 					gp_log (GP_LOG_ERROR,"ptp2_prepare_eos_preview", "setval of evf outputmode to 2 failed!");
+					ptp_free_devicepropdesc (&dpd);
 					return translate_ptp_result (ret);
 				}
 			}
@@ -2033,96 +2181,19 @@ camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 				return translate_ptp_result (ret);
 
 			params->eos_viewfinderenabled = 1;
-			while (tries--) {
-				/* Poll for camera events, but just call
-				 * it once and do not drain the queue now */
-				ret = ptp_check_eos_events (params);
-				if (ret != PTP_RC_OK)
-					return translate_ptp_result (ret);
-
-				ret = ptp_canon_eos_get_viewfinder_image (params , &data, &size);
-				if (ret == PTP_RC_OK) {
-					unsigned char	*xdata = data;
-
-					/* returns multiple blobs, they are usually structured as
-					 * uint32 len
-					 * uint32 type
-					 * ... data ... 
-					 *
-					 * 1: JPEG preview
-					 */
-
-					gp_log (GP_LOG_DEBUG,"ptp2_capture_eos_preview", "total size: len=%d", size);
-					while ((xdata-data) < size) {
-						uint32_t	len  = dtoh32a(xdata);
-						uint32_t	type = dtoh32a(xdata+4);
-
-						/* 4 byte len of jpeg data, 4 byte type */
-						/* JPEG blob */
-						/* stuff */
-						gp_log (GP_LOG_DEBUG,"ptp2_capture_eos_preview", "get_viewfinder_image header: len=%d type=%d", len, type);
-						if (type != 1) {
-							gp_log_data ("ptp2_capture_eos_preview", (char*)xdata, len);
-							xdata = xdata+len;
-							continue;
-						}
-
-						if (len > (size-(xdata-data))) {
-							len = size;
-							gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview", "len=%d larger than rest size %ld", len, (size-(xdata-data)));
-							break;
-						}
-						gp_file_append ( file, (char*)xdata+8, len-8 );
-						gp_file_set_mime_type (file, GP_MIME_JPEG);     /* always */
-						/* Add an arbitrary file name so caller won't crash */
-						gp_file_set_name (file, "preview.jpg");
-
-						/* dump the rest of the blobs */
-						xdata = xdata+len;
-						while ((xdata-data) < size) {
-							uint32_t	len  = dtoh32a(xdata);
-							uint32_t	type = dtoh32a(xdata+4);
-
-							gp_log (GP_LOG_DEBUG,"ptp2_capture_eos_preview", "get_viewfinder_image header: len=%d type=%d", len, type);
-							if (len > (size-(xdata-data))) {
-								len = size;
-								gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview", "len=%d larger than rest size %ld", len, (size-(xdata-data)));
-								break;
-							}
-							gp_log_data ("ptp2_capture_eos_preview", (char*)xdata, len);
-							xdata = xdata+len;
-						}
-						free (data);
-						SET_CONTEXT_P(params, NULL);
-						return GP_OK;
-					}
-					return GP_ERROR;
-				} else {
-					if ((ret == 0xa102) || (ret == PTP_RC_DeviceBusy)) { /* means "not there yet" ... so wait */
-						usleep (1300);
-						continue;
-					}
-					gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview", "get_viewfinder_image failed: 0x%x", ret);
-					SET_CONTEXT_P(params, NULL);
-					return translate_ptp_result (ret);
-				}
-			}
-			gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview","get_viewfinder_image failed after 20 tries with ret: 0x%x\n", ret);
-			SET_CONTEXT_P(params, NULL);
-			return translate_ptp_result (ret);
+			camera->pl->preview_lastcheck = time(NULL);
+			return GP_OK;
 		}
 		gp_context_error (context, _("Sorry, your Canon camera does not support Canon Viewfinder mode"));
 		return GP_ERROR_NOT_SUPPORTED;
 	case PTP_VENDOR_NIKON: {
 		PTPPropertyValue	value;
-		int 			tries;
 
 		if (!ptp_operation_issupported(params, PTP_OC_NIKON_StartLiveView)) {
 			gp_context_error (context,
 				_("Sorry, your Nikon camera does not support LiveView mode"));
 			return GP_ERROR_NOT_SUPPORTED;
 		}
-		SET_CONTEXT_P(params, context);
 		ret = ptp_getdevicepropvalue (params, PTP_DPC_NIKON_LiveViewStatus, &value, PTP_DTC_UINT8);
 		if (ret != PTP_RC_OK)
 			value.u8 = 0;
@@ -2135,7 +2206,6 @@ camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 			ret = ptp_nikon_start_liveview (params);
 			if (ret != PTP_RC_OK) {
 				gp_context_error (context, _("Nikon enable liveview failed: %x"), ret);
-				SET_CONTEXT_P(params, NULL);
 				return translate_ptp_result (ret);
 			}
 			do {
@@ -2145,77 +2215,208 @@ camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 
 			if (ret != PTP_RC_OK) {
 				gp_context_error (context, _("Nikon enable liveview failed: %x"), ret);
-				SET_CONTEXT_P(params, NULL);
 				return translate_ptp_result (ret);
 			}
 		}
+		return GP_OK;
+	}
+	default:
+		break;
+	}
+	return GP_ERROR_NOT_SUPPORTED;
+}
+
+/* Fetches one preview image, the viewfinder / live view has to be
+ * switched on by preview_prepare() before. Streams poll the camera for
+ * events only once a second, single previews before every try.
+ */
+static int
+preview_fetch (Camera *camera, CameraFile *file, int stream, GPContext *context)
+{
+	PTPParams	*params = &camera->pl->params;
+	PTPDataHandler	handler;
+	int		ret, tries;
+
+	ptp_init_previewbuf_handler (&handler, camera->pl);
+	switch (params->deviceinfo.VendorExtensionID) {
+	case PTP_VENDOR_CANON:
+		/* Canon PowerShot / IXUS preview mode */
+		if (ptp_operation_issupported(params, PTP_OC_CANON_ViewfinderOn)) {
+			uint32_t	size = 0;
+
+			ret = ptp_canon_getviewfinderimage_handler (params, &handler, &size);
+			if (ret != PTP_RC_OK) {
+				gp_context_error (context, _("Canon get viewfinder image failed: %d"), ret);
+				return translate_ptp_result (ret);
+			}
+			if (size > camera->pl->preview_size)
+				size = camera->pl->preview_size;
+			CR (gp_file_append (file, (char*)camera->pl->preview_buf, size));
+			gp_file_set_mime_type (file, GP_MIME_JPEG);     /* always */
+			/* Add an arbitrary file name so caller won't crash */
+			gp_file_set_name (file, "canon_preview.jpg");
+			gp_file_set_mtime (file, time(NULL));
+			return GP_OK;
+		}
+		/* Canon EOS DSLR preview mode */
+		/* FIXME: this might cause a focusing pass and take seconds. 20 was not
+		 * enough. */
+		tries = 100;
+		while (tries--) {
+			/* Poll for camera events, but just call it once and
+			 * do not drain the queue now */
+			if (!stream) {
+				ret = ptp_check_eos_events (params);
+				if (ret != PTP_RC_OK)
+					return translate_ptp_result (ret);
+			} else if (camera->pl->preview_lastcheck != time(NULL)) {
+				/* also keep the camera from shutting down */
+				ret = ptp_check_eos_events (params);
+				if (ret != PTP_RC_OK)
+					return translate_ptp_result (ret);
+				ret = ptp_canon_eos_keepdeviceon (params);
+				if (ret != PTP_RC_OK)
+					return translate_ptp_result (ret);
+				camera->pl->preview_lastcheck = time(NULL);
+			}
+
+			camera->pl->preview_size = 0;
+			ret = ptp_canon_eos_get_viewfinder_image_handler (params, &handler);
+			if (ret == PTP_RC_OK) {
+				unsigned char	*jpeg;
+				unsigned long	jpeglen;
+
+				CR (eos_preview_jpeg (params, camera->pl->preview_buf, camera->pl->preview_size, &jpeg, &jpeglen));
+				CR (gp_file_append (file, (char*)jpeg, jpeglen));
+				gp_file_set_mime_type (file, GP_MIME_JPEG);     /* always */
+				/* Add an arbitrary file name so caller won't crash */
+				gp_file_set_name (file, "preview.jpg");
+				return GP_OK;
+			}
+			if ((ret == 0xa102) || (ret == PTP_RC_DeviceBusy)) { /* means "not there yet" ... so wait */
+				/* see whether the camera told us something meanwhile */
+				camera->pl->preview_lastcheck = 0;
+				usleep (1300);
+				continue;
+			}
+			gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview", "get_viewfinder_image failed: 0x%x", ret);
+			return translate_ptp_result (ret);
+		}
+		gp_log (GP_LOG_ERROR,"ptp2_capture_eos_preview","get_viewfinder_image failed after 100 tries with ret: 0x%x\n", ret);
+		return translate_ptp_result (ret);
+	case PTP_VENDOR_NIKON:
 		tries = 20;
 		while (tries--) {
-			ret = ptp_nikon_get_liveview_image (params , &data, &size);
+			camera->pl->preview_size = 0;
+			ret = ptp_nikon_get_liveview_image_handler (params, &handler);
 			if (ret == PTP_RC_OK) {
-				/* look for the JPEG SOI marker (0xFFD8) in data */
-				jpgStartPtr = (unsigned char*)memchr(data, 0xff, size);
-				while(jpgStartPtr && ((jpgStartPtr+1) < (data + size))) {
-					if(*(jpgStartPtr + 1) == 0xd8) { /* SOI found */
-						break;
-					} else { /* go on looking (starting at next byte) */
-						jpgStartPtr++;
-						jpgStartPtr = (unsigned char*)memchr(jpgStartPtr, 0xff, data + size - jpgStartPtr);
-					}
-				}
-				if(!jpgStartPtr) { /* no SOI -> no JPEG */
-					gp_context_error (context, _("Sorry, your Nikon camera does not seem to return a JPEG image in LiveView mode"));
-					return GP_ERROR;
-				}
-				/* if SOI found, start looking for EOI marker (0xFFD9) one byte after SOI
-				   (just to be sure we will not go beyond the end of the data array) */
-				jpgEndPtr = (unsigned char*)memchr(jpgStartPtr+1, 0xff, data+size-jpgStartPtr-1);
-				while(jpgEndPtr && ((jpgEndPtr+1) < (data + size))) {
-					if(*(jpgEndPtr + 1) == 0xd9) { /* EOI found */
-						jpgEndPtr += 2;
-						break;
-					} else { /* go on looking (starting at next byte) */
-						jpgEndPtr++;
-						jpgEndPtr = (unsigned char*)memchr(jpgEndPtr, 0xff, data + size - jpgEndPtr);
-					}
-				}
-				if(!jpgEndPtr) { /* no EOI -> no JPEG */
+				unsigned char	*jpgStartPtr = NULL, *jpgEndPtr = NULL;
+
+				/* FIXME: perhaps handle the 128 byte header data too. */
+				if (nikon_preview_jpeg (camera->pl->preview_buf, camera->pl->preview_size, &jpgStartPtr, &jpgEndPtr) != GP_OK) {
 					gp_context_error (context, _("Sorry, your Nikon camera does not seem to return a JPEG image in LiveView mode"));
 					return GP_ERROR;
 				}
-				gp_file_append (file, (char*)jpgStartPtr, jpgEndPtr-jpgStartPtr);
-				free (data); /* FIXME: perhaps handle the 128 byte header data too. */
+				CR (gp_file_append (file, (char*)jpgStartPtr, jpgEndPtr-jpgStartPtr));
 				gp_file_set_mime_type (file, GP_MIME_JPEG);     /* always */
 				/* Add an arbitrary file name so caller won't crash */
 				gp_file_set_name (file, "preview.jpg");
 				gp_file_set_mtime (file, time(NULL));
-				break;
+				return GP_OK;
 			}
 			if (ret == PTP_RC_DeviceBusy) {
 				gp_log (GP_LOG_DEBUG, "ptp2/nikon_liveview", "busy, retrying after a bit of wait, try %d", tries);
 				usleep(10*1000);
 				continue;
 			}
-			SET_CONTEXT_P(params, NULL);
 			return translate_ptp_result (ret);
 		}
-#if 0
-		ret = ptp_nikon_end_liveview (params);
-		if (ret != PTP_RC_OK) {
-			gp_context_error (context, _("Nikon disable liveview failed: %x"), ret);
-			SET_CONTEXT_P(params, NULL);
-			//return GP_ERROR;
-		}
-#endif
-		SET_CONTEXT_P(params, NULL);
-		return GP_OK;
-	}
+		/* still busy after all tries */
+		return translate_ptp_result (ret);
 	default:
 		break;
 	}
 	return GP_ERROR_NOT_SUPPORTED;
 }
 
+static int
+camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
+{
+	int ret;
+	PTPParams *params = &camera->pl->params;
+
+	camera->pl->checkevents = TRUE;
+	SET_CONTEXT_P(params, context);
+	ret = preview_prepare (camera, context);
+	if (ret == GP_OK)
+		ret = preview_fetch (camera, file, 0, context);
+	SET_CONTEXT_P(params, NULL);
+	return ret;
+}
+
+static int
+camera_start_preview_stream (Camera *camera, GPContext *context)
+{
+	int ret;
+	PTPParams *params = &camera->pl->params;
+
+	camera->pl->checkevents = TRUE;
+	SET_CONTEXT_P(params, context);
+	ret = preview_prepare (camera, context);
+	SET_CONTEXT_P(params, NULL);
+	return ret;
+}
+
+static int
+camera_read_preview_frame (Camera *camera, CameraFile *file, GPContext *context)
+{
+	int ret;
+	PTPParams *params = &camera->pl->params;
+
+	SET_CONTEXT_P(params, context);
+	ret = preview_fetch (camera, file, 1, context);
+	SET_CONTEXT_P(params, NULL);
+	return ret;
+}
+
+static int
+camera_stop_preview_stream (Camera *camera, GPContext *context)
+{
+	int ret = PTP_RC_OK;
+	PTPParams *params = &camera->pl->params;
+
+	SET_CONTEXT_P(params, context);
+	switch (params->deviceinfo.VendorExtensionID) {
+	case PTP_VENDOR_CANON:
+		if (params->canon_viewfinder_on) {
+			ret = ptp_canon_viewfinderoff (params);
+			if (ret != PTP_RC_OK)
+				gp_context_error (context, _("Canon disable viewfinder failed: %d"), ret);
+			params->canon_viewfinder_on = 0;
+		}
+		if (params->eos_viewfinderenabled) {
+			ret = ptp_canon_eos_end_viewfinder (params);
+			params->eos_viewfinderenabled = 0;
+		}
+		break;
+	case PTP_VENDOR_NIKON:
+		if (ptp_operation_issupported(params, PTP_OC_NIKON_EndLiveView)) {
+			ret = ptp_nikon_end_liveview (params);
+			if (ret != PTP_RC_OK)
+				gp_context_error (context, _("Nikon disable liveview failed: %x"), ret);
+		}
+		break;
+	default:
+		break;
+	}
+	SET_CONTEXT_P(params, NULL);
+
+	free (camera->pl->preview_buf);
+	camera->pl->preview_buf = NULL;
+	camera->pl->preview_size = camera->pl->preview_alloc = 0;
+	return translate_ptp_result (ret);
+}
+
 static int
 get_folder_from_handle (Camera *camera, uint32_t storage, uint32_t handle, char *folder) {
 	int ret;
@@ -2230,8 +2431,6 @@ get_folder_from_handle (Camera *camera, uint32_t storage, uint32_t handle, char
 	ret = get_folder_from_handle (camera, storage, ob->oi.ParentObject, folder);
 	if (ret != GP_OK)
 		return ret;
-	/* now ob could be invalid, since we might have reallocated params->objects */
-	ptp_object_want (params, handle, PTPOBJECT_OBJECTINFO_LOADED, &ob);
 	strcat (folder, ob->oi.Filename);
 	strcat (folder, "/");
 	return (GP_OK);
@@ -2972,6 +3171,8 @@ camera_capture (Camera *camera, CameraCaptureType type, CameraFilePath *path,
 		return GP_ERROR_NOT_SUPPORTED;
 
 	SET_CONTEXT_P(params, context);
+	/* a prepared trigger does not survive a capture */
+	camera->pl->trigger_prepared = 0;
 	camera->pl->checkevents = TRUE;
 
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_NIKON) &&
@@ -3088,6 +3289,8 @@ camera_capture (Camera *camera, CameraCaptureType type, CameraFilePath *path,
 			/* we're not setting *path on error! */
 			return translate_ptp_result (ret);
 		}
+		if (event.Code == PTP_EC_DevicePropChanged)
+			ptp_invalidate_devicepropdesc (params, event.Param1);
 		switch (event.Code) {
 		case PTP_EC_ObjectRemoved:
 			/* Perhaps from previous Canon based capture + delete. Ignore. */
@@ -3138,80 +3341,74 @@ out:
 	return GP_OK;
 }
 
+/* The ways camera_trigger_capture can release the shutter */
+enum {
+	TRIGGER_NIKON_SDRAM,
+	TRIGGER_NIKON_CARD,
+	TRIGGER_CANON_EOS,
+	TRIGGER_CANON_POWERSHOT,
+	TRIGGER_GENERIC
+};
+
 static int
-camera_trigger_capture (Camera *camera, GPContext *context)
+trigger_method (PTPParams *params, char *buf)
 {
-	PTPParams *params = &camera->pl->params;
-	uint16_t	ret;
-	char buf[1024];
-
-	SET_CONTEXT_P(params, context);
-
 	strcpy (buf, "card");
 	gp_setting_get("ptp2","capturetarget",buf);
 
-	gp_log (GP_LOG_DEBUG, "ptp2/trigger_capture", "Triggering capture to %s", buf);
-
-	/* Nikon */
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_NIKON) &&
 		(ptp_operation_issupported(params, PTP_OC_NIKON_Capture) ||
 		 ptp_operation_issupported(params, PTP_OC_NIKON_AfCaptureSDRAM) 
 		)
 		&& !strcmp (buf, "sdram")
-	) {
-		/* If in liveview mode, we have to run non-af capture */
-		int inliveview = 0;
-		PTPPropertyValue propval;
-
-		CPR (context, ptp_check_event (params));
-		CPR (context, nikon_wait_busy (params, 20, 1000));
-		CPR (context, ptp_check_event (params));
-
-		if (ptp_property_issupported (params, PTP_DPC_NIKON_LiveViewStatus)) {
-			ret = ptp_getdevicepropvalue (params, PTP_DPC_NIKON_LiveViewStatus, &propval, PTP_DTC_UINT8);
-			if (ret == PTP_RC_OK)
-				inliveview = propval.u8;
-		}
-
-		if (!inliveview && ptp_operation_issupported (params,PTP_OC_NIKON_AfCaptureSDRAM))
-			ret = ptp_nikon_capture_sdram (params);
-		else
-			ret = ptp_nikon_capture (params, 0xffffffff);
-		if (ret != PTP_RC_OK)
-			return translate_ptp_result (ret);
-		while (PTP_RC_DeviceBusy == ptp_nikon_device_ready (params));
-		return GP_OK;
-	}
-	/* Nikon 2 */
+	)
+		return TRIGGER_NIKON_SDRAM;
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_NIKON) &&
 		ptp_operation_issupported(params, PTP_OC_NIKON_InitiateCaptureRecInMedia) &&
 		!strcmp (buf, "card")
-	) {
-		/* If in liveview mode, we have to run non-af capture */
-		int inliveview = 0;
-		PTPPropertyValue propval;
+	)
+		return TRIGGER_NIKON_CARD;
+	if ((params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+	     ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteRelease))
+		return TRIGGER_CANON_EOS;
+	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+		ptp_operation_issupported(params, PTP_OC_CANON_InitiateCaptureInMemory)
+	)
+		return TRIGGER_CANON_POWERSHOT;
+	return TRIGGER_GENERIC;
+}
 
+/* Everything camera_trigger_capture needs to do before the release */
+static int
+trigger_prepare (Camera *camera, GPContext *context)
+{
+	PTPParams *params = &camera->pl->params;
+	uint16_t	ret;
+	char buf[1024];
+	PTPPropertyValue propval;
+	int method = trigger_method (params, buf);
+
+	/* If in liveview mode, we have to run non-af capture */
+	camera->pl->trigger_inliveview = 0;
+
+	switch (method) {
+	case TRIGGER_NIKON_SDRAM:
+	case TRIGGER_NIKON_CARD:
 		CPR (context, ptp_check_event (params));
-		while (PTP_RC_DeviceBusy == ptp_nikon_device_ready (params));
+		if (method == TRIGGER_NIKON_SDRAM) {
+			CPR (context, nikon_wait_busy (params, 20, 1000));
+		} else {
+			while (PTP_RC_DeviceBusy == ptp_nikon_device_ready (params));
+		}
 		CPR (context, ptp_check_event (params));
 
 		if (ptp_property_issupported (params, PTP_DPC_NIKON_LiveViewStatus)) {
 			ret = ptp_getdevicepropvalue (params, PTP_DPC_NIKON_LiveViewStatus, &propval, PTP_DTC_UINT8);
 			if (ret == PTP_RC_OK)
-				inliveview = propval.u8;
+				camera->pl->trigger_inliveview = propval.u8;
 		}
-
-		ret = ptp_nikon_capture2 (params, !inliveview, 0);
-		if (ret != PTP_RC_OK)
-			return translate_ptp_result (ret);
-		while (PTP_RC_DeviceBusy == ptp_nikon_device_ready (params));
 		return GP_OK;
-	}
-	/* Canon EOS */
-	if ((params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
-	     ptp_operation_issupported(params, PTP_OC_CANON_EOS_RemoteRelease)) {
-		uint32_t	result;
-
+	case TRIGGER_CANON_EOS:
 		if (!params->eos_captureenabled)
 			camera_prepare_capture (camera, context);
 		else
@@ -3224,45 +3421,9 @@ camera_trigger_capture (Camera *camera, GPContext *context)
 			if (ret != PTP_RC_OK)
 				break;
 		} while (params->eos_camerastatus == 1);
-
-		ret = ptp_canon_eos_capture (params, &result);
-		if (ret != PTP_RC_OK) {
-			gp_context_error (context, _("Canon EOS Trigger Capture failed: 0x%x (result 0x%x)"), ret, result);
-			return translate_ptp_result (ret);
-		}
-		if ((result & 0x7000) == 0x2000) { /* also happened */
-			gp_context_error (context, _("Canon EOS Trigger Capture failed: 0x%x"), result);
-			return translate_ptp_result (result);
-		}
-		gp_log (GP_LOG_DEBUG, "ptp2/canon_eos_capture", "result is %d", result);
-		if (result == 1) {
-			gp_context_error (context, _("Canon EOS Trigger Capture failed to release: Perhaps no focus?"));
-			return GP_ERROR;
-		}
-		if (result == 7) {
-			gp_context_error (context, _("Canon EOS Trigger Capture failed to release: Perhaps no more memory on card?"));
-			return GP_ERROR_NO_MEMORY;
-		}
-		if (result) {
-			gp_context_error (context, _("Canon EOS Trigger Capture failed to release: Unknown error %d, please report."), result);
-			return GP_ERROR;
-		}
-		/* wait until camera reports busy ... */
-		do {
-			ptp_check_eos_events (params);
-		} while (params->eos_camerastatus == 0);
-		/* wait until camera reports ready ... */
-		do {
-			ptp_check_eos_events (params);
-		} while (params->eos_camerastatus == 1);
 		return GP_OK;
-	}
-	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
-		ptp_operation_issupported(params, PTP_OC_CANON_InitiateCaptureInMemory)
-	) {
+	case TRIGGER_CANON_POWERSHOT: {
 		uint16_t xmode;
-		/*int viewfinderwason = 0;*/
-		PTPPropertyValue propval;
 
 		if (!ptp_property_issupported(params, PTP_DPC_CANON_FlashMode)) {
 			/* did not call --set-config capture=on, do it for user */
@@ -3277,7 +3438,7 @@ camera_trigger_capture (Camera *camera, GPContext *context)
 		}
 
 		if (ptp_property_issupported(params, PTP_DPC_CANON_CaptureTransferMode)) {
-			if ((GP_OK == gp_setting_get("ptp2","capturetarget",buf)) && !strcmp(buf,"sdram"))
+			if (!strcmp(buf,"sdram"))
 				propval.u16 = xmode = CANON_TRANSFER_MEMORY;
 			else
 				propval.u16 = xmode = CANON_TRANSFER_CARD;
@@ -3310,10 +3471,8 @@ camera_trigger_capture (Camera *camera, GPContext *context)
 			ret = ptp_canon_viewfinderoff (params);
 			if (ret != PTP_RC_OK) {
 				gp_context_error (context, _("Canon disable viewfinder failed: %d"), ret);
-				SET_CONTEXT_P(params, NULL);
 				return translate_ptp_result (ret);
 			}
-			/*viewfinderwason = 1;*/
 			params->canon_viewfinder_on = 0;
 		}
 
@@ -3322,6 +3481,107 @@ camera_trigger_capture (Camera *camera, GPContext *context)
 		propval.u8 = 0;
 		ret = ptp_setdevicepropvalue(params, PTP_DPC_CANON_FlashMode, &propval, PTP_DTC_UINT8);
 	#endif
+		return GP_OK;
+	}
+	default:
+		break;
+	}
+	return GP_OK;
+}
+
+static int
+camera_prepare_trigger (Camera *camera, GPContext *context)
+{
+	PTPParams *params = &camera->pl->params;
+	char buf[1024];
+	int ret;
+
+	SET_CONTEXT_P(params, context);
+	camera->pl->trigger_prepared = 0;
+	ret = trigger_prepare (camera, context);
+	if (ret == GP_OK) {
+		camera->pl->trigger_prepared = 1;
+		camera->pl->trigger_prepared_method = trigger_method (params, buf);
+	}
+	SET_CONTEXT_P(params, NULL);
+	return ret;
+}
+
+static int
+camera_trigger_capture (Camera *camera, GPContext *context)
+{
+	PTPParams *params = &camera->pl->params;
+	uint16_t	ret;
+	char buf[1024];
+	int method;
+
+	SET_CONTEXT_P(params, context);
+
+	method = trigger_method (params, buf);
+	gp_log (GP_LOG_DEBUG, "ptp2/trigger_capture", "Triggering capture to %s", buf);
+
+	/* Unless camera_prepare_trigger did it already, for the same way
+	 * of releasing (the capture target might have changed since) */
+	if (!camera->pl->trigger_prepared ||
+	    (camera->pl->trigger_prepared_method != method))
+		CR (trigger_prepare (camera, context));
+	camera->pl->trigger_prepared = 0;
+
+	switch (method) {
+	/* Nikon */
+	case TRIGGER_NIKON_SDRAM:
+		if (!camera->pl->trigger_inliveview && ptp_operation_issupported (params,PTP_OC_NIKON_AfCaptureSDRAM))
+			ret = ptp_nikon_capture_sdram (params);
+		else
+			ret = ptp_nikon_capture (params, 0xffffffff);
+		if (ret != PTP_RC_OK)
+			return translate_ptp_result (ret);
+		while (PTP_RC_DeviceBusy == ptp_nikon_device_ready (params));
+		return GP_OK;
+	/* Nikon 2 */
+	case TRIGGER_NIKON_CARD:
+		ret = ptp_nikon_capture2 (params, !camera->pl->trigger_inliveview, 0);
+		if (ret != PTP_RC_OK)
+			return translate_ptp_result (ret);
+		while (PTP_RC_DeviceBusy == ptp_nikon_device_ready (params));
+		return GP_OK;
+	/* Canon EOS */
+	case TRIGGER_CANON_EOS: {
+		uint32_t	result;
+
+		ret = ptp_canon_eos_capture (params, &result);
+		if (ret != PTP_RC_OK) {
+			gp_context_error (context, _("Canon EOS Trigger Capture failed: 0x%x (result 0x%x)"), ret, result);
+			return translate_ptp_result (ret);
+		}
+		if ((result & 0x7000) == 0x2000) { /* also happened */
+			gp_context_error (context, _("Canon EOS Trigger Capture failed: 0x%x"), result);
+			return translate_ptp_result (result);
+		}
+		gp_log (GP_LOG_DEBUG, "ptp2/canon_eos_capture", "result is %d", result);
+		if (result == 1) {
+			gp_context_error (context, _("Canon EOS Trigger Capture failed to release: Perhaps no focus?"));
+			return GP_ERROR;
+		}
+		if (result == 7) {
+			gp_context_error (context, _("Canon EOS Trigger Capture failed to release: Perhaps no more memory on card?"));
+			return GP_ERROR_NO_MEMORY;
+		}
+		if (result) {
+			gp_context_error (context, _("Canon EOS Trigger Capture failed to release: Unknown error %d, please report."), result);
+			return GP_ERROR;
+		}
+		/* wait until camera reports busy ... */
+		do {
+			ptp_check_eos_events (params);
+		} while (params->eos_camerastatus == 0);
+		/* wait until camera reports ready ... */
+		do {
+			ptp_check_eos_events (params);
+		} while (params->eos_camerastatus == 1);
+		return GP_OK;
+	}
+	case TRIGGER_CANON_POWERSHOT:
 		while (1) {
 			ret = ptp_canon_initiatecaptureinmemory (params);
 			if (ret == PTP_RC_OK)
@@ -3341,8 +3601,9 @@ camera_trigger_capture (Camera *camera, GPContext *context)
 		}
 		gp_log (GP_LOG_DEBUG, "ptp/trigger_capture", "Canon Powershot capture triggered...");
 		return GP_OK;
+	default:
+		break;
 	}
-	
 
 #if 0
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
@@ -3539,7 +3800,9 @@ camera_wait_for_event (Camera *camera, int timeout,
 		ptp_operation_issupported(params, PTP_OC_CANON_CheckEvent)
 	) {
 		while (1) {
-			CPR (context, ptp_check_event (params));
+			/* drain the queued events before asking the camera again */
+			if (!params->nrofevents)
+				CPR (context, ptp_check_event (params));
 			if (ptp_get_one_event(params, &event)) {
 				gp_log (GP_LOG_DEBUG, "ptp","canon event: nparam=0x%X, C=0x%X, trans_id=0x%X, p1=0x%X, p2=0x%X, p3=0x%X", event.Nparam,event.Code,event.Transaction_ID, event.Param1, event.Param2, event.Param3);
 				switch (event.Code) {
@@ -3607,7 +3870,8 @@ camera_wait_for_event (Camera *camera, int timeout,
 		ptp_operation_issupported(params, PTP_OC_NIKON_CheckEvent)
 	) {
 		do {
-			CPR (context, ptp_check_event (params));
+			if (!params->nrofevents)
+				CPR (context, ptp_check_event (params));
 			if (!ptp_get_one_event (params, &event)) {
 				int i;
 
@@ -3783,7 +4047,8 @@ downloadnow:
 		*eventtype = GP_EVENT_TIMEOUT;
 		return GP_OK;
 	}
-	CPR (context, ptp_check_event(params));
+	if (!params->nrofevents)
+		CPR (context, ptp_check_event(params));
 	if (!ptp_get_one_event (params, &event)) {
 		/* FIXME: Might be another error, but usually is a timeout */
 		gp_log (GP_LOG_DEBUG, "ptp2/wait_for_event", "no events received.");
@@ -4040,6 +4305,7 @@ camera_summary (Camera* camera, CameraText* summary, GPContext *context)
 	char *txt;
 	PTPParams *params = &(camera->pl->params);
 	PTPDeviceInfo pdi;
+	PTPDevicePropDesc dpd;
 	PTPStorageIDs storageids;
 
 	SET_CONTEXT(camera, context);
@@ -4333,8 +4599,9 @@ camera_summary (Camera* camera, CameraText* summary, GPContext *context)
 	 */
 	CPR(context, ptp_getdeviceinfo (params, &pdi));
 	fixup_cached_deviceinfo (camera, &pdi);
+	/* the early exits below go through out, dpd is always freeable */
+	memset (&dpd, 0, sizeof (dpd));
         for (i=0;i<pdi.DevicePropertiesSupported_len;i++) {
-		PTPDevicePropDesc dpd;
 		unsigned int dpc = pdi.DevicePropertiesSupported[i];
 		const char *propname = ptp_get_property_description (params, dpc);
 
@@ -4344,7 +4611,7 @@ camera_summary (Camera* camera, CameraText* summary, GPContext *context)
 		} else {
 			n = snprintf(txt, spaceleft, "Property 0x%04x:", dpc);
 		}
-		if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+		if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 
 
 		/* Do not read the 0xd201 property (found on Creative Zen series).
@@ -4353,13 +4620,13 @@ camera_summary (Camera* camera, CameraText* summary, GPContext *context)
 		if (params->deviceinfo.VendorExtensionID==PTP_VENDOR_MICROSOFT) {
 			if (dpc == 0xd201) {
 				n = snprintf(txt, spaceleft, _(" not read out.\n"));
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				continue;
 			}
 		}
 		if (!ptp_operation_issupported(params, PTP_OC_GetDevicePropDesc)) {
 			n = snprintf(txt, spaceleft, _("cannot be queried.\n"));
-			if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+			if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 			continue;
 		}
 
@@ -4367,76 +4634,79 @@ camera_summary (Camera* camera, CameraText* summary, GPContext *context)
 		ret = ptp_getdevicepropdesc (params, dpc, &dpd);
 		if (ret == PTP_RC_OK) {
 			n = snprintf (txt, spaceleft, "(%s) ",_get_getset(dpd.GetSet));
-			if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+			if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 			n = snprintf (txt, spaceleft, "(type=0x%x) ",dpd.DataType);
-			if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+			if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 			switch (dpd.FormFlag) {
 			case PTP_DPFF_None:	break;
 			case PTP_DPFF_Range: {
 				n = snprintf (txt, spaceleft, "Range [");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n = _value_to_str (&dpd.FORM.Range.MinimumValue, dpd.DataType, txt, spaceleft);
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n = snprintf (txt, spaceleft, " - ");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n= _value_to_str (&dpd.FORM.Range.MaximumValue, dpd.DataType, txt, spaceleft);
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n = snprintf (txt, spaceleft, ", step ");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n= _value_to_str (&dpd.FORM.Range.StepSize, dpd.DataType, txt, spaceleft);
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n = snprintf (txt, spaceleft, "] value: ");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				break;
 			}
 			case PTP_DPFF_Enumeration:
 				n = snprintf (txt, spaceleft, "Enumeration [");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				if ((dpd.DataType & PTP_DTC_ARRAY_MASK) == PTP_DTC_ARRAY_MASK)  {
 					n = snprintf (txt, spaceleft, "\n\t");
-					if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+					if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				}
 				for (j = 0; j<dpd.FORM.Enum.NumberOfValues; j++) {
 					n = _value_to_str(dpd.FORM.Enum.SupportedValue+j,dpd.DataType,txt, spaceleft);
-					if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+					if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 					if (j != dpd.FORM.Enum.NumberOfValues-1) {
 						n = snprintf (txt, spaceleft, ",");
-						if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+						if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 						if ((dpd.DataType & PTP_DTC_ARRAY_MASK) == PTP_DTC_ARRAY_MASK)  {
 							n = snprintf (txt, spaceleft, "\n\t");
-							if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+							if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 						}
 					}
 				}
 				if ((dpd.DataType & PTP_DTC_ARRAY_MASK) == PTP_DTC_ARRAY_MASK)  {
 					n = snprintf (txt, spaceleft, "\n\t");
-					if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+					if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				}
 				n = snprintf (txt, spaceleft, "] value: ");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				break;
 			}
 			n = ptp_render_property_value(params, dpc, &dpd, sizeof(summary->text) - strlen(summary->text) - 1, txt);
-			if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+			if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 			if (n) {
 				n = snprintf(txt, spaceleft, " (");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n = _value_to_str (&dpd.CurrentValue, dpd.DataType, txt, spaceleft);
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 				n = snprintf(txt, spaceleft, ")");
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 			} else {
 				n = _value_to_str (&dpd.CurrentValue, dpd.DataType, txt, spaceleft);
-				if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+				if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 			}
 		} else {
 			n = snprintf (txt, spaceleft, _(" error %x on query."), ret);
-			if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
+			if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
 		}
-		n = snprintf(txt, spaceleft, "\n");
-		if (n>=spaceleft) return GP_OK;spaceleft-=n;txt+=n;
 		ptp_free_devicepropdesc (&dpd);
+		memset (&dpd, 0, sizeof (dpd));
+		n = snprintf(txt, spaceleft, "\n");
+		if (n>=spaceleft) goto out;spaceleft-=n;txt+=n;
         }
+out:
+	ptp_free_devicepropdesc (&dpd);
 	ptp_free_DI (&pdi);
 	return (GP_OK);
 }
@@ -4444,31 +4714,35 @@ camera_summary (Camera* camera, CameraText* summary, GPContext *context)
 static uint32_t
 find_child (PTPParams *params,const char *file,uint32_t storage,uint32_t handle,PTPObject **retob)
 {
-	unsigned int	i;
+	unsigned int	i, nrofchildren;
+	uint32_t	*children;
 	uint16_t	ret;
 
 	ret = ptp_list_folder (params, storage, handle);
 	if (ret != PTP_RC_OK)
 		return PTP_HANDLER_SPECIAL;
 
-	for (i = 0; i < params->nrofobjects; i++) {
-		PTPObject	*ob = &params->objects[i];
+	ret = ptp_object_children (params, handle, &children, &nrofchildren);
+	if (ret != PTP_RC_OK)
+		return PTP_HANDLER_SPECIAL;
+	for (i = 0; i < nrofchildren; i++) {
+		PTPObject	*ob;
 
-		ret = PTP_RC_OK;
-		if ((ob->flags & (PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED)) != (PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED))
-			ret = ptp_object_want (params, params->objects[i].oid, PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED, &ob);
+		ret = ptp_object_want (params, children[i], PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED, &ob);
 		if (ret != PTP_RC_OK)
-			return PTP_HANDLER_SPECIAL;
+			break;
 		if ((ob->oi.StorageID==storage) && (ob->oi.ParentObject==handle)) {
 			ret = ptp_object_want (params, ob->oid, PTPOBJECT_OBJECTINFO_LOADED, &ob);
 			if (ret != PTP_RC_OK)
-				return PTP_HANDLER_SPECIAL;
+				break;
 			if (!strcmp (ob->oi.Filename,file)) {
+				free (children);
 				if (retob) *retob = ob;
 				return ob->oid;
 			}
 		}
 	}
+	free (children);
 	/* else not found */
 	return PTP_HANDLER_SPECIAL;
 }
@@ -4500,6 +4774,44 @@ folder_to_handle(PTPParams *params, const char *folder, uint32_t storage, uint32
 	}
 }
 
+/* Set of the filenames already listed in one folder, to drop duplicates. */
+typedef struct {
+	const char	**names;
+	unsigned int	size;
+} PTPNameSet;
+
+static int
+nameset_init (PTPNameSet *set, unsigned int count)
+{
+	set->size = 16;
+	while (set->size < 2*count)
+		set->size *= 2;
+	set->names = calloc (set->size, sizeof(set->names[0]));
+	if (!set->names)
+		return GP_ERROR_NO_MEMORY;
+	return GP_OK;
+}
+
+/* Adds name, which has to stay valid while the set is used. Returns 1 if
+ * it was already in the set. */
+static int
+nameset_add (PTPNameSet *set, const char *name)
+{
+	unsigned int	h = 2166136261U;
+	const char	*s;
+
+	for (s = name; *s; s++)
+		h = (h ^ (unsigned char)*s) * 16777619U;
+	h &= set->size - 1;
+	while (set->names[h]) {
+		if (!strcmp (set->names[h], name))
+			return 1;
+		h = (h + 1) & (set->size - 1);
+	}
+	set->names[h] = name;
+	return 0;
+}
+
 static int
 file_list_func (CameraFilesystem *fs, const char *folder, CameraList *list,
 		void *data, GPContext *context)
@@ -4507,7 +4819,12 @@ file_list_func (CameraFilesystem *fs, const char *folder, CameraList *list,
     Camera *camera = (Camera *)data;
     PTPParams *params = &camera->pl->params;
     uint32_t parent, storage=0x0000000;
-    unsigned int i, hasgetstorageids;
+    unsigned int i, hasgetstorageids, nrofchildren;
+    uint32_t *children;
+    PTPNameSet names;
+    uint16_t ptpret = PTP_RC_OK;
+    uint32_t transactions = params->transaction_id;
+    int ret = GP_OK;
     SET_CONTEXT_P(params, context);
 
     gp_log (GP_LOG_DEBUG, "ptp2", "file_list_func(%s)", folder);
@@ -4531,45 +4848,59 @@ file_list_func (CameraFilesystem *fs, const char *folder, CameraList *list,
     CPR (context, ptp_list_folder (params, storage, parent));
     gp_log (GP_LOG_DEBUG, "file_list_func", "after list folder");
 
+    CPR (context, ptp_object_children (params, parent, &children, &nrofchildren));
+    ret = nameset_init (&names, nrofchildren);
+    if (ret < GP_OK) {
+	free (children);
+	return ret;
+    }
+
     hasgetstorageids = ptp_operation_issupported(params,PTP_OC_GetStorageIDs);
-    for (i = 0; i < params->nrofobjects; i++) {
+    for (i = 0; i < nrofchildren; i++) {
         PTPObject *ob;
-	/* not our parent -> next */
-	CPR (context, ptp_object_want (params, params->objects[i].oid, PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED, &ob));
 
-	if (params->objects[i].oi.ParentObject!=parent)
+	ptpret = ptp_object_want (params, children[i], PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED, &ob);
+	if (ptpret != PTP_RC_OK)
+		break;
+	/* not our parent -> next */
+	if (ob->oi.ParentObject!=parent)
 		continue;
 
 	/* not on our storage devices -> next */
 	if (	(hasgetstorageids &&
-		(params->objects[i].oi.StorageID != storage)))
+		(ob->oi.StorageID != storage)))
 		continue;
 
-	CPR (context, ptp_object_want (params, params->objects[i].oid, PTPOBJECT_OBJECTINFO_LOADED, &ob));
+	ptpret = ptp_object_want (params, ob->oid, PTPOBJECT_LISTINFO_LOADED, &ob);
+	if (ptpret != PTP_RC_OK)
+		break;
 	/* Is a directory -> next */
 	if (ob->oi.ObjectFormat == PTP_OFC_Association)
 		continue;
 
-	debug_objectinfo(params, params->objects[i].oid, &ob->oi);
+	debug_objectinfo(params, ob->oid, &ob->oi);
 
 	if (!ob->oi.Filename)
 	    continue;
 
-	if (1) {
-	    /* HP Photosmart 850, the camera tends to duplicate filename in the list.
-             * Original patch by clement.rezvoy@gmail.com */
-	    /* search backwards, likely gets hits faster. */
-	    /* FIXME Marcus: This is also O(n^2) ... bad for large directories. */
-	    if (GP_OK == gp_list_find_by_name(list, NULL, ob->oi.Filename)) {
+	/* HP Photosmart 850, the camera tends to duplicate filename in the list.
+         * Original patch by clement.rezvoy@gmail.com */
+	if (nameset_add (&names, ob->oi.Filename)) {
 		gp_log (GP_LOG_ERROR, "ptp2/file_list_func",
 			"Duplicate filename '%s' in folder '%s'. Ignoring nth entry.\n",
 			ob->oi.Filename, folder);
 		continue;
-	    }
 	}
-	CR(gp_list_append (list, ob->oi.Filename, NULL));
+	ret = gp_list_append (list, ob->oi.Filename, NULL);
+	if (ret < GP_OK)
+		break;
     }
-    return GP_OK;
+    free (children);
+    free (names.names);
+    gp_log (GP_LOG_DEBUG, "ptp2/file_list_func", "listed %d files of %u objects in %u transactions",
+	    gp_list_count (list), nrofchildren, params->transaction_id - transactions);
+    CPR (context, ptpret);
+    return ret;
 }
 
 static int
@@ -4577,8 +4908,13 @@ folder_list_func (CameraFilesystem *fs, const char *folder, CameraList *list,
 		void *data, GPContext *context)
 {
 	PTPParams *params = &((Camera *)data)->pl->params;
-	unsigned int i, hasgetstorageids;
+	unsigned int i, hasgetstorageids, nrofchildren;
 	uint32_t handler,storage;
+	uint32_t *children;
+	PTPNameSet names;
+	uint16_t ptpret = PTP_RC_OK;
+	uint32_t transactions = params->transaction_id;
+	int ret = GP_OK;
 
 	SET_CONTEXT_P(params, context);
 	gp_log (GP_LOG_DEBUG, "ptp2", "folder_list_func(%s)", folder);
@@ -4635,22 +4971,33 @@ folder_list_func (CameraFilesystem *fs, const char *folder, CameraList *list,
 	/* Look for objects we can present as directories.
 	 * Currently we specify *any* PTP association as directory.
 	 */
+	CPR (context, ptp_object_children (params, handler, &children, &nrofchildren));
+	ret = nameset_init (&names, nrofchildren);
+	if (ret < GP_OK) {
+		free (children);
+		return ret;
+	}
+
 	hasgetstorageids = ptp_operation_issupported(params,PTP_OC_GetStorageIDs);
-	for (i = 0; i < params->nrofobjects; i++) {
+	for (i = 0; i < nrofchildren; i++) {
 		PTPObject *ob;
 
-		CPR (context, ptp_object_want (params, params->objects[i].oid, PTPOBJECT_STORAGEID_LOADED|PTPOBJECT_PARENTOBJECT_LOADED, &ob));
+		ptpret = ptp_object_want (params, children[i], PTPOBJECT_STORAGEID_LOADED|PTPOBJECT_PARENTOBJECT_LOADED, &ob);
+		if (ptpret != PTP_RC_OK)
+			break;
 
-		if (params->objects[i].oi.ParentObject != handler)
+		if (ob->oi.ParentObject != handler)
 			continue;
-		if (hasgetstorageids && (params->objects[i].oi.StorageID != storage))
+		if (hasgetstorageids && (ob->oi.StorageID != storage))
 			continue;
 
-		CPR (context, ptp_object_want (params, params->objects[i].oid, PTPOBJECT_OBJECTINFO_LOADED, &ob));
+		ptpret = ptp_object_want (params, ob->oid, PTPOBJECT_LISTINFO_LOADED, &ob);
+		if (ptpret != PTP_RC_OK)
+			break;
 		if (ob->oi.ObjectFormat!=PTP_OFC_Association)
 			continue;
         	gp_log (GP_LOG_DEBUG, "folder_list_func", "adding 0x%x to folder", ob->oid);
-		if (GP_OK == gp_list_find_by_name(list, NULL, ob->oi.Filename)) {
+		if (nameset_add (&names, ob->oi.Filename)) {
 			char	*buf;
 			gp_log (GP_LOG_ERROR, "ptp2/folder_list_func",
 				"Duplicate foldername '%s' in folder '%s'. Ignoring nth entry.\n",
@@ -4659,10 +5006,18 @@ folder_list_func (CameraFilesystem *fs, const char *folder, CameraList *list,
 			sprintf (buf, "%s_%08x", ob->oi.Filename, ob->oid);
 			free (ob->oi.Filename);
 			ob->oi.Filename = buf;
+			nameset_add (&names, ob->oi.Filename);
 		}
-		CR (gp_list_append (list, ob->oi.Filename, NULL));
+		ret = gp_list_append (list, ob->oi.Filename, NULL);
+		if (ret < GP_OK)
+			break;
 	}
-	return (GP_OK);
+	free (children);
+	free (names.names);
+	gp_log (GP_LOG_DEBUG, "ptp2/folder_list_func", "listed %d folders of %u objects in %u transactions",
+		gp_list_count (list), nrofchildren, params->transaction_id - transactions);
+	CPR (context, ptpret);
+	return ret;
 }
 
 /* To avoid roundtrips for querying prop desc
@@ -5115,6 +5470,18 @@ gpfile_putfunc (PTPParams *params, void *xpriv,
 	return PTP_RC_OK;
 }
 
+static uint16_t
+gpfile_getbuffunc (PTPParams *params, void *xpriv,
+	unsigned long wantlen, unsigned char **bytes
+) {
+	PTPCFHandlerPrivate* priv= (PTPCFHandlerPrivate*)xpriv;
+
+	/* only memory backed files hand out a buffer */
+	if (gp_file_get_append_buffer (priv->file, wantlen, (char**)bytes) != GP_OK)
+		return PTP_RC_GeneralError;
+	return PTP_RC_OK;
+}
+
 static uint16_t
 ptp_init_camerafile_handler (PTPDataHandler *handler, CameraFile *file) {
 	PTPCFHandlerPrivate* priv = malloc (sizeof(PTPCFHandlerPrivate));
@@ -5122,6 +5489,7 @@ ptp_init_camerafile_handler (PTPDataHandler *handler, CameraFile *file) {
 	handler->priv = priv;
 	handler->getfunc = gpfile_getfunc;
 	handler->putfunc = gpfile_putfunc;
+	handler->getbuffunc = gpfile_getbuffunc;
 	priv->file = file;
 	return PTP_RC_OK;
 }
@@ -5377,6 +5745,9 @@ get_file_func (CameraFilesystem *fs, const char *folder, const char *filename,
 			uint16_t	ret;
 			PTPDataHandler	handler;
 
+			/* Allocate memory backed files in one go, the data is
+			 * then read straight into place. */
+			gp_file_reserve (file, size);
 			ptp_init_camerafile_handler (&handler, file);
 			ret = ptp_getobject_to_handler(params, oid, &handler);
 			ptp_exit_camerafile_handler (&handler);
@@ -6238,7 +6609,7 @@ init_ptp_fs (Camera *camera, GPContext *context)
 /* FIXME: incomplete ... needs storage mode retrieval support too (storage == 0xffffffff) */
 static uint16_t
 ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle) {
-	unsigned int	k, i, j, last, changed;
+	unsigned int	k, i;
 	PTPCANONFolderEntry *tmp = NULL;
 	unsigned int	nroftmp = 0;
 	uint16_t	ret;
@@ -6263,8 +6634,6 @@ ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle) {
 		storageids.Storage = malloc(sizeof(storageids.Storage[0]));
 		storageids.Storage[0] = storage;
 	}
-	last = changed = 0;
-
 	for (k=0;k<storageids.n;k++) {
 		gp_log (GP_LOG_DEBUG, "ptp2/eos_directory", "reading handle %08x directory of 0x%08x", storageids.Storage[k], handle);
 		ret = ptp_canon_eos_getobjectinfoex (
@@ -6275,50 +6644,42 @@ ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle) {
 			free (storageids.Storage);
 			return ret;
 		}
+		ret = ptp_objects_reserve (params, nroftmp);
+		if (ret != PTP_RC_OK) {
+			free (tmp);
+			free (storageids.Storage);
+			return ret;
+		}
 		/* convert read entries into objectinfos */
 		for (i=0;i<nroftmp;i++) {
 			PTPObject	*ob = NULL;
-			PTPObject	*newobs;
 
-			for (j=0;j<params->nrofobjects;j++) {
-				if (params->objects[(last+j)%params->nrofobjects].oid == tmp[i].ObjectHandle)  {
-					ob = &params->objects[(last+j)%params->nrofobjects];
-					break;
+			if (ptp_object_find (params, tmp[i].ObjectHandle, &ob) != PTP_RC_OK) {
+				gp_log (GP_LOG_DEBUG, "ptp_list_folder_eos", "adding new objectid 0x%08x (nrofobs=%d)", tmp[i].ObjectHandle, params->nrofobjects);
+				ret = ptp_object_find_or_insert (params, tmp[i].ObjectHandle, &ob);
+				if (ret != PTP_RC_OK) {
+					free (tmp);
+					free (storageids.Storage);
+					return ret;
 				}
-			}
-			if (j == params->nrofobjects) {
-				gp_log (GP_LOG_DEBUG, "ptp_list_folder_eos", "adding new objectid 0x%08x (nrofobs=%d,j=%d)", tmp[i].ObjectHandle, params->nrofobjects,j);
-				newobs = realloc (params->objects,sizeof(PTPObject)*(params->nrofobjects+1));
-				if (!newobs) return PTP_RC_GeneralError;
-				params->objects = newobs;
-				memset (&params->objects[params->nrofobjects],0,sizeof(params->objects[params->nrofobjects]));
-				params->objects[params->nrofobjects].oid   = tmp[i].ObjectHandle;
-				params->objects[params->nrofobjects].flags = 0;
-
-				params->objects[params->nrofobjects].oi.StorageID = storageids.Storage[k];
-				params->objects[params->nrofobjects].flags |= PTPOBJECT_STORAGEID_LOADED;
+				ob->oi.StorageID = storageids.Storage[k];
+				ob->flags |= PTPOBJECT_STORAGEID_LOADED;
 				if (handle == 0xffffffff)
-					params->objects[params->nrofobjects].oi.ParentObject = 0;
+					ob->oi.ParentObject = 0;
 				else
-					params->objects[params->nrofobjects].oi.ParentObject = handle;
-				params->objects[params->nrofobjects].flags |= PTPOBJECT_PARENTOBJECT_LOADED;
-				params->objects[params->nrofobjects].oi.Filename = strdup(tmp[i].Filename);
-				params->objects[params->nrofobjects].oi.ObjectFormat = tmp[i].ObjectFormatCode;
-				params->objects[params->nrofobjects].oi.ProtectionStatus = PTP_DPGS_Get; /* FIXME: check if ok */
-				params->objects[params->nrofobjects].oi.ObjectCompressedSize = tmp[i].ObjectSize;
-				params->objects[params->nrofobjects].oi.CaptureDate = tmp[i].Time;
-				params->objects[params->nrofobjects].oi.ModificationDate = tmp[i].Time;
-				params->objects[params->nrofobjects].flags |= PTPOBJECT_OBJECTINFO_LOADED;
-
-				debug_objectinfo(params, tmp[i].ObjectHandle, &params->objects[params->nrofobjects].oi);
-				last = params->nrofobjects;
-				params->nrofobjects++;
-				changed = 1;
+					ob->oi.ParentObject = handle;
+				ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
+				ob->oi.Filename = strdup(tmp[i].Filename);
+				ob->oi.ObjectFormat = tmp[i].ObjectFormatCode;
+				ob->oi.ProtectionStatus = PTP_DPGS_Get; /* FIXME: check if ok */
+				ob->oi.ObjectCompressedSize = tmp[i].ObjectSize;
+				ob->oi.CaptureDate = tmp[i].Time;
+				ob->oi.ModificationDate = tmp[i].Time;
+				ob->flags |= PTPOBJECT_OBJECTINFO_LOADED;
+
+				debug_objectinfo(params, tmp[i].ObjectHandle, &ob->oi);
 			} else {
-				gp_log (GP_LOG_DEBUG, "ptp_list_folder_eos", "adding old objectid 0x%08x (nrofobs=%d,j=%d)", tmp[i].ObjectHandle, params->nrofobjects,j);
-				ob = &params->objects[(last+j)%params->nrofobjects];
-				/* for speeding up search */
-				last = (last+j)%params->nrofobjects;
+				gp_log (GP_LOG_DEBUG, "ptp_list_folder_eos", "adding old objectid 0x%08x (nrofobs=%d)", tmp[i].ObjectHandle, params->nrofobjects);
 				if (handle != PTP_HANDLER_SPECIAL) {
 					ob->oi.ParentObject = handle;
 					ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
@@ -6328,11 +6689,10 @@ ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle) {
 					ob->flags |= PTPOBJECT_STORAGEID_LOADED;
 				}
 			}
+			ptp_object_index_parent (params, ob);
 		}
 	}
-	if (changed) ptp_objects_sort (params);
 
-	/* Do not cache ob, it might be reallocated and have a new address */
 	if (handle != 0xffffffff) {
 		ret = ptp_object_want (params, handle, PTPOBJECT_OBJECTINFO_LOADED, &ob);
 		if (ret == PTP_RC_OK)
@@ -6344,10 +6704,9 @@ ptp_list_folder_eos (PTPParams *params, uint32_t storage, uint32_t handle) {
 
 uint16_t
 ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle) {
-	unsigned int		i, changed, last;
+	unsigned int		i, unloaded = 0;
 	uint16_t		ret;
 	uint32_t		xhandle = handle;
-	PTPObject		*newobs;
 	PTPObjectHandles	handles;
 
 	gp_log (GP_LOG_DEBUG, "ptp_list_folder", "(storage=0x%08x, handle=0x%08x)", storage, handle);
@@ -6393,48 +6752,39 @@ ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle) {
 	}
 	if (ret != PTP_RC_OK)
 		return ret;
-	last = changed = 0;
+	/* make room for all of them at once */
+	ret = ptp_objects_reserve (params, handles.n);
+	if (ret != PTP_RC_OK) {
+		free (handles.Handler);
+		return ret;
+	}
 	for (i=0;i<handles.n;i++) {
 		PTPObject	*ob;
-		unsigned int	j;
 
-		ob = NULL;
-		for (j=0;j<params->nrofobjects;j++) {
-			if (params->objects[(last+j)%params->nrofobjects].oid == handles.Handler[i])  {
-				ob = &params->objects[(last+j)%params->nrofobjects];
-				break;
+		if (ptp_object_find (params, handles.Handler[i], &ob) != PTP_RC_OK) {
+			gp_log (GP_LOG_DEBUG, "ptp_list_folder", "adding new objectid 0x%08x (nrofobs=%d)", handles.Handler[i], params->nrofobjects);
+			ret = ptp_object_find_or_insert (params, handles.Handler[i], &ob);
+			if (ret != PTP_RC_OK) {
+				free (handles.Handler);
+				return ret;
 			}
-		}
-		if (j == params->nrofobjects) {
-			gp_log (GP_LOG_DEBUG, "ptp_list_folder", "adding new objectid 0x%08x (nrofobs=%d,j=%d)", handles.Handler[i], params->nrofobjects,j);
-			newobs = realloc (params->objects,sizeof(PTPObject)*(params->nrofobjects+1));
-			if (!newobs) return PTP_RC_GeneralError;
-			params->objects = newobs;
-			memset (&params->objects[params->nrofobjects],0,sizeof(params->objects[params->nrofobjects]));
-			params->objects[params->nrofobjects].oid = handles.Handler[i];
-			params->objects[params->nrofobjects].flags = 0;
 			/* root directory list files might return all files, so avoid tagging it */
 			if (handle != PTP_HANDLER_SPECIAL && handle) {
 				gp_log (GP_LOG_DEBUG, "ptp_list_folder", "  parenthandle 0x%08x", handle);
 				if (handles.Handler[i] == handle) { /* EOS bug where oid == parent(oid) */
-					params->objects[params->nrofobjects].oi.ParentObject = 0;
+					ob->oi.ParentObject = 0;
 				} else {
-					params->objects[params->nrofobjects].oi.ParentObject = handle;
+					ob->oi.ParentObject = handle;
 				}
-				params->objects[params->nrofobjects].flags |= PTPOBJECT_PARENTOBJECT_LOADED;
+				ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
 			}
 			if (storage != PTP_HANDLER_SPECIAL) {
 				gp_log (GP_LOG_DEBUG, "ptp_list_folder", "  storage 0x%08x", storage);
-				params->objects[params->nrofobjects].oi.StorageID = storage;
-				params->objects[params->nrofobjects].flags |= PTPOBJECT_STORAGEID_LOADED;
+				ob->oi.StorageID = storage;
+				ob->flags |= PTPOBJECT_STORAGEID_LOADED;
 			}
-			params->nrofobjects++;
-			changed = 1;
 		} else {
-			gp_log (GP_LOG_DEBUG, "ptp_list_folder", "adding old objectid 0x%08x (nrofobs=%d,j=%d)", handles.Handler[i], params->nrofobjects,j);
-			ob = &params->objects[(last+j)%params->nrofobjects];
-			/* for speeding up search */
-			last = (last+j)%params->nrofobjects;
+			gp_log (GP_LOG_DEBUG, "ptp_list_folder", "adding old objectid 0x%08x (nrofobs=%d)", handles.Handler[i], params->nrofobjects);
 			if (handle != PTP_HANDLER_SPECIAL) {
 				ob->oi.ParentObject = handle;
 				ob->flags |= PTPOBJECT_PARENTOBJECT_LOADED;
@@ -6444,9 +6794,15 @@ ptp_list_folder (PTPParams *params, uint32_t storage, uint32_t handle) {
 				ob->flags |= PTPOBJECT_STORAGEID_LOADED;
 			}
 		}
+		ptp_object_index_parent (params, ob);
+		if (!(ob->flags & (PTPOBJECT_OBJECTINFO_LOADED|PTPOBJECT_MTPPROPLIST_LOADED)))
+			unloaded++;
 	}
 	free (handles.Handler);
-	if (changed) ptp_objects_sort (params);
+	/* MTP devices can give us the properties of the whole folder in one
+	 * go, which saves a GetObjPropList round trip per object later on. */
+	if ((unloaded > 1) && (handle != PTP_HANDLER_SPECIAL))
+		ptp_object_prefetch_children (params, handle);
 	return PTP_RC_OK;
 }
 
@@ -6492,11 +6848,17 @@ camera_init (Camera *camera, GPContext *context)
 	camera->functions->about = camera_about;
 	camera->functions->exit = camera_exit;
 	camera->functions->trigger_capture = camera_trigger_capture;
+	camera->functions->prepare_trigger = camera_prepare_trigger;
 	camera->functions->capture = camera_capture;
 	camera->functions->capture_preview = camera_capture_preview;
+	camera->functions->start_preview_stream = camera_start_preview_stream;
+	camera->functions->read_preview_frame = camera_read_preview_frame;
+	camera->functions->stop_preview_stream = camera_stop_preview_stream;
 	camera->functions->summary = camera_summary;
 	camera->functions->get_config = camera_get_config;
 	camera->functions->set_config = camera_set_config;
+	camera->functions->get_single_config = camera_get_single_config;
+	camera->functions->set_single_config = camera_set_single_config;
 	camera->functions->wait_for_event = camera_wait_for_event;
 
 	/* We need some data that we pass around */
@@ -6507,6 +6869,7 @@ camera_init (Camera *camera, GPContext *context)
 	params = &camera->pl->params;
 	params->debug_func = ptp_debug_func;
 	params->error_func = ptp_error_func;
+	params->transaction_func = ptp_transaction_func;
 	params->data = malloc (sizeof (PTPData));
 	memset (params->data, 0, sizeof (PTPData));
 	((PTPData *) params->data)->camera = camera;
@@ -6561,6 +6924,7 @@ camera_init (Camera *camera, GPContext *context)
 		params->event_check	= ptp_usb_event_check;
 		params->cancelreq_func	= ptp_usb_control_cancel_request;
 		params->maxpacketsize 	= settings.usb.maxpacketsize;
+		params->queued_read	= 1; /* cleared if the port lacks support */
 		gp_log (GP_LOG_DEBUG, "ptp2", "maxpacketsize %d", settings.usb.maxpacketsize);
 		if (params->device_flags & DEVICE_FLAG_OLYMPUS_XML_WRAPPED) {
 #ifdef HAVE_LIBXML2
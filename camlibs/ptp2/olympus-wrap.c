@@ -1204,6 +1204,8 @@ is_outer_operation (PTPParams* params, uint16_t opcode) {
 
 	/* Do nothing here, either do stuff in senddata, getdata or getresp,
 	 * which will get the PTPContainer req too. */
+	if (params->outer_deviceinfo.OperationsBitset)
+		return PTP_BITSET_ISSET(params->outer_deviceinfo.OperationsBitset, opcode);
         for (i=0;i<params->outer_deviceinfo.OperationsSupported_len;i++)
                 if (params->outer_deviceinfo.OperationsSupported[i]==opcode)
                         return TRUE;
@@ -1407,6 +1409,7 @@ olympus_setup (PTPParams *params) {
 
 	params->outer_params = outerparams = malloc (sizeof(PTPParams));
 	memcpy(outerparams, params, sizeof(PTPParams));
+	outerparams->strcache = NULL;	/* do not share the converted strings */
 	outerparams->sendreq_func	= ums_wrap_sendreq;
 	outerparams->getresp_func	= ums_wrap_getresp;
 	outerparams->senddata_func	= ums_wrap_senddata;
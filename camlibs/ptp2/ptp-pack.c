@@ -120,21 +120,65 @@ dtoh64ap (PTPParams *params, const unsigned char *a)
 #define dtoh64(x)	dtoh64p(params,x)
 
 
+/* Strings that needed iconv, kept by their UCS-2 form so that repeated
+ * ones are converted only once per camera. */
+#define PTP_STRCACHE_SIZE	256
+
+typedef struct _PTPStrCacheEntry {
+	unsigned char	*raw;		/* length byte + UCS-2 */
+	char		*str;
+} PTPStrCacheEntry;
+
+struct _PTPStrCache {
+	PTPStrCacheEntry	entries[PTP_STRCACHE_SIZE];
+	unsigned int		hits, misses;
+};
+
+static inline void
+ptp_free_strcache (PTPStrCache *cache)
+{
+	unsigned int i;
+
+	if (!cache)
+		return;
+	for (i=0;i<PTP_STRCACHE_SIZE;i++) {
+		free (cache->entries[i].raw);
+		free (cache->entries[i].str);
+	}
+	free (cache);
+}
+
+/* Whether the n UCS-2 characters at s are all 7 bit ASCII, looking at
+ * 4 characters at a time. The mask is in memory order and covers the
+ * high byte and the top bit of the low byte of each character. */
+static inline int
+ptp_ucs2_isascii (PTPParams *params, const unsigned char *s, unsigned int n)
+{
+	static const unsigned char lemask[8] = {0x80,0xff,0x80,0xff,0x80,0xff,0x80,0xff};
+	static const unsigned char bemask[8] = {0xff,0x80,0xff,0x80,0xff,0x80,0xff,0x80};
+	const unsigned char	*m = (params->byteorder == PTP_DL_LE) ? lemask : bemask;
+	uint64_t		mask, w, acc = 0;
+	unsigned int		i;
+
+	memcpy (&mask, m, sizeof(mask));
+	for (i=0;i+8<=2*n;i+=8) {
+		memcpy (&w, s+i, sizeof(w));
+		acc |= w & mask;
+	}
+	for (;i<2*n;i++)
+		acc |= s[i] & m[i%8];
+	return !acc;
+}
+
 static inline char*
-ptp_unpack_string(PTPParams *params, unsigned char* data, uint16_t offset, uint8_t *len)
+ptp_unpack_string_iconv(PTPParams *params, unsigned char* data, uint16_t offset, uint8_t length)
 {
-	uint8_t length;
 	uint16_t string[PTP_MAXSTRLEN+1];
 	/* allow for UTF-8: max of 3 bytes per UCS-2 char, plus final null */
 	char loclstr[PTP_MAXSTRLEN*3+1];
 	size_t nconv, srclen, destlen;
 	char *src, *dest;
 
-	length = dtoh8a(&data[offset]);	/* PTP_MAXSTRLEN == 255, 8 bit len */
-	*len = length;
-	if (length == 0)		/* nothing to do? */
-		return(NULL);
-
 	/* copy to string[] to ensure correct alignment for iconv(3) */
 	memcpy(string, &data[offset+1], length * sizeof(string[0]));
 	string[length] = 0x0000U;   /* be paranoid!  add a terminator. */
@@ -166,6 +210,65 @@ ptp_unpack_string(PTPParams *params, unsigned char* data, uint16_t offset, uint8
 	return(strdup(loclstr));
 }
 
+static inline char*
+ptp_unpack_string(PTPParams *params, unsigned char* data, uint16_t offset, uint8_t *len)
+{
+	uint8_t			length;
+	unsigned char		*raw = &data[offset];
+	unsigned int		rawlen, i;
+	uint32_t		hash = 2166136261U;
+	PTPStrCacheEntry	*e;
+	char			*str;
+
+	length = dtoh8a(&data[offset]);	/* PTP_MAXSTRLEN == 255, 8 bit len */
+	*len = length;
+	if (length == 0)		/* nothing to do? */
+		return(NULL);
+
+	/* nearly all strings are plain ASCII, just narrow those */
+	if (ptp_ucs2_isascii (params, raw+1, length)) {
+		unsigned char *lo = raw+1+(params->byteorder == PTP_DL_LE ? 0 : 1);
+
+		str = malloc (length+1);
+		if (!str)
+			return NULL;
+		for (i=0;i<length;i++)
+			str[i] = lo[2*i];
+		str[length] = '\0';
+		return str;
+	}
+
+	if (!params->strcache)
+		params->strcache = calloc (1, sizeof(PTPStrCache));
+	if (!params->strcache)
+		return ptp_unpack_string_iconv (params, data, offset, length);
+	rawlen = 1+2*length;
+	for (i=0;i<rawlen;i++)
+		hash = (hash ^ raw[i]) * 16777619U;
+	e = &params->strcache->entries[hash % PTP_STRCACHE_SIZE];
+	if (e->raw && !memcmp (e->raw, raw, rawlen)) {
+		params->strcache->hits++;
+		return strdup (e->str);
+	}
+	params->strcache->misses++;
+	str = ptp_unpack_string_iconv (params, data, offset, length);
+	if (!str)
+		return NULL;
+	free (e->raw);
+	free (e->str);
+	e->raw = malloc (rawlen);
+	e->str = strdup (str);
+	if (!e->raw || !e->str) {
+		free (e->raw);
+		free (e->str);
+		e->raw = NULL;
+		e->str = NULL;
+		return str;
+	}
+	memcpy (e->raw, raw, rawlen);
+	return str;
+}
+
 static inline int
 ucs2strlen(uint16_t const * const unicstr)
 {
@@ -355,6 +458,10 @@ ptp_unpack_DI (PTPParams *params, unsigned char* data, PTPDeviceInfo *di, unsign
 	di->SerialNumber = ptp_unpack_string(params, data,
 		PTP_di_OperationsSupported+totallen,
 		&len);
+	di->OperationsBitset = NULL;
+	di->EventsBitset = NULL;
+	di->DevicePropertiesBitset = NULL;
+	ptp_deviceinfo_index (di);
 }
 
 inline static void
@@ -369,6 +476,10 @@ ptp_free_DI (PTPDeviceInfo *di) {
 	if (di->OperationsSupported) free (di->OperationsSupported);
 	if (di->EventsSupported) free (di->EventsSupported);
 	if (di->DevicePropertiesSupported) free (di->DevicePropertiesSupported);
+	free (di->OperationsBitset);
+	free (di->EventsBitset);
+	free (di->DevicePropertiesBitset);
+	memset (di, 0, sizeof(*di));
 }
 
 /* EOS Device Info unpack */
@@ -1130,59 +1241,56 @@ ptp_pack_OPL (PTPParams *params, MTPProperties *props, int nrofprops, unsigned c
 	return totalsize;
 }
 
-static int
-_compare_func(const void* x, const void *y) {
-	const MTPProperties *px = x;
-	const MTPProperties *py = y;
-
-	return px->ObjectHandle - py->ObjectHandle;
-}
+/* Size of the entry of an MTP object property list at data, of which len
+ * bytes are there. If that is more than len the entry is incomplete (or
+ * its size cannot be told yet), 0 means it cannot be parsed at all. */
+#define PTP_OPL_MAXARRAY	0x00FFFFFFU
 
-static inline int
-ptp_unpack_OPL (PTPParams *params, unsigned char* data, MTPProperties **pprops, unsigned int len)
-{ 
-	uint32_t prop_count = dtoh32a(data);
-	MTPProperties *props = NULL;
-	unsigned int offset = 0, i;
-
-	if (prop_count == 0) {
-		*pprops = NULL;
+static inline unsigned long
+ptp_opl_entry_len (PTPParams *params, unsigned char *data, unsigned long len)
+{
+	unsigned long	elemsize;
+	uint32_t	n;
+
+	if (len < 8)
+		return 8;
+	switch (dtoh16a(&data[6])) {
+	case PTP_DTC_INT8:	case PTP_DTC_UINT8:	return 8+1;
+	case PTP_DTC_INT16:	case PTP_DTC_UINT16:	return 8+2;
+	case PTP_DTC_INT32:	case PTP_DTC_UINT32:	return 8+4;
+	case PTP_DTC_INT64:	case PTP_DTC_UINT64:	return 8+8;
+	case PTP_DTC_INT128:	case PTP_DTC_UINT128:	return 8+16;
+	case PTP_DTC_STR:
+		if (len < 9)
+			return 9;
+		return 9+2*dtoh8a(&data[8]);
+	case PTP_DTC_AINT8:	case PTP_DTC_AUINT8:	elemsize = 1; break;
+	case PTP_DTC_AINT16:	case PTP_DTC_AUINT16:	elemsize = 2; break;
+	case PTP_DTC_AINT32:	case PTP_DTC_AUINT32:	elemsize = 4; break;
+	case PTP_DTC_AINT64:	case PTP_DTC_AUINT64:	elemsize = 8; break;
+	default:
 		return 0;
 	}
-	ptp_debug (params ,"Unpacking MTP OPL, size %d (prop_count %d)", len, prop_count);
-	data += sizeof(uint32_t);
-	len -= sizeof(uint32_t);
-	props = malloc(prop_count * sizeof(MTPProperties));
-	if (!props) return 0;
-	for (i = 0; i < prop_count; i++) {
-		if (len <= 0) {
-			ptp_debug (params ,"short MTP Object Property List at property %d (of %d)", i, prop_count);
-			ptp_debug (params ,"device probably needs DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST_ALL", i);
-			ptp_debug (params ,"or even DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST", i);
-			qsort (props, i, sizeof(MTPProperties),_compare_func);
-			*pprops = props;
-			return i;
-		}
-		props[i].ObjectHandle = dtoh32a(data);
-		data += sizeof(uint32_t);
-		len -= sizeof(uint32_t);
-
-		props[i].property = dtoh16a(data);
-		data += sizeof(uint16_t);
-		len -= sizeof(uint16_t);
-
-		props[i].datatype = dtoh16a(data);
-		data += sizeof(uint16_t);
-		len -= sizeof(uint16_t);
-
-		offset = 0;
-		ptp_unpack_DPV(params, data, &offset, len, &props[i].propval, props[i].datatype);
-		data += offset;
-		len -= offset;
-	}
-	qsort (props, prop_count, sizeof(MTPProperties),_compare_func);
-	*pprops = props;
-	return prop_count;
+	if (len < 12)
+		return 12;
+	n = dtoh32a(&data[8]);
+	if (n > PTP_OPL_MAXARRAY)
+		return 0;
+	return 12+n*elemsize;
+}
+
+/* unpacks one complete entry, as sized by ptp_opl_entry_len */
+static inline void
+ptp_unpack_OPL_entry (PTPParams *params, unsigned char *data, unsigned long len,
+	MTPProperties *prop)
+{
+	unsigned int	offset = 8;
+
+	memset (prop, 0, sizeof(*prop));
+	prop->ObjectHandle = dtoh32a(data);
+	prop->property = dtoh16a(&data[4]);
+	prop->datatype = dtoh16a(&data[6]);
+	ptp_unpack_DPV (params, data, &offset, len, &prop->propval, prop->datatype);
 }
 
 /*
@@ -1549,9 +1657,16 @@ ptp_unpack_CANON_changes (PTPParams *params, unsigned char* data, int datasize,
 			PTPDevicePropDesc	*dpd;
 
 			ptp_debug (params, "event %d: EOS prop %04x desc record, datasize %d, propxtype %d", i, proptype, size-PTP_ece_Prop_Desc_Data, propxtype);
-			for (j=0;j<params->nrofcanon_props;j++)
-				if (params->canon_props[j].proptype == proptype)
-					break;
+			ptp_invalidate_devicepropdesc (params, proptype);
+			j = params->nrofcanon_props;
+			/* the bitset only rules out proptypes never seen */
+			if (	(proptype > 0xffff) || !params->canon_props_bitset ||
+				PTP_BITSET_ISSET(params->canon_props_bitset, proptype)
+			) {
+				for (j=0;j<params->nrofcanon_props;j++)
+					if (params->canon_props[j].proptype == proptype)
+						break;
+			}
 			if (j==params->nrofcanon_props) {
 				ptp_debug (params, "event %d: propdesc %x, default value not found.", i, proptype);
 				break;
@@ -1622,9 +1737,16 @@ ptp_unpack_CANON_changes (PTPParams *params, unsigned char* data, int datasize,
 				PTPDevicePropDesc	*dpd;
 
 				ptp_debug (params, "event %d: EOS prop %04x info record, datasize is %d", i, proptype, size-PTP_ece_Prop_Val_Data);
-				for (j=0;j<params->nrofcanon_props;j++)
-					if (params->canon_props[j].proptype == proptype)
-						break;
+				ptp_invalidate_devicepropdesc (params, proptype);
+				j = params->nrofcanon_props;
+				/* the bitset only rules out proptypes never seen */
+				if (	(proptype > 0xffff) || !params->canon_props_bitset ||
+					PTP_BITSET_ISSET(params->canon_props_bitset, proptype)
+				) {
+					for (j=0;j<params->nrofcanon_props;j++)
+						if (params->canon_props[j].proptype == proptype)
+							break;
+				}
 				if (j<params->nrofcanon_props) {
 					if (	(params->canon_props[j].size != size) ||
 						(memcmp(params->canon_props[j].data,xdata,size-PTP_ece_Prop_Val_Data))) {
@@ -1645,6 +1767,10 @@ ptp_unpack_CANON_changes (PTPParams *params, unsigned char* data, int datasize,
 					params->canon_props[j].dpd.GetSet = 1;
 					params->canon_props[j].dpd.FormFlag = PTP_DPFF_None;
 					params->nrofcanon_props = j+1;
+					if (!params->canon_props_bitset)
+						params->canon_props_bitset = calloc (PTP_BITSET_WORDS, sizeof(params->canon_props_bitset[0]));
+					if (params->canon_props_bitset && (proptype <= 0xffff))
+						PTP_BITSET_SET(params->canon_props_bitset, proptype);
 				}
 				dpd = &params->canon_props[j].dpd;
 
@@ -24,6 +24,8 @@
 /* config.c */
 int camera_get_config (Camera *camera, CameraWidget **window, GPContext *context);
 int camera_set_config (Camera *camera, CameraWidget *window, GPContext *context);
+int camera_get_single_config (Camera *camera, const char *name, CameraWidget **widget, GPContext *context);
+int camera_set_single_config (Camera *camera, const char *name, CameraWidget *widget, GPContext *context);
 int camera_prepare_capture (Camera *camera, GPContext *context);
 int camera_unprepare_capture (Camera *camera, GPContext *context);
 int camera_canon_eos_update_capture_target(Camera *camera, GPContext *context, int value);
@@ -36,6 +38,17 @@ void fixup_cached_deviceinfo (Camera *camera, PTPDeviceInfo*);
 struct _CameraPrivateLibrary {
 	PTPParams params;
 	int checkevents;
+
+	/* Receive buffer for the preview images, kept between frames */
+	unsigned char	*preview_buf;
+	unsigned long	preview_size, preview_alloc;
+	time_t		preview_lastcheck;
+
+	/* Set by camera_prepare_trigger for the next camera_trigger_capture,
+	 * cleared by everything that might change what it prepared */
+	int		trigger_prepared;
+	int		trigger_prepared_method;
+	int		trigger_inliveview;
 };
 
 struct _PTPData {
@@ -26,6 +26,8 @@
 #include "config.h"
 #include "ptp.h"
 
+#include <gphoto2/gphoto2-port-trace.h>
+
 #ifdef HAVE_LIBXML2
 # include <libxml/parser.h>
 #endif
@@ -110,57 +112,89 @@ ptp_error (PTPParams *params, const char *format, ...)
 #define PTP_DP_GETDATA		0x0002	/* receiving data */
 #define PTP_DP_DATA_MASK	0x00ff	/* data phase mask */
 
-/**
- * ptp_transaction:
- * params:	PTPParams*
- * 		PTPContainer* ptp	- general ptp container
- * 		uint16_t flags		- lower 8 bits - data phase description
- * 		unsigned int sendlen	- senddata phase data length
- * 		char** data		- send or receive data buffer pointer
- * 		int* recvlen		- receive data length
- *
- * Performs PTP transaction. ptp is a PTPContainer with appropriate fields
- * filled in (i.e. operation code and parameters). It's up to caller to do
- * so.
- * The flags decide thether the transaction has a data phase and what is its
- * direction (send or receive). 
- * If transaction is sending data the sendlen should contain its length in
- * bytes, otherwise it's ignored.
- * The data should contain an address of a pointer to data going to be sent
- * or is filled with such a pointer address if data are received depending
- * od dataphase direction (send or received) or is beeing ignored (no
- * dataphase).
- * The memory for a pointer should be preserved by the caller, if data are
- * beeing retreived the appropriate amount of memory is beeing allocated
- * (the caller should handle that!).
- *
- * Return values: Some PTP_RC_* code.
- * Upon success PTPContainer* ptp contains PTP Response Phase container with
- * all fields filled in.
- **/
-uint16_t
-ptp_transaction_new (PTPParams* params, PTPContainer* ptp, 
+/* Record a PTP transaction or a phase of it in the trace. */
+static void
+ptp_trace (GPTraceOp op, uint16_t code, uint32_t transaction, uint64_t size,
+	   uint16_t ret, uint64_t start)
+{
+	GPTraceRecord	record;
+
+	memset (&record, 0, sizeof(record));
+	record.time = start;
+	record.op = op;
+	record.code = code;
+	record.transaction = transaction;
+	record.size = (size > 0xFFFFFFFFU) ? 0xFFFFFFFFU : size;
+	record.result = ret;
+	gp_trace_add (&record);
+}
+
+/* Passes the received data on to the real handler and counts it. */
+typedef struct {
+	PTPDataHandler	*handler;
+	uint64_t	count;
+} PTPCountHandlerPrivate;
+
+static uint16_t
+count_getfunc (PTPParams* params, void* private,
+	       unsigned long wantlen, unsigned char *data,
+	       unsigned long *gotlen
+) {
+	PTPCountHandlerPrivate *priv = (PTPCountHandlerPrivate*)private;
+
+	return priv->handler->getfunc (params, priv->handler->priv, wantlen, data, gotlen);
+}
+
+static uint16_t
+count_putfunc (PTPParams* params, void* private,
+	       unsigned long sendlen, unsigned char *data,
+	       unsigned long *putlen
+) {
+	PTPCountHandlerPrivate	*priv = (PTPCountHandlerPrivate*)private;
+	uint16_t		ret;
+
+	ret = priv->handler->putfunc (params, priv->handler->priv, sendlen, data, putlen);
+	if (ret == PTP_RC_OK)
+		priv->count += *putlen;
+	return ret;
+}
+
+static uint16_t
+count_getbuffunc (PTPParams* params, void* private,
+		  unsigned long wantlen, unsigned char **data
+) {
+	PTPCountHandlerPrivate *priv = (PTPCountHandlerPrivate*)private;
+
+	return priv->handler->getbuffunc (params, priv->handler->priv, wantlen, data);
+}
+
+static uint16_t
+ptp_transaction_run (PTPParams* params, PTPContainer* ptp,
 		     uint16_t flags, uint64_t sendlen,
-		     PTPDataHandler *handler
+		     PTPDataHandler *handler, uint64_t *received,
+		     unsigned int *retries
 ) {
+	uint16_t	ret;
 	int 		tries;
 	uint16_t	cmd;
-
-	if ((params==NULL) || (ptp==NULL)) 
-		return PTP_ERROR_BADPARAM;
+	uint64_t	start;
 
 	cmd = ptp->Code;
 	ptp->Transaction_ID=params->transaction_id++;
 	ptp->SessionID=params->session_id;
 	/* send request */
-	CHECK_PTP_RC(params->sendreq_func (params, ptp));
+	start = gp_trace_now ();
+	ret = params->sendreq_func (params, ptp);
+	ptp_trace (GP_TRACE_PTP_REQUEST, cmd, ptp->Transaction_ID, 0, ret, start);
+	CHECK_PTP_RC(ret);
 	/* is there a dataphase? */
 	switch (flags&PTP_DP_DATA_MASK) {
 	case PTP_DP_SENDDATA:
 		{
-			uint16_t ret;
+			start = gp_trace_now ();
 			ret = params->senddata_func(params, ptp,
 						    sendlen, handler);
+			ptp_trace (GP_TRACE_PTP_DATA_OUT, cmd, ptp->Transaction_ID, sendlen, ret, start);
 			if (ret == PTP_ERROR_CANCEL) {
 				ret = params->cancelreq_func(params, 
 							     params->transaction_id-1);
@@ -173,8 +207,19 @@ ptp_transaction_new (PTPParams* params, PTPContainer* ptp,
 		break;
 	case PTP_DP_GETDATA:
 		{
-			uint16_t ret;
-			ret = params->getdata_func(params, ptp, handler);
+			PTPDataHandler		counter;
+			PTPCountHandlerPrivate	count;
+
+			count.handler = handler;
+			count.count = 0;
+			counter.getfunc = count_getfunc;
+			counter.putfunc = count_putfunc;
+			counter.getbuffunc = handler->getbuffunc ? count_getbuffunc : NULL;
+			counter.priv = &count;
+			start = gp_trace_now ();
+			ret = params->getdata_func(params, ptp, &counter);
+			ptp_trace (GP_TRACE_PTP_DATA_IN, cmd, ptp->Transaction_ID, count.count, ret, start);
+			*received = count.count;
 			if (ret == PTP_ERROR_CANCEL) {
 				ret = params->cancelreq_func(params, 
 							     params->transaction_id-1);
@@ -192,12 +237,14 @@ ptp_transaction_new (PTPParams* params, PTPContainer* ptp,
 	}
 	tries = 3;
 	while (tries--) {
-		uint16_t ret;
 		/* get response */
+		start = gp_trace_now ();
 		ret = params->getresp_func(params, ptp);
+		ptp_trace (GP_TRACE_PTP_RESPONSE, ptp->Code, ptp->Transaction_ID, 0, ret, start);
 		if (ret == PTP_ERROR_RESP_EXPECTED) {
 			ptp_debug (params,"PTP: response expected but not got, retrying.");
 			tries++;
+			(*retries)++;
 			continue;
 		}
 		if (ret != PTP_RC_OK)
@@ -205,6 +252,7 @@ ptp_transaction_new (PTPParams* params, PTPContainer* ptp,
 		
 		if (ptp->Transaction_ID < params->transaction_id-1) {
 			tries++;
+			(*retries)++;
 			ptp_debug (params,
 				"PTP: Sequence number mismatch %d vs expected %d, suspecting old reply.",
 				ptp->Transaction_ID, params->transaction_id-1
@@ -213,8 +261,10 @@ ptp_transaction_new (PTPParams* params, PTPContainer* ptp,
 		}
 		if (ptp->Transaction_ID != params->transaction_id-1) {
 			/* try to clean up potential left overs from previous session */
-			if ((cmd == PTP_OC_OpenSession) && tries)
+			if ((cmd == PTP_OC_OpenSession) && tries) {
+				(*retries)++;
 				continue;
+			}
 			ptp_error (params,
 				"PTP: Sequence number mismatch %d vs expected %d.",
 				ptp->Transaction_ID, params->transaction_id-1
@@ -226,6 +276,59 @@ ptp_transaction_new (PTPParams* params, PTPContainer* ptp,
 	return ptp->Code;
 }
 
+/**
+ * ptp_transaction:
+ * params:	PTPParams*
+ * 		PTPContainer* ptp	- general ptp container
+ * 		uint16_t flags		- lower 8 bits - data phase description
+ * 		unsigned int sendlen	- senddata phase data length
+ * 		char** data		- send or receive data buffer pointer
+ * 		int* recvlen		- receive data length
+ *
+ * Performs PTP transaction. ptp is a PTPContainer with appropriate fields
+ * filled in (i.e. operation code and parameters). It's up to caller to do
+ * so.
+ * The flags decide thether the transaction has a data phase and what is its
+ * direction (send or receive). 
+ * If transaction is sending data the sendlen should contain its length in
+ * bytes, otherwise it's ignored.
+ * The data should contain an address of a pointer to data going to be sent
+ * or is filled with such a pointer address if data are received depending
+ * od dataphase direction (send or received) or is beeing ignored (no
+ * dataphase).
+ * The memory for a pointer should be preserved by the caller, if data are
+ * beeing retreived the appropriate amount of memory is beeing allocated
+ * (the caller should handle that!).
+ *
+ * Return values: Some PTP_RC_* code.
+ * Upon success PTPContainer* ptp contains PTP Response Phase container with
+ * all fields filled in.
+ **/
+uint16_t
+ptp_transaction_new (PTPParams* params, PTPContainer* ptp, 
+		     uint16_t flags, uint64_t sendlen,
+		     PTPDataHandler *handler
+) {
+	uint16_t	cmd, ret;
+	uint64_t	start, received = 0;
+	unsigned int	retries = 0;
+
+	if ((params==NULL) || (ptp==NULL)) 
+		return PTP_ERROR_BADPARAM;
+
+	cmd = ptp->Code;
+	start = gp_trace_now ();
+	ret = ptp_transaction_run (params, ptp, flags, sendlen, handler,
+				   &received, &retries);
+	ptp_trace (GP_TRACE_PTP_TRANSACTION, cmd, ptp->Transaction_ID,
+		   ((flags&PTP_DP_DATA_MASK) == PTP_DP_SENDDATA) ? sendlen : received,
+		   ret, start);
+	if (params->transaction_func)
+		params->transaction_func (params, cmd, ret,
+					  gp_trace_now () - start, retries);
+	return ret;
+}
+
 /* memory data get/put handler */
 typedef struct {
 	unsigned char	*data;
@@ -277,6 +380,7 @@ ptp_init_recv_memory_handler(PTPDataHandler *handler) {
 	handler->priv = priv;
 	handler->getfunc = memory_getfunc;
 	handler->putfunc = memory_putfunc;
+	handler->getbuffunc = NULL;
 	priv->data = NULL;
 	priv->size = 0;
 	priv->curoff = 0;
@@ -297,6 +401,7 @@ ptp_init_send_memory_handler(PTPDataHandler *handler,
 	handler->priv = priv;
 	handler->getfunc = memory_getfunc;
 	handler->putfunc = memory_putfunc;
+	handler->getbuffunc = NULL;
 	priv->data = data;
 	priv->size = len;
 	priv->curoff = 0;
@@ -370,6 +475,7 @@ ptp_init_fd_handler(PTPDataHandler *handler, int fd) {
 	handler->priv = priv;
 	handler->getfunc = fd_getfunc;
 	handler->putfunc = fd_putfunc;
+	handler->getbuffunc = NULL;
 	priv->fd = fd;
 	return PTP_RC_OK;
 }
@@ -894,6 +1000,7 @@ ptp_olympus_getdeviceinfo (PTPParams* params, PTPDeviceInfo *di)
 		return ret;
 
 	ret = parse_9301_tree (params, code, di);
+	ptp_deviceinfo_index (di);
 
 	xmlFreeDoc(code->doc);
 	return ret;
@@ -1106,17 +1213,36 @@ ptp_free_params (PTPParams *params) {
 
 	if (params->cameraname) free (params->cameraname);
 	if (params->wifi_profiles) free (params->wifi_profiles);
-	for (i=0;i<params->nrofobjects;i++)
-		ptp_free_object (&params->objects[i]);
+	for (i=0;i<params->nrofobjects;i++) {
+		ptp_free_object (params->objects[i]);
+		free (params->objects[i]);
+	}
 	free (params->objects);
+	free (params->objecthash);
+	for (i=0;i<params->childrenhashsize;i++) {
+		PTPObjectChildren *ch;
+
+		while ((ch = params->childrenhash[i])) {
+			params->childrenhash[i] = ch->next;
+			free (ch);
+		}
+	}
+	free (params->childrenhash);
 	free (params->events);
 	for (i=0;i<params->nrofcanon_props;i++) {
 		free (params->canon_props[i].data);
 		ptp_free_devicepropdesc (&params->canon_props[i].dpd);
 	}
 	free (params->canon_props);
+	free (params->canon_props_bitset);
 	free (params->backlogentries);
+	for (i=0;i<(unsigned int)params->nrofdeviceproperties;i++)
+		if (params->deviceproperties[i].timestamp)
+			ptp_free_devicepropdesc (&params->deviceproperties[i].desc);
+	free (params->deviceproperties);
 	ptp_free_DI (&params->deviceinfo);
+	ptp_free_DI (&params->outer_deviceinfo);
+	ptp_free_strcache (params->strcache);
 }
 
 /**
@@ -1716,6 +1842,170 @@ ptp_getdevicepropdesc (PTPParams* params, uint16_t propcode,
 	return ret;
 }
 
+static int
+_duplicate_propval (uint16_t dt, PTPPropertyValue *src, PTPPropertyValue *dst)
+{
+	*dst = *src;
+	if (dt == PTP_DTC_STR) {
+		if (src->str && !(dst->str = strdup (src->str)))
+			return 0;
+		return 1;
+	}
+	if ((dt & PTP_DTC_ARRAY_MASK) && src->a.v) {
+		dst->a.v = malloc (sizeof(src->a.v[0])*src->a.count);
+		if (!dst->a.v)
+			return 0;
+		memcpy (dst->a.v, src->a.v, sizeof(src->a.v[0])*src->a.count);
+	}
+	return 1;
+}
+
+static uint16_t
+ptp_duplicate_devicepropdesc (PTPDevicePropDesc *src, PTPDevicePropDesc *dst)
+{
+	uint16_t i, dt = src->DataType;
+
+	memcpy (dst, src, sizeof (*dst));
+	/* only the scalars so far, so the error path can free it */
+	memset (&dst->FactoryDefaultValue, 0, sizeof(dst->FactoryDefaultValue));
+	memset (&dst->CurrentValue, 0, sizeof(dst->CurrentValue));
+	memset (&dst->FORM, 0, sizeof(dst->FORM));
+	dst->FormFlag = PTP_DPFF_None;
+
+	if (	!_duplicate_propval (dt, &src->FactoryDefaultValue, &dst->FactoryDefaultValue) ||
+		!_duplicate_propval (dt, &src->CurrentValue, &dst->CurrentValue)
+	)
+		goto fail;
+	switch (src->FormFlag) {
+	case PTP_DPFF_Range:
+		dst->FormFlag = PTP_DPFF_Range;
+		if (	!_duplicate_propval (dt, &src->FORM.Range.MinimumValue, &dst->FORM.Range.MinimumValue) ||
+			!_duplicate_propval (dt, &src->FORM.Range.MaximumValue, &dst->FORM.Range.MaximumValue) ||
+			!_duplicate_propval (dt, &src->FORM.Range.StepSize, &dst->FORM.Range.StepSize)
+		)
+			goto fail;
+		break;
+	case PTP_DPFF_Enumeration:
+		dst->FormFlag = PTP_DPFF_Enumeration;
+		if (!src->FORM.Enum.SupportedValue)
+			break;
+		dst->FORM.Enum.SupportedValue = calloc (src->FORM.Enum.NumberOfValues, sizeof(PTPPropertyValue));
+		if (!dst->FORM.Enum.SupportedValue)
+			goto fail;
+		dst->FORM.Enum.NumberOfValues = src->FORM.Enum.NumberOfValues;
+		for (i=0;i<src->FORM.Enum.NumberOfValues;i++)
+			if (!_duplicate_propval (dt, &src->FORM.Enum.SupportedValue[i], &dst->FORM.Enum.SupportedValue[i]))
+				goto fail;
+		break;
+	default:
+		dst->FormFlag = src->FormFlag;
+		break;
+	}
+	return PTP_RC_OK;
+fail:
+	ptp_free_devicepropdesc (dst);
+	memset (dst, 0, sizeof (*dst));
+	return PTP_RC_GeneralError;
+}
+
+/* Whether the camera tells us about changed properties, so that cached
+ * descriptors stay valid until an event says otherwise. */
+static int
+ptp_reports_propchanges (PTPParams *params)
+{
+	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_NIKON) &&
+		ptp_operation_issupported(params, PTP_OC_NIKON_CheckEvent)
+	)
+		return 1;
+	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
+		ptp_operation_issupported(params, PTP_OC_CANON_EOS_GetEvent)
+	)
+		return 1;
+	return ptp_event_issupported (params, PTP_EC_DevicePropChanged);
+}
+
+/**
+ * ptp_generic_getdevicepropdesc:
+ * params:	PTPParams*
+ * propcode:	the device property
+ * dpd:		receives a copy of the descriptor, to be freed with
+ *		ptp_free_devicepropdesc()
+ *
+ * Like ptp_getdevicepropdesc(), but served from the device property
+ * cache of the session if possible. Entries are dropped when the camera
+ * reports the property as changed or any property is set, see
+ * ptp_invalidate_devicepropdesc(), or after PROPCACHE_TIMEOUT seconds
+ * for cameras without such events.
+ *
+ * Return values: Some PTP_RC_* code.
+ **/
+uint16_t
+ptp_generic_getdevicepropdesc (PTPParams *params, uint16_t propcode,
+			       PTPDevicePropDesc *dpd)
+{
+	PTPDeviceProperty	*prop;
+	uint16_t		ret;
+	time_t			now;
+	int			i;
+
+	time (&now);
+	for (i=0;i<params->nrofdeviceproperties;i++)
+		if (params->deviceproperties[i].prop == propcode)
+			break;
+	prop = &params->deviceproperties[i];
+	if (	(i < params->nrofdeviceproperties) && prop->timestamp &&
+		(ptp_reports_propchanges (params) || (now - prop->timestamp <= PROPCACHE_TIMEOUT))
+	)
+		return ptp_duplicate_devicepropdesc (&prop->desc, dpd);
+
+	ret = ptp_getdevicepropdesc (params, propcode, dpd);
+	if (ret != PTP_RC_OK)
+		return ret;
+
+	if (i == params->nrofdeviceproperties) {
+		prop = realloc (params->deviceproperties, sizeof(params->deviceproperties[0])*(i+1));
+		if (!prop) /* just not cached */
+			return PTP_RC_OK;
+		params->deviceproperties = prop;
+		prop = &params->deviceproperties[i];
+		memset (prop, 0, sizeof(*prop));
+		prop->prop = propcode;
+		params->nrofdeviceproperties++;
+	} else if (prop->timestamp) {
+		ptp_free_devicepropdesc (&prop->desc);
+		prop->timestamp = 0;
+	}
+	if (ptp_duplicate_devicepropdesc (dpd, &prop->desc) == PTP_RC_OK)
+		prop->timestamp = now;
+	return PTP_RC_OK;
+}
+
+/**
+ * ptp_invalidate_devicepropdesc:
+ * params:	PTPParams*
+ * propcode:	the changed device property, or 0 for all of them
+ *
+ * Drops the cached descriptor of a property, so that the next
+ * ptp_generic_getdevicepropdesc() reads it from the camera again.
+ **/
+void
+ptp_invalidate_devicepropdesc (PTPParams *params, uint16_t propcode)
+{
+	int i;
+
+	for (i=0;i<params->nrofdeviceproperties;i++) {
+		PTPDeviceProperty *prop = &params->deviceproperties[i];
+
+		if (propcode && (prop->prop != propcode))
+			continue;
+		if (prop->timestamp) {
+			ptp_debug (params, "ptp2/propcache: dropping 0x%04x", prop->prop);
+			ptp_free_devicepropdesc (&prop->desc);
+			prop->timestamp = 0;
+		}
+	}
+}
+
 
 uint16_t
 ptp_getdevicepropvalue (PTPParams* params, uint16_t propcode,
@@ -1754,6 +2044,9 @@ ptp_setdevicepropvalue (PTPParams* params, uint16_t propcode,
 	size=ptp_pack_DPV(params, value, &dpv, datatype);
 	ret=ptp_transaction(params, &ptp, PTP_DP_SENDDATA, size, &dpv, NULL);
 	free(dpv);
+	/* the current value changed, and the ranges of others might have
+	 * changed with it (shutter speeds after the exposure mode, ...) */
+	ptp_invalidate_devicepropdesc (params, 0);
 	return ret;
 }
 
@@ -2202,15 +2495,94 @@ ptp_canon_checkevent (PTPParams* params, PTPContainer* event, int* isevent)
 	return ret;
 }
 
+/* Event queues are ring buffers of *alloc elements of size bytes, holding
+ * *count elements starting at index *base. They double in size when full
+ * and large buffers are released once the queue runs empty again. */
+#define PTP_EVENTQUEUE_INITIAL	16
+#define PTP_EVENTQUEUE_KEEP	256
+
+static uint16_t
+_queue_push (void **queue, unsigned int *base, unsigned int *count, unsigned int *alloc,
+	     size_t size, const void *elems, unsigned int nrofelems)
+{
+	unsigned int	pos, first;
+
+	if (*count + nrofelems > *alloc) {
+		unsigned int	newalloc = *alloc ? *alloc : PTP_EVENTQUEUE_INITIAL;
+		unsigned char	*newqueue;
+
+		while (newalloc < *count + nrofelems)
+			newalloc *= 2;
+		newqueue = malloc (newalloc*size);
+		if (!newqueue)
+			return PTP_RC_GeneralError;
+		/* linearize the old contents */
+		if (*count) {
+			first = *alloc - *base;
+			if (first > *count)
+				first = *count;
+			memcpy (newqueue, (unsigned char*)*queue + *base*size, first*size);
+			memcpy (newqueue + first*size, *queue, (*count-first)*size);
+		}
+		free (*queue);
+		*queue	= newqueue;
+		*base	= 0;
+		*alloc	= newalloc;
+	}
+	pos   = (*base + *count) % *alloc;
+	first = *alloc - pos;
+	if (first > nrofelems)
+		first = nrofelems;
+	memcpy ((unsigned char*)*queue + pos*size, elems, first*size);
+	memcpy (*queue, (const unsigned char*)elems + first*size, (nrofelems-first)*size);
+	*count += nrofelems;
+	return PTP_RC_OK;
+}
+
+static unsigned int
+_queue_pop (void **queue, unsigned int *base, unsigned int *count, unsigned int *alloc,
+	    size_t size, void *elems, unsigned int maxelems)
+{
+	unsigned int	n = *count, first;
+
+	if (n > maxelems)
+		n = maxelems;
+	if (!n)
+		return 0;
+	first = *alloc - *base;
+	if (first > n)
+		first = n;
+	memcpy (elems, (unsigned char*)*queue + *base*size, first*size);
+	memcpy ((unsigned char*)elems + first*size, *queue, (n-first)*size);
+	*base   = (*base + n) % *alloc;
+	*count -= n;
+	if (!*count) {
+		*base = 0;
+		if (*alloc > PTP_EVENTQUEUE_KEEP) {
+			free (*queue);
+			*queue = NULL;
+			*alloc = 0;
+		}
+	}
+	return n;
+}
+
+static uint16_t
+_add_events (PTPParams *params, PTPContainer *evts, unsigned int nrofevts)
+{
+	unsigned int	i;
+
+	for (i=0;i<nrofevts;i++)
+		if (evts[i].Code == PTP_EC_DevicePropChanged)
+			ptp_invalidate_devicepropdesc (params, evts[i].Param1);
+	return _queue_push ((void**)&params->events, &params->eventsbase,
+			    &params->nrofevents, &params->eventsalloc,
+			    sizeof(PTPContainer), evts, nrofevts);
+}
+
 uint16_t
 ptp_add_event (PTPParams *params, PTPContainer *evt) {
-	if (params->nrofevents)
-		params->events = realloc(params->events, sizeof(PTPContainer)*(params->nrofevents+1));
-	else
-		params->events = malloc(sizeof(PTPContainer)*1);
-	memcpy (&params->events[params->nrofevents],evt,1*sizeof(PTPContainer));
-	params->nrofevents += 1;
-	return PTP_RC_OK;
+	return _add_events (params, evt, 1);
 }
 
 uint16_t
@@ -2229,15 +2601,10 @@ ptp_check_event (PTPParams *params) {
 			return ret;
 
 		if (evtcnt) {
-			if (params->nrofevents)
-				params->events = realloc(params->events, sizeof(PTPContainer)*(evtcnt+params->nrofevents));
-			else
-				params->events = malloc(sizeof(PTPContainer)*evtcnt);
-			memcpy (&params->events[params->nrofevents],xevent,evtcnt*sizeof(PTPContainer));
-			params->nrofevents += evtcnt;
+			ret = _add_events (params, xevent, evtcnt);
 			free (xevent);
 		}
-		return PTP_RC_OK;
+		return ret;
 	}
 	/* should not get here ... EOS has no normal PTP events and another queue handling. */
 	if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_CANON) &&
@@ -2273,6 +2640,15 @@ ptp_check_event (PTPParams *params) {
 
 store_event:
 	if (ret == PTP_RC_OK) {
+		GPTraceRecord	record;
+
+		memset (&record, 0, sizeof(record));
+		record.time = gp_trace_now ();
+		record.op = GP_TRACE_PTP_EVENT;
+		record.code = event.Code;
+		record.transaction = event.Transaction_ID;
+		record.result = event.Param1;
+		gp_trace_add (&record);
 		ptp_debug (params, "event: nparams=0x%X, code=0x%X, trans_id=0x%X, p1=0x%X, p2=0x%X, p3=0x%X", event.Nparam,event.Code,event.Transaction_ID, event.Param1, event.Param2, event.Param3);
 		ptp_add_event (params, &event);
 	}
@@ -2281,19 +2657,65 @@ store_event:
 	return ret;
 }
 
+/* Interrupt events fetched by ptp_check_propchange_events() at most, so
+ * that a busy camera cannot keep us polling. */
+#define PROPCHANGE_EVENTS_MAX	16
+
+/**
+ * ptp_check_propchange_events:
+ * params:	PTPParams*
+ *
+ * Fetches the pending events of the camera once, so that the
+ * DevicePropChanged events among them invalidate the cached property
+ * descriptors. The events stay queued. Does nothing if there is nothing
+ * cached, or if the camera does not report changes at all, as its
+ * descriptors expire by time then.
+ *
+ * Return value: Some PTP_RC_* code.
+ **/
+uint16_t
+ptp_check_propchange_events (PTPParams *params) {
+	unsigned int	i, oldevents;
+	uint16_t	ret;
+
+	if (!params->nrofdeviceproperties || !ptp_reports_propchanges (params))
+		return PTP_RC_OK;
+	for (i=0;i<PROPCHANGE_EVENTS_MAX;i++) {
+		oldevents = params->nrofevents;
+		ret = ptp_check_event (params);
+		if (ret != PTP_RC_OK)
+			return ret;
+		if (params->nrofevents == oldevents)
+			break;
+		/* the Nikon CheckEvent hands out all queued events in one go */
+		if (	(params->deviceinfo.VendorExtensionID == PTP_VENDOR_NIKON) &&
+			ptp_operation_issupported(params, PTP_OC_NIKON_CheckEvent)
+		)
+			break;
+	}
+	return PTP_RC_OK;
+}
+
 int
 ptp_get_one_event(PTPParams *params, PTPContainer *event) {
-	if (!params->nrofevents)
-		return 0;
-	memcpy (event, params->events, sizeof(PTPContainer));
-	memmove (params->events, params->events+1, sizeof(PTPContainer)*(params->nrofevents-1));
-	/* do not realloc on shrink. */
-	params->nrofevents--;
-	if (!params->nrofevents) {
-		free (params->events);
-		params->events = NULL;
-	}
-	return 1;
+	return ptp_get_events (params, event, 1);
+}
+
+/**
+ * ptp_get_events:
+ * @params: PTPParams*
+ * @evts: array to store the events in
+ * @maxevts: size of @evts
+ *
+ * Removes up to @maxevts of the queued events, oldest first.
+ *
+ * Return values: Number of events stored in @evts.
+ **/
+unsigned int
+ptp_get_events (PTPParams *params, PTPContainer *evts, unsigned int maxevts) {
+	return _queue_pop ((void**)&params->events, &params->eventsbase,
+			   &params->nrofevents, &params->eventsalloc,
+			   sizeof(PTPContainer), evts, maxevts);
 }
 
 /**
@@ -2331,7 +2753,7 @@ ptp_canon_eos_getevent (PTPParams* params, PTPCanon_changes_entry **entries, int
 uint16_t
 ptp_check_eos_events (PTPParams *params) {
 	uint16_t		ret;
-	PTPCanon_changes_entry	*entries = NULL, *nentries;
+	PTPCanon_changes_entry	*entries = NULL;
 	int			nrofentries = 0;
 
 	while (1) { /* call it repeatedly until the camera does not report any */
@@ -2341,36 +2763,36 @@ ptp_check_eos_events (PTPParams *params) {
 		if (!nrofentries)
 			return PTP_RC_OK;
 
-		if (params->nrofbacklogentries) {
-			nentries = realloc(params->backlogentries,sizeof(entries[0])*(params->nrofbacklogentries+nrofentries));
-			if (!nentries)
-				return PTP_RC_GeneralError;
-			params->backlogentries = nentries;
-			memcpy (nentries+params->nrofbacklogentries, entries, nrofentries*sizeof(entries[0]));
-			params->nrofbacklogentries += nrofentries;
-			free (entries);
-		} else {
-			params->backlogentries = entries;
-			params->nrofbacklogentries = nrofentries;
-		}
+		ret = _queue_push ((void**)&params->backlogentries, &params->backlogbase,
+				   &params->nrofbacklogentries, &params->backlogalloc,
+				   sizeof(entries[0]), entries, nrofentries);
+		free (entries);
+		if (ret != PTP_RC_OK)
+			return ret;
 	}
 	return PTP_RC_OK;
 }
 
 int
 ptp_get_one_eos_event (PTPParams *params, PTPCanon_changes_entry *entry) {
-	if (!params->nrofbacklogentries)
-		return 0;
-	memcpy (entry, params->backlogentries, sizeof(*entry));
-	if (params->nrofbacklogentries > 1) {
-		memmove (params->backlogentries,params->backlogentries+1,sizeof(*entry)*(params->nrofbacklogentries-1));
-		params->nrofbacklogentries--;
-	} else {
-		free (params->backlogentries);
-		params->backlogentries = NULL;
-		params->nrofbacklogentries = 0;
-	}
-	return 1;
+	return ptp_get_eos_events (params, entry, 1);
+}
+
+/**
+ * ptp_get_eos_events:
+ * @params: PTPParams*
+ * @entries: array to store the entries in
+ * @maxentries: size of @entries
+ *
+ * Removes up to @maxentries of the queued EOS change entries, oldest first.
+ *
+ * Return values: Number of entries stored in @entries.
+ **/
+unsigned int
+ptp_get_eos_events (PTPParams *params, PTPCanon_changes_entry *entries, unsigned int maxentries) {
+	return _queue_pop ((void**)&params->backlogentries, &params->backlogbase,
+			   &params->nrofbacklogentries, &params->backlogalloc,
+			   sizeof(entries[0]), entries, maxentries);
 }
 
 
@@ -2380,6 +2802,8 @@ ptp_canon_eos_getdevicepropdesc (PTPParams* params, uint16_t propcode,
 {
 	unsigned int i;
 
+	if (params->canon_props_bitset && !PTP_BITSET_ISSET(params->canon_props_bitset, propcode))
+		return PTP_RC_Undefined;
 	for (i=0;i<params->nrofcanon_props;i++)
 		if (params->canon_props[i].proptype == propcode)
 			break;
@@ -2679,6 +3103,20 @@ ptp_canon_getviewfinderimage (PTPParams* params, unsigned char** image, uint32_t
 	return ret;
 }
 
+uint16_t
+ptp_canon_getviewfinderimage_handler (PTPParams* params, PTPDataHandler *handler, uint32_t* size)
+{
+	uint16_t ret;
+	PTPContainer ptp;
+	
+	PTP_CNT_INIT(ptp);
+	ptp.Code=PTP_OC_CANON_GetViewfinderImage;
+	ptp.Nparam=0;
+	ret=ptp_transaction_new(params, &ptp, PTP_DP_GETDATA, 0, handler);
+	if (ret==PTP_RC_OK) *size=ptp.Param1;
+	return ret;
+}
+
 /**
  * ptp_canon_getchanges:
  *
@@ -2922,6 +3360,17 @@ ptp_nikon_get_liveview_image (PTPParams* params, unsigned char **data, unsigned
         return ptp_transaction(params, &ptp, PTP_DP_GETDATA, 0, data, size);
 }
 
+uint16_t
+ptp_nikon_get_liveview_image_handler (PTPParams* params, PTPDataHandler *handler)
+{
+        PTPContainer ptp;
+        
+        PTP_CNT_INIT(ptp);
+        ptp.Code=PTP_OC_NIKON_GetLiveViewImg;
+        ptp.Nparam=0;
+        return ptp_transaction_new(params, &ptp, PTP_DP_GETDATA, 0, handler);
+}
+
 /**
  * ptp_nikon_get_preview_image:
  *
@@ -3422,13 +3871,159 @@ ptp_mtp_setobjectreferences (PTPParams* params, uint32_t handle, uint32_t* ohArr
 	return ret;
 }
 
+/* GetObjPropList receiver: parses the property list as it arrives, so
+ * only the entry straddling two chunks is ever buffered. */
+typedef struct {
+	uint32_t	count;		/* properties announced by the device */
+	uint32_t	done;		/* properties parsed so far */
+	int		gotcount;
+	int		stop;
+	unsigned char	*tail;		/* incomplete entry of the last chunk */
+	unsigned long	tailsize, tailalloc;
+	MTPProperties	*run;		/* properties of the current object */
+	unsigned int	nrofrun, runalloc;
+	PTPOPLFunc	func;
+	void		*funcpriv;
+} PTPOPLHandlerPrivate;
+
+static void
+opl_flush_run (PTPParams *params, PTPOPLHandlerPrivate *priv)
+{
+	if (!priv->nrofrun)
+		return;
+	priv->func (params, priv->funcpriv, priv->run, priv->nrofrun);
+	priv->nrofrun = 0;
+}
+
+static unsigned long
+opl_need (PTPParams *params, PTPOPLHandlerPrivate *priv, unsigned char *data, unsigned long len)
+{
+	if (!priv->gotcount)
+		return sizeof(uint32_t);
+	return ptp_opl_entry_len (params, data, len);
+}
+
+static void
+opl_consume (PTPParams *params, PTPOPLHandlerPrivate *priv, unsigned char *data, unsigned long len)
+{
+	MTPProperties	*prop;
+
+	if (!priv->gotcount) {
+		priv->count = dtoh32a(data);
+		priv->gotcount = 1;
+		ptp_debug (params, "Unpacking MTP OPL (prop_count %d)", priv->count);
+		if (!priv->count)
+			priv->stop = 1;
+		return;
+	}
+	if (priv->nrofrun && (priv->run[0].ObjectHandle != dtoh32a(data)))
+		opl_flush_run (params, priv);
+	if (priv->nrofrun == priv->runalloc) {
+		MTPProperties *run;
+
+		run = realloc (priv->run, (priv->runalloc+16)*sizeof(MTPProperties));
+		if (!run) {
+			priv->stop = 1;
+			return;
+		}
+		priv->run = run;
+		priv->runalloc += 16;
+	}
+	prop = &priv->run[priv->nrofrun++];
+	ptp_unpack_OPL_entry (params, data, len, prop);
+	if (++priv->done == priv->count)
+		priv->stop = 1;
+}
+
+static uint16_t
+opl_putfunc (PTPParams* params, void* private,
+	unsigned long sendlen, unsigned char *data, unsigned long *putlen
+) {
+	PTPOPLHandlerPrivate	*priv = (PTPOPLHandlerPrivate*)private;
+	unsigned long		need, copy;
+
+	/* whatever we do not parse is ignored, the transfer goes on */
+	*putlen = sendlen;
+	while (sendlen && !priv->stop) {
+		if (!priv->tailsize) {
+			need = opl_need (params, priv, data, sendlen);
+			if (!need)
+				break;
+			if (need <= sendlen) {
+				opl_consume (params, priv, data, need);
+				data += need;
+				sendlen -= need;
+				continue;
+			}
+		}
+		/* complete the entry carried over in tail */
+		need = opl_need (params, priv, priv->tail, priv->tailsize);
+		while (need > priv->tailsize && sendlen) {
+			if (need > priv->tailalloc) {
+				unsigned char *tail = realloc (priv->tail, need);
+
+				if (!tail)
+					return PTP_RC_GeneralError;
+				priv->tail = tail;
+				priv->tailalloc = need;
+			}
+			copy = need - priv->tailsize;
+			if (copy > sendlen)
+				copy = sendlen;
+			memcpy (priv->tail + priv->tailsize, data, copy);
+			priv->tailsize += copy;
+			data += copy;
+			sendlen -= copy;
+			need = opl_need (params, priv, priv->tail, priv->tailsize);
+		}
+		if (!need)
+			break;
+		if (need > priv->tailsize)
+			return PTP_RC_OK;
+		opl_consume (params, priv, priv->tail, need);
+		priv->tailsize = 0;
+	}
+	if (sendlen && !priv->stop) {
+		ptp_debug (params, "MTP OPL entry %d has unknown datatype, ignoring the rest", priv->done);
+		priv->stop = 1;
+	}
+	return PTP_RC_OK;
+}
+
+/**
+ * ptp_mtp_getobjectproplist_stream:
+ * params:	PTPParams*
+ * handle:	object handle, 0xffffffff for all objects
+ * depth:	0 for the object itself, 1 for its children, 0xffffffff for all below
+ * func:	called with the properties of each object as they are parsed
+ * priv:	passed to func
+ * nrofprops:	number of properties parsed (may be NULL)
+ *
+ * Runs GetObjPropList and parses the result while it is being received.
+ * func gets the consecutive properties of one object at a time and takes
+ * over their contents, but not the array holding them. Properties of an
+ * object usually come in one run, but that is up to the device.
+ *
+ * Return value: Some PTP_RC_* code.
+ **/
 uint16_t
-ptp_mtp_getobjectproplist (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops)
+ptp_mtp_getobjectproplist_stream (PTPParams* params, uint32_t handle, uint32_t depth,
+	PTPOPLFunc func, void *priv, unsigned int *nrofprops)
 {
-	uint16_t ret;
-	PTPContainer ptp;
-	unsigned char* opldata = NULL;
-	unsigned int oplsize;
+	uint16_t		ret;
+	PTPContainer		ptp;
+	PTPDataHandler		handler;
+	PTPOPLHandlerPrivate	*opl;
+
+	opl = calloc (1, sizeof(PTPOPLHandlerPrivate));
+	if (!opl)
+		return PTP_RC_GeneralError;
+	opl->func = func;
+	opl->funcpriv = priv;
+	handler.getfunc = NULL;
+	handler.putfunc = opl_putfunc;
+	handler.getbuffunc = NULL;
+	handler.priv = opl;
 
 	PTP_CNT_INIT(ptp);
 	ptp.Code = PTP_OC_MTP_GetObjPropList;
@@ -3436,36 +4031,104 @@ ptp_mtp_getobjectproplist (PTPParams* params, uint32_t handle, MTPProperties **p
 	ptp.Param2 = 0x00000000U;  /* 0x00000000U should be "all formats" */
 	ptp.Param3 = 0xFFFFFFFFU;  /* 0xFFFFFFFFU should be "all properties" */
 	ptp.Param4 = 0x00000000U;
-	ptp.Param5 = 0xFFFFFFFFU;  /* means - return full tree below the Param1 handle */
+	ptp.Param5 = depth;
 	ptp.Nparam = 5;
-	ret = ptp_transaction(params, &ptp, PTP_DP_GETDATA, 0, &opldata, &oplsize);  
-	if (ret == PTP_RC_OK) *nrofprops = ptp_unpack_OPL(params, opldata, props, oplsize);
-	if (opldata != NULL)
-		free(opldata);
+	ret = ptp_transaction_new (params, &ptp, PTP_DP_GETDATA, 0, &handler);
+	/* hand out what we got even on errors, func owns it then */
+	opl_flush_run (params, opl);
+	if ((ret == PTP_RC_OK) && (opl->done < opl->count)) {
+		ptp_debug (params ,"short MTP Object Property List at property %d (of %d)", opl->done, opl->count);
+		ptp_debug (params ,"device probably needs DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST_ALL");
+		ptp_debug (params ,"or even DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST");
+	}
+	if (nrofprops)
+		*nrofprops = opl->done;
+	free (opl->run);
+	free (opl->tail);
+	free (opl);
+	return ret;
+}
+
+/* collects the streamed property list into one array sorted by handle */
+typedef struct {
+	MTPProperties	*props;
+	unsigned int	nrofprops, alloc;
+	int		unsorted;
+} PTPOPLCollect;
+
+static void
+opl_collect (PTPParams *params, void *priv, MTPProperties *props, unsigned int n)
+{
+	PTPOPLCollect	*c = (PTPOPLCollect*)priv;
+
+	if (c->nrofprops + n > c->alloc) {
+		unsigned int	alloc = c->alloc ? c->alloc : 64;
+		MTPProperties	*newprops;
+
+		while (alloc < c->nrofprops + n)
+			alloc *= 2;
+		newprops = realloc (c->props, alloc*sizeof(MTPProperties));
+		if (!newprops) {
+			while (n--)
+				ptp_destroy_object_prop (&props[n]);
+			return;
+		}
+		c->props = newprops;
+		c->alloc = alloc;
+	}
+	if (c->nrofprops && (c->props[c->nrofprops-1].ObjectHandle > props[0].ObjectHandle))
+		c->unsorted = 1;
+	memcpy (&c->props[c->nrofprops], props, n*sizeof(MTPProperties));
+	c->nrofprops += n;
+}
+
+static int
+_compare_func(const void* x, const void *y) {
+	const MTPProperties *px = x;
+	const MTPProperties *py = y;
+
+	return px->ObjectHandle - py->ObjectHandle;
+}
+
+static uint16_t
+ptp_mtp_getobjectproplist_depth (PTPParams* params, uint32_t handle, uint32_t depth,
+	MTPProperties **props, int *nrofprops)
+{
+	uint16_t	ret;
+	PTPOPLCollect	c;
+
+	memset (&c, 0, sizeof(c));
+	ret = ptp_mtp_getobjectproplist_stream (params, handle, depth, opl_collect, &c, NULL);
+	if (ret != PTP_RC_OK) {
+		ptp_destroy_object_prop_list (c.props, c.nrofprops);
+		return ret;
+	}
+	if (c.unsorted)
+		qsort (c.props, c.nrofprops, sizeof(MTPProperties), _compare_func);
+	*props = c.props;
+	*nrofprops = c.nrofprops;
 	return ret;
 }
 
+uint16_t
+ptp_mtp_getobjectproplist (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops)
+{
+	/* 0xFFFFFFFFU means - return full tree below the Param1 handle */
+	return ptp_mtp_getobjectproplist_depth (params, handle, 0xFFFFFFFFU, props, nrofprops);
+}
+
 uint16_t
 ptp_mtp_getobjectproplist_single (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops)
 {
-	uint16_t ret;
-	PTPContainer ptp;
-	unsigned char* opldata = NULL;
-	unsigned int oplsize;
+	/* 0x00000000U means - return single tree below the Param1 handle */
+	return ptp_mtp_getobjectproplist_depth (params, handle, 0x00000000U, props, nrofprops);
+}
 
-	PTP_CNT_INIT(ptp);
-	ptp.Code = PTP_OC_MTP_GetObjPropList;
-	ptp.Param1 = handle;
-	ptp.Param2 = 0x00000000U;  /* 0x00000000U should be "all formats" */
-	ptp.Param3 = 0xFFFFFFFFU;  /* 0xFFFFFFFFU should be "all properties" */
-	ptp.Param4 = 0x00000000U;
-	ptp.Param5 = 0x00000000U;  /* means - return single tree below the Param1 handle */
-	ptp.Nparam = 5;
-	ret = ptp_transaction(params, &ptp, PTP_DP_GETDATA, 0, &opldata, &oplsize);  
-	if (ret == PTP_RC_OK) *nrofprops = ptp_unpack_OPL(params, opldata, props, oplsize);
-	if (opldata != NULL)
-		free(opldata);
-	return ret;
+uint16_t
+ptp_mtp_getobjectproplist_level (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops)
+{
+	/* 0x00000001U means - return the direct children of the Param1 handle */
+	return ptp_mtp_getobjectproplist_depth (params, handle, 0x00000001U, props, nrofprops);
 }
 
 uint16_t
@@ -3938,11 +4601,43 @@ ptp_android_sendpartialobject (PTPParams* params, uint32_t handle, uint64_t offs
 /* Non PTP protocol functions */
 /* devinfo testing functions */
 
+static void
+_build_bitset (uint32_t **set, uint16_t *codes, uint32_t nrofcodes)
+{
+	uint32_t i;
+
+	if (!*set)
+		*set = malloc (PTP_BITSET_WORDS*sizeof((*set)[0]));
+	if (!*set) /* callers fall back to scanning the lists */
+		return;
+	memset (*set, 0, PTP_BITSET_WORDS*sizeof((*set)[0]));
+	for (i=0;i<nrofcodes;i++)
+		PTP_BITSET_SET(*set, codes[i]);
+}
+
+/**
+ * ptp_deviceinfo_index:
+ * @di: device info
+ *
+ * (Re)builds the operation, event and property bitsets of @di, so the
+ * *_issupported() checks do not need to scan the lists.
+ * Needs to be called after modifying the lists.
+ **/
+void
+ptp_deviceinfo_index (PTPDeviceInfo *di)
+{
+	_build_bitset (&di->OperationsBitset, di->OperationsSupported, di->OperationsSupported_len);
+	_build_bitset (&di->EventsBitset, di->EventsSupported, di->EventsSupported_len);
+	_build_bitset (&di->DevicePropertiesBitset, di->DevicePropertiesSupported, di->DevicePropertiesSupported_len);
+}
+
 int
 ptp_event_issupported(PTPParams* params, uint16_t event)
 {
 	unsigned int i=0;
 
+	if (params->deviceinfo.EventsBitset)
+		return PTP_BITSET_ISSET(params->deviceinfo.EventsBitset, event);
 	for (;i<params->deviceinfo.EventsSupported_len;i++) {
 		if (params->deviceinfo.EventsSupported[i]==event)
 			return 1;
@@ -3956,6 +4651,8 @@ ptp_property_issupported(PTPParams* params, uint16_t property)
 {
 	unsigned int i;
 
+	if (params->deviceinfo.DevicePropertiesBitset)
+		return PTP_BITSET_ISSET(params->deviceinfo.DevicePropertiesBitset, property);
 	for (i=0;i<params->deviceinfo.DevicePropertiesSupported_len;i++)
 		if (params->deviceinfo.DevicePropertiesSupported[i]==property)
 			return 1;
@@ -3979,6 +4676,9 @@ ptp_free_object (PTPObject *ob)
 	ptp_free_objectinfo (&ob->oi);
 	for (i=0;i<ob->nrofmtpprops;i++)
 		ptp_destroy_object_prop(&ob->mtpprops[i]);
+	free (ob->mtpprops);
+	ob->mtpprops = NULL;
+	ob->nrofmtpprops = 0;
 	ob->flags = 0;
 }
 
@@ -5982,111 +6682,351 @@ ptp_find_object_prop_in_cache(PTPParams *params, uint32_t const handle, uint32_t
 	return NULL;
 }
 
+/* Bucket of an object handle in a hash of size buckets (a power of 2). */
+static inline unsigned int
+_ob_hash (uint32_t handle, unsigned int size) {
+	return ((handle ^ (handle >> 16)) * 0x45d9f3bU) & (size - 1);
+}
+
+/* The list of cached children of parent, optionally created if missing.
+ * Objects whose parent is not known yet are kept under PTP_HANDLER_SPECIAL. */
+static PTPObjectChildren *
+_children_find (PTPParams *params, uint32_t parent, int create) {
+	PTPObjectChildren	*ch = NULL;
+	unsigned int		h;
+
+	if (params->childrenhashsize)
+		ch = params->childrenhash[_ob_hash (parent, params->childrenhashsize)];
+	while (ch && (ch->parent != parent))
+		ch = ch->next;
+	if (ch || !create)
+		return ch;
+
+	if (params->nrofchildren >= params->childrenhashsize) {
+		unsigned int		i, newsize = params->childrenhashsize ? params->childrenhashsize*2 : 64;
+		PTPObjectChildren	**newhash;
+
+		newhash = calloc (newsize, sizeof(PTPObjectChildren*));
+		if (!newhash) return NULL;
+		for (i=0;i<params->childrenhashsize;i++) {
+			while ((ch = params->childrenhash[i])) {
+				params->childrenhash[i] = ch->next;
+				h = _ob_hash (ch->parent, newsize);
+				ch->next = newhash[h];
+				newhash[h] = ch;
+			}
+		}
+		free (params->childrenhash);
+		params->childrenhash = newhash;
+		params->childrenhashsize = newsize;
+	}
+	ch = calloc (1, sizeof(PTPObjectChildren));
+	if (!ch) return NULL;
+	ch->parent = parent;
+	h = _ob_hash (parent, params->childrenhashsize);
+	ch->next = params->childrenhash[h];
+	params->childrenhash[h] = ch;
+	params->nrofchildren++;
+	return ch;
+}
+
+static void
+_children_unlink (PTPObject *ob) {
+	PTPObjectChildren	*ch = ob->siblings;
+
+	if (!ch) return;
+	if (ob->sibling_prev)
+		ob->sibling_prev->sibling_next = ob->sibling_next;
+	else
+		ch->first = ob->sibling_next;
+	if (ob->sibling_next)
+		ob->sibling_next->sibling_prev = ob->sibling_prev;
+	ch->count--;
+	ob->siblings = NULL;
+	ob->sibling_prev = ob->sibling_next = NULL;
+}
+
+/**
+ * ptp_object_index_parent:
+ * params:	PTPParams*
+ * ob:		PTPObject* whose ParentObject might have changed
+ *
+ * Files the object in the children index under its current ParentObject,
+ * or under the objects of unknown parent if PTPOBJECT_PARENTOBJECT_LOADED
+ * is not set. Has to be called whenever either of them is changed.
+ **/
+void
+ptp_object_index_parent (PTPParams *params, PTPObject *ob) {
+	PTPObjectChildren	*ch;
+	uint32_t		parent = PTP_HANDLER_SPECIAL;
+
+	if (ob->flags & PTPOBJECT_PARENTOBJECT_LOADED)
+		parent = ob->oi.ParentObject;
+	if (ob->siblings && (ob->siblings->parent == parent))
+		return;
+	_children_unlink (ob);
+	ch = _children_find (params, parent, 1);
+	if (!ch) return; /* out of memory, lookups will miss it */
+	ob->siblings = ch;
+	ob->sibling_prev = NULL;
+	ob->sibling_next = ch->first;
+	if (ch->first)
+		ch->first->sibling_prev = ob;
+	ch->first = ob;
+	ch->count++;
+}
+
+static int _cmp_handle (const void *a, const void *b) {
+	uint32_t ha = *(uint32_t*)a;
+	uint32_t hb = *(uint32_t*)b;
+
+	if (ha < hb) return -1;
+	return ha > hb;
+}
+
+/**
+ * ptp_object_children:
+ * params:	PTPParams*
+ * parent:	handle of the parent object, 0 for the root
+ * handles:	pointer to receive a malloc()ed array of child handles
+ * nrofhandles:	pointer to receive the number of handles
+ *
+ * Returns the handles of all cached objects whose ParentObject is parent,
+ * sorted by handle. Objects of which the parent is not known yet get their
+ * ObjectInfo loaded first, so the result is complete for the cache.
+ *
+ * Return values: Some PTP_RC_* code.
+ **/
+uint16_t
+ptp_object_children (PTPParams *params, uint32_t parent, uint32_t **handles, unsigned int *nrofhandles) {
+	PTPObjectChildren	*ch;
+	PTPObject		*ob, *next;
+	unsigned int		i;
+
+	*handles = NULL;
+	*nrofhandles = 0;
+
+	/* resolve the objects without known parent first */
+	ch = _children_find (params, PTP_HANDLER_SPECIAL, 0);
+	if (ch) {
+		for (ob = ch->first; ob; ob = next) {
+			uint16_t	ret;
+			PTPObject	*xob;
+
+			next = ob->sibling_next;
+			ret = ptp_object_want (params, ob->oid, PTPOBJECT_PARENTOBJECT_LOADED|PTPOBJECT_STORAGEID_LOADED, &xob);
+			if (ret != PTP_RC_OK)
+				return ret;
+			ptp_object_index_parent (params, xob);
+		}
+	}
+
+	ch = _children_find (params, parent, 0);
+	if (!ch || !ch->count)
+		return PTP_RC_OK;
+	*handles = malloc (ch->count*sizeof(uint32_t));
+	if (!*handles)
+		return PTP_RC_GeneralError;
+	for (i = 0, ob = ch->first; ob; ob = ob->sibling_next)
+		(*handles)[i++] = ob->oid;
+	qsort (*handles, i, sizeof(uint32_t), _cmp_handle);
+	*nrofhandles = i;
+	return PTP_RC_OK;
+}
+
 void
 ptp_remove_object_from_cache(PTPParams *params, uint32_t handle)
 {
-	unsigned int i;
-	PTPObject	*ob;
+	PTPObject	*ob, **pob;
 	uint16_t	ret;
 
 	ret = ptp_object_find (params, handle, &ob);
 	if (ret != PTP_RC_OK)
 		return;
-	i = ob-params->objects;
+	/* unlink from the handle hash */
+	pob = &params->objecthash[_ob_hash (handle, params->objecthashsize)];
+	while (*pob != ob)
+		pob = &(*pob)->hash_next;
+	*pob = ob->hash_next;
+	_children_unlink (ob);
+	/* and move the last object into its slot of the object list */
+	params->nrofobjects--;
+	if (ob->index < params->nrofobjects) {
+		params->objects[ob->index] = params->objects[params->nrofobjects];
+		params->objects[ob->index]->index = ob->index;
+	}
 	/* remove object from object info cache */
 	ptp_free_object (ob);
-
-	if (i < params->nrofobjects-1)
-		memmove (ob,ob+1,(params->nrofobjects-1-i)*sizeof(PTPObject));
-	params->nrofobjects--;
-	/* We use less memory than before so this shouldn't fail */
-	params->objects = realloc(params->objects, sizeof(PTPObject)*params->nrofobjects);
+	free (ob);
 }
 
-static int _cmp_ob (const void *a, const void *b) {
-	PTPObject *oa = (PTPObject*)a;
-	PTPObject *ob = (PTPObject*)b;
-
-	return oa->oid - ob->oid;
-}
-	
-void
-ptp_objects_sort (PTPParams *params) {
-	qsort (params->objects, params->nrofobjects, sizeof(PTPObject), _cmp_ob);
+/**
+ * ptp_objects_reserve:
+ * params:	PTPParams*
+ * count:	number of objects about to be added
+ *
+ * Grows the object list and the handle hash so that count more
+ * objects can be added without any further reallocation, e.g. before
+ * entering all handles returned by GetObjectHandles.
+ *
+ * Return values: Some PTP_RC_* code.
+ **/
+uint16_t
+ptp_objects_reserve (PTPParams *params, unsigned int count) {
+	unsigned int	i, want = params->nrofobjects + count;
+
+	if (want > params->allocobjects) {
+		unsigned int	newalloc = params->allocobjects ? params->allocobjects : 64;
+		PTPObject	**newobs;
+
+		while (newalloc < want)
+			newalloc *= 2;
+		newobs = realloc (params->objects, sizeof(PTPObject*)*newalloc);
+		if (!newobs) return PTP_RC_GeneralError;
+		params->objects = newobs;
+		params->allocobjects = newalloc;
+	}
+	/* keep the hash load factor at most 1 */
+	if (want > params->objecthashsize) {
+		unsigned int	newsize = params->objecthashsize ? params->objecthashsize : 64;
+		PTPObject	**newhash;
+
+		while (newsize < want)
+			newsize *= 2;
+		newhash = calloc (newsize, sizeof(PTPObject*));
+		if (!newhash) return PTP_RC_GeneralError;
+		for (i=0;i<params->nrofobjects;i++) {
+			PTPObject	*ob = params->objects[i];
+			unsigned int	h = _ob_hash (ob->oid, newsize);
+
+			ob->hash_next = newhash[h];
+			newhash[h] = ob;
+		}
+		free (params->objecthash);
+		params->objecthash = newhash;
+		params->objecthashsize = newsize;
+	}
+	return PTP_RC_OK;
 }
 
-/* Binary search in objects. Needs "objects" to be a sorted by objectid list!  */
+/* Hash lookup of an object by handle. */
 uint16_t
 ptp_object_find (PTPParams *params, uint32_t handle, PTPObject **retob) {
-	PTPObject	tmpob;
+	PTPObject	*ob = NULL;
 
-	tmpob.oid = handle;
-	*retob = bsearch (&tmpob, params->objects, params->nrofobjects, sizeof(tmpob), _cmp_ob);
-	if (!*retob)
+	if (params->objecthashsize)
+		ob = params->objecthash[_ob_hash (handle, params->objecthashsize)];
+	while (ob && (ob->oid != handle))
+		ob = ob->hash_next;
+	*retob = ob;
+	if (!ob)
 		return PTP_RC_GeneralError;
 	return PTP_RC_OK;
 }
 
-/* Binary search in objects + insert of not found. Needs "objects" to be a sorted by objectid list!  */
+/* Hash lookup of an object by handle, adds an empty object if not found. The
+ * returned object stays at the same address until it is removed again. */
 uint16_t
 ptp_object_find_or_insert (PTPParams *params, uint32_t handle, PTPObject **retob) {
-	unsigned int 	begin, end, cursor;
-	unsigned int	insertat;
-	PTPObject	*newobs;
+	PTPObject	*ob;
+	unsigned int	h;
 
 	if (!handle) return PTP_RC_GeneralError;
-	*retob = NULL;
-	if (!params->nrofobjects) {
-		params->objects = calloc(1,sizeof(PTPObject));
-		params->nrofobjects = 1;
-		params->objects[0].oid = handle;
-		*retob = &params->objects[0];
+	if (ptp_object_find (params, handle, retob) == PTP_RC_OK)
 		return PTP_RC_OK;
-	}
-	begin = 0;
-	end = params->nrofobjects-1;
-	/*ptp_debug (params, "searching %08x, total=%d", handle, params->nrofobjects);*/
-	while (1) {
-		cursor = (end-begin)/2+begin;
-		/*ptp_debug (params, "ob %d: %08x [%d-%d]", cursor, params->objects[cursor].oid, begin, end);*/
-		if (params->objects[cursor].oid == handle) {
-			*retob = &params->objects[cursor];
-			return PTP_RC_OK;
-		}
-		if (params->objects[cursor].oid < handle)
-			begin = cursor;
-		else
-			end = cursor;
-		if ((end - begin) <= 1)
+	if (ptp_objects_reserve (params, 1) != PTP_RC_OK)
+		return PTP_RC_GeneralError;
+	ob = calloc (1, sizeof(PTPObject));
+	if (!ob) return PTP_RC_GeneralError;
+	ob->oid = handle;
+	ob->index = params->nrofobjects;
+	params->objects[params->nrofobjects++] = ob;
+	h = _ob_hash (handle, params->objecthashsize);
+	ob->hash_next = params->objecthash[h];
+	params->objecthash[h] = ob;
+	ptp_object_index_parent (params, ob);
+	*retob = ob;
+	return PTP_RC_OK;
+}
+
+/* Copy the ObjectInfo relevant entries of the objects MTP property list
+ * into its ObjectInfo. Properties with an unexpected datatype are skipped,
+ * devices do not always stick to the types of the specification. */
+static void
+ptp_object_props_to_oi (PTPObject *ob)
+{
+	unsigned int	i;
+	MTPProperties	*prop = ob->mtpprops;
+
+	for (i=0;i<ob->nrofmtpprops;i++,prop++) {
+		/* in case we got all subtree objects */
+		if (prop->ObjectHandle != ob->oid) continue;
+
+		switch (prop->property) {
+		case PTP_OPC_StorageID:
+			if (prop->datatype == PTP_DTC_UINT32)
+				ob->oi.StorageID = prop->propval.u32;
 			break;
+		case PTP_OPC_ObjectFormat:
+			if (prop->datatype == PTP_DTC_UINT16)
+				ob->oi.ObjectFormat = prop->propval.u16;
+			break;
+		case PTP_OPC_ProtectionStatus:
+			if (prop->datatype == PTP_DTC_UINT16)
+				ob->oi.ProtectionStatus = prop->propval.u16;
+			break;
+		case PTP_OPC_ObjectSize:
+			if (prop->datatype == PTP_DTC_UINT64)
+				ob->oi.ObjectCompressedSize = prop->propval.u64;
+			else if (prop->datatype == PTP_DTC_UINT32)
+				ob->oi.ObjectCompressedSize = prop->propval.u32;
+			break;
+		case PTP_OPC_AssociationType:
+			if (prop->datatype == PTP_DTC_UINT16)
+				ob->oi.AssociationType = prop->propval.u16;
+			break;
+		case PTP_OPC_AssociationDesc:
+			if (prop->datatype == PTP_DTC_UINT32)
+				ob->oi.AssociationDesc = prop->propval.u32;
+			break;
+		case PTP_OPC_ObjectFileName:
+			if ((prop->datatype == PTP_DTC_STR) && prop->propval.str) {
+				free(ob->oi.Filename);
+				ob->oi.Filename = strdup(prop->propval.str);
+			}
+			break;
+		case PTP_OPC_DateCreated:
+			if (prop->datatype == PTP_DTC_STR)
+				ob->oi.CaptureDate = ptp_unpack_PTPTIME(prop->propval.str);
+			break;
+		case PTP_OPC_DateModified:
+			if (prop->datatype == PTP_DTC_STR)
+				ob->oi.ModificationDate = ptp_unpack_PTPTIME(prop->propval.str);
+			break;
+		case PTP_OPC_Keywords:
+			if ((prop->datatype == PTP_DTC_STR) && prop->propval.str) {
+				free(ob->oi.Keywords);
+				ob->oi.Keywords = strdup(prop->propval.str);
+			}
+			break;
+		case PTP_OPC_ParentObject:
+			if (prop->datatype == PTP_DTC_UINT32)
+				ob->oi.ParentObject = prop->propval.u32;
+			break;
+		case PTP_OPC_Width:
+			if (prop->datatype == PTP_DTC_UINT32)
+				ob->oi.ImagePixWidth = prop->propval.u32;
+			else if (prop->datatype == PTP_DTC_UINT16)
+				ob->oi.ImagePixWidth = prop->propval.u16;
+			break;
+		case PTP_OPC_Height:
+			if (prop->datatype == PTP_DTC_UINT32)
+				ob->oi.ImagePixHeight = prop->propval.u32;
+			else if (prop->datatype == PTP_DTC_UINT16)
+				ob->oi.ImagePixHeight = prop->propval.u16;
+			break;
+		}
 	}
-	if (params->objects[begin].oid == handle) {
-		*retob = &params->objects[begin];
-		return PTP_RC_OK;
-	}
-	if (params->objects[end].oid == handle) {
-		*retob = &params->objects[end];
-		return PTP_RC_OK;
-	}
-	if ((begin == 0) && (handle < params->objects[0].oid)) {
-		insertat=begin;
-	} else {
-		if ((end == params->nrofobjects-1) && (handle > params->objects[end].oid))
-			insertat=end+1;
-		else
-			insertat=begin+1;
-	}
-	/*ptp_debug (params, "inserting oid %x at [%x,%x], begin=%d, end=%d, insertat=%d\n", handle, params->objects[begin].oid, params->objects[end].oid, begin, end, insertat);*/
-	newobs = realloc (params->objects, sizeof(PTPObject)*(params->nrofobjects+1));
-	if (!newobs) return PTP_RC_GeneralError;
-	params->objects = newobs;
-	if (insertat<params->nrofobjects)
-		memmove (&params->objects[insertat+1],&params->objects[insertat],(params->nrofobjects-insertat)*sizeof(PTPObject));
-	memset(&params->objects[insertat],0,sizeof(PTPObject));
-	params->objects[insertat].oid = handle;
-	*retob = &params->objects[insertat];
-	params->nrofobjects++;
-	return PTP_RC_OK;
 }
 
 uint16_t
@@ -6108,6 +7048,12 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 	if (ret != PTP_RC_OK)
 		return PTP_RC_GeneralError;
 	*retob = ob;
+	/* a full ObjectInfo also does for listing */
+	if (want & PTPOBJECT_LISTINFO_LOADED) {
+		want &= ~PTPOBJECT_LISTINFO_LOADED;
+		if (!(ob->flags & (PTPOBJECT_LISTINFO_LOADED|PTPOBJECT_OBJECTINFO_LOADED)))
+			want |= PTPOBJECT_OBJECTINFO_LOADED;
+	}
 	/* Do we have all of it already? */
 	if ((ob->flags & want) == want)
 		return PTP_RC_OK;
@@ -6120,12 +7066,20 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 		if (ob->flags & PTPOBJECT_PARENTOBJECT_LOADED)
 			saveparent = ob->oi.ParentObject;
 
+		/* the filename might already be there from a property list */
+		free (ob->oi.Filename);
+		ob->oi.Filename = NULL;
 		ret = ptp_getobjectinfo (params, handle, &ob->oi);
 		if (ret != PTP_RC_OK) {
 			/* kill it from the internal list ... */
 			ptp_remove_object_from_cache(params, handle);
 			return ret;
 		}
+		/* a property list fetched earlier still overrides it */
+		if (	(params->device_flags & DEVICE_FLAG_PROPLIST_OVERRIDES_OI) &&
+			(ob->flags & PTPOBJECT_MTPPROPLIST_LOADED)
+		)
+			ptp_object_props_to_oi (ob);
 		if (!ob->oi.Filename) ob->oi.Filename=strdup("<none>");
 		if (ob->flags & PTPOBJECT_PARENTOBJECT_LOADED)
 			ob->oi.ParentObject = saveparent;
@@ -6178,64 +7132,8 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 		ob->nrofmtpprops = nrofprops;
 
 		/* Override the ObjectInfo data with data from properties */
-		if (params->device_flags & DEVICE_FLAG_PROPLIST_OVERRIDES_OI) {
-			unsigned int i;
-			MTPProperties *prop = ob->mtpprops;
-
-			for (i=0;i<ob->nrofmtpprops;i++,prop++) {
-				/* in case we got all subtree objects */
-				if (prop->ObjectHandle != handle) continue;
-
-				switch (prop->property) {
-				case PTP_OPC_StorageID:
-					ob->oi.StorageID = prop->propval.u32;
-					break;
-				case PTP_OPC_ObjectFormat:
-					ob->oi.ObjectFormat = prop->propval.u16;
-					break;
-				case PTP_OPC_ProtectionStatus:
-					ob->oi.ProtectionStatus = prop->propval.u16;
-					break;
-				case PTP_OPC_ObjectSize:
-					if (prop->datatype == PTP_DTC_UINT64) {
-						if (prop->propval.u64 > 0xFFFFFFFFU)
-							ob->oi.ObjectCompressedSize = 0xFFFFFFFFU;
-						else
-							ob->oi.ObjectCompressedSize = (uint32_t)prop->propval.u64;
-					} else if (prop->datatype == PTP_DTC_UINT32) {
-						ob->oi.ObjectCompressedSize = prop->propval.u32;
-					}
-					break;
-				case PTP_OPC_AssociationType:
-					ob->oi.AssociationType = prop->propval.u16;
-					break;
-				case PTP_OPC_AssociationDesc:
-					ob->oi.AssociationDesc = prop->propval.u32;
-					break;
-				case PTP_OPC_ObjectFileName:
-					if (prop->propval.str) {
-						free(ob->oi.Filename);
-						ob->oi.Filename = strdup(prop->propval.str);
-					}
-					break;
-				case PTP_OPC_DateCreated:
-					ob->oi.CaptureDate = ptp_unpack_PTPTIME(prop->propval.str);
-					break;
-				case PTP_OPC_DateModified:
-					ob->oi.ModificationDate = ptp_unpack_PTPTIME(prop->propval.str);
-					break;
-				case PTP_OPC_Keywords:
-					if (prop->propval.str) {
-						free(ob->oi.Keywords);
-						ob->oi.Keywords = strdup(prop->propval.str);
-					}
-					break;
-				case PTP_OPC_ParentObject:
-					ob->oi.ParentObject = prop->propval.u32;
-					break;
-				}
-			}
-		}
+		if (params->device_flags & DEVICE_FLAG_PROPLIST_OVERRIDES_OI)
+			ptp_object_props_to_oi (ob);
 
 #if 0
 		MTPProperties 	*xpl;
@@ -6334,12 +7232,114 @@ ptp_object_want (PTPParams *params, uint32_t handle, unsigned int want, PTPObjec
 		ob->flags |= PTPOBJECT_MTPPROPLIST_LOADED;
 fallback:	;
 	}
+	ptp_object_index_parent (params, ob);
 	if ((ob->flags & want) == want)
 		return PTP_RC_OK;
 	ptp_debug (params, "ptp_object_want: oid 0x%08x, want flags %x, have only %x?", handle, want, ob->flags);
 	return PTP_RC_GeneralError;
 }
 
+typedef struct {
+	uint32_t	parent;
+	unsigned int	loaded;
+} PTPPrefetchPrivate;
+
+/* stores the streamed properties of one child in the object cache */
+static void
+prefetch_child (PTPParams *params, void *priv, MTPProperties *props, unsigned int n)
+{
+	PTPPrefetchPrivate	*pf = (PTPPrefetchPrivate*)priv;
+	PTPObject		*ob;
+	unsigned int		i, seen = 0, format = 0;
+
+	/* objects are expected to come in one run, later runs of an
+	 * object already loaded are dropped like the ones loaded before */
+	if (	(props[0].ObjectHandle == pf->parent)				||
+		(ptp_object_find (params, props[0].ObjectHandle, &ob) != PTP_RC_OK)	||
+		(ob->flags & (PTPOBJECT_OBJECTINFO_LOADED|PTPOBJECT_MTPPROPLIST_LOADED))
+	) {
+		for (i=0;i<n;i++)
+			ptp_destroy_object_prop (&props[i]);
+		return;
+	}
+	ob->mtpprops = malloc (n*sizeof(MTPProperties));
+	if (!ob->mtpprops) {
+		for (i=0;i<n;i++)
+			ptp_destroy_object_prop (&props[i]);
+		return;
+	}
+	memcpy (ob->mtpprops, props, n*sizeof(MTPProperties));
+	ob->nrofmtpprops = n;
+
+	for (i=0;i<n;i++) {
+		switch (props[i].property) {
+		case PTP_OPC_ParentObject:
+			if (props[i].datatype == PTP_DTC_UINT32)
+				seen |= PTPOBJECT_PARENTOBJECT_LOADED;
+			break;
+		case PTP_OPC_StorageID:
+			if (props[i].datatype == PTP_DTC_UINT32)
+				seen |= PTPOBJECT_STORAGEID_LOADED;
+			break;
+		case PTP_OPC_ObjectFormat:
+			if (props[i].datatype == PTP_DTC_UINT16)
+				format = 1;
+			break;
+		}
+	}
+	/* The property list does not carry all of the ObjectInfo (thumbnail
+	 * and sequence fields for instance), so it is not marked as loaded;
+	 * ptp_object_want still does the GetObjectInfo when it is asked for.
+	 * It does carry what a folder listing needs though. */
+	ptp_object_props_to_oi (ob);
+	if (format && ob->oi.Filename)
+		seen |= PTPOBJECT_LISTINFO_LOADED;
+	/* same EOS style bug as in ptp_object_want */
+	if (ob->oi.ParentObject == ob->oid)
+		ob->oi.ParentObject = 0;
+	ob->flags |= seen|PTPOBJECT_MTPPROPLIST_LOADED;
+	ptp_object_index_parent (params, ob);
+	pf->loaded++;
+}
+
+/**
+ * ptp_object_prefetch_children:
+ * params:	PTPParams*
+ * parent:	handle of the folder, 0 for the root
+ *
+ * Fetches the MTP property lists of all direct children of parent with
+ * one GetObjPropList call and stores them with every child already in
+ * the object cache that has not been loaded yet, instead of one
+ * GetObjPropList round trip per child. The parent, storage, format and
+ * filename of the children are known afterwards, so listing them needs
+ * no GetObjectInfo; the full ObjectInfo is not known.
+ *
+ * Does nothing on devices without a working GetObjPropList.
+ *
+ * Return value: PTP_RC_OK if the children were loaded.
+ **/
+uint16_t
+ptp_object_prefetch_children (PTPParams *params, uint32_t parent) {
+	uint16_t		ret;
+	PTPPrefetchPrivate	pf;
+
+	if (params->device_flags & (DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST|DEVICE_FLAG_BROKEN_MTPGETOBJPROPLIST_ALL))
+		return PTP_RC_OperationNotSupported;
+	if (!ptp_operation_issupported(params,PTP_OC_MTP_GetObjPropList))
+		return PTP_RC_OperationNotSupported;
+
+	ptp_debug (params, "ptp2/mtpfast: reading mtp proplists of children of %08x", parent);
+	pf.parent = parent;
+	pf.loaded = 0;
+	/* the children go into the cache while the list is still coming in */
+	ret = ptp_mtp_getobjectproplist_stream (params, parent, 0x00000001U, prefetch_child, &pf, NULL);
+	if (ret != PTP_RC_OK) {
+		ptp_debug (params, "ptp2/mtpfast: folder proplist failed with 0x%04x", ret);
+		return ret;
+	}
+	ptp_debug (params, "ptp2/mtpfast: loaded %d objects below %08x", pf.loaded, parent);
+	return PTP_RC_OK;
+}
 
 uint16_t
 ptp_add_object_to_cache(PTPParams *params, uint32_t handle)
@@ -785,9 +785,19 @@ struct _PTPDeviceInfo {
 	char	*Model;
 	char	*DeviceVersion;
 	char	*SerialNumber;
+
+	/* Bitsets over all 16 bit codes of the above lists, built by
+	 * ptp_deviceinfo_index(). NULL if not available. */
+	uint32_t *OperationsBitset;
+	uint32_t *EventsBitset;
+	uint32_t *DevicePropertiesBitset;
 };
 typedef struct _PTPDeviceInfo PTPDeviceInfo;
 
+#define PTP_BITSET_WORDS		(0x10000/32)
+#define PTP_BITSET_ISSET(set,code)	(((set)[(code)>>5] >> ((code)&31)) & 1)
+#define PTP_BITSET_SET(set,code)	((set)[(code)>>5] |= 1U << ((code)&31))
+
 /* PTP storageIDs structute (returned by GetStorageIDs) */
 
 struct _PTPStorageIDs {
@@ -2113,6 +2123,7 @@ typedef struct _PTPCanonEOSDeviceInfo {
 /* Glue stuff starts here */
 
 typedef struct _PTPParams PTPParams;
+typedef struct _PTPStrCache PTPStrCache;
 
 
 typedef uint16_t (* PTPDataGetFunc)	(PTPParams* params, void*priv,
@@ -2122,9 +2133,17 @@ typedef uint16_t (* PTPDataGetFunc)	(PTPParams* params, void*priv,
 typedef uint16_t (* PTPDataPutFunc)	(PTPParams* params, void*priv,
 					unsigned long sendlen,
 	                                unsigned char *data, unsigned long *putlen);
+
+/* Optional: returns room for wantlen bytes at the handlers destination.
+ * The transport reads into it and passes the same pointer to putfunc,
+ * which then does not need to copy. */
+typedef uint16_t (* PTPDataGetBufFunc)	(PTPParams* params, void*priv,
+					unsigned long wantlen,
+					unsigned char **data);
 typedef struct _PTPDataHandler {
 	PTPDataGetFunc		getfunc;
 	PTPDataPutFunc		putfunc;
+	PTPDataGetBufFunc	getbuffunc;
 	void			*priv;
 } PTPDataHandler;
 
@@ -2141,6 +2160,11 @@ typedef uint16_t (* PTPIOGetData)	(PTPParams* params, PTPContainer* ptp,
 	                                 PTPDataHandler *putter);
 typedef uint16_t (* PTPIOCancelReq)	(PTPParams* params, uint32_t transaction_id);
 
+/* called after each transaction with its round trip time and retries */
+typedef void (* PTPTransactionFunc)	(PTPParams* params, uint16_t code,
+					 uint16_t ret, uint64_t usec,
+					 unsigned int retries);
+
 /* debug functions */
 typedef void (* PTPErrorFunc) (void *data, const char *format, va_list args)
 #if (__GNUC__ >= 3)
@@ -2162,18 +2186,37 @@ struct _PTPObject {
 #define PTPOBJECT_DIRECTORY_LOADED	(1<<3)
 #define PTPOBJECT_PARENTOBJECT_LOADED	(1<<4)
 #define PTPOBJECT_STORAGEID_LOADED	(1<<5)
+/* format and filename, enough to list the object; implied by OBJECTINFO */
+#define PTPOBJECT_LISTINFO_LOADED	(1<<6)
 
 	PTPObjectInfo	oi;
 	uint32_t	canon_flags;
 	MTPProperties	*mtpprops;
 	unsigned int	nrofmtpprops;
+
+	/* object cache bookkeeping, see ptp_object_find_or_insert() */
+	struct _PTPObject	*hash_next;
+	unsigned int		index;		/* in params->objects */
+	/* children index, see ptp_object_index_parent() */
+	struct _PTPObjectChildren	*siblings;
+	struct _PTPObject		*sibling_prev;
+	struct _PTPObject		*sibling_next;
 };
 typedef struct _PTPObject PTPObject;
 
-/* The Device Property Cache */
+/* The cached children of one parent handle */
+struct _PTPObjectChildren {
+	uint32_t			parent;
+	PTPObject			*first;
+	unsigned int			count;
+	struct _PTPObjectChildren	*next;	/* in hash bucket */
+};
+typedef struct _PTPObjectChildren PTPObjectChildren;
+
+/* The Device Property Cache, see ptp_generic_getdevicepropdesc() */
 struct _PTPDeviceProperty {
 	uint16_t		prop;
-	time_t			timestamp;
+	time_t			timestamp;	/* 0 if desc is not valid */
 	PTPDevicePropDesc	desc;
 	PTPPropertyValue	value;
 };
@@ -2200,6 +2243,9 @@ struct _PTPParams {
 	PTPErrorFunc	error_func;
 	PTPDebugFunc	debug_func;
 
+	/* Transaction statistics, may be NULL */
+	PTPTransactionFunc	transaction_func;
+
 	/* Data passed to above functions */
 	void		*data;
 
@@ -2210,17 +2256,28 @@ struct _PTPParams {
 
 	/* PTP IO: if we have MTP style split header/data transfers */
 	int		split_header_data;
+	/* PTP IO: if the port can keep several bulk reads in flight */
+	int		queued_read;
 	int		ocs64; /* 64bit objectsize */
 
 	/* PTP: internal structures used by ptp driver */
-	PTPObject	*objects;
+	PTPObject	**objects;	/* in no particular order, see objecthash */
 	unsigned int	nrofobjects;
+	unsigned int	allocobjects;
+	PTPObject	**objecthash;	/* by handle, chained via hash_next */
+	unsigned int	objecthashsize;
+	PTPObjectChildren **childrenhash; /* by parent handle */
+	unsigned int	childrenhashsize;
+	unsigned int	nrofchildren;
 
 	PTPDeviceInfo	deviceinfo;
 
-	/* PTP: the current event queue */
+	/* PTP: the current event queue, a ring buffer of eventsalloc
+	 * entries holding nrofevents starting at eventsbase */
 	PTPContainer	*events;
-	int		nrofevents;
+	unsigned int	nrofevents;
+	unsigned int	eventsbase;
+	unsigned int	eventsalloc;
 
 	/* PTP: Device Property Caching */
 	PTPDeviceProperty	*deviceproperties;
@@ -2229,12 +2286,15 @@ struct _PTPParams {
 	/* PTP: Canon specific flags list */
 	PTPCanon_Property	*canon_props;
 	unsigned int		nrofcanon_props;
+	uint32_t		*canon_props_bitset;	/* proptypes <= 0xffff seen */
 	int			canon_viewfinder_on;
 	int			canon_event_mode;
 
-	/* PTP: Canon EOS event queue */
+	/* PTP: Canon EOS event queue, a ring buffer like events */
 	PTPCanon_changes_entry	*backlogentries;
 	unsigned int		nrofbacklogentries;
+	unsigned int		backlogbase;
+	unsigned int		backlogalloc;
 	int			eos_captureenabled;
 	int			eos_viewfinderenabled;
 	int			eos_camerastatus;
@@ -2261,6 +2321,8 @@ struct _PTPParams {
 	iconv_t	cd_locale_to_ucs2;
 	iconv_t cd_ucs2_to_locale;
 #endif
+	/* PTP: converted non-ASCII strings, see ptp_unpack_string */
+	PTPStrCache	*strcache;
 
 	/* IO: Sometimes the response packet get send in the dataphase
 	 * too. This only happens for a Samsung player now.
@@ -2407,6 +2469,9 @@ uint16_t ptp_sendobject_from_handler  (PTPParams* params, PTPDataHandler*, uint6
 
 uint16_t ptp_getdevicepropdesc	(PTPParams* params, uint16_t propcode,
 				PTPDevicePropDesc *devicepropertydesc);
+uint16_t ptp_generic_getdevicepropdesc (PTPParams* params, uint16_t propcode,
+				PTPDevicePropDesc *devicepropertydesc);
+void ptp_invalidate_devicepropdesc (PTPParams* params, uint16_t propcode);
 uint16_t ptp_getdevicepropvalue	(PTPParams* params, uint16_t propcode,
 				PTPPropertyValue* value, uint16_t datatype);
 uint16_t ptp_setdevicepropvalue (PTPParams* params, uint16_t propcode,
@@ -2418,10 +2483,13 @@ uint16_t ptp_getfilesystemmanifest (PTPParams* params, uint32_t storage,
 
 
 uint16_t ptp_check_event (PTPParams *params);
+uint16_t ptp_check_propchange_events (PTPParams *params);
 uint16_t ptp_add_event (PTPParams *params, PTPContainer *evt);
 int ptp_get_one_event (PTPParams *params, PTPContainer *evt);
+unsigned int ptp_get_events (PTPParams *params, PTPContainer *evts, unsigned int maxevts);
 uint16_t ptp_check_eos_events (PTPParams *params);
 int ptp_get_one_eos_event (PTPParams *params, PTPCanon_changes_entry *entry);
+unsigned int ptp_get_eos_events (PTPParams *params, PTPCanon_changes_entry *entries, unsigned int maxentries);
 
 
 /* Microsoft MTP extensions */
@@ -2434,7 +2502,13 @@ uint16_t ptp_mtp_setobjectpropvalue (PTPParams* params, uint32_t oid, uint16_t o
 uint16_t ptp_mtp_getobjectreferences (PTPParams* params, uint32_t handle, uint32_t** ohArray, uint32_t* arraylen);
 uint16_t ptp_mtp_setobjectreferences (PTPParams* params, uint32_t handle, uint32_t* ohArray, uint32_t arraylen);
 uint16_t ptp_mtp_getobjectproplist (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops);
+/* Receives the properties of one object from a streamed GetObjPropList,
+ * takes over the contents of props[0..n-1] but not the array. */
+typedef void (* PTPOPLFunc) (PTPParams *params, void *priv, MTPProperties *props, unsigned int n);
+uint16_t ptp_mtp_getobjectproplist_stream (PTPParams* params, uint32_t handle, uint32_t depth,
+					  PTPOPLFunc func, void *priv, unsigned int *nrofprops);
 uint16_t ptp_mtp_getobjectproplist_single (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops);
+uint16_t ptp_mtp_getobjectproplist_level (PTPParams* params, uint32_t handle, MTPProperties **props, int *nrofprops);
 uint16_t ptp_mtp_sendobjectproplist (PTPParams* params, uint32_t* store, uint32_t* parenthandle, uint32_t* handle,
 				     uint16_t objecttype, uint64_t objectsize, MTPProperties *props, int nrofprops);
 uint16_t ptp_mtp_setobjectproplist (PTPParams* params, MTPProperties *props, int nrofprops);
@@ -2625,6 +2699,8 @@ uint16_t ptp_canon_getpartialobject (PTPParams* params, uint32_t handle,
 				uint32_t* readnum);
 uint16_t ptp_canon_getviewfinderimage (PTPParams* params, unsigned char** image,
 				uint32_t* size);
+uint16_t ptp_canon_getviewfinderimage_handler (PTPParams* params,
+				PTPDataHandler *handler, uint32_t* size);
 uint16_t ptp_canon_getchanges (PTPParams* params, uint16_t** props,
 				uint32_t* propnum); 
 uint16_t ptp_canon_getobjectinfo (PTPParams* params, uint32_t store,
@@ -2916,6 +2992,7 @@ uint16_t ptp_nikon_writewifiprofile (PTPParams* params, PTPNIKONWifiProfile* pro
  **/
 #define ptp_nikon_start_liveview(params) ptp_generic_no_data(params,PTP_OC_NIKON_StartLiveView,0)
 uint16_t ptp_nikon_get_liveview_image (PTPParams* params, unsigned char**,unsigned int*);
+uint16_t ptp_nikon_get_liveview_image_handler (PTPParams* params, PTPDataHandler*);
 uint16_t ptp_nikon_get_preview_image (PTPParams* params, unsigned char**, unsigned int*, uint32_t*);
 /**
  * ptp_nikon_end_liveview:
@@ -2968,6 +3045,8 @@ ptp_operation_issupported(PTPParams* params, uint16_t operation)
 {
 	unsigned int i=0;
 
+	if (params->deviceinfo.OperationsBitset)
+		return PTP_BITSET_ISSET(params->deviceinfo.OperationsBitset, operation);
 	for (;i<params->deviceinfo.OperationsSupported_len;i++) {
 		if (params->deviceinfo.OperationsSupported[i]==operation)
 			return 1;
@@ -2977,6 +3056,7 @@ ptp_operation_issupported(PTPParams* params, uint16_t operation)
 
 int ptp_event_issupported	(PTPParams* params, uint16_t event);
 int ptp_property_issupported	(PTPParams* params, uint16_t property);
+void ptp_deviceinfo_index	(PTPDeviceInfo *di);
 
 void ptp_free_params		(PTPParams *params);
 void ptp_free_objectpropdesc	(PTPObjectPropDesc*);
@@ -3007,7 +3087,10 @@ MTPProperties *ptp_find_object_prop_in_cache(PTPParams *params, uint32_t const h
 void ptp_remove_object_from_cache(PTPParams *params, uint32_t handle);
 uint16_t ptp_add_object_to_cache(PTPParams *params, uint32_t handle);
 uint16_t ptp_object_want (PTPParams *, uint32_t handle, unsigned int want, PTPObject**retob);
-void ptp_objects_sort (PTPParams *);
+uint16_t ptp_objects_reserve (PTPParams *params, unsigned int count);
+void ptp_object_index_parent (PTPParams *params, PTPObject *ob);
+uint16_t ptp_object_children (PTPParams *params, uint32_t parent, uint32_t **handles, unsigned int *nrofhandles);
+uint16_t ptp_object_prefetch_children (PTPParams *params, uint32_t parent);
 uint16_t ptp_object_find (PTPParams *params, uint32_t handle, PTPObject **retob);
 uint16_t ptp_object_find_or_insert (PTPParams *params, uint32_t handle, PTPObject **retob);
 /* ptpip.c */
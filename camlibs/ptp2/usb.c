@@ -234,14 +234,15 @@ retry:
 }
 
 #define READLEN 64*1024 /* read blob size */
+#define QUEUEDREADLEN 1024*1024 /* read blob size with queued port reads */
 
 uint16_t
 ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 {
 	uint16_t ret;
 	PTPUSBBulkContainer usbdata;
-	unsigned char	*data;
-	unsigned long	bytes_to_read, written, curread, oldsize;
+	unsigned char	*data, *buf;
+	unsigned long	bytes_to_read, written, curread, oldsize, readlen;
 	Camera		*camera = ((PTPData *)params->data)->camera;
 	int usecontext, progressid = 0, tries = 0, res;
 	GPContext *context = ((PTPData *)params->data)->context;
@@ -360,7 +361,10 @@ ptp_usb_getdata (PTPParams* params, PTPContainer* ptp, PTPDataHandler *handler)
 		/* If not read the rest of it. */
 retry:
 		oldsize = 0;
-		data = malloc(READLEN);
+		/* With queued reads the port keeps the bus busy within a blob,
+		 * so larger blobs leave fewer gaps between them. */
+		readlen = params->queued_read ? QUEUEDREADLEN : READLEN;
+		data = malloc(readlen);
 		if (!data) return PTP_RC_GeneralError;
 		bytes_to_read = len - (rlen - PTP_USB_BULK_HDR_LEN);
 		usecontext = (bytes_to_read > CONTEXT_BLOCK_SIZE);
@@ -375,17 +379,29 @@ retry:
 			 * if smaller than large blob, read all but the last short packet
 			 * depending on EP packetsize.
 			 */
-			if (toread > READLEN)
-				toread = READLEN;
+			if (toread > readlen)
+				toread = readlen;
 			else if (toread > params->maxpacketsize)
 				toread = toread - (toread % params->maxpacketsize);
-			res = gp_port_read (camera->port, (char*)data, toread);
+			/* read straight into the destination if it lets us */
+			if (!handler->getbuffunc ||
+			    (handler->getbuffunc (params, handler->priv, toread, &buf) != PTP_RC_OK))
+				buf = data;
+			if (params->queued_read) {
+				res = gp_port_read_queued (camera->port, (char*)buf, toread);
+				if (res == GP_ERROR_NOT_SUPPORTED) {
+					gp_log (GP_LOG_DEBUG, "ptp2/usbread", "Port has no queued reads, falling back.");
+					params->queued_read = 0;
+					res = gp_port_read (camera->port, (char*)buf, toread);
+				}
+			} else
+				res = gp_port_read (camera->port, (char*)buf, toread);
 			if (res <= 0) {
 				ret = PTP_ERROR_IO;
 				break;
 			}
 			ret = handler->putfunc (params, handler->priv,
-				res, data, &written
+				res, buf, &written
 			);
 			if (ret != PTP_RC_OK)
 				break;
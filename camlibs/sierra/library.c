@@ -1245,6 +1245,8 @@ int sierra_get_string_register (Camera *camera, int reg, int fnumber,
 	p[5] = reg;
 	CHECK (sierra_write_packet (camera, p, context));
 
+	if (file && total)
+		gp_file_reserve (file, total);
 	if (file && total > min_progress_bytes) {
 		id = gp_context_progress_start (context, total, _("Downloading data..."));
 	}
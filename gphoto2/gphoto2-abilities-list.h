@@ -167,6 +167,7 @@ int gp_abilities_list_free   (CameraAbilitiesList *list);
 
 int gp_abilities_list_load   (CameraAbilitiesList *list, GPContext *context);
 int gp_abilities_list_load_dir   (CameraAbilitiesList *list, const char *dir, GPContext *context);
+int gp_abilities_list_rebuild_cache (const char *dir, GPContext *context);
 int gp_abilities_list_reset  (CameraAbilitiesList *list);
 
 int gp_abilities_list_detect (CameraAbilitiesList *list,
@@ -198,6 +199,16 @@ const char *gp_message_codeset (const char *);
 #define CAMLIBDIR_ENV "CAMLIBS"
 #endif /* _GPHOTO2_INTERNAL_CODE */
 
+/**
+ * Name of the environment variable which may contain the file name of
+ * the camlib cache. If it is set but empty, no cache is used.
+ *
+ * \internal Internal use only.
+ */
+#ifdef _GPHOTO2_INTERNAL_CODE
+#define CAMLIBCACHE_ENV "CAMLIBS_CACHE"
+#endif /* _GPHOTO2_INTERNAL_CODE */
+
 
 #ifdef __cplusplus
 }
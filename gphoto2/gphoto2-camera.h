@@ -172,11 +172,92 @@ typedef int (*CameraGetConfigFunc) (Camera *camera, CameraWidget **widget,
  */
 typedef int (*CameraSetConfigFunc) (Camera *camera, CameraWidget  *widget,
 				    GPContext *context);
+/**
+ * \brief Get a single configuration widget
+ *
+ * \param camera the current camera
+ * \param name the name of the widget
+ * \param widget pointer to store the standalone widget in
+ * \param context the active #GPContext
+ *
+ * Like #CameraGetConfigFunc, but builds only the widget of the given name
+ * and so queries the camera for just this value. If not specified, the
+ * core retrieves the complete configuration instead.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraGetSingleConfigFunc) (Camera *camera, const char *name,
+					  CameraWidget **widget,
+					  GPContext *context);
+/**
+ * \brief Set a single configuration value in the camera
+ *
+ * \param camera the current camera
+ * \param name the name of the widget
+ * \param widget the widget holding the new value
+ * \param context the active #GPContext
+ *
+ * The value is applied even if the widget is not marked as changed.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraSetSingleConfigFunc) (Camera *camera, const char *name,
+					  CameraWidget *widget,
+					  GPContext *context);
 typedef int (*CameraCaptureFunc)   (Camera *camera, CameraCaptureType type,
 				    CameraFilePath *path, GPContext *context);
 typedef int (*CameraTriggerCaptureFunc)   (Camera *camera, GPContext *context);
+/**
+ * \brief Get the camera ready for a fast trigger
+ *
+ * \param camera the current camera
+ * \param context the active #GPContext
+ *
+ * Does everything the next #CameraTriggerCaptureFunc call would do before
+ * releasing the shutter, so that it only needs to send the release.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraPrepareTriggerFunc)   (Camera *camera, GPContext *context);
 typedef int (*CameraCapturePreviewFunc) (Camera *camera, CameraFile *file,
 					 GPContext *context);
+/**
+ * \brief Prepare the camera for streaming preview frames
+ *
+ * \param camera the current camera
+ * \param context the active #GPContext
+ *
+ * Does the setup otherwise done by every #CameraCapturePreviewFunc call
+ * once, e.g. switching on the viewfinder, so that the following
+ * #CameraReadPreviewFrameFunc calls only need to fetch the frames.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraStartPreviewStreamFunc) (Camera *camera, GPContext *context);
+/**
+ * \brief Read the next frame of a preview stream
+ *
+ * \param camera the current camera
+ * \param file an empty memory #CameraFile to store the frame in
+ * \param context the active #GPContext
+ *
+ * Only called between #CameraStartPreviewStreamFunc and
+ * #CameraStopPreviewStreamFunc. The \c file keeps its buffer between
+ * frames, so appending to it usually does not need to allocate.
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraReadPreviewFrameFunc) (Camera *camera, CameraFile *file,
+					   GPContext *context);
+/**
+ * \brief End a preview stream
+ *
+ * \param camera the current camera
+ * \param context the active #GPContext
+ *
+ * \returns a gphoto error code
+ */
+typedef int (*CameraStopPreviewStreamFunc) (Camera *camera, GPContext *context);
 typedef int (*CameraSummaryFunc)   (Camera *camera, CameraText *text,
 				    GPContext *context);
 typedef int (*CameraManualFunc)    (Camera *camera, CameraText *text,
@@ -239,13 +320,18 @@ typedef struct _CameraFunctions {
 
 	/* Event Interface */
 	CameraWaitForEvent wait_for_event;	/**< \brief Wait for a specific event from the camera */
+	/* Configuration of single values */
+	CameraGetSingleConfigFunc get_single_config;	/**< \brief Called for requesting a single configuration widget. */
+	CameraSetSingleConfigFunc set_single_config;	/**< \brief Called for setting a single configuration value. */
+
+	/* Preview streaming */
+	CameraStartPreviewStreamFunc start_preview_stream;	/**< \brief Set up the camera for streaming preview frames. */
+	CameraReadPreviewFrameFunc   read_preview_frame;	/**< \brief Read the next preview frame of the stream. */
+	CameraStopPreviewStreamFunc  stop_preview_stream;	/**< \brief End the preview stream. */
+
+	CameraPrepareTriggerFunc prepare_trigger;	/**< \brief Prepare the camera for the next trigger_capture */
+
 	/* Reserved space to use in the future without changing the struct size */
-	void *reserved1;			/**< \brief reserved for future use */
-	void *reserved2;			/**< \brief reserved for future use */
-	void *reserved3;			/**< \brief reserved for future use */
-	void *reserved4;			/**< \brief reserved for future use */
-	void *reserved5;			/**< \brief reserved for future use */
-	void *reserved6;			/**< \brief reserved for future use */
 	void *reserved7;			/**< \brief reserved for future use */
 	void *reserved8;			/**< \brief reserved for future use */
 } CameraFunctions;
@@ -307,17 +393,41 @@ int gp_camera_exit               (Camera *camera, GPContext *context);
  
 
 
+/**
+ * \brief Number of frames a preview stream cycles through.
+ *
+ * A frame returned by gp_camera_read_preview_frame() stays valid until
+ * this many further frames have been read or the stream is stopped.
+ */
+#define GP_PREVIEW_STREAM_BUFFERS	3
+
+/**
+ * \brief Timing of a frame returned by gp_camera_read_preview_frame().
+ */
+typedef struct {
+	unsigned int	sequence;	/**< \brief Number of the frame since the stream was started, from 0. */
+	time_t		time_sec;	/**< \brief Time the frame was received, seconds. */
+	unsigned int	time_usec;	/**< \brief Time the frame was received, microseconds. */
+	unsigned int	fetch_usec;	/**< \brief Time it took to fetch the frame from the camera. */
+	unsigned int	interval_usec;	/**< \brief Time since the previous frame, 0 for the first one. */
+} CameraPreviewFrameInfo;
+
 /** \name Operations on cameras 
  * @{ 
  */
 int gp_camera_ref   		 (Camera *camera);
 int gp_camera_unref 		 (Camera *camera);
+int gp_camera_set_serialized	 (Camera *camera, int serialized);
 int gp_camera_free 		 (Camera *camera);
 
 int gp_camera_get_config	 (Camera *camera, CameraWidget **window,
 				  GPContext *context);
 int gp_camera_set_config	 (Camera *camera, CameraWidget  *window,
 				  GPContext *context);
+int gp_camera_get_single_config	 (Camera *camera, const char *name,
+				  CameraWidget **widget, GPContext *context);
+int gp_camera_set_single_config	 (Camera *camera, const char *name,
+				  CameraWidget *widget, GPContext *context);
 int gp_camera_get_summary	 (Camera *camera, CameraText *summary,
 				  GPContext *context);
 int gp_camera_get_manual	 (Camera *camera, CameraText *manual,
@@ -327,8 +437,14 @@ int gp_camera_get_about		 (Camera *camera, CameraText *about,
 int gp_camera_capture 		 (Camera *camera, CameraCaptureType type,
 				  CameraFilePath *path, GPContext *context);
 int gp_camera_trigger_capture 	 (Camera *camera, GPContext *context);
+int gp_camera_prepare_trigger 	 (Camera *camera, GPContext *context);
 int gp_camera_capture_preview 	 (Camera *camera, CameraFile *file,
 				  GPContext *context);
+int gp_camera_start_preview_stream (Camera *camera, GPContext *context);
+int gp_camera_read_preview_frame (Camera *camera, CameraFile **frame,
+				  CameraPreviewFrameInfo *info,
+				  GPContext *context);
+int gp_camera_stop_preview_stream (Camera *camera, GPContext *context);
 int gp_camera_wait_for_event     (Camera *camera, int timeout,
 		                  CameraEventType *eventtype, void **eventdata,
 			          GPContext *context);
@@ -339,6 +455,53 @@ int gp_camera_get_storageinfo    (Camera *camera, CameraStorageInformation**,
 /**@}*/
 
 
+/**
+ * \brief Number of operation codes #CameraMetrics keeps apart.
+ */
+#define GP_CAMERA_METRICS_OPERATIONS	64
+
+/**
+ * \brief Number of buckets of #CameraOperationMetrics.latency.
+ */
+#define GP_CAMERA_METRICS_BUCKETS	24
+
+/**
+ * \brief Round trips of one kind of operation of a camera driver.
+ */
+typedef struct {
+	unsigned int	code;		/**< \brief Driver specific operation code, e.g. the PTP opcode. 0 collects the operations that did not fit into the table. */
+	unsigned int	count;		/**< \brief Number of operations. */
+	unsigned int	errors;		/**< \brief Operations that failed. */
+	unsigned int	retries;	/**< \brief Retries within the operations. */
+	unsigned int	max_usec;	/**< \brief Slowest round trip, in microseconds. */
+	uint64_t	total_usec;	/**< \brief Sum of all round trips, in microseconds. */
+	/** \brief Histogram of the round trips: bucket n counts operations
+	 * of 2^n up to 2^(n+1)-1 microseconds, the last bucket everything
+	 * slower. */
+	unsigned int	latency[GP_CAMERA_METRICS_BUCKETS];
+} CameraOperationMetrics;
+
+/**
+ * \brief Counters of a camera, see gp_camera_get_metrics().
+ */
+typedef struct {
+	GPPortStats			port;	/**< \brief Transfers on the port. */
+	CameraFilesystemCacheStats	cache;	/**< \brief The file cache of the camera filesystem. */
+	unsigned int			nrofoperations;	/**< \brief Used entries of operations. */
+	CameraOperationMetrics		operations[GP_CAMERA_METRICS_OPERATIONS]; /**< \brief Per operation code, in order of first use. */
+} CameraMetrics;
+
+/** \name Metrics
+ * @{
+ */
+int gp_camera_get_metrics	 (Camera *camera, CameraMetrics *metrics);
+int gp_camera_reset_metrics	 (Camera *camera);
+int gp_camera_record_operation	 (Camera *camera, unsigned int code,
+				  uint64_t usec, int result,
+				  unsigned int retries);
+/**@}*/
+
+
 /** \name Operations on folders 
  * @{
  */
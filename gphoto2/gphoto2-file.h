@@ -113,6 +113,11 @@ int gp_file_ref            (CameraFile *file);
 int gp_file_unref          (CameraFile *file);
 int gp_file_free           (CameraFile *file);
 
+#ifdef _GPHOTO2_INTERNAL_CODE
+int gpi_file_is_shared     (CameraFile *file);
+int gpi_file_is_memory     (CameraFile *file);
+#endif /* _GPHOTO2_INTERNAL_CODE */
+
 int gp_file_set_name       (CameraFile *file, const char  *name);
 int gp_file_get_name       (CameraFile *file, const char **name);
 
@@ -130,6 +135,7 @@ int gp_file_set_data_and_size (CameraFile*,       char *data,
 			       unsigned long int size);
 int gp_file_get_data_and_size (CameraFile*, const char **data,
 			       unsigned long int *size);
+int gp_file_reserve           (CameraFile*, unsigned long int size);
 /* "Do not use those"
  *
  * These functions probably were originally intended for internal use only.
@@ -165,6 +171,9 @@ int gp_file_append            (CameraFile*, const char *data,
 			       unsigned long int size);
 int gp_file_slurp             (CameraFile*, char *data,
 			       size_t size, size_t *readlen);
+int gp_file_get_append_buffer (CameraFile*, unsigned long int size,
+			       char **data);
+int gp_file_reset             (CameraFile*);
 
 #ifdef __cplusplus
 }
@@ -374,6 +374,27 @@ int gp_filesystem_make_dir   (CameraFilesystem *fs, const char *folder,
 int gp_filesystem_remove_dir (CameraFilesystem *fs, const char *folder,
 			      const char *name, GPContext *context);
 
+/**
+ * \brief Statistics of the file cache of a #CameraFilesystem.
+ *
+ * See gp_filesystem_get_cache_stats().
+ */
+typedef struct _CameraFilesystemCacheStats {
+	unsigned long int	hits;		/**< \brief Files served from the cache. */
+	unsigned long int	misses;		/**< \brief Files that had to be fetched from the camera. */
+	unsigned long int	evictions;	/**< \brief Files dropped to stay within the budgets. */
+	unsigned long int	entries;	/**< \brief Files currently cached. */
+	unsigned long int	size;		/**< \brief Bytes currently cached. */
+} CameraFilesystemCacheStats;
+
+/* File cache */
+int gp_filesystem_set_cache_limit       (CameraFilesystem *fs, CameraFileType type,
+					 unsigned long int size);
+int gp_filesystem_set_cache_total_limit (CameraFilesystem *fs, unsigned long int size);
+int gp_filesystem_get_cache_stats       (CameraFilesystem *fs,
+					 CameraFilesystemCacheStats *stats);
+int gp_filesystem_reset_cache_stats     (CameraFilesystem *fs);
+
 /* For debugging */
 int gp_filesystem_dump         (CameraFilesystem *fs);
 
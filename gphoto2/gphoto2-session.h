@@ -0,0 +1,116 @@
+/** \file gphoto2-session.h
+ *
+ * \brief Driving a number of cameras at once.
+ *
+ * \author Copyright 2013 The gPhoto Developers
+ *
+ * \note
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \note
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \note
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GPHOTO2_SESSION_H__
+#define __GPHOTO2_SESSION_H__
+
+#include <gphoto2/gphoto2-abilities-list.h>
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-context.h>
+#include <gphoto2/gphoto2-list.h>
+#include <gphoto2/gphoto2-port-info-list.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief A number of cameras driven together.
+ *
+ * A session loads the camera drivers and port drivers only once and
+ * shares them between all of its cameras. The cameras are opened
+ * concurrently, and operations on all cameras of the session are run
+ * in parallel on a pool of worker threads, one per camera.
+ *
+ * \code
+ *    CameraSession *session;
+ *    CameraList    *list;
+ *
+ *    gp_session_new (&session, context);
+ *    gp_list_new (&list);
+ *    gp_session_autodetect (session, list, context);
+ *    gp_session_open (session, list, context);
+ *    gp_session_trigger_capture (session, context);
+ *    ...
+ *    gp_session_free (session);
+ * \endcode
+ *
+ * The details are internal, please use the gp_session_xxx functions.
+ */
+typedef struct _CameraSession CameraSession;
+
+/**
+ * \brief When the release of a camera was sent and done.
+ *
+ * Times are in microseconds of a monotonic clock, only the differences
+ * between them are meaningful.
+ */
+typedef struct {
+	uint64_t	sent_usec;	/**< \brief Right before the release was sent. */
+	uint64_t	done_usec;	/**< \brief When the camera confirmed the release. */
+} CameraTriggerTiming;
+
+int gp_session_new  (CameraSession **session, GPContext *context);
+int gp_session_free (CameraSession *session);
+
+int gp_session_get_abilities_list (CameraSession *session,
+				   CameraAbilitiesList **list);
+int gp_session_get_port_info_list (CameraSession *session,
+				   GPPortInfoList **list);
+int gp_session_autodetect (CameraSession *session, CameraList *list,
+			   GPContext *context);
+
+int gp_session_open       (CameraSession *session, CameraList *cameras,
+			   GPContext *context);
+int gp_session_close      (CameraSession *session, GPContext *context);
+int gp_session_count      (CameraSession *session);
+int gp_session_get_camera (CameraSession *session, int n, Camera **camera);
+int gp_session_get_result (CameraSession *session, int n);
+
+/** \name Operations on all cameras of a session
+ *
+ * These run on every camera of the session in parallel and return when
+ * all cameras are done. They return #GP_OK if the operation succeeded
+ * on every camera and the error of the first failing camera otherwise;
+ * gp_session_get_result() tells the result of each camera.
+ *
+ * @{
+ */
+int gp_session_trigger_capture (CameraSession *session, GPContext *context);
+int gp_session_trigger_capture_synced (CameraSession *session,
+				       CameraTriggerTiming *timings,
+				       GPContext *context);
+int gp_session_download_latest (CameraSession *session, int timeout,
+				CameraFile **files, GPContext *context);
+int gp_session_wait_for_event  (CameraSession *session, int timeout,
+				int *n, CameraEventType *eventtype,
+				void **eventdata, GPContext *context);
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __GPHOTO2_SESSION_H__ */
@@ -48,6 +48,7 @@ extern "C" {
 #include <gphoto2/gphoto2-file.h>
 #include <gphoto2/gphoto2-library.h>
 #include <gphoto2/gphoto2-setting.h>
+#include <gphoto2/gphoto2-session.h>
 
 #ifdef __cplusplus
 }
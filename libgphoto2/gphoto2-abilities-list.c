@@ -28,11 +28,18 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include <ltdl.h>
 
 #include <gphoto2/gphoto2-result.h>
 #include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-port-portability.h>
 #include <gphoto2/gphoto2-library.h>
 
 #ifdef ENABLE_NLS
@@ -69,12 +76,22 @@
 struct _CameraAbilitiesList {
 	int count;
 	CameraAbilities *abilities;
+
+	/* USB autodetection index, see gp_abilities_list_index_usb() */
+	int usb_indexed;
+	int usb_hashsize;
+	int *usb_hash;		/* first model of a vendor:product bucket */
+	int *usb_next;		/* next model in the same bucket */
+	int nrofusbclass;
+	int *usb_class;		/* models matching by interface class */
 };
 
 /** \internal */
 static int gp_abilities_list_lookup_id (CameraAbilitiesList *, const char *);
 /** \internal */
 static int gp_abilities_list_sort      (CameraAbilitiesList *);
+/** \internal */
+static int gp_abilities_list_index_usb (CameraAbilitiesList *);
 
 /**
  * \brief Set the current character codeset libgphoto2 is operating in.
@@ -161,9 +178,293 @@ foreach_func (const char *filename, lt_ptr data)
 }
 
 
-int
-gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
-			    GPContext *context)
+/*
+ * The camlib cache remembers what camera_id() and camera_abilities()
+ * returned for every camlib of a directory, so that later starts do not
+ * have to dlopen() all of them. A camlib is only loaded again if its
+ * files changed (size or mtime). The whole file is read at once:
+ *
+ *   CamlibCacheHeader
+ *   nrofentries times: CamlibCacheEntry, then count abilities records
+ *
+ * An abilities record is a CameraAbilities without the library and id
+ * strings, which are the same for all models of a camlib. The cache is
+ * host specific and thrown away if the header does not match.
+ */
+
+/** \internal */
+#define CAMLIB_CACHE_MAGIC	"gpcamlb"
+/** \internal */
+#define CAMLIB_CACHE_FORMAT	1
+
+/** \internal */
+#define AB_HEAD_SIZE	offsetof (CameraAbilities, library)
+/** \internal */
+#define AB_TAIL_OFFSET	(offsetof (CameraAbilities, id) + sizeof (((CameraAbilities *)0)->id))
+/** \internal */
+#define AB_RECORD_SIZE	(AB_HEAD_SIZE + sizeof (CameraAbilities) - AB_TAIL_OFFSET)
+
+/** \internal */
+typedef struct {
+	char		magic[8];
+	unsigned int	format;
+	unsigned int	abilities_size;
+	char		version[32];
+	char		dir[1024];
+	unsigned int	nrofentries;
+} CamlibCacheHeader;
+
+/** \internal */
+typedef struct {
+	char		name[1024];	/* as passed to lt_dlopenext() */
+	char		id[1024];	/* empty if the camlib did not load */
+	long long	mtime;
+	long long	size;
+	unsigned int	count;		/* number of abilities records */
+} CamlibCacheEntry;
+
+/** \internal */
+typedef struct {
+	unsigned char	*data;
+	size_t		size, alloc;
+} CamlibCacheBuffer;
+
+static int
+cache_buffer_append (CamlibCacheBuffer *buf, const void *data, size_t size)
+{
+	if (buf->size + size > buf->alloc) {
+		size_t		 alloc = buf->alloc ? buf->alloc : 65536;
+		unsigned char	*n;
+
+		while (buf->size + size > alloc)
+			alloc *= 2;
+		n = realloc (buf->data, alloc);
+		CHECK_MEM (n);
+		buf->data  = n;
+		buf->alloc = alloc;
+	}
+	memcpy (buf->data + buf->size, data, size);
+	buf->size += size;
+	return (GP_OK);
+}
+
+static int
+cache_filename (const char *dir, char *buf, size_t size)
+{
+	const char	*env = getenv (CAMLIBCACHE_ENV);
+	const char	*s;
+	unsigned int	 hash = 2166136261U;
+
+	if (env) {
+		/* set but empty disables the cache */
+		if (!*env)
+			return (GP_ERROR_NOT_SUPPORTED);
+		snprintf (buf, size, "%s", env);
+		return (GP_OK);
+	}
+
+	/* one cache per camlib directory, next to the settings */
+	for (s = dir; *s; s++)
+		hash = (hash ^ (unsigned char)*s) * 16777619U;
+#ifdef WIN32
+	GetWindowsDirectory (buf, size);
+	strcat (buf, "\\gphoto");
+	(void)gp_system_mkdir (buf);
+	snprintf (buf + strlen (buf), size - strlen (buf), "\\camlibs-%08x.cache", hash);
+#else
+	if (!getenv ("HOME"))
+		return (GP_ERROR_NOT_SUPPORTED);
+	snprintf (buf, size, "%s/.gphoto", getenv ("HOME"));
+	(void)gp_system_mkdir (buf);
+	snprintf (buf, size, "%s/.gphoto/camlibs-%08x.cache", getenv ("HOME"), hash);
+#endif
+	return (GP_OK);
+}
+
+/* The size and mtime of the files lt_dlopenext() would load for name.
+ * Returns 0 if there are none. */
+static int
+camlib_stat (const char *name, long long *mtime, long long *size)
+{
+#ifdef WIN32
+	static const char *exts[] = { ".la", ".dll" };
+#else
+	static const char *exts[] = { ".la", ".so" };
+#endif
+	char		buf[1024 + 8];
+	struct stat	st;
+	unsigned int	i;
+	int		found = 0;
+
+	*mtime = *size = 0;
+	for (i = 0; i < sizeof (exts) / sizeof (exts[0]); i++) {
+		snprintf (buf, sizeof (buf), "%s%s", name, exts[i]);
+		if (stat (buf, &st))
+			continue;
+		if (st.st_mtime > *mtime)
+			*mtime = st.st_mtime;
+		*size += st.st_size;
+		found = 1;
+	}
+	return found;
+}
+
+/* Reads the cache for dir. Returns GP_OK with *data == NULL if there is
+ * no usable cache. */
+static int
+cache_read (const char *filename, const char *dir,
+	    unsigned char **data, size_t *size)
+{
+	CamlibCacheHeader	hdr;
+	struct stat		st;
+	FILE			*f;
+
+	*data = NULL;
+	*size = 0;
+	if (stat (filename, &st) || (st.st_size < (off_t)sizeof (hdr)))
+		return (GP_OK);
+	f = fopen (filename, "rb");
+	if (!f)
+		return (GP_OK);
+	*data = malloc (st.st_size);
+	if (!*data) {
+		fclose (f);
+		return (GP_ERROR_NO_MEMORY);
+	}
+	if (fread (*data, 1, st.st_size, f) != (size_t)st.st_size) {
+		fclose (f);
+		free (*data);
+		*data = NULL;
+		return (GP_OK);
+	}
+	fclose (f);
+	*size = st.st_size;
+
+	memcpy (&hdr, *data, sizeof (hdr));
+	if (memcmp (hdr.magic, CAMLIB_CACHE_MAGIC, sizeof (hdr.magic)) ||
+	    (hdr.format != CAMLIB_CACHE_FORMAT) ||
+	    (hdr.abilities_size != sizeof (CameraAbilities)) ||
+	    strncmp (hdr.version, VERSION, sizeof (hdr.version)) ||
+	    strncmp (hdr.dir, dir, sizeof (hdr.dir))) {
+		gp_log (GP_LOG_DEBUG, "gphoto2-abilities-list",
+			"Ignoring camlib cache '%s' of a different version or directory.",
+			filename);
+		free (*data);
+		*data = NULL;
+		*size = 0;
+	}
+	return (GP_OK);
+}
+
+/* Finds the entry of name in the cache read by cache_read(). */
+static const unsigned char *
+cache_lookup (const unsigned char *data, size_t size, const char *name,
+	      CamlibCacheEntry *entry)
+{
+	CamlibCacheHeader	hdr;
+	size_t			off = sizeof (hdr);
+	unsigned int		i;
+
+	if (!data)
+		return NULL;
+	memcpy (&hdr, data, sizeof (hdr));
+	for (i = 0; i < hdr.nrofentries; i++) {
+		if (off + sizeof (*entry) > size)
+			return NULL;
+		memcpy (entry, data + off, sizeof (*entry));
+		if ((entry->count > size) ||
+		    (off + sizeof (*entry) + (size_t)entry->count * AB_RECORD_SIZE > size))
+			return NULL;
+		if (!strncmp (entry->name, name, sizeof (entry->name)))
+			return data + off;
+		off += sizeof (*entry) + (size_t)entry->count * AB_RECORD_SIZE;
+	}
+	return NULL;
+}
+
+static int
+cache_write (const char *filename, CamlibCacheBuffer *buf)
+{
+	char	tmpname[1024 + 8];
+	FILE	*f;
+
+	/* write a new file and move it over, so that concurrent readers
+	 * never see a partial cache */
+	snprintf (tmpname, sizeof (tmpname), "%s.%d", filename, (int)getpid ());
+	f = fopen (tmpname, "wb");
+	if (!f)
+		return (GP_ERROR_FILE_NOT_FOUND);
+	if (fwrite (buf->data, 1, buf->size, f) != buf->size) {
+		fclose (f);
+		unlink (tmpname);
+		return (GP_ERROR_FILE_EXISTS);
+	}
+	if (fclose (f) || rename (tmpname, filename)) {
+		unlink (tmpname);
+		return (GP_ERROR_FILE_EXISTS);
+	}
+	return (GP_OK);
+}
+
+/* Appends the models of a cache entry to the list. */
+static int
+cache_append_abilities (CameraAbilitiesList *list, const unsigned char *e)
+{
+	CamlibCacheEntry	entry;
+	CameraAbilities		*n, *ab;
+	unsigned int		i;
+
+	memcpy (&entry, e, sizeof (entry));
+	if (!entry.count)
+		return (GP_OK);
+	n = realloc (list->abilities,
+		     sizeof (CameraAbilities) * (list->count + entry.count));
+	CHECK_MEM (n);
+	list->abilities = n;
+	list->usb_indexed = 0;
+	e += sizeof (entry);
+	for (i = 0; i < entry.count; i++, e += AB_RECORD_SIZE) {
+		ab = &list->abilities[list->count++];
+		memset (ab, 0, sizeof (*ab));
+		memcpy (ab, e, AB_HEAD_SIZE);
+		memcpy ((char *)ab + AB_TAIL_OFFSET, e + AB_HEAD_SIZE,
+			sizeof (CameraAbilities) - AB_TAIL_OFFSET);
+		memcpy (ab->library, entry.name, sizeof (ab->library));
+		memcpy (ab->id, entry.id, sizeof (ab->id));
+		ab->library[sizeof (ab->library) - 1] = '\0';
+		ab->id[sizeof (ab->id) - 1] = '\0';
+	}
+	return (GP_OK);
+}
+
+/* Adds the entry of a freshly loaded camlib to the new cache. */
+static int
+cache_add_entry (CamlibCacheBuffer *buf, const char *name, const char *id,
+		 long long mtime, long long size,
+		 CameraAbilities *abilities, unsigned int count)
+{
+	CamlibCacheEntry	entry;
+	unsigned int		i;
+
+	memset (&entry, 0, sizeof (entry));
+	strncpy (entry.name, name, sizeof (entry.name) - 1);
+	strncpy (entry.id, id, sizeof (entry.id) - 1);
+	entry.mtime = mtime;
+	entry.size  = size;
+	entry.count = count;
+	CHECK_RESULT (cache_buffer_append (buf, &entry, sizeof (entry)));
+	for (i = 0; i < count; i++) {
+		CHECK_RESULT (cache_buffer_append (buf, &abilities[i], AB_HEAD_SIZE));
+		CHECK_RESULT (cache_buffer_append (buf,
+			(char *)&abilities[i] + AB_TAIL_OFFSET,
+			sizeof (CameraAbilities) - AB_TAIL_OFFSET));
+	}
+	return (GP_OK);
+}
+
+static int
+gp_abilities_list_load_dir_cached (CameraAbilitiesList *list, const char *dir,
+				   int use_cache, GPContext *context)
 {
 	CameraLibraryIdFunc id;
 	CameraLibraryAbilitiesFunc ab;
@@ -174,6 +475,15 @@ gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
 	CameraList *flist;
 	int count;
 	lt_dlhandle lh;
+	char cachename[1024];
+	unsigned char *cache = NULL;
+	size_t cachesize = 0;
+	CamlibCacheBuffer newcache = { NULL, 0, 0 };
+	CamlibCacheHeader hdr;
+	CamlibCacheEntry entry;
+	const unsigned char *e;
+	long long mtime, size;
+	int write_cache = 0, dlinit = 0;
 
 	CHECK_NULL (list && dir);
 
@@ -209,20 +519,86 @@ gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
 	}
 	gp_log (GP_LOG_DEBUG, "gp-abilities-list", "Found %i "
 		"camera drivers.", count);
-	lt_dlinit ();
+
+	if (cache_filename (dir, cachename, sizeof (cachename)) == GP_OK) {
+		write_cache = !use_cache;
+		if (use_cache)
+			cache_read (cachename, dir, &cache, &cachesize);
+		memset (&hdr, 0, sizeof (hdr));
+		memcpy (hdr.magic, CAMLIB_CACHE_MAGIC, sizeof (hdr.magic));
+		hdr.format = CAMLIB_CACHE_FORMAT;
+		hdr.abilities_size = sizeof (CameraAbilities);
+		strncpy (hdr.version, VERSION, sizeof (hdr.version) - 1);
+		strncpy (hdr.dir, dir, sizeof (hdr.dir) - 1);
+		ret = cache_buffer_append (&newcache, &hdr, sizeof (hdr));
+		if (ret < GP_OK) {
+			free (cache);
+			gp_list_free (flist);
+			return ret;
+		}
+	} else
+		cachename[0] = '\0';
+
 	p = gp_context_progress_start (context, count,
 		_("Loading camera drivers from '%s'..."), dir);
 	for (i = 0; i < count; i++) {
+		/* cached camlibs count as loaded, too */
+		gp_context_progress_update (context, p, i);
+		if (gp_context_cancel (context) == GP_CONTEXT_FEEDBACK_CANCEL) {
+			if (dlinit) lt_dlexit ();
+			gp_context_progress_stop (context, p);
+			free (cache);
+			free (newcache.data);
+			gp_list_free (flist);
+			return (GP_ERROR_CANCEL);
+		}
 		ret = gp_list_get_name (flist, i, &filename);
 		if (ret < GP_OK) {
+			free (cache);
+			free (newcache.data);
 			gp_list_free (flist);
 			return ret;
 		}
+		if (!camlib_stat (filename, &mtime, &size))
+			mtime = size = -1;
+
+		e = cache_lookup (cache, cachesize, filename, &entry);
+		if (e && (mtime >= 0) && (entry.mtime == mtime) && (entry.size == size)) {
+			ret = cache_buffer_append (&newcache, e,
+				sizeof (entry) + (size_t)entry.count * AB_RECORD_SIZE);
+			if ((ret == GP_OK) && entry.id[0] &&
+			    (gp_abilities_list_lookup_id (list, entry.id) < 0))
+				ret = cache_append_abilities (list, e);
+			if (ret < GP_OK) {
+				if (dlinit) lt_dlexit ();
+				free (cache);
+				free (newcache.data);
+				gp_list_free (flist);
+				return ret;
+			}
+			hdr.nrofentries++;
+			continue;
+		}
+		if (mtime >= 0) {
+			gp_log (GP_LOG_DEBUG, "gphoto2-abilities-list",
+				"'%s' is not in the camlib cache or has changed.",
+				filename);
+			write_cache = 1;
+		}
+
+		if (!dlinit) {
+			lt_dlinit ();
+			dlinit = 1;
+		}
 		lh = lt_dlopenext (filename);
 		if (!lh) {
 			gp_log (GP_LOG_DEBUG, "gphoto2-abilities-list",
 				"Failed to load '%s': %s.", filename,
 				lt_dlerror ());
+			/* remember it as not loadable */
+			if ((mtime >= 0) && (cache_add_entry (&newcache, filename,
+					"", mtime, size, NULL, 0) == GP_OK))
+				hdr.nrofentries++;
 			continue;
 		}
 
@@ -234,6 +610,9 @@ gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
 				"contain a camera_id function: %s",
 				filename, lt_dlerror ());
 			lt_dlclose (lh);
+			if ((mtime >= 0) && (cache_add_entry (&newcache, filename,
+					"", mtime, size, NULL, 0) == GP_OK))
+				hdr.nrofentries++;
 			continue;
 		}
 
@@ -283,21 +662,87 @@ gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
 			strcpy (list->abilities[x].id, text.text);
 			strcpy (list->abilities[x].library, filename);
 		}
-
-		gp_context_progress_update (context, p, i);
-		if (gp_context_cancel (context) == GP_CONTEXT_FEEDBACK_CANCEL) {
-			lt_dlexit ();
-			gp_list_free (flist);
-			return (GP_ERROR_CANCEL); 
-		}
+		if ((mtime >= 0) && (cache_add_entry (&newcache, filename,
+				text.text, mtime, size,
+				&list->abilities[old_count],
+				new_count - old_count) == GP_OK))
+			hdr.nrofentries++;
 	}
+	gp_context_progress_update (context, p, count);
 	gp_context_progress_stop (context, p);
-	lt_dlexit ();
+	if (dlinit)
+		lt_dlexit ();
 	gp_list_free (flist);
 
+	if (cache) {
+		CamlibCacheHeader oldhdr;
+
+		/* camlibs might have been removed */
+		memcpy (&oldhdr, cache, sizeof (oldhdr));
+		if (oldhdr.nrofentries != hdr.nrofentries)
+			write_cache = 1;
+	}
+	if (cachename[0] && (write_cache || !cache)) {
+		memcpy (newcache.data, &hdr, sizeof (hdr));
+		ret = cache_write (cachename, &newcache);
+		gp_log (GP_LOG_DEBUG, "gphoto2-abilities-list",
+			"Writing camlib cache '%s' with %d entries: %d.",
+			cachename, hdr.nrofentries, ret);
+	}
+	free (cache);
+	free (newcache.data);
+
 	return (GP_OK);
 }
 
+/**
+ * \brief Scans a directory for camera drivers.
+ *
+ * \param list a CameraAbilitiesList
+ * \param dir the directory containing the camera libraries
+ * \param context a GPContext
+ * \return a gphoto2 error code
+ *
+ * Only the camlibs that are new or changed since the last call are
+ * loaded, the abilities of the others come from the camlib cache.
+ * The cache file can be set with the CAMLIBS_CACHE environment variable,
+ * setting it to an empty value disables the cache.
+ */
+int
+gp_abilities_list_load_dir (CameraAbilitiesList *list, const char *dir,
+			    GPContext *context)
+{
+	return gp_abilities_list_load_dir_cached (list, dir, 1, context);
+}
+
+/**
+ * \brief Rebuilds the camlib cache.
+ *
+ * \param dir the directory containing the camera libraries or NULL
+ *            for the default one
+ * \param context a GPContext
+ * \return a gphoto2 error code
+ *
+ * Loads all camera drivers in dir, ignoring the existing cache, and
+ * writes a new cache for it. Usually not needed, as the cache is
+ * refreshed automatically when camlibs change.
+ */
+int
+gp_abilities_list_rebuild_cache (const char *dir, GPContext *context)
+{
+	const char *camlib_env = getenv(CAMLIBDIR_ENV);
+	CameraAbilitiesList *list;
+	int ret;
+
+	if (!dir)
+		dir = (camlib_env != NULL)?camlib_env:CAMLIBS;
+
+	CHECK_RESULT (gp_abilities_list_new (&list));
+	ret = gp_abilities_list_load_dir_cached (list, dir, 0, context);
+	gp_abilities_list_free (list);
+	return (ret);
+}
+
 
 /**
  * \brief Scans the system for camera drivers.
@@ -318,14 +763,73 @@ gp_abilities_list_load (CameraAbilitiesList *list, GPContext *context)
 
 	CHECK_RESULT (gp_abilities_list_load_dir (list, camlibs, context));
 	CHECK_RESULT (gp_abilities_list_sort (list));
+	CHECK_RESULT (gp_abilities_list_index_usb (list));
 
 	return (GP_OK);
 }
 
 
+/** \internal */
+#define USB_HASH(v,p,size) ((((unsigned int)(v) * 0x9e3779b1U) ^ (unsigned int)(p)) & ((size) - 1))
+
+/*
+ * Builds the indices used for USB autodetection: a hash table of the
+ * models by vendor:product id, chained in list order, and the list of
+ * models with an interface class. Has to be redone whenever the list
+ * changes or is reordered.
+ */
 static int
-gp_abilities_list_detect_usb (CameraAbilitiesList *list,
-			      int *ability, GPPort *port)
+gp_abilities_list_index_usb (CameraAbilitiesList *list)
+{
+	int i, h, size = 64;
+
+	free (list->usb_hash);
+	free (list->usb_next);
+	free (list->usb_class);
+	list->usb_hash = list->usb_next = list->usb_class = NULL;
+	list->usb_hashsize = list->nrofusbclass = 0;
+	list->usb_indexed = 0;
+
+	while (size < 2 * list->count)
+		size *= 2;
+	list->usb_hash = malloc (sizeof (int) * size);
+	list->usb_next = malloc (sizeof (int) * (list->count + 1));
+	list->usb_class = malloc (sizeof (int) * (list->count + 1));
+	if (!list->usb_hash || !list->usb_next || !list->usb_class) {
+		free (list->usb_hash);
+		free (list->usb_next);
+		free (list->usb_class);
+		list->usb_hash = list->usb_next = list->usb_class = NULL;
+		return (GP_ERROR_NO_MEMORY);
+	}
+	list->usb_hashsize = size;
+	for (h = 0; h < size; h++)
+		list->usb_hash[h] = -1;
+
+	/* walk backwards so each chain is in list order */
+	for (i = list->count - 1; i >= 0; i--) {
+		list->usb_next[i] = -1;
+		if (!list->abilities[i].usb_vendor)
+			continue;
+		h = USB_HASH (list->abilities[i].usb_vendor,
+			      list->abilities[i].usb_product, size);
+		list->usb_next[i] = list->usb_hash[h];
+		list->usb_hash[h] = i;
+	}
+	for (i = 0; i < list->count; i++)
+		if (list->abilities[i].usb_class)
+			list->usb_class[list->nrofusbclass++] = i;
+	list->usb_indexed = 1;
+	return (GP_OK);
+}
+
+/*
+ * The fallback for ports that cannot list their devices: probe the port
+ * for every model of the list.
+ */
+static int
+gp_abilities_list_detect_usb_scan (CameraAbilitiesList *list,
+				   int *ability, GPPort *port)
 {
 	int i, count, res = GP_ERROR_IO_USB_FIND;
 
@@ -400,6 +904,154 @@ gp_abilities_list_detect_usb (CameraAbilitiesList *list,
 	return res;
 }
 
+/*
+ * Finds the first model of the list that matches a device on the port,
+ * like gp_abilities_list_detect_usb_scan() does, but looks up the ids of
+ * the attached devices in the USB index instead of probing the port for
+ * each of the thousands of models.
+ */
+static int
+gp_abilities_list_detect_usb (CameraAbilitiesList *list,
+			      int *ability, GPPort *port)
+{
+	int *vendors = NULL, *products = NULL, *tmp;
+	int i, j, k, n, h, res, size = 0, start = 0, best, byclass;
+
+	/* The port does not tell how many devices there are, so grow the
+	 * arrays until they are not filled up. */
+	do {
+		size = size ? size * 2 : 64;
+		tmp = realloc (vendors, size * sizeof (int));
+		if (!tmp) {
+			res = GP_ERROR_NO_MEMORY;
+			goto out;
+		}
+		vendors = tmp;
+		tmp = realloc (products, size * sizeof (int));
+		if (!tmp) {
+			res = GP_ERROR_NO_MEMORY;
+			goto out;
+		}
+		products = tmp;
+		n = gp_port_usb_list_device_ids (port, vendors, products, size);
+	} while (n == size);
+	if (n == GP_ERROR_NOT_SUPPORTED) {
+		free (vendors);
+		free (products);
+		gp_port_set_error (port, NULL);
+		return gp_abilities_list_detect_usb_scan (list, ability, port);
+	}
+	res = n;
+	if (res < GP_OK)
+		goto out;
+	if (!list->usb_indexed) {
+		res = gp_abilities_list_index_usb (list);
+		if (res < GP_OK)
+			goto out;
+	}
+
+	gp_log (GP_LOG_VERBOSE, __FILE__,
+		"Auto-detecting USB cameras among %d devices...", n);
+	*ability = -1;
+
+	/* Models from start on are candidates; a model whose device cannot
+	 * be set up is passed over like the scan of the port does. */
+	for (;;) {
+		best = -1;
+		byclass = 0;
+		for (j = 0; j < n; j++) {
+			if (!vendors[j])
+				continue;
+			h = USB_HASH (vendors[j], products[j], list->usb_hashsize);
+			for (i = list->usb_hash[h]; (i >= 0) && ((best < 0) || (i < best)); i = list->usb_next[i]) {
+				if (i < start)
+					continue;
+				if ((list->abilities[i].usb_vendor  == vendors[j]) &&
+				    (list->abilities[i].usb_product == products[j]) &&
+				    (list->abilities[i].port & port->type)) {
+					best = i;
+					break;
+				}
+			}
+		}
+
+		/* A class match only counts if it comes before the id match */
+		for (j = 0; j < list->nrofusbclass; j++) {
+			int c, s, p;
+
+			i = list->usb_class[j];
+			if (i < start)
+				continue;
+			if ((best >= 0) && (i >= best))
+				break;
+			if (!(list->abilities[i].port & port->type))
+				continue;
+			c = list->abilities[i].usb_class;
+			s = list->abilities[i].usb_subclass;
+			p = list->abilities[i].usb_protocol;
+
+			/* Already probed for an earlier model? */
+			for (k = 0; k < j; k++) {
+				CameraAbilities *a = &list->abilities[list->usb_class[k]];
+
+				if ((list->usb_class[k] >= start) &&
+				    (a->port & port->type) && (a->usb_class == c) &&
+				    (a->usb_subclass == s) && (a->usb_protocol == p))
+					break;
+			}
+			if (k < j)
+				continue;
+
+			res = gp_port_usb_find_device_by_class (port, c, s, p);
+			if (res == GP_OK) {
+				best = i;
+				byclass = 1;
+				break;
+			}
+			if (res != GP_ERROR_IO_USB_FIND) {
+				gp_log (GP_LOG_DEBUG, __FILE__,
+					"gp_port_usb_find_device_by_class("
+					"class=0x%x, subclass=0x%x, "
+					"protocol=0x%x) returned %i, "
+					"clearing error message on port",
+					c, s, p, res);
+				goto out;
+			}
+		}
+		if (best < 0) {
+			res = GP_ERROR_IO_USB_FIND;
+			goto out;
+		}
+		if (byclass)
+			break;
+
+		/* sets up the port for this device */
+		res = gp_port_usb_find_device (port,
+					       list->abilities[best].usb_vendor,
+					       list->abilities[best].usb_product);
+		if (res == GP_OK)
+			break;
+		if (res != GP_ERROR_IO_USB_FIND)
+			goto out;
+		gp_log (GP_LOG_DEBUG, __FILE__,
+			"Could not set up '%s' (0x%x,0x%x), trying the next model",
+			list->abilities[best].model,
+			list->abilities[best].usb_vendor,
+			list->abilities[best].usb_product);
+		start = best + 1;
+	}
+	gp_log (GP_LOG_DEBUG, __FILE__, "Found '%s' (0x%x,0x%x)",
+		list->abilities[best].model,
+		list->abilities[best].usb_vendor,
+		list->abilities[best].usb_product);
+	*ability = best;
+	res = GP_OK;
+out:
+	free (vendors);
+	free (products);
+	return res;
+}
+
 
 /**
  * \param list a CameraAbilitiesList
@@ -547,6 +1199,7 @@ gp_abilities_list_append (CameraAbilitiesList *list, CameraAbilities abilities)
 	remove_colon_from_string(list->abilities[list->count].model);
 
 	list->count++;
+	list->usb_indexed = 0;
 
 	return (GP_OK);
 }
@@ -568,6 +1221,13 @@ gp_abilities_list_reset (CameraAbilitiesList *list)
 	}
 	list->count = 0;
 
+	free (list->usb_hash);
+	free (list->usb_next);
+	free (list->usb_class);
+	list->usb_hash = list->usb_next = list->usb_class = NULL;
+	list->usb_hashsize = list->nrofusbclass = 0;
+	list->usb_indexed = 0;
+
 	return (GP_OK);
 }
 
@@ -599,6 +1259,7 @@ gp_abilities_list_sort (CameraAbilitiesList *list)
 	CHECK_NULL (list);
 
 	qsort (list->abilities, list->count, sizeof(CameraAbilities), cmp_abilities);
+	list->usb_indexed = 0;
 	return (GP_OK);
 }
 
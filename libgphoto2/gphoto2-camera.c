@@ -31,6 +31,12 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+#endif
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
 
 #include <ltdl.h>
 
@@ -59,16 +65,7 @@
 
 #define CHECK_NULL(r)              {if (!(r)) return (GP_ERROR_BAD_PARAMETERS);}
 
-#define CAMERA_UNUSED(c,ctx)						\
-{									\
-	(c)->pc->used--;						\
-	if (!(c)->pc->used) {						\
-		if ((c)->pc->exit_requested)				\
-			gp_camera_exit ((c), (ctx));			\
-		if (!(c)->pc->ref_count)				\
-			gp_camera_free (c);				\
-	}								\
-}
+#define CAMERA_UNUSED(c,ctx) gp_camera_leave ((c), (ctx))
 
 #define CR(c,result,ctx)						\
 {									\
@@ -192,7 +189,6 @@
 	int r5 = (res);							\
 									\
 	if (r5 < 0) {							\
-		CAMERA_UNUSED (c,ctx);                              	\
 		gp_list_free (list);					\
 		return (r5);						\
 	}								\
@@ -215,9 +211,8 @@
 
 #define CHECK_INIT(c,ctx)						\
 {									\
-	if ((c)->pc->used)						\
+	if (gp_camera_enter (c) < 0)					\
 		return (GP_ERROR_CAMERA_BUSY);				\
-	(c)->pc->used++;						\
 	if (!(c)->pc->lh)						\
 		CR((c), gp_camera_init (c, ctx), ctx);			\
 }
@@ -247,8 +242,200 @@ struct _CameraPrivateCore {
 	void                  *timeout_data;
 	unsigned int          *timeout_ids;
 	unsigned int           timeout_ids_len;
+
+	/* Preview stream */
+	int            preview_streaming;
+	CameraFile    *preview_frames[GP_PREVIEW_STREAM_BUFFERS];
+	unsigned int   preview_sequence;
+	struct timeval preview_last;
+
+	/* Operation metrics (see gp_camera_record_operation) */
+	unsigned int           nrofoperations;
+	CameraOperationMetrics operations[GP_CAMERA_METRICS_OPERATIONS];
+
+#ifdef HAVE_PTHREAD
+	/*
+	 * Serialized access (see gp_camera_set_serialized). Callers take
+	 * a ticket and run their operation once it is served, so the
+	 * operations are executed one after the other in the order they
+	 * were requested. The lock protects the fields below, used,
+	 * ref_count and the operation metrics.
+	 */
+	int             serialized;
+	pthread_mutex_t lock;
+	pthread_cond_t  turn_cond;
+	unsigned long   ticket_next;
+	unsigned long   ticket_served;
+	int             turn_taken;
+	pthread_t       turn_owner;
+#endif
 };
 
+#ifdef HAVE_PTHREAD
+/* Whether the calling thread is running an operation on the camera */
+static int
+gp_camera_owns_turn (Camera *camera)
+{
+	int owns;
+
+	pthread_mutex_lock (&camera->pc->lock);
+	owns = camera->pc->turn_taken &&
+	       pthread_equal (camera->pc->turn_owner, pthread_self ());
+	pthread_mutex_unlock (&camera->pc->lock);
+	return owns;
+}
+#endif
+
+/*
+ * Marks the camera as used by an operation. Without serialized access,
+ * a camera that is already in use is busy. With it, the caller waits
+ * until all operations requested before have finished; only calls from
+ * within an operation of the same thread are busy.
+ */
+static int
+gp_camera_enter (Camera *camera)
+{
+#ifdef HAVE_PTHREAD
+	if (camera->pc->serialized) {
+		unsigned long ticket;
+
+		pthread_mutex_lock (&camera->pc->lock);
+		if (camera->pc->turn_taken &&
+		    pthread_equal (camera->pc->turn_owner, pthread_self ())) {
+			pthread_mutex_unlock (&camera->pc->lock);
+			return (GP_ERROR_CAMERA_BUSY);
+		}
+		ticket = camera->pc->ticket_next++;
+		while (ticket != camera->pc->ticket_served)
+			pthread_cond_wait (&camera->pc->turn_cond,
+					   &camera->pc->lock);
+		camera->pc->turn_taken = 1;
+		camera->pc->turn_owner = pthread_self ();
+		camera->pc->used++;
+		pthread_mutex_unlock (&camera->pc->lock);
+		return (GP_OK);
+	}
+#endif
+	if (camera->pc->used)
+		return (GP_ERROR_CAMERA_BUSY);
+	camera->pc->used++;
+	return (GP_OK);
+}
+
+/*
+ * Ends an operation started with gp_camera_enter. The last one runs
+ * a postponed gp_camera_exit and frees an unreferenced camera before
+ * the next waiting operation gets its turn.
+ */
+static void
+gp_camera_leave (Camera *camera, GPContext *context)
+{
+#ifdef HAVE_PTHREAD
+	if (camera->pc->serialized) {
+		pthread_mutex_lock (&camera->pc->lock);
+		camera->pc->used--;
+		if (camera->pc->used) {
+			pthread_mutex_unlock (&camera->pc->lock);
+			return;
+		}
+		pthread_mutex_unlock (&camera->pc->lock);
+		if (camera->pc->exit_requested)
+			gp_camera_exit (camera, context);
+		pthread_mutex_lock (&camera->pc->lock);
+		if (!camera->pc->ref_count) {
+			pthread_mutex_unlock (&camera->pc->lock);
+			gp_camera_free (camera);
+			return;
+		}
+		camera->pc->turn_taken = 0;
+		camera->pc->ticket_served++;
+		pthread_cond_broadcast (&camera->pc->turn_cond);
+		pthread_mutex_unlock (&camera->pc->lock);
+		return;
+	}
+#endif
+	camera->pc->used--;
+	if (!camera->pc->used) {
+		if (camera->pc->exit_requested)
+			gp_camera_exit (camera, context);
+		if (!camera->pc->ref_count)
+			gp_camera_free (camera);
+	}
+}
+
+#ifdef HAVE_PTHREAD
+/* libltdl is not thread safe, but cameras may be opened and closed from
+ * several threads at once (see gphoto2-session.c) */
+static pthread_mutex_t gp_camera_ltdl_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Loads the camera driver and looks up its camera_init function. */
+static int
+gp_camera_load_driver (Camera *camera, CameraLibraryInitFunc *init_func,
+		       GPContext *context)
+{
+	int result = GP_OK;
+
+	gp_log (GP_LOG_DEBUG, "gphoto2-camera", "Loading '%s'...",
+		camera->pc->a.library);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&gp_camera_ltdl_lock);
+#endif
+	lt_dlinit ();
+	camera->pc->lh = lt_dlopenext (camera->pc->a.library);
+	if (!camera->pc->lh) {
+		gp_context_error (context, _("Could not load required "
+			"camera driver '%s' (%s)."), camera->pc->a.library,
+			lt_dlerror ());
+		lt_dlexit ();
+		result = GP_ERROR_LIBRARY;
+	} else {
+		*init_func = lt_dlsym (camera->pc->lh, "camera_init");
+		if (!*init_func) {
+			lt_dlclose (camera->pc->lh);
+			lt_dlexit ();
+			camera->pc->lh = NULL;
+			gp_context_error (context, _("Camera driver '%s' is "
+				"missing the 'camera_init' function."),
+				camera->pc->a.library);
+			result = GP_ERROR_LIBRARY;
+		}
+	}
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock (&gp_camera_ltdl_lock);
+#endif
+	return (result);
+}
+
+static void
+gp_camera_unload_driver (Camera *camera)
+{
+	if (!camera->pc->lh)
+		return;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&gp_camera_ltdl_lock);
+#endif
+	lt_dlclose (camera->pc->lh);
+	lt_dlexit ();
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock (&gp_camera_ltdl_lock);
+#endif
+	camera->pc->lh = NULL;
+}
+
+static void
+gp_camera_free_preview_frames (Camera *camera)
+{
+	unsigned int i;
+
+	for (i = 0; i < GP_PREVIEW_STREAM_BUFFERS; i++) {
+		if (camera->pc->preview_frames[i]) {
+			gp_file_unref (camera->pc->preview_frames[i]);
+			camera->pc->preview_frames[i] = NULL;
+		}
+	}
+}
+
 
 /**
  * Close connection to camera.
@@ -274,6 +461,19 @@ gp_camera_exit (Camera *camera, GPContext *context)
 	gp_log (GP_LOG_DEBUG, "gphoto2-camera", "Exiting camera ('%s')...",
 		camera->pc->a.model);
 
+#ifdef HAVE_PTHREAD
+	/*
+	 * Queue up behind the running operations, the exit is then done
+	 * when our own turn ends.
+	 */
+	if (camera->pc->serialized && !gp_camera_owns_turn (camera)) {
+		gp_camera_enter (camera);
+		camera->pc->exit_requested = 1;
+		gp_camera_leave (camera, context);
+		return (GP_OK);
+	}
+#endif
+
 	/*
 	 * We have to postpone this operation if the camera is currently 
 	 * in use. gp_camera_exit will be called again if the
@@ -290,6 +490,10 @@ gp_camera_exit (Camera *camera, GPContext *context)
 	free (camera->pc->timeout_ids);
 	camera->pc->timeout_ids = NULL;
 
+	/* The driver cleans up the camera side of the stream in exit */
+	camera->pc->preview_streaming = 0;
+	gp_camera_free_preview_frames (camera);
+
 	if (camera->functions->exit) {
 #ifdef HAVE_MULTI
 		gp_port_open (camera->port);
@@ -299,11 +503,7 @@ gp_camera_exit (Camera *camera, GPContext *context)
 	gp_port_close (camera->port);
 	memset (camera->functions, 0, sizeof (CameraFunctions));
 
-	if (camera->pc->lh) {
-		lt_dlclose (camera->pc->lh);
-		lt_dlexit ();
-		camera->pc->lh = NULL;
-	}
+	gp_camera_unload_driver (camera);
 
 	gp_filesystem_reset (camera->fs);
 
@@ -343,6 +543,10 @@ gp_camera_new (Camera **camera)
 		return (GP_ERROR_NO_MEMORY);
 	}
 	memset ((*camera)->pc, 0, sizeof (CameraPrivateCore));
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init (&(*camera)->pc->lock, NULL);
+	pthread_cond_init (&(*camera)->pc->turn_cond, NULL);
+#endif
 
         (*camera)->pc->ref_count = 1;
 
@@ -532,7 +736,13 @@ gp_camera_ref (Camera *camera)
 {
 	CHECK_NULL (camera);
 
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&camera->pc->lock);
+#endif
 	camera->pc->ref_count += 1;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock (&camera->pc->lock);
+#endif
 
 	return (GP_OK);
 }
@@ -551,9 +761,17 @@ gp_camera_ref (Camera *camera)
 int
 gp_camera_unref (Camera *camera)
 {
+	int do_free;
+
 	CHECK_NULL (camera);
 
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&camera->pc->lock);
+#endif
 	if (!camera->pc->ref_count) {
+#ifdef HAVE_PTHREAD
+		pthread_mutex_unlock (&camera->pc->lock);
+#endif
 		gp_log (GP_LOG_ERROR, "gphoto2-camera", "gp_camera_unref on "
 			"a camera with ref_count == 0 should not happen "
 			"at all");
@@ -562,13 +780,193 @@ gp_camera_unref (Camera *camera)
 
 	camera->pc->ref_count -= 1;
 
-	if (!camera->pc->ref_count) {
+	/* We cannot free a camera that is currently in use */
+	do_free = !camera->pc->ref_count && !camera->pc->used;
+#ifdef HAVE_PTHREAD
+	if (camera->pc->turn_taken)
+		do_free = 0;
+	pthread_mutex_unlock (&camera->pc->lock);
+#endif
+	if (do_free)
+		gp_camera_free (camera);
 
-		/* We cannot free a camera that is currently in use */
-		if (!camera->pc->used)
-			gp_camera_free (camera);
+	return (GP_OK);
+}
+
+
+/**
+ * Serialize the access to a #Camera from several threads.
+ *
+ * @param camera a #Camera
+ * @param serialized whether the access should be serialized
+ * @return a gphoto2 error code
+ *
+ * By default, calling a gp_camera_* function while another one is still
+ * running on the same \c camera fails with #GP_ERROR_CAMERA_BUSY. With
+ * serialized access, calls from different threads are queued instead and
+ * run one after the other, in the order they were made. This way e.g. a
+ * user interface thread can capture previews while another thread
+ * downloads files, without locking around every call.
+ *
+ * The camera filesystem is only accessed from within the queued calls;
+ * use the gp_camera_* functions rather than the #CameraFilesystem of the
+ * camera directly from several threads.
+ *
+ * Must not be changed while the camera is in use.
+ *
+ */
+int
+gp_camera_set_serialized (Camera *camera, int serialized)
+{
+	CHECK_NULL (camera);
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&camera->pc->lock);
+	if (camera->pc->used || camera->pc->turn_taken) {
+		pthread_mutex_unlock (&camera->pc->lock);
+		return (GP_ERROR_CAMERA_BUSY);
+	}
+	camera->pc->serialized = serialized ? 1 : 0;
+	pthread_mutex_unlock (&camera->pc->lock);
+	return (GP_OK);
+#else
+	if (serialized)
+		return (GP_ERROR_NOT_SUPPORTED);
+	return (GP_OK);
+#endif
+}
+
+
+/**
+ * \brief Record the round trip of a driver operation
+ *
+ * @param camera a #Camera
+ * @param code the driver specific code of the operation, e.g. a PTP opcode
+ * @param usec how long the operation took, in microseconds
+ * @param result the gphoto2 error code of the operation
+ * @param retries how often parts of the operation had to be retried
+ * @return a gphoto2 error code
+ *
+ * Called by camera drivers after each operation they send to the camera.
+ * The first #GP_CAMERA_METRICS_OPERATIONS - 1 codes get an entry of their
+ * own, all further ones are counted together under code 0.
+ *
+ */
+int
+gp_camera_record_operation (Camera *camera, unsigned int code,
+			    uint64_t usec, int result, unsigned int retries)
+{
+	CameraOperationMetrics *op = NULL;
+	unsigned int i, bucket;
+
+	CHECK_NULL (camera);
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&camera->pc->lock);
+#endif
+	for (i = 0; i < camera->pc->nrofoperations; i++)
+		if (camera->pc->operations[i].code == code) {
+			op = &camera->pc->operations[i];
+			break;
+		}
+	if (!op && (camera->pc->nrofoperations < GP_CAMERA_METRICS_OPERATIONS - 1)) {
+		op = &camera->pc->operations[camera->pc->nrofoperations++];
+		op->code = code;
+	}
+	if (!op) {
+		/* the table is full, use the shared last entry */
+		op = &camera->pc->operations[GP_CAMERA_METRICS_OPERATIONS - 1];
+		if (camera->pc->nrofoperations < GP_CAMERA_METRICS_OPERATIONS) {
+			camera->pc->nrofoperations++;
+			op->code = 0;
+		}
 	}
 
+	op->count++;
+	if (result < 0)
+		op->errors++;
+	op->retries += retries;
+	op->total_usec += usec;
+	if (usec > op->max_usec)
+		op->max_usec = (usec > 0xffffffff) ? 0xffffffff : usec;
+	for (bucket = 0; (usec >>= 1) && (bucket < GP_CAMERA_METRICS_BUCKETS - 1); bucket++)
+		;
+	op->latency[bucket]++;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock (&camera->pc->lock);
+#endif
+
+	return (GP_OK);
+}
+
+
+/**
+ * \brief Get the metrics of a camera
+ *
+ * @param camera a #Camera
+ * @param metrics the #CameraMetrics to fill in
+ * @return a gphoto2 error code
+ *
+ * Collects the transfer statistics of the port, the statistics of the
+ * file cache and the round trips of the operations the driver recorded
+ * since the camera was created or gp_camera_reset_metrics() was called.
+ * Does not wait for a running operation, so it can be used to watch a
+ * long download from another thread. Each part is copied under the lock
+ * its writer takes, so no counter is read while it is being updated.
+ *
+ */
+int
+gp_camera_get_metrics (Camera *camera, CameraMetrics *metrics)
+{
+	CHECK_NULL (camera && metrics);
+
+	memset (metrics, 0, sizeof (CameraMetrics));
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&camera->pc->lock);
+#endif
+	if (camera->port)
+		gp_port_get_stats (camera->port, &metrics->port);
+	if (camera->fs)
+		gp_filesystem_get_cache_stats (camera->fs, &metrics->cache);
+	metrics->nrofoperations = camera->pc->nrofoperations;
+	memcpy (metrics->operations, camera->pc->operations,
+		sizeof (CameraOperationMetrics) * camera->pc->nrofoperations);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock (&camera->pc->lock);
+#endif
+
+	return (GP_OK);
+}
+
+
+/**
+ * \brief Reset the metrics of a camera
+ *
+ * @param camera a #Camera
+ * @return a gphoto2 error code
+ *
+ * Starts all counters of gp_camera_get_metrics() from zero again,
+ * including those of the port and of the file cache.
+ *
+ */
+int
+gp_camera_reset_metrics (Camera *camera)
+{
+	CHECK_NULL (camera);
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock (&camera->pc->lock);
+#endif
+	if (camera->port)
+		gp_port_reset_stats (camera->port);
+	if (camera->fs)
+		gp_filesystem_reset_cache_stats (camera->fs);
+	camera->pc->nrofoperations = 0;
+	memset (camera->pc->operations, 0, sizeof (camera->pc->operations));
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock (&camera->pc->lock);
+#endif
+
 	return (GP_OK);
 }
 
@@ -606,6 +1004,11 @@ gp_camera_free (Camera *camera)
 	if (camera->pc) {
 		if (camera->pc->timeout_ids)
 			free (camera->pc->timeout_ids);
+		gp_camera_free_preview_frames (camera);
+#ifdef HAVE_PTHREAD
+		pthread_cond_destroy (&camera->pc->turn_cond);
+		pthread_mutex_destroy (&camera->pc->lock);
+#endif
 		free (camera->pc);
 		camera->pc = NULL;
 	}
@@ -716,6 +1119,15 @@ gp_camera_init (Camera *camera, GPContext *context)
 	gp_log (GP_LOG_DEBUG, "gphoto2-camera", "Initializing camera...");
 
 	CHECK_NULL (camera);
+#ifdef HAVE_PTHREAD
+	/* Called by the application, not from within an operation */
+	if (camera->pc->serialized && !gp_camera_owns_turn (camera)) {
+		gp_camera_enter (camera);
+		result = gp_camera_init (camera, context);
+		gp_camera_leave (camera, context);
+		return (result);
+	}
+#endif
 	/*
 	 * Reset the exit_requested flag. If this flag is set, 
 	 * gp_camera_exit will be called as soon as the camera is no
@@ -800,12 +1212,14 @@ gp_camera_init (Camera *camera, GPContext *context)
 			if (gp_port_usb_find_device (camera->port,
 					camera->pc->a.usb_vendor,
 					camera->pc->a.usb_product) != GP_OK) {
-				CRS (camera, gp_port_usb_find_device_by_class
+				result = gp_port_usb_find_device_by_class
 					(camera->port,
 					camera->pc->a.usb_class,
 					camera->pc->a.usb_subclass,
-					camera->pc->a.usb_protocol), context);
-					}
+					camera->pc->a.usb_protocol);
+				if (result < 0)
+					return (result);
+			}
 			break;
 		default:
 			break;
@@ -813,46 +1227,23 @@ gp_camera_init (Camera *camera, GPContext *context)
 	}
 
 	/* Load the library. */
-	gp_log (GP_LOG_DEBUG, "gphoto2-camera", "Loading '%s'...",
-		camera->pc->a.library);
-	lt_dlinit ();
-	camera->pc->lh = lt_dlopenext (camera->pc->a.library);
-	if (!camera->pc->lh) {
-		gp_context_error (context, _("Could not load required "
-			"camera driver '%s' (%s)."), camera->pc->a.library,
-			lt_dlerror ());
-		lt_dlexit ();
-		return (GP_ERROR_LIBRARY);
-	}
-
-	/* Initialize the camera */
-	init_func = lt_dlsym (camera->pc->lh, "camera_init");
-	if (!init_func) {
-		lt_dlclose (camera->pc->lh);
-		lt_dlexit ();
-		camera->pc->lh = NULL;
-		gp_context_error (context, _("Camera driver '%s' is "
-			"missing the 'camera_init' function."), 
-			camera->pc->a.library);
-		return (GP_ERROR_LIBRARY);
-	}
+	result = gp_camera_load_driver (camera, &init_func, context);
+	if (result < 0)
+		return (result);
 
 	if (strcasecmp (camera->pc->a.model, "Directory Browse")) {
 		result = gp_port_open (camera->port);
 		if (result < 0) {
-			lt_dlclose (camera->pc->lh);
-			lt_dlexit ();
-			camera->pc->lh = NULL;
+			gp_camera_unload_driver (camera);
 			return (result);
 		}
 	}
 
+	/* Initialize the camera */
 	result = init_func (camera, context);
 	if (result < 0) {
 		gp_port_close (camera->port);
-		lt_dlclose (camera->pc->lh);
-		lt_dlexit ();
-		camera->pc->lh = NULL;
+		gp_camera_unload_driver (camera);
 		memset (camera->functions, 0, sizeof (CameraFunctions));
 		return (result);
 	}
@@ -930,6 +1321,196 @@ gp_camera_set_config (Camera *camera, CameraWidget *window, GPContext *context)
 	return (GP_OK);
 }
 
+static int
+gp_camera_copy_widget_value (CameraWidget *to, CameraWidget *from)
+{
+	CameraWidgetType	type;
+	CameraWidgetCallback	callback;
+	char			*str = NULL;
+	float			f;
+	int			i;
+
+	gp_widget_get_type (from, &type);
+	switch (type) {
+	case GP_WIDGET_MENU:
+	case GP_WIDGET_RADIO:
+	case GP_WIDGET_TEXT:
+		gp_widget_get_value (from, &str);
+		if (!str)
+			return (GP_OK);
+		return (gp_widget_set_value (to, str));
+	case GP_WIDGET_RANGE:
+		gp_widget_get_value (from, &f);
+		return (gp_widget_set_value (to, &f));
+	case GP_WIDGET_DATE:
+	case GP_WIDGET_TOGGLE:
+		gp_widget_get_value (from, &i);
+		return (gp_widget_set_value (to, &i));
+	case GP_WIDGET_BUTTON:
+		gp_widget_get_value (from, &callback);
+		return (gp_widget_set_value (to, (void *) callback));
+	default:
+		return (GP_ERROR_BAD_PARAMETERS);
+	}
+}
+
+/* Creates a standalone copy of a leaf widget out of a configuration tree. */
+static int
+gp_camera_clone_widget (CameraWidget *from, CameraWidget **to)
+{
+	CameraWidgetType	type;
+	const char		*label, *name, *info, *choice;
+	float			min, max, step;
+	int			i, n, readonly, ret;
+
+	gp_widget_get_type (from, &type);
+	gp_widget_get_label (from, &label);
+	ret = gp_widget_new (type, label, to);
+	if (ret < 0)
+		return (ret);
+	if ((gp_widget_get_name (from, &name) == GP_OK) && name)
+		gp_widget_set_name (*to, name);
+	if ((gp_widget_get_info (from, &info) == GP_OK) && info)
+		gp_widget_set_info (*to, info);
+	gp_widget_get_readonly (from, &readonly);
+	gp_widget_set_readonly (*to, readonly);
+	if (type == GP_WIDGET_RANGE) {
+		gp_widget_get_range (from, &min, &max, &step);
+		gp_widget_set_range (*to, min, max, step);
+	}
+	n = gp_widget_count_choices (from);
+	for (i = 0; i < n; i++)
+		if (gp_widget_get_choice (from, i, &choice) == GP_OK)
+			gp_widget_add_choice (*to, choice);
+	ret = gp_camera_copy_widget_value (*to, from);
+	if (ret < 0) {
+		gp_widget_free (*to);
+		*to = NULL;
+		return (ret);
+	}
+	gp_widget_set_changed (*to, 0);
+	return (GP_OK);
+}
+
+/**
+ * Retrieve a single configuration \c widget for the \c camera.
+ *
+ * @param camera a #Camera
+ * @param name the name of a configuration widget
+ * @param widget a #CameraWidget
+ * @param context a #GPContext
+ * @return gphoto2 error code
+ *
+ * This \c widget is a standalone copy of the widget of the same \c name
+ * within the tree returned by #gp_camera_get_config. Drivers providing
+ * #CameraGetSingleConfigFunc only query the camera for this one value.
+ * For all others, and for names such a driver reports as
+ * #GP_ERROR_NOT_SUPPORTED, the complete configuration is retrieved.
+ *
+ * The \c widget has to be freed with #gp_widget_free.
+ *
+ */
+int
+gp_camera_get_single_config (Camera *camera, const char *name,
+			     CameraWidget **widget, GPContext *context)
+{
+	CameraWidget	*window, *child;
+	int		ret;
+
+	CHECK_NULL (camera && name && widget);
+	CHECK_INIT (camera, context);
+
+	if (!camera->functions->get_single_config &&
+	    !camera->functions->get_config) {
+		gp_context_error (context, _("This camera does "
+			"not provide any configuration options."));
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NOT_SUPPORTED);
+	}
+
+	CHECK_OPEN (camera, context);
+	ret = GP_ERROR_NOT_SUPPORTED;
+	if (camera->functions->get_single_config)
+		ret = camera->functions->get_single_config (camera, name,
+							    widget, context);
+	/* not known to the driver on its own, look for it in the tree */
+	if ((ret == GP_ERROR_NOT_SUPPORTED) && camera->functions->get_config) {
+		ret = camera->functions->get_config (camera, &window, context);
+		if (ret == GP_OK) {
+			ret = gp_widget_get_child_by_name (window, name, &child);
+			if (ret == GP_OK)
+				ret = gp_camera_clone_widget (child, widget);
+			gp_widget_free (window);
+		}
+	}
+	CHECK_CLOSE (camera, context);
+
+	CAMERA_UNUSED (camera, context);
+	return (ret);
+}
+
+/**
+ * Sets a single configuration value.
+ *
+ * @param camera a #Camera
+ * @param name the name of a configuration widget
+ * @param widget a #CameraWidget
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Typically, a \c widget is retrieved using #gp_camera_get_single_config,
+ * changed and passed to this function in order to adjust this one setting
+ * on the camera. Its value is applied regardless of the changed flag.
+ * Names the driver cannot set on their own are set through the complete
+ * configuration.
+ *
+ **/
+int
+gp_camera_set_single_config (Camera *camera, const char *name,
+			     CameraWidget *widget, GPContext *context)
+{
+	CameraWidget	*window, *child;
+	int		ret;
+
+	CHECK_NULL (camera && name && widget);
+	CHECK_INIT (camera, context);
+
+	if (!camera->functions->set_single_config &&
+	    (!camera->functions->get_config || !camera->functions->set_config)) {
+		gp_context_error (context, _("This camera does "
+			"not support setting configuration options."));
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NOT_SUPPORTED);
+	}
+
+	CHECK_OPEN (camera, context);
+	ret = GP_ERROR_NOT_SUPPORTED;
+	if (camera->functions->set_single_config)
+		ret = camera->functions->set_single_config (camera, name,
+							    widget, context);
+	/* not known to the driver on its own, set it through the tree */
+	if ((ret == GP_ERROR_NOT_SUPPORTED) &&
+	    camera->functions->get_config && camera->functions->set_config) {
+		ret = camera->functions->get_config (camera, &window, context);
+		if (ret == GP_OK) {
+			ret = gp_widget_get_child_by_name (window, name, &child);
+			if (ret == GP_OK)
+				ret = gp_camera_copy_widget_value (child, widget);
+			if (ret == GP_OK) {
+				/* apply it even if the value did not change */
+				gp_widget_set_changed (child, 1);
+				ret = camera->functions->set_config (camera,
+							window, context);
+			}
+			gp_widget_free (window);
+		}
+	}
+	CHECK_CLOSE (camera, context);
+
+	CAMERA_UNUSED (camera, context);
+	return (ret);
+}
+
 /**
  * Retrieves a camera summary.
  *
@@ -1086,6 +1667,32 @@ gp_camera_trigger_capture (Camera *camera, GPContext *context)
 	return (GP_OK);
 }
 
+/**
+ * Prepares the camera for the next #gp_camera_trigger_capture.
+ *
+ * @param camera a #Camera
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Does the vendor specific setup of a trigger ahead of time, so that the
+ * next #gp_camera_trigger_capture only needs to release the shutter. This
+ * makes the release latency short and predictable, e.g. for firing a number
+ * of cameras at the same time. Cameras without such setup return #GP_OK.
+ **/
+int
+gp_camera_prepare_trigger (Camera *camera, GPContext *context)
+{
+	CHECK_NULL (camera);
+	CHECK_INIT (camera, context);
+
+	if (camera->functions->prepare_trigger)
+		CHECK_RESULT_OPEN_CLOSE (camera,
+			camera->functions->prepare_trigger (camera, context),
+			context);
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
 /**
  * Captures a preview that won't be stored on the camera but returned in 
  * supplied file. 
@@ -1127,6 +1734,191 @@ gp_camera_capture_preview (Camera *camera, CameraFile *file, GPContext *context)
 }
 
 
+/**
+ * Start streaming preview frames.
+ *
+ * @param camera a #Camera
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Prepares the camera for a series of gp_camera_read_preview_frame()
+ * calls, e.g. for a live view display. Drivers that support streaming
+ * switch on the viewfinder only once here instead of for every frame.
+ * For all others the frames are captured with gp_camera_capture_preview()
+ * semantics. Call gp_camera_stop_preview_stream() when done.
+ *
+ **/
+int
+gp_camera_start_preview_stream (Camera *camera, GPContext *context)
+{
+	unsigned int i;
+
+	CHECK_NULL (camera);
+	CHECK_INIT (camera, context);
+
+	if (camera->pc->preview_streaming) {
+		CAMERA_UNUSED (camera, context);
+		return (GP_OK);
+	}
+
+	if (!camera->functions->start_preview_stream &&
+	    !camera->functions->capture_preview) {
+		gp_context_error (context, _("This camera can "
+			"not capture previews."));
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_NOT_SUPPORTED);
+	}
+
+	for (i = 0; i < GP_PREVIEW_STREAM_BUFFERS; i++) {
+		if (camera->pc->preview_frames[i])
+			continue;
+		CR (camera, gp_file_new (&camera->pc->preview_frames[i]),
+		    context);
+	}
+
+	if (camera->functions->start_preview_stream)
+		CHECK_RESULT_OPEN_CLOSE (camera,
+			camera->functions->start_preview_stream (camera,
+							context), context);
+
+	camera->pc->preview_streaming = 1;
+	camera->pc->preview_sequence = 0;
+	memset (&camera->pc->preview_last, 0, sizeof (struct timeval));
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
+/**
+ * Read the next frame of a preview stream.
+ *
+ * @param camera a #Camera
+ * @param frame receives the frame
+ * @param info receives the timing of the frame, may be NULL
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * The returned \c frame belongs to the stream. It stays valid until
+ * #GP_PREVIEW_STREAM_BUFFERS further frames have been read or the stream
+ * is stopped; reference it with gp_file_ref() to keep it longer and
+ * gp_file_unref() it when done. The frames are reused round-robin, so a
+ * steady stream does not allocate once the buffers have grown to the
+ * frame size; a frame that is still referenced is left alone and a new
+ * buffer takes its place.
+ *
+ **/
+int
+gp_camera_read_preview_frame (Camera *camera, CameraFile **frame,
+			      CameraPreviewFrameInfo *info,
+			      GPContext *context)
+{
+	CameraFile *file, **slot;
+	struct timeval start, end;
+	const char *mime;
+	char *xname;
+
+	CHECK_NULL (camera && frame);
+	CHECK_INIT (camera, context);
+
+	if (!camera->pc->preview_streaming) {
+		gp_context_error (context, _("The preview stream has "
+			"not been started."));
+		CAMERA_UNUSED (camera, context);
+		return (GP_ERROR_BAD_PARAMETERS);
+	}
+
+	slot = &camera->pc->preview_frames[camera->pc->preview_sequence %
+					    GP_PREVIEW_STREAM_BUFFERS];
+	/* The caller kept the frame that was here, leave it to them */
+	if (gpi_file_is_shared (*slot)) {
+		gp_file_unref (*slot);
+		*slot = NULL;
+	}
+	if (!*slot) {
+		CR (camera, gp_file_new (slot), context);
+	} else {
+		CR (camera, gp_file_reset (*slot), context);
+	}
+	file = *slot;
+
+	gettimeofday (&start, NULL);
+	if (camera->functions->read_preview_frame) {
+		CHECK_RESULT_OPEN_CLOSE (camera,
+			camera->functions->read_preview_frame (camera, file,
+							context), context);
+	} else {
+		CHECK_RESULT_OPEN_CLOSE (camera,
+			camera->functions->capture_preview (camera, file,
+							context), context);
+	}
+	gettimeofday (&end, NULL);
+
+	/* Only ask for a generated name if it is not the usual JPEG */
+	gp_file_get_mime_type (file, &mime);
+	if (!strcmp (mime, GP_MIME_JPEG))
+		gp_file_set_name (file, "capture_preview.jpg");
+	else if (gp_file_get_name_by_type (file, "capture_preview",
+				GP_FILE_TYPE_NORMAL, &xname) == GP_OK) {
+		gp_file_set_name (file, xname);
+		free (xname);
+	}
+
+	if (info) {
+		info->sequence = camera->pc->preview_sequence;
+		info->time_sec = end.tv_sec;
+		info->time_usec = end.tv_usec;
+		info->fetch_usec = (end.tv_sec - start.tv_sec) * 1000000 +
+				   (end.tv_usec - start.tv_usec);
+		if (camera->pc->preview_sequence)
+			info->interval_usec =
+				(end.tv_sec - camera->pc->preview_last.tv_sec) * 1000000 +
+				(end.tv_usec - camera->pc->preview_last.tv_usec);
+		else
+			info->interval_usec = 0;
+	}
+	camera->pc->preview_last = end;
+	camera->pc->preview_sequence++;
+	*frame = file;
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
+/**
+ * Stop a preview stream.
+ *
+ * @param camera a #Camera
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Ends a stream started with gp_camera_start_preview_stream() and
+ * releases the frames returned by gp_camera_read_preview_frame() that
+ * have not been referenced by the caller.
+ *
+ **/
+int
+gp_camera_stop_preview_stream (Camera *camera, GPContext *context)
+{
+	CHECK_NULL (camera);
+	CHECK_INIT (camera, context);
+
+	if (!camera->pc->preview_streaming) {
+		CAMERA_UNUSED (camera, context);
+		return (GP_OK);
+	}
+	camera->pc->preview_streaming = 0;
+	gp_camera_free_preview_frames (camera);
+
+	if (camera->functions->stop_preview_stream)
+		CHECK_RESULT_OPEN_CLOSE (camera,
+			camera->functions->stop_preview_stream (camera,
+							context), context);
+
+	CAMERA_UNUSED (camera, context);
+	return (GP_OK);
+}
+
+
 /**
  * Wait for an event from the camera.
  *
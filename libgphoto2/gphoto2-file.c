@@ -52,6 +52,9 @@
 # define MAX_PATH 256
 #endif
 
+/* smallest allocation for appended memory file data */
+#define MIN_ALLOC 4096
+
 /*! The internals of the CameraFile struct are private.
  * \internal
  */
@@ -65,6 +68,7 @@ struct _CameraFile {
 
 	/* for GP_FILE_ACCESSTYPE_MEMORY files */
         unsigned long	size;
+        unsigned long	allocated;	/* bytes allocated at data, >= size */
         unsigned char	*data;
         unsigned long	offset;	/* read pointer */
 
@@ -203,6 +207,78 @@ gp_file_unref (CameraFile *file)
 	return (GP_OK);
 }
 
+/*
+ * Whether someone besides the creator holds a reference to the file,
+ * for code that wants to reuse a file it handed out.
+ */
+int
+gpi_file_is_shared (CameraFile *file)
+{
+	return (file && (file->ref_count > 1));
+}
+
+/* Whether the file data is held in memory, as opposed to a fd or handler. */
+int
+gpi_file_is_memory (CameraFile *file)
+{
+	return (file && (file->accesstype == GP_FILE_ACCESSTYPE_MEMORY));
+}
+
+
+/*
+ * Makes room for at least needed bytes of memory file data. Grows
+ * geometrically, so appending many small chunks stays linear.
+ */
+static int
+gp_file_grow (CameraFile *file, unsigned long int needed)
+{
+	unsigned long int	newsize;
+	unsigned char		*t;
+
+	if (needed <= file->allocated)
+		return GP_OK;
+	newsize = file->allocated * 2;
+	if (newsize < MIN_ALLOC)
+		newsize = MIN_ALLOC;
+	if (newsize < needed)
+		newsize = needed;
+	t = realloc (file->data, sizeof (char) * newsize);
+	if (!t)
+		return GP_ERROR_NO_MEMORY;
+	file->data = t;
+	file->allocated = newsize;
+	return GP_OK;
+}
+
+/**
+ * @param file a #CameraFile
+ * @param size the expected total size of the file data
+ * @return a gphoto2 error code.
+ *
+ * Hints the final size of the file data, e.g. when a camera driver
+ * knows the object size before downloading it. Memory backed files
+ * allocate it in one go, so the following gp_file_append() calls do
+ * not need to reallocate. Other files ignore the hint.
+ **/
+int
+gp_file_reserve (CameraFile *file, unsigned long int size)
+{
+	unsigned char *t;
+
+	CHECK_NULL (file);
+
+	if (file->accesstype != GP_FILE_ACCESSTYPE_MEMORY)
+		return GP_OK;
+	if (size <= file->allocated)
+		return GP_OK;
+	/* exactly what was asked for, no geometric slack */
+	t = realloc (file->data, sizeof (char) * size);
+	if (!t)
+		return GP_ERROR_NO_MEMORY;
+	file->data = t;
+	file->allocated = size;
+	return GP_OK;
+}
 
 /**
  * @param file a #CameraFile
@@ -215,21 +291,14 @@ int
 gp_file_append (CameraFile *file, const char *data, 
 		unsigned long int size)
 {
-        char *t;
-
 	CHECK_NULL (file);
 
 	switch (file->accesstype) {
 	case GP_FILE_ACCESSTYPE_MEMORY:
-		if (!file->data)
-			file->data = malloc (sizeof(char) * (size));
-		else {
-			t = realloc (file->data, sizeof (char) * (file->size + size));
-			if (!t)
-				return GP_ERROR_NO_MEMORY;
-			file->data = (unsigned char*)t;
-		}
-		memcpy (&file->data[file->size], data, size);
+		CHECK_RESULT (gp_file_grow (file, file->size + size));
+		/* Data read in place via gp_file_get_append_buffer() */
+		if (data != (char*)&file->data[file->size])
+			memcpy (&file->data[file->size], data, size);
 		file->size += size;
 		break;
 	case GP_FILE_ACCESSTYPE_FD: {
@@ -264,6 +333,56 @@ gp_file_append (CameraFile *file, const char *data,
         return (GP_OK);
 }
 
+/**
+ * @param file a #CameraFile
+ * @param size the number of bytes the caller wants to write
+ * @param data returns a pointer to the writable space
+ * @return a gphoto2 error code.
+ *
+ * Provides room for at least size bytes directly behind the current end
+ * of a memory backed file, so a caller like a camera driver can read
+ * data straight into place. Committing it with gp_file_append() on the
+ * same pointer then skips the copy. The pointer stays valid until the
+ * next call modifying the file, space that is not committed is not part
+ * of the file data.
+ *
+ * Files backed by a fd or a handler return GP_ERROR_NOT_SUPPORTED.
+ **/
+int
+gp_file_get_append_buffer (CameraFile *file, unsigned long int size,
+	char **data
+) {
+	CHECK_NULL (file && data);
+
+	if (file->accesstype != GP_FILE_ACCESSTYPE_MEMORY)
+		return GP_ERROR_NOT_SUPPORTED;
+	CHECK_RESULT (gp_file_grow (file, file->size + size));
+	*data = (char*)&file->data[file->size];
+	return GP_OK;
+}
+
+/**
+ * @param file a #CameraFile
+ * @return a gphoto2 error code.
+ *
+ * Empties a memory backed file like gp_file_clean(), but keeps its
+ * buffer allocated, so refilling the file with data of a similar size
+ * (e.g. the next preview frame) does not need to allocate again.
+ * Other files are cleaned.
+ **/
+int
+gp_file_reset (CameraFile *file)
+{
+	CHECK_NULL (file);
+
+	if (file->accesstype != GP_FILE_ACCESSTYPE_MEMORY)
+		return gp_file_clean (file);
+	file->size = 0;
+	file->offset = 0;
+	strcpy (file->name, "");
+	return GP_OK;
+}
+
 /**
  * @param file a #CameraFile
  * @param data
@@ -346,6 +465,7 @@ gp_file_set_data_and_size (CameraFile *file, char *data,
 			free (file->data);
 		file->data = (unsigned char*)data;
 		file->size = size;
+		file->allocated = size;
 		break;
 	case GP_FILE_ACCESSTYPE_FD: {
 		int curwritten = 0;
@@ -669,6 +789,7 @@ gp_file_open (CameraFile *file, const char *filename)
 		}
 		fclose(fp);
 		file->size = size_read;
+		file->allocated = size + 1;
 		file->data[size_read] = 0;
 		break;
 	case GP_FILE_ACCESSTYPE_FD: {
@@ -745,6 +866,7 @@ gp_file_clean (CameraFile *file)
 			free(file->data);
 		file->data = NULL;
 		file->size = 0;
+		file->allocated = 0;
 		break;
 	case GP_FILE_ACCESSTYPE_FD:
 		break;
@@ -778,11 +900,13 @@ gp_file_copy (CameraFile *destination, CameraFile *source)
 		if (destination->data) {
 			free (destination->data);
 			destination->data = NULL;
+			destination->allocated = 0;
 		}
 		destination->size = source->size;
 		destination->data = malloc (sizeof (char) * source->size);
 		if (!destination->data)
 			return (GP_ERROR_NO_MEMORY);
+		destination->allocated = source->size;
 		memcpy (destination->data, source->data, source->size);
 		return (GP_OK);
 	}
@@ -795,6 +919,7 @@ gp_file_copy (CameraFile *destination, CameraFile *source)
 		if (destination->data) {
 			free (destination->data);
 			destination->data = NULL;
+			destination->allocated = 0;
 		}
 		if (-1 == lseek (source->fd, 0, SEEK_END)) {
 			if (errno == EBADF) return GP_ERROR_IO;
@@ -815,6 +940,7 @@ gp_file_copy (CameraFile *destination, CameraFile *source)
 		destination->data = malloc (offset);
 		if (!destination->data)
 			return GP_ERROR_NO_MEMORY;
+		destination->allocated = offset;
 		while (curread < offset) {
 			unsigned int res = read (source->fd, destination->data+curread, offset-curread);
 			if (res == -1) {
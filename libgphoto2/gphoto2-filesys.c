@@ -38,6 +38,9 @@
 #include <gphoto2/gphoto2-setting.h>
 
 #include <limits.h>
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
 
 #ifdef HAVE_LIBEXIF
 #  include <libexif/exif-data.h>
@@ -68,6 +71,31 @@
 # define PATH_MAX 4096
 #endif
 
+/** Number of #CameraFileType values that can be cached per file. */
+#define FS_CACHE_TYPES	(GP_FILE_TYPE_METADATA + 1)
+
+typedef struct _CameraFilesystemCacheEntry {
+	CameraFile *file;
+	CameraFileType type;
+	unsigned long int size;
+	unsigned long int used;	/* stamp of the last use, see cache_clock */
+
+	/* least recently used chain of this type */
+	struct _CameraFilesystemCacheEntry *type_prev;
+	struct _CameraFilesystemCacheEntry *type_next;
+	/* least recently used chain over all types */
+	struct _CameraFilesystemCacheEntry *lru_prev;
+	struct _CameraFilesystemCacheEntry *lru_next;
+} CameraFilesystemCacheEntry;
+
+typedef struct _CameraFilesystemCacheList {
+	CameraFilesystemCacheEntry *first;
+	CameraFilesystemCacheEntry *last;
+	unsigned long int size;
+	unsigned long int limit;
+	unsigned int count;
+} CameraFilesystemCacheList;
+
 typedef struct _CameraFilesystemFile {
 	char *name;
 
@@ -75,16 +103,13 @@ typedef struct _CameraFilesystemFile {
 
 	CameraFileInfo info;
 
-	struct _CameraFilesystemFile *lru_prev;
-	struct _CameraFilesystemFile *lru_next;
-	CameraFile *preview;
-	CameraFile *normal;
-	CameraFile *raw;
-	CameraFile *audio;
-	CameraFile *exif;
-	CameraFile *metadata;
+	CameraFilesystemCacheEntry cache[FS_CACHE_TYPES]; /* by CameraFileType */
 
 	struct _CameraFilesystemFile *next; /* in folder */
+	struct _CameraFilesystemFile *prev; /* in folder */
+
+	unsigned int hash; /* of name */
+	struct _CameraFilesystemFile *hash_next; /* in name hash bucket */
 } CameraFilesystemFile;
 
 typedef struct _CameraFilesystemFolder {
@@ -96,25 +121,58 @@ typedef struct _CameraFilesystemFolder {
 	struct _CameraFilesystemFolder *next; /* chain in same folder */
 	struct _CameraFilesystemFolder *folders; /* childchain of this folder */
 	struct _CameraFilesystemFile *files; /* of this folder */
+	struct _CameraFilesystemFile *lastfile; /* tail of files, for appending */
+
+	unsigned int hash; /* of name */
+	struct _CameraFilesystemFolder *hash_next; /* in name hash bucket of parent */
+
+	/* Name hash indices of the children, allocated on first use */
+	unsigned int nrofolders, folders_hashsize;
+	struct _CameraFilesystemFolder **folders_hash;
+	unsigned int nroffiles, files_hashsize;
+	struct _CameraFilesystemFile **files_hash;
 } CameraFilesystemFolder;
 
 /**
- * The default number of pictures to keep in the internal cache,
- * can be overriden by settings.
+ * Initial number of buckets of the per folder name hash indices. The
+ * tables double whenever they contain more entries than buckets.
  */
-#define PICTURES_TO_KEEP	2
+#define FS_HASH_INITIAL	64
+
 /**
- * The current number of pictures to keep in the internal cache,
- * either from #PICTURES_TO_KEEP or from the settings.
+ * The default cache budgets per #CameraFileType in bytes, can be changed
+ * with gp_filesystem_set_cache_limit().
  */
-static int pictures_to_keep = -1;
+static const unsigned long int cache_limits[FS_CACHE_TYPES] = {
+	16*1024*1024,	/* GP_FILE_TYPE_PREVIEW */
+	64*1024*1024,	/* GP_FILE_TYPE_NORMAL */
+	64*1024*1024,	/* GP_FILE_TYPE_RAW */
+	16*1024*1024,	/* GP_FILE_TYPE_AUDIO */
+	4*1024*1024,	/* GP_FILE_TYPE_EXIF */
+	4*1024*1024,	/* GP_FILE_TYPE_METADATA */
+};
+/**
+ * The default budget of the whole cache in bytes, can be changed with
+ * gp_filesystem_set_cache_total_limit().
+ */
+#define CACHE_TOTAL_LIMIT	(128*1024*1024)
 
-static int gp_filesystem_lru_clear (CameraFilesystem *fs);
-static int gp_filesystem_lru_remove_one (CameraFilesystem *fs, CameraFilesystemFile *item);
-static int gp_filesystem_lru_update (CameraFilesystem *fs,
-			  const char *folder, const char *filename,
-			  CameraFileType type,
-			  CameraFile *file, GPContext *context);
+/**
+ * The number of pictures (normal, raw and audio files) to keep cached
+ * as set by the "cached-images" setting, -1 for no limit. 0 disables
+ * caching of pictures. Read on first use.
+ */
+static int pictures_to_keep = -2;
+
+#define FS_IS_PICTURE(type) (((type) == GP_FILE_TYPE_NORMAL) || \
+			     ((type) == GP_FILE_TYPE_RAW) ||	\
+			     ((type) == GP_FILE_TYPE_AUDIO))
+
+static void gp_filesystem_cache_clear (CameraFilesystem *fs);
+static void gp_filesystem_cache_drop_file (CameraFilesystem *fs, CameraFilesystemFile *file);
+static void gp_filesystem_cache_touch (CameraFilesystem *fs, CameraFilesystemCacheEntry *entry);
+static int gp_filesystem_cache_insert (CameraFilesystem *fs, CameraFilesystemFile *xfile,
+			  CameraFileType type, CameraFile *file);
 
 #ifdef HAVE_LIBEXIF
 
@@ -242,12 +300,28 @@ gp_filesystem_get_exif_mtime (CameraFilesystem *fs, const char *folder,
  * The internals of the #CameraFilesystem are only visible to gphoto2. You
  * can only access them using the functions provided by gphoto2.
  **/
+#ifdef HAVE_PTHREAD
+#  define LOCK_STATS(fs)	pthread_mutex_lock (&(fs)->stats_lock)
+#  define UNLOCK_STATS(fs)	pthread_mutex_unlock (&(fs)->stats_lock)
+#else
+#  define LOCK_STATS(fs)
+#  define UNLOCK_STATS(fs)
+#endif
+
 struct _CameraFilesystem {
 	CameraFilesystemFolder *rootfolder;
 
-	CameraFilesystemFile *lru_first;
-	CameraFilesystemFile *lru_last;
-	unsigned long int lru_size;
+	CameraFilesystemCacheList cache[FS_CACHE_TYPES];
+	CameraFilesystemCacheEntry *lru_first;
+	CameraFilesystemCacheEntry *lru_last;
+	unsigned long int cache_clock;	/* counts uses of cache entries */
+	unsigned long int cache_size;
+	unsigned long int cache_limit;
+	int picture_limit;
+	CameraFilesystemCacheStats cache_stats;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t stats_lock;	/* cache_stats and cache_size */
+#endif
 
 	CameraFilesystemGetInfoFunc get_info_func;
 	CameraFilesystemSetInfoFunc set_info_func;
@@ -307,6 +381,165 @@ struct _CameraFilesystem {
 	}								\
 }
 
+/* FNV-1a over the first len bytes of name */
+static unsigned int
+fs_name_hash (const char *name, size_t len)
+{
+	unsigned int hash = 2166136261U;
+
+	while (len--) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static int
+fs_hash_grow (void ***table, unsigned int *size, unsigned int nr)
+{
+	unsigned int newsize = *size ? *size * 2 : FS_HASH_INITIAL;
+
+	if (nr < *size)
+		return (GP_OK);
+	if (*table) {
+		/* The caller rehashes from its own chain afterwards. */
+		free (*table);
+		*table = NULL;
+		*size = 0;
+	}
+	CHECK_MEM (*table = calloc (newsize, sizeof (void*)));
+	*size = newsize;
+	return (GP_OK);
+}
+
+static void
+file_hash_link (CameraFilesystemFolder *folder, CameraFilesystemFile *file)
+{
+	unsigned int idx = file->hash & (folder->files_hashsize - 1);
+
+	file->hash_next = folder->files_hash[idx];
+	folder->files_hash[idx] = file;
+}
+
+/* Enter a file, already linked into folder->files, into the name index. */
+static int
+file_hash_insert (CameraFilesystemFolder *folder, CameraFilesystemFile *file)
+{
+	CameraFilesystemFile	*f;
+
+	file->hash = fs_name_hash (file->name, strlen (file->name));
+	if (folder->nroffiles >= folder->files_hashsize) {
+		CR (fs_hash_grow ((void***)&folder->files_hash,
+				  &folder->files_hashsize, folder->nroffiles));
+		for (f = folder->files; f; f = f->next)
+			if (f != file)
+				file_hash_link (folder, f);
+	}
+	file_hash_link (folder, file);
+	folder->nroffiles++;
+	return (GP_OK);
+}
+
+static void
+file_hash_remove (CameraFilesystemFolder *folder, CameraFilesystemFile *file)
+{
+	CameraFilesystemFile	**f;
+
+	if (!folder->files_hash)
+		return;
+	f = &folder->files_hash[file->hash & (folder->files_hashsize - 1)];
+	while (*f && (*f != file))
+		f = &(*f)->hash_next;
+	if (!*f)
+		return;
+	*f = file->hash_next;
+	file->hash_next = NULL;
+	folder->nroffiles--;
+}
+
+static CameraFilesystemFile*
+file_hash_lookup (CameraFilesystemFolder *folder, const char *name)
+{
+	CameraFilesystemFile	*f;
+	unsigned int		hash;
+
+	if (!folder->files_hash)
+		return NULL;
+	hash = fs_name_hash (name, strlen (name));
+	f = folder->files_hash[hash & (folder->files_hashsize - 1)];
+	while (f) {
+		if ((f->hash == hash) && !strcmp (f->name, name))
+			return f;
+		f = f->hash_next;
+	}
+	return NULL;
+}
+
+static void
+folder_hash_link (CameraFilesystemFolder *folder, CameraFilesystemFolder *child)
+{
+	unsigned int idx = child->hash & (folder->folders_hashsize - 1);
+
+	child->hash_next = folder->folders_hash[idx];
+	folder->folders_hash[idx] = child;
+}
+
+/* Enter a subfolder, already linked into folder->folders, into the name index. */
+static int
+folder_hash_insert (CameraFilesystemFolder *folder, CameraFilesystemFolder *child)
+{
+	CameraFilesystemFolder	*f;
+
+	child->hash = fs_name_hash (child->name, strlen (child->name));
+	if (folder->nrofolders >= folder->folders_hashsize) {
+		CR (fs_hash_grow ((void***)&folder->folders_hash,
+				  &folder->folders_hashsize, folder->nrofolders));
+		for (f = folder->folders; f; f = f->next)
+			if (f != child)
+				folder_hash_link (folder, f);
+	}
+	folder_hash_link (folder, child);
+	folder->nrofolders++;
+	return (GP_OK);
+}
+
+static void
+folder_hash_remove (CameraFilesystemFolder *folder, CameraFilesystemFolder *child)
+{
+	CameraFilesystemFolder	**f;
+
+	if (!folder->folders_hash)
+		return;
+	f = &folder->folders_hash[child->hash & (folder->folders_hashsize - 1)];
+	while (*f && (*f != child))
+		f = &(*f)->hash_next;
+	if (!*f)
+		return;
+	*f = child->hash_next;
+	child->hash_next = NULL;
+	folder->nrofolders--;
+}
+
+/* Looks up the subfolder called by the first len characters of name. */
+static CameraFilesystemFolder*
+folder_hash_lookup (CameraFilesystemFolder *folder, const char *name, size_t len)
+{
+	CameraFilesystemFolder	*f;
+	unsigned int		hash;
+
+	if (!folder->folders_hash)
+		return NULL;
+	hash = fs_name_hash (name, len);
+	f = folder->folders_hash[hash & (folder->folders_hashsize - 1)];
+	while (f) {
+		if ((f->hash == hash) && !strncmp (f->name, name, len) &&
+		    (f->name[len] == '\0'))
+			return f;
+		f = f->hash_next;
+	}
+	return NULL;
+}
+
 static int
 delete_all_files (CameraFilesystem *fs, CameraFilesystemFolder *folder)
 {
@@ -319,37 +552,18 @@ delete_all_files (CameraFilesystem *fs, CameraFilesystemFolder *folder)
 	while (file) {
 		CameraFilesystemFile	*next;
 		/* Get rid of cached files */
-		gp_filesystem_lru_remove_one (fs, file);
-		if (file->preview) {
-			gp_file_unref (file->preview);
-			file->preview = NULL;
-		}
-		if (file->normal) {
-			gp_file_unref (file->normal);
-			file->normal = NULL;
-		}
-		if (file->raw) {
-			gp_file_unref (file->raw);
-			file->raw = NULL;
-		}
-		if (file->audio) {
-			gp_file_unref (file->audio);
-			file->audio = NULL;
-		}
-		if (file->exif) {
-			gp_file_unref (file->exif);
-			file->exif = NULL;
-		}
-		if (file->metadata) {
-			gp_file_unref (file->metadata);
-			file->metadata = NULL;
-		}
+		gp_filesystem_cache_drop_file (fs, file);
 		next = file->next;
 		free (file->name);
 		free (file);
 		file = next;
 	}
 	folder->files = NULL;
+	folder->lastfile = NULL;
+	free (folder->files_hash);
+	folder->files_hash = NULL;
+	folder->files_hashsize = 0;
+	folder->nroffiles = 0;
 	return (GP_OK);
 }
 
@@ -362,6 +576,7 @@ delete_folder (CameraFilesystem *fs, CameraFilesystemFolder **folder)
 	gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "Delete one folder %p/%s", *folder, (*folder)->name);
 	next = (*folder)->next;
 	delete_all_files (fs, *folder);
+	free ((*folder)->folders_hash);
 	free ((*folder)->name);
 	free (*folder);
 	*folder = next;
@@ -374,7 +589,6 @@ lookup_folder (
 	CameraFilesystemFolder *folder, const char *foldername,
 	GPContext *context
 ) {
-	CameraFilesystemFolder	*f;
 	const char	*curpt = foldername;
 	const char	*s;
 
@@ -412,23 +626,11 @@ lookup_folder (
 			}
 			free (copy);
 		}
-		f = folder->folders;
-		while (f) {
-			if (s) {
-				if (!strncmp(f->name,curpt, (s-curpt)) &&
-				    (strlen(f->name) == (s-curpt))
-				) {
-					folder = f;
-					curpt = s;
-					break;
-				}
-			} else {
-				if (!strcmp(f->name,curpt))
-					return f;
-			}
-			f = f->next;
-		}
-		folder = f;
+		if (s) {
+			folder = folder_hash_lookup (folder, curpt, s-curpt);
+			curpt = s;
+		} else
+			return folder_hash_lookup (folder, curpt, strlen (curpt));
 	}
 	return NULL;
 }
@@ -465,16 +667,12 @@ lookup_folder_file (
 			gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "Making folder %s clean failed: %d", folder, ret);
 	}
 
-	f = xf->files;
-	while (f) {
-		if (!strcmp (f->name, filename)) {
-			*xfile = f;
-			*xfolder = xf;
-			return GP_OK;
-		}
-		f = f->next;
-	}
-	return GP_ERROR_FILE_NOT_FOUND;
+	f = file_hash_lookup (xf, filename);
+	if (!f)
+		return GP_ERROR_FILE_NOT_FOUND;
+	*xfile = f;
+	*xfolder = xf;
+	return GP_OK;
 }
 
 /* delete all folder content */
@@ -488,6 +686,10 @@ recurse_delete_folder (CameraFilesystem *fs, CameraFilesystemFolder *folder) {
 		recurse_delete_folder (fs, *f);
 		delete_folder (fs, f); /* will also advance to next */
 	}
+	free (folder->folders_hash);
+	folder->folders_hash = NULL;
+	folder->folders_hashsize = 0;
+	folder->nrofolders = 0;
 	return (GP_OK);
 }
 
@@ -516,16 +718,28 @@ append_folder_one (
 	CameraFilesystemFolder **newfolder
 ) {
 	CameraFilesystemFolder *f;
+	int ret;
 
 	gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "Append one folder %s", name);
 	CHECK_MEM (f = calloc(sizeof(CameraFilesystemFolder),1));
-	CHECK_MEM (f->name = strdup (name));
+	f->name = strdup (name);
+	if (!f->name) {
+		free (f);
+		return (GP_ERROR_NO_MEMORY);
+	}
 	f->files_dirty = 1;
 	f->folders_dirty = 1;
 
 	/* Link into the current chain...  perhaps later alphabetically? */
 	f->next = folder->folders;
 	folder->folders = f;
+	ret = folder_hash_insert (folder, f);
+	if (ret < GP_OK) {
+		folder->folders = f->next;
+		free (f->name);
+		free (f);
+		return ret;
+	}
 	if (newfolder) *newfolder = f;
 	return (GP_OK);
 }
@@ -549,29 +763,28 @@ append_to_folder (CameraFilesystemFolder *folder,
 	}
 
 	s = strchr(foldername,'/');
-	f = folder->folders;
-	while (f) {
-		if (s) {
-			if (!strncmp(f->name,foldername, (s-foldername)) &&
-			    (strlen(f->name) == (s-foldername))
-			)
-				return append_to_folder (f, s+1, newfolder);
-		} else {
-			if (!strcmp(f->name,foldername)) {
-				if (newfolder) *newfolder = f;
-				return (GP_OK);
-			}
+	if (s) {
+		f = folder_hash_lookup (folder, foldername, s-foldername);
+		if (f)
+			return append_to_folder (f, s+1, newfolder);
+	} else {
+		f = folder_hash_lookup (folder, foldername, strlen (foldername));
+		if (f) {
+			if (newfolder) *newfolder = f;
+			return (GP_OK);
 		}
-		f = f->next;
 	}
 	/* Not found ... create new folder */
 	if (s) {
 		char *x;
+		int ret;
+
 		CHECK_MEM (x = calloc ((s-foldername)+1,1));
 		memcpy (x, foldername, (s-foldername));
 		x[s-foldername] = 0;
-		CR (append_folder_one (folder, x, newfolder));
+		ret = append_folder_one (folder, x, newfolder);
 		free (x);
+		CR (ret);
 	} else {
 		CR (append_folder_one (folder, foldername, newfolder));
 	}
@@ -592,30 +805,60 @@ append_folder (CameraFilesystem *fs,
 	return append_to_folder (fs->rootfolder, folder, newfolder);
 }
 
+/* create and append 1 new file entry to the end of the folder */
+static int
+append_file_one (
+	CameraFilesystemFolder *folder,
+	const char *name,
+	CameraFilesystemFile **newfile
+) {
+	CameraFilesystemFile *f;
+	int ret;
+
+	CHECK_MEM (f = calloc (sizeof (CameraFilesystemFile), 1));
+	f->name = strdup (name);
+	if (!f->name) {
+		free (f);
+		return (GP_ERROR_NO_MEMORY);
+	}
+	f->info_dirty = 1;
+
+	f->prev = folder->lastfile;
+	if (folder->lastfile)
+		folder->lastfile->next = f;
+	else
+		folder->files = f;
+	folder->lastfile = f;
+
+	ret = file_hash_insert (folder, f);
+	if (ret < GP_OK) {
+		folder->lastfile = f->prev;
+		if (f->prev)
+			f->prev->next = NULL;
+		else
+			folder->files = NULL;
+		free (f->name);
+		free (f);
+		return ret;
+	}
+	if (newfile) *newfile = f;
+	return (GP_OK);
+}
+
 static int
 append_file (CameraFilesystem *fs, CameraFilesystemFolder *folder, const char *name, CameraFile *file, GPContext *context)
 {
-	CameraFilesystemFile **new;
+	CameraFilesystemFile *new;
 
 	CHECK_NULL (fs && file);
 	gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "Appending file %s...", name);
 
-	new = &folder->files;
-	while (*new) {
-		if (!strcmp((*new)->name, name)) {
-			gp_log (GP_LOG_ERROR, "gphoto2-filesystem", "File %s already exists!", name);
-			return (GP_ERROR);
-		}
-		new = &((*new)->next);
-	}
-	/* new now points to the location of the last ->next pointer,
-	 * if we write to it, we set last->next */
-	CHECK_MEM ((*new) = calloc (sizeof (CameraFilesystemFile), 1));
-	(*new)->name = strdup (name);
-	(*new)->info_dirty = 1;
-	(*new)->normal = file;
-	gp_file_ref (file);
-	return (GP_OK);
+	if (file_hash_lookup (folder, name)) {
+		gp_log (GP_LOG_ERROR, "gphoto2-filesystem", "File %s already exists!", name);
+		return (GP_ERROR);
+	}
+	CR (append_file_one (folder, name, &new));
+	return gp_filesystem_cache_insert (fs, new, GP_FILE_TYPE_NORMAL, file);
 }
 
 /**
@@ -631,7 +874,7 @@ int
 gp_filesystem_reset (CameraFilesystem *fs)
 {
 	gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "resetting filesystem");
-	CR (gp_filesystem_lru_clear (fs));
+	gp_filesystem_cache_clear (fs);
 	CR (delete_all_folders (fs, "/", NULL));
 	if (fs->rootfolder) {
 		fs->rootfolder->files_dirty = 1;
@@ -654,11 +897,26 @@ gp_filesystem_reset (CameraFilesystem *fs)
 int
 gp_filesystem_new (CameraFilesystem **fs)
 {
+	int i;
+
 	CHECK_NULL (fs);
 
 	CHECK_MEM (*fs = malloc (sizeof (CameraFilesystem)));
 
 	memset(*fs,0,sizeof(CameraFilesystem));
+	for (i = 0; i < FS_CACHE_TYPES; i++)
+		(*fs)->cache[i].limit = cache_limits[i];
+	(*fs)->cache_limit = CACHE_TOTAL_LIMIT;
+	if (pictures_to_keep == -2) {
+		char cached_images[1024];
+
+		pictures_to_keep = -1;
+		if (gp_setting_get ("libgphoto", "cached-images", cached_images) == GP_OK)
+			pictures_to_keep = atoi (cached_images);
+		if (pictures_to_keep < 0)
+			pictures_to_keep = -1;
+	}
+	(*fs)->picture_limit = pictures_to_keep;
 
 	(*fs)->rootfolder = calloc (sizeof (CameraFilesystemFolder), 1);
 	if (!(*fs)->rootfolder) {
@@ -673,6 +931,9 @@ gp_filesystem_new (CameraFilesystem **fs)
 	}
 	(*fs)->rootfolder->files_dirty = 1;
 	(*fs)->rootfolder->folders_dirty = 1;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init (&(*fs)->stats_lock, NULL);
+#endif
 	return (GP_OK);
 }
 
@@ -692,8 +953,13 @@ gp_filesystem_free (CameraFilesystem *fs)
 
 	/* Now, we've only got left over the root folder. Free that and
 	 * the filesystem. */
+	delete_all_files (fs, fs->rootfolder);
+	free (fs->rootfolder->folders_hash);
 	free (fs->rootfolder->name);
 	free (fs->rootfolder);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_destroy (&fs->stats_lock);
+#endif
 	free (fs);
 	return (GP_OK);
 }
@@ -716,29 +982,13 @@ static int
 internal_append (CameraFilesystem *fs, CameraFilesystemFolder *f,
 		      const char *filename, GPContext *context)
 {
-	CameraFilesystemFile **new;
-
 	CHECK_NULL (fs && f);
 
 	gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "Internal append %s to folder %s", filename, f->name);
 	/* Check folder for existence, if not, create it. */
-	new = &f->files;
-	while (*new) {
-		if (!strcmp((*new)->name, filename)) break;
-		new = &((*new)->next);
-	}
-	if (*new)
+	if (file_hash_lookup (f, filename))
 		return (GP_ERROR_FILE_EXISTS);
-
-	CHECK_MEM ((*new) = calloc (sizeof (CameraFilesystemFile), 1))
-	(*new)->name = strdup (filename);
-	if (!(*new)->name) {
-		free (*new);
-		*new = NULL;
-		return (GP_ERROR_NO_MEMORY);
-	}
-	(*new)->info_dirty = 1;
-	return (GP_OK);
+	return append_file_one (f, filename, NULL);
 }
 
 int
@@ -811,42 +1061,18 @@ gp_filesystem_dump (CameraFilesystem *fs)
 static int
 delete_file (CameraFilesystem *fs, CameraFilesystemFolder *folder, CameraFilesystemFile *file)
 {
-	CameraFilesystemFile **prev;
-
-	gp_filesystem_lru_remove_one (fs, file);
 	/* Get rid of cached files */
-	if (file->preview) {
-		gp_file_unref (file->preview);
-		file->preview = NULL;
-	}
-	if (file->normal) {
-		gp_file_unref (file->normal);
-		file->normal = NULL;
-	}
-	if (file->raw) {
-		gp_file_unref (file->raw);
-		file->raw = NULL;
-	}
-	if (file->audio) {
-		gp_file_unref (file->audio);
-		file->audio = NULL;
-	}
-	if (file->exif) {
-		gp_file_unref (file->exif);
-		file->exif = NULL;
-	}
-	if (file->metadata) {
-		gp_file_unref (file->metadata);
-		file->metadata = NULL;
-	}
+	gp_filesystem_cache_drop_file (fs, file);
 
-	prev = &(folder->files);
-	while ((*prev) && ((*prev) != file))
-		prev = &((*prev)->next);
-	if (!*prev)
-		return GP_ERROR;
-	*prev = file->next;
-	file->next = NULL;
+	if (file->prev)
+		file->prev->next = file->next;
+	else
+		folder->files = file->next;
+	if (file->next)
+		file->next->prev = file->prev;
+	else
+		folder->lastfile = file->prev;
+	file_hash_remove (folder, file);
 	free (file->name);
 	free (file);
 	return (GP_OK);
@@ -1078,9 +1304,7 @@ int
 gp_filesystem_count (CameraFilesystem *fs, const char *folder,
 		     GPContext *context)
 {
-	int x;
 	CameraFilesystemFolder	*f;
-	CameraFilesystemFile	*file;
 
 	CHECK_NULL (fs && folder);
 	CC (context);
@@ -1089,13 +1313,7 @@ gp_filesystem_count (CameraFilesystem *fs, const char *folder,
 	f = lookup_folder (fs, fs->rootfolder, folder, context);
 	if (!f) return (GP_ERROR_DIRECTORY_NOT_FOUND);
 
-	x = 0;
-	file = f->files;
-	while (file) {
-		x++;
-		file = file->next;
-	}
-	return x;
+	return f->nroffiles;
 }
 
 /**
@@ -1252,6 +1470,8 @@ gp_filesystem_remove_dir (CameraFilesystem *fs, const char *folder,
 			gp_log (GP_LOG_DEBUG, "gphoto2-filesystem", "Done making folder %s clean...", folder);
 		}
 	}
+	if (!folder_hash_lookup (f, name, strlen (name)))
+		return (GP_ERROR_DIRECTORY_NOT_FOUND);
 	prev = &(f->folders);
 	while (*prev) {
 		if (!strcmp (name, (*prev)->name))
@@ -1273,6 +1493,7 @@ gp_filesystem_remove_dir (CameraFilesystem *fs, const char *folder,
 
 	/* Remove the directory */
 	CR (fs->remove_dir_func (fs, folder, name, fs->data, context));
+	folder_hash_remove (f, *prev);
 	CR (delete_folder (fs, prev));
 	return (GP_OK);
 }
@@ -1398,13 +1619,16 @@ gp_filesystem_number (CameraFilesystem *fs, const char *folder,
 	f = lookup_folder (fs, fs->rootfolder, folder, context);
 	if (!f) return (GP_ERROR_DIRECTORY_NOT_FOUND);
 
-	file = f->files;
-	num = 0;
-	while (file) {
-		if (!strcmp (file->name, filename))
-			return num;
-		num++;
-		file = file->next;
+	/* The index is the position in the list, only walk it on a hit. */
+	if (file_hash_lookup (f, filename)) {
+		file = f->files;
+		num = 0;
+		while (file) {
+			if (!strcmp (file->name, filename))
+				return num;
+			num++;
+			file = file->next;
+		}
 	}
 
 	/* Ok, we didn't find the file. Is the folder dirty? */
@@ -1558,40 +1782,24 @@ gp_filesystem_get_file_impl (CameraFilesystem *fs, const char *folder,
 	/* Search folder and file */
 	CR( lookup_folder_file (fs, folder, filename, &xfolder, &xfile, context));
 
-	ret = GP_ERROR;
-	switch (type) {
-	case GP_FILE_TYPE_PREVIEW:
-		if (xfile->preview)
-			ret = gp_file_copy (file, xfile->preview);
-		break;
-	case GP_FILE_TYPE_NORMAL:
-		if (xfile->normal)
-			ret = gp_file_copy (file, xfile->normal);
-		break;
-	case GP_FILE_TYPE_RAW:
-		if (xfile->raw)
-			ret = gp_file_copy (file, xfile->raw);
-		break;
-	case GP_FILE_TYPE_AUDIO:
-		if (xfile->audio)
-			ret = gp_file_copy (file, xfile->audio);
-		break;
-	case GP_FILE_TYPE_EXIF:
-		if (xfile->exif)
-			ret = gp_file_copy (file, xfile->exif);
-		break;
-	case GP_FILE_TYPE_METADATA:
-		if (xfile->metadata)
-			ret = gp_file_copy (file, xfile->metadata);
-		break;
-	default:
+	if ((type < 0) || (type >= FS_CACHE_TYPES)) {
 		gp_context_error (context, _("Unknown file type %i."), type);
 		return (GP_ERROR);
 	}
-	if (ret == GP_OK) {
-		gp_log (GP_LOG_DEBUG, "lru", "LRU cache used for type %d!", type);
-		return GP_OK;
+	if (xfile->cache[type].file) {
+		ret = gp_file_copy (file, xfile->cache[type].file);
+		if (ret == GP_OK) {
+			gp_log (GP_LOG_DEBUG, "lru", "LRU cache used for type %d!", type);
+			gp_filesystem_cache_touch (fs, &xfile->cache[type]);
+			LOCK_STATS (fs);
+			fs->cache_stats.hits++;
+			UNLOCK_STATS (fs);
+			return GP_OK;
+		}
 	}
+	LOCK_STATS (fs);
+	fs->cache_stats.misses++;
+	UNLOCK_STATS (fs);
 
 	gp_context_status (context, _("Downloading '%s' from folder '%s'..."),
 			   filename, folder);
@@ -1910,279 +2118,306 @@ gp_filesystem_get_info (CameraFilesystem *fs, const char *folder,
 	return (GP_OK);
 }
 
-static int
-gp_filesystem_lru_clear (CameraFilesystem *fs)
+static void
+gp_filesystem_cache_link (CameraFilesystem *fs, CameraFilesystemCacheEntry *entry)
 {
-	int n = 0;
-	CameraFilesystemFile *ptr, *prev;
-
-	GP_DEBUG ("Clearing fscache LRU list...");
-
-	if (fs->lru_first == NULL) {
-		GP_DEBUG ("fscache LRU list already empty");
-		return (GP_OK);
-	}
-
-	ptr = prev = fs->lru_first;
-	while (ptr != NULL) {
-		n++;
-		if (ptr->lru_prev != prev) {
-			GP_DEBUG ("fscache LRU list corrupted (%i)", n);
-			return (GP_ERROR);
-		}
-		prev = ptr;
-		ptr = ptr->lru_next;
-
-		prev->lru_prev = NULL;
-		prev->lru_next = NULL;
-	}
-
-	fs->lru_first = NULL;
-	fs->lru_last = NULL;
-	fs->lru_size = 0;
-
-	GP_DEBUG ("fscache LRU list cleared (removed %i items)", n);
+	CameraFilesystemCacheList *list = &fs->cache[entry->type];
 
-	return (GP_OK);
+	entry->type_next = NULL;
+	entry->type_prev = list->last;
+	if (list->last)
+		list->last->type_next = entry;
+	else
+		list->first = entry;
+	list->last = entry;
+
+	entry->used = fs->cache_clock++;
+	entry->lru_next = NULL;
+	entry->lru_prev = fs->lru_last;
+	if (fs->lru_last)
+		fs->lru_last->lru_next = entry;
+	else
+		fs->lru_first = entry;
+	fs->lru_last = entry;
 }
 
-static int
-gp_filesystem_lru_remove_one (CameraFilesystem *fs, CameraFilesystemFile *item)
+static void
+gp_filesystem_cache_unlink (CameraFilesystem *fs, CameraFilesystemCacheEntry *entry)
 {
-	if (item->lru_prev == NULL)
-		return (GP_ERROR);
-
-	/* Update the prev and next pointers. */
-	if (item->lru_prev) item->lru_prev->lru_next = item->lru_next;
-	if (item->lru_next) item->lru_next->lru_prev = item->lru_prev;
-	if (fs->lru_last == item) {
-		if (fs->lru_first == item) {
-
-			/*
-			 * Case 1: ITEM is the only one in the list. We'll
-			 * remove it, and the list will be empty afterwards.
-			 */
-			fs->lru_last  = NULL;
-			fs->lru_first = NULL;
-		} else {
-
-			/* Case 2: ITEM is the last in the list. */
-			fs->lru_last = item->lru_prev;
-		}
-	} else if (fs->lru_first == item) {
+	CameraFilesystemCacheList *list = &fs->cache[entry->type];
 
-		/* Case 3: ITEM is the first in the list. */
-		fs->lru_first = item->lru_next;
-		/* the first item prev links back to itself */
-		fs->lru_first->lru_prev = fs->lru_first;
-	}
+	if (entry->type_prev)
+		entry->type_prev->type_next = entry->type_next;
+	else
+		list->first = entry->type_next;
+	if (entry->type_next)
+		entry->type_next->type_prev = entry->type_prev;
+	else
+		list->last = entry->type_prev;
 
-	/* Clear the pointers */
-	item->lru_prev = NULL;
-	item->lru_next = NULL;
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		fs->lru_first = entry->lru_next;
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		fs->lru_last = entry->lru_prev;
 
-	return (GP_OK);
+	entry->type_prev = entry->type_next = NULL;
+	entry->lru_prev = entry->lru_next = NULL;
 }
 
-static int
-gp_filesystem_lru_free (CameraFilesystem *fs)
+/* Drops the cached data of one entry, if there is any. */
+static void
+gp_filesystem_cache_drop (CameraFilesystem *fs, CameraFilesystemCacheEntry *entry)
 {
-	CameraFilesystemFile *ptr;
-	unsigned long int size;
-
-	CHECK_NULL (fs && fs->lru_first);
-
-	ptr = fs->lru_first;
-
-	GP_DEBUG ("Freeing cached data for file '%s'...", ptr->name);
-
-	/* Remove it from the list. */
-	fs->lru_first = ptr->lru_next;
-	if (fs->lru_first)
-		fs->lru_first->lru_prev = fs->lru_first;
-	else
-		fs->lru_last = NULL;
-
-	/* Free its content. */
-	if (ptr->normal) {
-		CR( gp_file_get_data_and_size (ptr->normal, NULL, &size));
-		fs->lru_size -= size;
-		gp_file_unref (ptr->normal);
-		ptr->normal = NULL;
-	}
-	if (ptr->raw) {
-		CR( gp_file_get_data_and_size (ptr->raw, NULL, &size));
-		fs->lru_size -= size;
-		gp_file_unref (ptr->raw);
-		ptr->raw = NULL;
-	}
-	if (ptr->audio) {
-		CR( gp_file_get_data_and_size (ptr->audio, NULL, &size));
-		fs->lru_size -= size;
-		gp_file_unref (ptr->audio);
-		ptr->audio = NULL;
-	}
-	ptr->lru_next = ptr->lru_prev = NULL;
-	return (GP_OK);
+	if (!entry->file)
+		return;
+	gp_filesystem_cache_unlink (fs, entry);
+	fs->cache[entry->type].size -= entry->size;
+	fs->cache[entry->type].count--;
+	LOCK_STATS (fs);
+	fs->cache_size -= entry->size;
+	fs->cache_stats.entries--;
+	UNLOCK_STATS (fs);
+	gp_file_unref (entry->file);
+	entry->file = NULL;
+	entry->size = 0;
 }
 
-static int
-gp_filesystem_lru_count (CameraFilesystem *fs)
+static void
+gp_filesystem_cache_drop_file (CameraFilesystem *fs, CameraFilesystemFile *file)
 {
-	CameraFilesystemFile *ptr;
-	int count = 0;
+	int i;
 
-	if (!fs) return 0;
-	ptr = fs->lru_first;
-	while (ptr) {
-		if (ptr->normal || ptr->raw || ptr->audio)
-			count++;
-		ptr = ptr->lru_next;
-	}
-	return count;
+	for (i = 0; i < FS_CACHE_TYPES; i++)
+		gp_filesystem_cache_drop (fs, &file->cache[i]);
 }
 
-static int
-gp_filesystem_lru_update (CameraFilesystem *fs,
-			  const char *folder, const char *filename,
-			  CameraFileType type,
-			  CameraFile *file, GPContext *context)
+/* Marks an entry as most recently used. */
+static void
+gp_filesystem_cache_touch (CameraFilesystem *fs, CameraFilesystemCacheEntry *entry)
 {
-	CameraFilesystemFolder	*f;
-	CameraFilesystemFile	*xfile;
-	CameraFile *oldfile = NULL;
-	unsigned long int size;
-	int x;
-	char cached_images[1024];
-
-	CHECK_NULL (fs && folder && file);
+	if (fs->lru_last == entry && fs->cache[entry->type].last == entry)
+		return;
+	gp_filesystem_cache_unlink (fs, entry);
+	gp_filesystem_cache_link (fs, entry);
+}
 
-	CR (gp_file_get_data_and_size (file, NULL, &size));
+/*
+ * The least recently used picture other than keep. Each type chain is in
+ * order of use, so it is the oldest of the heads of the picture types.
+ */
+static CameraFilesystemCacheEntry *
+gp_filesystem_cache_oldest_picture (CameraFilesystem *fs,
+				    CameraFilesystemCacheEntry *keep)
+{
+	static const CameraFileType types[] = {
+		GP_FILE_TYPE_NORMAL, GP_FILE_TYPE_RAW, GP_FILE_TYPE_AUDIO
+	};
+	CameraFilesystemCacheEntry *entry, *oldest = NULL;
+	unsigned int i;
+
+	for (i = 0; i < sizeof (types) / sizeof (types[0]); i++) {
+		entry = fs->cache[types[i]].first;
+		if (entry == keep)
+			entry = entry->type_next;
+		if (entry && (!oldest || (entry->used < oldest->used)))
+			oldest = entry;
+	}
+	return (oldest);
+}
 
-	/*
-	 * The following is a very simple case which is used to prune
-	 * the LRU. We keep PICTURES_TO_KEEP pictures in the LRU.
-	 *
-	 * We have 2 main scenarios:
-	 *	- query all thumbnails (repeatedly) ... they are cached and
-	 *	  are not pruned by lru free.
-	 *	- download all images, linear.	no real need for caching.
-	 *	- skip back 1 image (in viewers) (really? I don't know.)
-	 *
-	 * So lets just keep 2 pictures in memory.
-	 */
-	if (pictures_to_keep == -1) {
-		if (gp_setting_get ("libgphoto", "cached-images", cached_images) == GP_OK) {
-			pictures_to_keep = atoi(cached_images);
-		} else {
-			/* store a default setting */
-			sprintf (cached_images, "%d", PICTURES_TO_KEEP);
-			gp_setting_set ("libgphoto", "cached-images", cached_images);
+/*
+ * Evicts least recently used entries until the budgets are kept again.
+ * The entry keep is never evicted, so that a file which is bigger than
+ * the budget on its own is still available until the next file comes in.
+ */
+static void
+gp_filesystem_cache_prune (CameraFilesystem *fs, CameraFilesystemCacheEntry *keep)
+{
+	CameraFilesystemCacheEntry *entry;
+	int i;
+
+	for (i = 0; i < FS_CACHE_TYPES; i++) {
+		while (fs->cache[i].size > fs->cache[i].limit) {
+			entry = fs->cache[i].first;
+			if (entry == keep)
+				entry = entry->type_next;
+			if (!entry)
+				break;
+			GP_DEBUG ("Evicting cached data (type %i, %ld bytes) from fscache...",
+				  i, entry->size);
+			gp_filesystem_cache_drop (fs, entry);
+			LOCK_STATS (fs);
+			fs->cache_stats.evictions++;
+			UNLOCK_STATS (fs);
 		}
 	}
-
-	if (pictures_to_keep < 0) /* also sanity check, but no upper limit. */
-		pictures_to_keep = PICTURES_TO_KEEP;
-
-	x = gp_filesystem_lru_count (fs);
-	while (x > pictures_to_keep) {
-		CR (gp_filesystem_lru_free (fs));
-		x = gp_filesystem_lru_count (fs);
-	}
-
-	GP_DEBUG ("Adding file '%s' from folder '%s' to the fscache LRU list "
-		  "(type %i)...", filename, folder, type);
-
-	/* Search folder and file */
-	CR (lookup_folder_file (fs, folder, filename, &f, &xfile, context));
-
-	/*
-	 * If the file is already in the lru, we first remove it. Note that
-	 * we will only remove 'normal', 'raw' and 'audio' from cache.
-	 * See gp_filesystem_lru_free.
-	 */
-	if (xfile->lru_prev != NULL) {
-		switch (type) {
-		case GP_FILE_TYPE_NORMAL:
-			oldfile = xfile->normal;
-			break;
-		case GP_FILE_TYPE_RAW:
-			oldfile = xfile->raw;
+	while (fs->cache_size > fs->cache_limit) {
+		entry = fs->lru_first;
+		if (entry == keep)
+			entry = entry->lru_next;
+		if (!entry)
 			break;
-		case GP_FILE_TYPE_AUDIO:
-			oldfile = xfile->audio;
+		GP_DEBUG ("Evicting cached data (type %i, %ld bytes) from fscache...",
+			  entry->type, entry->size);
+		gp_filesystem_cache_drop (fs, entry);
+		LOCK_STATS (fs);
+		fs->cache_stats.evictions++;
+		UNLOCK_STATS (fs);
+	}
+	while ((fs->picture_limit >= 0) &&
+	       (fs->cache[GP_FILE_TYPE_NORMAL].count + fs->cache[GP_FILE_TYPE_RAW].count +
+		fs->cache[GP_FILE_TYPE_AUDIO].count > (unsigned int)fs->picture_limit)) {
+		entry = gp_filesystem_cache_oldest_picture (fs, keep);
+		if (!entry)
 			break;
-		case GP_FILE_TYPE_PREVIEW:
-		case GP_FILE_TYPE_EXIF:
-		case GP_FILE_TYPE_METADATA:
-			break;
-		default:
-			gp_context_error (context, _("Unknown file type %i."),
-					  type);
-			return (GP_ERROR);
-		}
-		if (oldfile) {
-			CR( gp_file_get_data_and_size (oldfile, NULL, &size));
-			fs->lru_size -= size;
-		}
-
-		CR (gp_filesystem_lru_remove_one (fs, xfile));
+		GP_DEBUG ("Evicting cached picture (type %i) from fscache...",
+			  entry->type);
+		gp_filesystem_cache_drop (fs, entry);
+		LOCK_STATS (fs);
+		fs->cache_stats.evictions++;
+		UNLOCK_STATS (fs);
 	}
+}
 
-	/* Then add the file at the end of the LRU. */
-	if (fs->lru_first == NULL) {
-		fs->lru_first = xfile;
-		fs->lru_last = xfile;
+static int
+gp_filesystem_cache_insert (CameraFilesystem *fs, CameraFilesystemFile *xfile,
+			    CameraFileType type, CameraFile *file)
+{
+	CameraFilesystemCacheEntry *entry;
+	unsigned long int size = 0;
 
-		/*
-		 * For the first item, prev point it itself to show that the
-		 * item is in the list.
-		 */
-		xfile->lru_prev = xfile;
+	if ((type < 0) || (type >= FS_CACHE_TYPES))
+		return (GP_ERROR_BAD_PARAMETERS);
+	/* Files backed by a fd or a handler do not take any memory */
+	if (gpi_file_is_memory (file))
+		CR (gp_file_get_data_and_size (file, NULL, &size));
 
-	} else {
-		xfile->lru_next = NULL;
-		xfile->lru_prev = fs->lru_last;
-		fs->lru_last->lru_next = xfile;
-		fs->lru_last = xfile;
-	}
+	entry = &xfile->cache[type];
+	gp_filesystem_cache_drop (fs, entry);
+	if (!fs->cache[type].limit || !fs->cache_limit)
+		return (GP_OK);
+	if (FS_IS_PICTURE (type) && !fs->picture_limit)
+		return (GP_OK);
 
-	CR( gp_file_get_data_and_size (file, NULL, &size));
-	fs->lru_size += size;
+	entry->type = type;
+	entry->file = file;
+	entry->size = size;
+	gp_file_ref (file);
+	gp_filesystem_cache_link (fs, entry);
+	fs->cache[type].size += size;
+	fs->cache[type].count++;
+	LOCK_STATS (fs);
+	fs->cache_size += size;
+	fs->cache_stats.entries++;
+	UNLOCK_STATS (fs);
+
+	gp_filesystem_cache_prune (fs, entry);
+	return (GP_OK);
+}
 
-	GP_DEBUG ("File '%s' from folder '%s' added in fscache LRU list.",
-		  filename, folder);
+static void
+gp_filesystem_cache_clear (CameraFilesystem *fs)
+{
+	GP_DEBUG ("Clearing fscache...");
+	while (fs->lru_first)
+		gp_filesystem_cache_drop (fs, fs->lru_first);
+}
+
+/**
+ * \brief Set the cache budget for one type of files
+ * \param fs a #CameraFilesystem
+ * \param type the #CameraFileType the budget applies to
+ * \param size the maximum number of bytes to keep cached for this type
+ *
+ * Files of the given type that have been passed to the filesystem are kept
+ * in memory until their accumulated size exceeds the budget, then the least
+ * recently used ones are evicted. A size of 0 disables caching for this type.
+ *
+ * Files backed by a file descriptor or a handler do not count against the
+ * budgets. The "cached-images" setting of "libgphoto" limits the number
+ * of cached normal, raw and audio files in addition, 0 disables caching
+ * of those.
+ *
+ * \return a gphoto2 error code.
+ **/
+int
+gp_filesystem_set_cache_limit (CameraFilesystem *fs, CameraFileType type,
+			       unsigned long int size)
+{
+	CHECK_NULL (fs);
+	if ((type < 0) || (type >= FS_CACHE_TYPES))
+		return (GP_ERROR_BAD_PARAMETERS);
 
+	fs->cache[type].limit = size;
+	gp_filesystem_cache_prune (fs, NULL);
 	return (GP_OK);
 }
 
-static int
-gp_filesystem_lru_check (CameraFilesystem *fs)
+/**
+ * \brief Set the overall cache budget of the filesystem
+ * \param fs a #CameraFilesystem
+ * \param size the maximum number of bytes to keep cached over all types
+ *
+ * In addition to the per type budgets (see gp_filesystem_set_cache_limit),
+ * the least recently used files of any type are evicted once the cache
+ * holds more than size bytes. A size of 0 disables the cache.
+ *
+ * \return a gphoto2 error code.
+ **/
+int
+gp_filesystem_set_cache_total_limit (CameraFilesystem *fs, unsigned long int size)
 {
-	int n = 0;
-	CameraFilesystemFile *ptr, *prev;
+	CHECK_NULL (fs);
 
-	GP_DEBUG ("Checking fscache LRU list integrity...");
+	fs->cache_limit = size;
+	gp_filesystem_cache_prune (fs, NULL);
+	return (GP_OK);
+}
 
-	if (fs->lru_first == NULL) {
-		GP_DEBUG ("fscache LRU list empty");
-		return (GP_OK);
-	}
+/**
+ * \brief Get statistics of the filesystem cache
+ * \param fs a #CameraFilesystem
+ * \param stats a #CameraFilesystemCacheStats to fill in
+ *
+ * Can be called from another thread while a file is being downloaded.
+ *
+ * \return a gphoto2 error code.
+ **/
+int
+gp_filesystem_get_cache_stats (CameraFilesystem *fs, CameraFilesystemCacheStats *stats)
+{
+	CHECK_NULL (fs && stats);
 
-	ptr = prev = fs->lru_first;
-	while (ptr != NULL) {
-		n++;
-		if (ptr->lru_prev != prev) {
-			GP_DEBUG ("fscache LRU list corrupted (%i)", n);
-			return (GP_ERROR);
-		}
-		prev = ptr;
-		ptr = ptr->lru_next;
-	}
+	LOCK_STATS (fs);
+	memcpy (stats, &fs->cache_stats, sizeof (CameraFilesystemCacheStats));
+	stats->size = fs->cache_size;
+	UNLOCK_STATS (fs);
+	return (GP_OK);
+}
 
-	GP_DEBUG ("fscache LRU list ok with %i items (%ld bytes)", n,
-		  fs->lru_size);
+/**
+ * \brief Reset the statistics of the filesystem cache
+ * \param fs a #CameraFilesystem
+ *
+ * Starts counting hits, misses and evictions from zero again. The number
+ * and size of the cached files are left alone.
+ *
+ * \return a gphoto2 error code.
+ **/
+int
+gp_filesystem_reset_cache_stats (CameraFilesystem *fs)
+{
+	CHECK_NULL (fs);
 
+	LOCK_STATS (fs);
+	fs->cache_stats.hits = 0;
+	fs->cache_stats.misses = 0;
+	fs->cache_stats.evictions = 0;
+	UNLOCK_STATS (fs);
 	return (GP_OK);
 }
 
@@ -2223,59 +2458,15 @@ gp_filesystem_set_file_noop (CameraFilesystem *fs,
 	CR (lookup_folder_file (fs, folder, filename, &f, &xfile, context));
 
 	/*
-	 * If we add a significant amount of data in the cache, we put (or
-	 * move) a reference to this file in the LRU linked list. We
-	 * assume that only GP_FILE_TYPE_[RAW,NORMAL,EXIF] will contain a
-	 * significant amount of data.
+	 * Put (or move) the file to the end of the LRU lists. This
+	 * evicts the least recently used files if it takes the cache
+	 * over its budgets.
 	 */
-	if ((type == GP_FILE_TYPE_RAW) || (type == GP_FILE_TYPE_NORMAL) ||
-	    (type == GP_FILE_TYPE_AUDIO))
-		CR (gp_filesystem_lru_update (fs, folder, filename, type, file, context));
-
-	/* Redundant sanity check. */
-	CR (gp_filesystem_lru_check (fs));
-
-	switch (type) {
-	case GP_FILE_TYPE_PREVIEW:
-		if (xfile->preview)
-			gp_file_unref (xfile->preview);
-		xfile->preview = file;
-		gp_file_ref (file);
-		break;
-	case GP_FILE_TYPE_NORMAL:
-		if (xfile->normal)
-			gp_file_unref (xfile->normal);
-		xfile->normal = file;
-		gp_file_ref (file);
-		break;
-	case GP_FILE_TYPE_RAW:
-		if (xfile->raw)
-			gp_file_unref (xfile->raw);
-		xfile->raw = file;
-		gp_file_ref (file);
-		break;
-	case GP_FILE_TYPE_AUDIO:
-		if (xfile->audio)
-			gp_file_unref (xfile->audio);
-		xfile->audio = file;
-		gp_file_ref (file);
-		break;
-	case GP_FILE_TYPE_EXIF:
-		if (xfile->exif)
-			gp_file_unref (xfile->exif);
-		xfile->exif = file;
-		gp_file_ref (file);
-		break;
-	case GP_FILE_TYPE_METADATA:
-		if (xfile->metadata)
-			gp_file_unref (xfile->metadata);
-		xfile->metadata = file;
-		gp_file_ref (file);
-		break;
-	default:
+	if ((type < 0) || (type >= FS_CACHE_TYPES)) {
 		gp_context_error (context, _("Unknown file type %i."), type);
 		return (GP_ERROR);
 	}
+	CR (gp_filesystem_cache_insert (fs, xfile, type, file));
 
 	/*
 	 * If we didn't get a mtime, try to get it from the CameraFileInfo.
@@ -0,0 +1,1001 @@
+/** \file gphoto2-session.c
+ *
+ * \author Copyright 2013 The gPhoto Developers
+ *
+ * \note
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \note
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \note
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+#include <gphoto2/gphoto2-session.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+#endif
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
+
+#include <gphoto2/gphoto2-result.h>
+#include <gphoto2/gphoto2-port-log.h>
+
+#define CHECK_NULL(r)        {if (!(r)) return (GP_ERROR_BAD_PARAMETERS);}
+#define CHECK_RESULT(result) {int r = (result); if (r < 0) return (r);}
+
+/* How long each camera is polled per round while waiting for any event */
+#define GP_SESSION_EVENT_SLICE	100
+
+typedef struct _SessionEvent SessionEvent;
+struct _SessionEvent {
+	CameraEventType	 type;
+	void		*data;
+	SessionEvent	*next;
+};
+
+typedef struct {
+	Camera		*camera;
+	int		 result;
+
+	/* Events received while waiting for something else */
+	SessionEvent	*events, *events_last;
+
+	/* Waiting for events failed, see gp_session_wait_for_event() */
+	int		 events_failed;
+} SessionCamera;
+
+#define SESSION_EVENTS_FAILED	1	/* not reported yet */
+#define SESSION_EVENTS_REPORTED	2	/* left out of the wait */
+
+typedef void (*SessionJobFunc) (CameraSession *session, unsigned int n,
+				void *data, GPContext *context);
+
+struct _CameraSession {
+	CameraAbilitiesList	*al;
+	GPPortInfoList		*il;
+
+	SessionCamera		*cameras;
+	unsigned int		 count;
+
+#ifdef HAVE_PTHREAD
+	/*
+	 * Worker pool. A job is run for the indices 0..job_count-1, the
+	 * workers pick the next index until all are taken.
+	 */
+	pthread_t		*workers;
+	unsigned int		 workers_count;
+	pthread_mutex_t		 lock;
+	pthread_cond_t		 job_cond, done_cond;
+	SessionJobFunc		 job;
+	void			*job_data;
+	GPContext		*job_context;
+	unsigned int		 job_count, job_next, job_done;
+	int			 quit;
+
+	/* Lets all jobs of a synchronized trigger go at the same time */
+	pthread_cond_t		 barrier_cond;
+	unsigned int		 barrier_waiting;
+	unsigned long		 barrier_round;
+#endif
+};
+
+#ifdef HAVE_PTHREAD
+static void *
+gp_session_worker (void *data)
+{
+	CameraSession	*session = data;
+	unsigned int	 n;
+
+	pthread_mutex_lock (&session->lock);
+	for (;;) {
+		while (!session->quit &&
+		       (!session->job || session->job_next >= session->job_count))
+			pthread_cond_wait (&session->job_cond, &session->lock);
+		if (session->quit)
+			break;
+		n = session->job_next++;
+		pthread_mutex_unlock (&session->lock);
+
+		session->job (session, n, session->job_data,
+			      session->job_context);
+
+		pthread_mutex_lock (&session->lock);
+		if (++session->job_done == session->job_count)
+			pthread_cond_signal (&session->done_cond);
+	}
+	pthread_mutex_unlock (&session->lock);
+	return NULL;
+}
+
+/* Makes sure there is a worker for each of count parallel jobs */
+static int
+gp_session_grow_workers (CameraSession *session, unsigned int count)
+{
+	pthread_t	*newworkers;
+
+	if (count <= session->workers_count)
+		return (GP_OK);
+	newworkers = realloc (session->workers, count * sizeof (pthread_t));
+	if (!newworkers)
+		return (GP_ERROR_NO_MEMORY);
+	session->workers = newworkers;
+	while (session->workers_count < count) {
+		if (pthread_create (&session->workers[session->workers_count],
+				    NULL, gp_session_worker, session)) {
+			gp_log (GP_LOG_ERROR, "gphoto2-session", "Could not "
+				"start worker %d.", session->workers_count);
+			break;
+		}
+		session->workers_count++;
+	}
+	return (GP_OK);
+}
+#endif
+
+/*
+ * Runs job for each index 0..count-1, in parallel on the worker pool
+ * if there is one, and returns once all of them are done.
+ */
+static void
+gp_session_run (CameraSession *session, unsigned int count,
+		SessionJobFunc job, void *data, GPContext *context)
+{
+	unsigned int n;
+
+#ifdef HAVE_PTHREAD
+	if ((count > 1) &&
+	    (gp_session_grow_workers (session, count) == GP_OK) &&
+	    session->workers_count) {
+		pthread_mutex_lock (&session->lock);
+		session->job         = job;
+		session->job_data    = data;
+		session->job_context = context;
+		session->job_count   = count;
+		session->job_next    = 0;
+		session->job_done    = 0;
+		pthread_cond_broadcast (&session->job_cond);
+		while (session->job_done < count)
+			pthread_cond_wait (&session->done_cond, &session->lock);
+		session->job = NULL;
+		pthread_mutex_unlock (&session->lock);
+		return;
+	}
+#endif
+	for (n = 0; n < count; n++)
+		job (session, n, data, context);
+}
+
+/* The first error of all cameras, GP_OK if there is none */
+static int
+gp_session_first_error (CameraSession *session)
+{
+	unsigned int n;
+
+	for (n = 0; n < session->count; n++)
+		if (session->cameras[n].result < 0)
+			return (session->cameras[n].result);
+	return (GP_OK);
+}
+
+static void
+gp_session_free_event_data (CameraEventType type, void *data)
+{
+	switch (type) {
+	case GP_EVENT_UNKNOWN:
+	case GP_EVENT_FILE_ADDED:
+	case GP_EVENT_FOLDER_ADDED:
+		free (data);
+		break;
+	default:
+		break;
+	}
+}
+
+static int
+gp_session_push_event (SessionCamera *cam, CameraEventType type, void *data)
+{
+	SessionEvent *event;
+
+	event = malloc (sizeof (SessionEvent));
+	if (!event) {
+		gp_session_free_event_data (type, data);
+		return (GP_ERROR_NO_MEMORY);
+	}
+	event->type = type;
+	event->data = data;
+	event->next = NULL;
+	if (cam->events_last)
+		cam->events_last->next = event;
+	else
+		cam->events = event;
+	cam->events_last = event;
+	return (GP_OK);
+}
+
+static int
+gp_session_pop_event (SessionCamera *cam, CameraEventType *type, void **data)
+{
+	SessionEvent *event = cam->events;
+
+	if (!event)
+		return (0);
+	cam->events = event->next;
+	if (!cam->events)
+		cam->events_last = NULL;
+	*type = event->type;
+	*data = event->data;
+	free (event);
+	return (1);
+}
+
+/* Removes the first event of the given type and returns its data */
+static void *
+gp_session_take_event (SessionCamera *cam, CameraEventType type)
+{
+	SessionEvent	*event, *prev = NULL;
+	void		*data;
+
+	for (event = cam->events; event; prev = event, event = event->next) {
+		if (event->type != type)
+			continue;
+		if (prev)
+			prev->next = event->next;
+		else
+			cam->events = event->next;
+		if (cam->events_last == event)
+			cam->events_last = prev;
+		data = event->data;
+		free (event);
+		return (data);
+	}
+	return (NULL);
+}
+
+/**
+ * Create a new #CameraSession.
+ *
+ * @param session the new session
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Loads the camera and port drivers for all cameras that will be
+ * opened in this session.
+ *
+ */
+int
+gp_session_new (CameraSession **session, GPContext *context)
+{
+	int result;
+
+	CHECK_NULL (session);
+
+	*session = malloc (sizeof (CameraSession));
+	if (!*session)
+		return (GP_ERROR_NO_MEMORY);
+	memset (*session, 0, sizeof (CameraSession));
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init (&(*session)->lock, NULL);
+	pthread_cond_init (&(*session)->job_cond, NULL);
+	pthread_cond_init (&(*session)->done_cond, NULL);
+	pthread_cond_init (&(*session)->barrier_cond, NULL);
+#endif
+
+	result = gp_port_info_list_new (&(*session)->il);
+	if (result >= GP_OK)
+		result = gp_port_info_list_load ((*session)->il);
+	if (result >= GP_OK)
+		result = gp_abilities_list_new (&(*session)->al);
+	if (result >= GP_OK)
+		result = gp_abilities_list_load ((*session)->al, context);
+	if (result < GP_OK) {
+		gp_session_free (*session);
+		*session = NULL;
+		return (result);
+	}
+	return (GP_OK);
+}
+
+/**
+ * Free a #CameraSession.
+ *
+ * @param session a #CameraSession
+ * @return a gphoto2 error code
+ *
+ * Closes all cameras of the session, see gp_session_close().
+ *
+ */
+int
+gp_session_free (CameraSession *session)
+{
+	CHECK_NULL (session);
+
+	gp_session_close (session, NULL);
+
+#ifdef HAVE_PTHREAD
+	if (session->workers_count) {
+		unsigned int n;
+
+		pthread_mutex_lock (&session->lock);
+		session->quit = 1;
+		pthread_cond_broadcast (&session->job_cond);
+		pthread_mutex_unlock (&session->lock);
+		for (n = 0; n < session->workers_count; n++)
+			pthread_join (session->workers[n], NULL);
+	}
+	free (session->workers);
+	pthread_cond_destroy (&session->barrier_cond);
+	pthread_cond_destroy (&session->done_cond);
+	pthread_cond_destroy (&session->job_cond);
+	pthread_mutex_destroy (&session->lock);
+#endif
+
+	if (session->al)
+		gp_abilities_list_free (session->al);
+	if (session->il)
+		gp_port_info_list_free (session->il);
+	free (session);
+	return (GP_OK);
+}
+
+/**
+ * Get the camera drivers of a #CameraSession.
+ *
+ * @param session a #CameraSession
+ * @param list the #CameraAbilitiesList of the session
+ * @return a gphoto2 error code
+ *
+ * The list belongs to the session and must not be freed.
+ *
+ */
+int
+gp_session_get_abilities_list (CameraSession *session,
+			       CameraAbilitiesList **list)
+{
+	CHECK_NULL (session && list);
+
+	*list = session->al;
+	return (GP_OK);
+}
+
+/**
+ * Get the port drivers of a #CameraSession.
+ *
+ * @param session a #CameraSession
+ * @param list the #GPPortInfoList of the session
+ * @return a gphoto2 error code
+ *
+ * The list belongs to the session and must not be freed.
+ *
+ */
+int
+gp_session_get_port_info_list (CameraSession *session, GPPortInfoList **list)
+{
+	CHECK_NULL (session && list);
+
+	*list = session->il;
+	return (GP_OK);
+}
+
+/**
+ * Detect the attached cameras.
+ *
+ * @param session a #CameraSession
+ * @param list a #CameraList that receives the model and port of each camera
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Like gp_camera_autodetect(), but with the drivers already loaded by
+ * the session.
+ *
+ */
+int
+gp_session_autodetect (CameraSession *session, CameraList *list,
+		       GPContext *context)
+{
+	CameraList	*xlist;
+	int		 result, i;
+
+	CHECK_NULL (session && list);
+
+	CHECK_RESULT (gp_list_new (&xlist));
+	result = gp_abilities_list_detect (session->al, session->il, xlist,
+					   context);
+	if (result >= GP_OK)
+		result = gp_list_count (xlist);
+	for (i = 0; i < result; i++) {
+		const char *name, *value;
+
+		gp_list_get_name (xlist, i, &name);
+		gp_list_get_value (xlist, i, &value);
+		/* Filter out the "usb:" entry */
+		if (!strcmp ("usb:", value))
+			continue;
+		gp_list_append (list, name, value);
+	}
+	gp_list_free (xlist);
+	return (result < GP_OK) ? result : GP_OK;
+}
+
+static void
+gp_session_open_job (CameraSession *session, unsigned int n, void *data,
+		     GPContext *context)
+{
+	SessionCamera *cam = &session->cameras[*(unsigned int*)data + n];
+
+	if (cam->result < 0)
+		return;
+	cam->result = gp_camera_init (cam->camera, context);
+}
+
+/*
+ * Creates the camera for a model/port pair. The lookups are done here
+ * and not in the workers, the session lists are not locked.
+ */
+static int
+gp_session_new_camera (CameraSession *session, const char *model,
+		       const char *port, Camera **camera)
+{
+	CameraAbilities	a;
+	GPPortInfo	info;
+	int		result, m, p;
+
+	m = gp_abilities_list_lookup_model (session->al, model);
+	if (m < GP_OK)
+		return (m);
+	p = gp_port_info_list_lookup_path (session->il, port);
+	if (p < GP_OK)
+		return (p);
+
+	CHECK_RESULT (gp_camera_new (camera));
+	result = gp_abilities_list_get_abilities (session->al, m, &a);
+	if (result >= GP_OK)
+		result = gp_camera_set_abilities (*camera, a);
+	if (result >= GP_OK)
+		result = gp_port_info_list_get_info (session->il, p, &info);
+	if (result >= GP_OK)
+		result = gp_camera_set_port_info (*camera, info);
+	if (result < GP_OK) {
+		gp_camera_unref (*camera);
+		*camera = NULL;
+		return (result);
+	}
+	/* The application may drive the camera from its own threads too */
+	gp_camera_set_serialized (*camera, 1);
+	return (GP_OK);
+}
+
+/**
+ * Open a number of cameras.
+ *
+ * @param session a #CameraSession
+ * @param cameras a #CameraList with the model and port of each camera,
+ *                e.g. from gp_session_autodetect()
+ * @param context a #GPContext
+ * @return the number of cameras in the session or a gphoto2 error code
+ *
+ * Initializes all cameras concurrently and adds those that could be
+ * opened to the session. Cameras that fail are logged and left out. If
+ * none can be opened, the error of the first one is returned.
+ *
+ * The opened cameras use serialized access (see
+ * gp_camera_set_serialized()), so each one may also be driven from a
+ * thread of the application.
+ *
+ */
+int
+gp_session_open (CameraSession *session, CameraList *cameras,
+		 GPContext *context)
+{
+	SessionCamera	*newcameras;
+	unsigned int	 first, n, i;
+	int		 count, result;
+
+	CHECK_NULL (session && cameras);
+
+	count = gp_list_count (cameras);
+	CHECK_RESULT (count);
+	if (!count)
+		return (session->count);
+
+	newcameras = realloc (session->cameras,
+			      (session->count + count) * sizeof (SessionCamera));
+	if (!newcameras)
+		return (GP_ERROR_NO_MEMORY);
+	session->cameras = newcameras;
+	first = session->count;
+	memset (&session->cameras[first], 0, count * sizeof (SessionCamera));
+
+	for (n = 0; n < (unsigned int)count; n++) {
+		const char *model, *port;
+
+		gp_list_get_name (cameras, n, &model);
+		gp_list_get_value (cameras, n, &port);
+		session->cameras[first + n].result = gp_session_new_camera (
+			session, model, port,
+			&session->cameras[first + n].camera);
+	}
+
+	gp_session_run (session, count, gp_session_open_job, &first, context);
+
+	/* Keep the cameras that could be opened */
+	result = GP_OK;
+	for (n = i = first; n < first + count; n++) {
+		SessionCamera *cam = &session->cameras[n];
+
+		if (cam->result < 0) {
+			const char *model, *port;
+
+			gp_list_get_name (cameras, n - first, &model);
+			gp_list_get_value (cameras, n - first, &port);
+			gp_log (GP_LOG_ERROR, "gphoto2-session", "Could not "
+				"open '%s' at '%s': %s", model, port,
+				gp_result_as_string (cam->result));
+			if (result == GP_OK)
+				result = cam->result;
+			if (cam->camera)
+				gp_camera_unref (cam->camera);
+			continue;
+		}
+		session->cameras[i++] = *cam;
+	}
+	if ((i == first) && (result < 0))
+		return (result);
+	session->count = i;
+	return (session->count);
+}
+
+static void
+gp_session_close_job (CameraSession *session, unsigned int n, void *data,
+		      GPContext *context)
+{
+	session->cameras[n].result = gp_camera_exit (session->cameras[n].camera,
+						     context);
+}
+
+/**
+ * Close all cameras of a #CameraSession.
+ *
+ * @param session a #CameraSession
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Exits all cameras concurrently, drops the events that were not
+ * fetched yet and removes the cameras from the session.
+ *
+ */
+int
+gp_session_close (CameraSession *session, GPContext *context)
+{
+	CameraEventType	type;
+	void		*data;
+	unsigned int	n;
+
+	CHECK_NULL (session);
+
+	gp_session_run (session, session->count, gp_session_close_job, NULL,
+			context);
+	for (n = 0; n < session->count; n++) {
+		while (gp_session_pop_event (&session->cameras[n], &type, &data))
+			gp_session_free_event_data (type, data);
+		gp_camera_unref (session->cameras[n].camera);
+	}
+	free (session->cameras);
+	session->cameras = NULL;
+	session->count = 0;
+	return (GP_OK);
+}
+
+/**
+ * @param session a #CameraSession
+ * @return the number of cameras in the session or a gphoto2 error code
+ */
+int
+gp_session_count (CameraSession *session)
+{
+	CHECK_NULL (session);
+
+	return (session->count);
+}
+
+/**
+ * Get a camera of a #CameraSession.
+ *
+ * @param session a #CameraSession
+ * @param n the index of the camera
+ * @param camera the #Camera
+ * @return a gphoto2 error code
+ *
+ * The camera belongs to the session; use gp_camera_ref() to keep it
+ * beyond the session.
+ *
+ */
+int
+gp_session_get_camera (CameraSession *session, int n, Camera **camera)
+{
+	CHECK_NULL (session && camera);
+	if ((n < 0) || ((unsigned int)n >= session->count))
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	*camera = session->cameras[n].camera;
+	return (GP_OK);
+}
+
+/**
+ * Get the result of the last operation of a camera.
+ *
+ * @param session a #CameraSession
+ * @param n the index of the camera
+ * @return the gphoto2 error code the last operation on all cameras of the
+ *         session returned for the camera
+ */
+int
+gp_session_get_result (CameraSession *session, int n)
+{
+	CHECK_NULL (session);
+	if ((n < 0) || ((unsigned int)n >= session->count))
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	return (session->cameras[n].result);
+}
+
+static void
+gp_session_trigger_job (CameraSession *session, unsigned int n, void *data,
+			GPContext *context)
+{
+	session->cameras[n].result = gp_camera_trigger_capture (
+		session->cameras[n].camera, context);
+}
+
+/**
+ * Trigger a capture on all cameras.
+ *
+ * @param session a #CameraSession
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Calls gp_camera_trigger_capture() on all cameras in parallel. Use
+ * gp_session_download_latest() or gp_session_wait_for_event() to get
+ * the captured images.
+ *
+ */
+int
+gp_session_trigger_capture (CameraSession *session, GPContext *context)
+{
+	CHECK_NULL (session);
+
+	gp_session_run (session, session->count, gp_session_trigger_job, NULL,
+			context);
+	return (gp_session_first_error (session));
+}
+
+/* Monotonic time in microseconds, for the trigger timings */
+static uint64_t
+gp_session_now (void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if (!clock_gettime (CLOCK_MONOTONIC, &ts))
+		return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+	{
+		struct timeval tv;
+
+		gettimeofday (&tv, NULL);
+		return ((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+	}
+}
+
+static void
+gp_session_prepare_job (CameraSession *session, unsigned int n, void *data,
+			GPContext *context)
+{
+	session->cameras[n].result = gp_camera_prepare_trigger (
+		session->cameras[n].camera, context);
+}
+
+typedef struct {
+	CameraTriggerTiming	*timings;
+	int			 barrier;
+} SessionTrigger;
+
+static void
+gp_session_synced_job (CameraSession *session, unsigned int n, void *data,
+		       GPContext *context)
+{
+	SessionTrigger *trigger = data;
+
+#ifdef HAVE_PTHREAD
+	/* Wait until the workers of all cameras are here */
+	if (trigger->barrier) {
+		unsigned long round;
+
+		pthread_mutex_lock (&session->lock);
+		round = session->barrier_round;
+		if (++session->barrier_waiting == session->count) {
+			session->barrier_waiting = 0;
+			session->barrier_round++;
+			pthread_cond_broadcast (&session->barrier_cond);
+		} else {
+			while (round == session->barrier_round)
+				pthread_cond_wait (&session->barrier_cond,
+						   &session->lock);
+		}
+		pthread_mutex_unlock (&session->lock);
+	}
+#endif
+	trigger->timings[n].sent_usec = gp_session_now ();
+	session->cameras[n].result = gp_camera_trigger_capture (
+		session->cameras[n].camera, context);
+	trigger->timings[n].done_usec = gp_session_now ();
+}
+
+/**
+ * Trigger a capture on all cameras at the same time.
+ *
+ * @param session a #CameraSession
+ * @param timings array of gp_session_count() entries that receives when
+ *                the release of each camera was sent and done, or NULL
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * First gets all cameras ready with gp_camera_prepare_trigger(), in
+ * parallel, and then releases them from one thread per camera that are
+ * let go together. This keeps the skew between the cameras as small as
+ * the cameras allow; the \c timings tell how large it was. If a camera
+ * cannot be prepared, no camera is released.
+ *
+ */
+int
+gp_session_trigger_capture_synced (CameraSession *session,
+				   CameraTriggerTiming *timings,
+				   GPContext *context)
+{
+	SessionTrigger	 trigger;
+	CameraTriggerTiming *xtimings = timings;
+	uint64_t	 sent_min, sent_max, done_min, done_max;
+	unsigned int	 n;
+	int		 result;
+
+	CHECK_NULL (session);
+	if (!session->count)
+		return (GP_OK);
+
+	gp_session_run (session, session->count, gp_session_prepare_job, NULL,
+			context);
+	CHECK_RESULT (gp_session_first_error (session));
+
+	if (!xtimings) {
+		xtimings = malloc (session->count * sizeof (CameraTriggerTiming));
+		if (!xtimings)
+			return (GP_ERROR_NO_MEMORY);
+	}
+	trigger.timings = xtimings;
+	trigger.barrier = 0;
+#ifdef HAVE_PTHREAD
+	/* Only if every camera has its own worker, it would wait forever */
+	trigger.barrier = (session->count > 1) &&
+			  (session->workers_count >= session->count);
+	session->barrier_waiting = 0;
+#endif
+	if (!trigger.barrier && (session->count > 1))
+		gp_log (GP_LOG_ERROR, "gphoto2-session", "Not enough "
+			"workers, releasing the cameras one after the other.");
+	gp_session_run (session, session->count, gp_session_synced_job,
+			&trigger, context);
+	result = gp_session_first_error (session);
+
+	sent_min = sent_max = xtimings[0].sent_usec;
+	done_min = done_max = xtimings[0].done_usec;
+	for (n = 1; n < session->count; n++) {
+		if (xtimings[n].sent_usec < sent_min) sent_min = xtimings[n].sent_usec;
+		if (xtimings[n].sent_usec > sent_max) sent_max = xtimings[n].sent_usec;
+		if (xtimings[n].done_usec < done_min) done_min = xtimings[n].done_usec;
+		if (xtimings[n].done_usec > done_max) done_max = xtimings[n].done_usec;
+	}
+	gp_log (GP_LOG_DEBUG, "gphoto2-session", "Released %d cameras, skew "
+		"%ld us when sent, %ld us when done.", session->count,
+		(long)(sent_max - sent_min), (long)(done_max - done_min));
+
+	if (xtimings != timings)
+		free (xtimings);
+	return (result);
+}
+
+typedef struct {
+	int		 timeout;
+	CameraFile	**files;
+} SessionDownload;
+
+static void
+gp_session_download_job (CameraSession *session, unsigned int n, void *data,
+			 GPContext *context)
+{
+	SessionDownload	*dl = data;
+	SessionCamera	*cam = &session->cameras[n];
+	CameraFilePath	*path;
+	CameraEventType	 type;
+	void		*eventdata;
+	struct timeval	 start, now;
+	int		 result, left;
+
+	dl->files[n] = NULL;
+
+	/* An image may already have been seen while waiting for events */
+	path = gp_session_take_event (cam, GP_EVENT_FILE_ADDED);
+
+	gettimeofday (&start, NULL);
+	while (!path) {
+		gettimeofday (&now, NULL);
+		left = dl->timeout - ((now.tv_sec - start.tv_sec) * 1000 +
+				      (now.tv_usec - start.tv_usec) / 1000);
+		if (left <= 0) {
+			cam->result = GP_ERROR_TIMEOUT;
+			return;
+		}
+		eventdata = NULL;
+		result = gp_camera_wait_for_event (cam->camera, left, &type,
+						   &eventdata, context);
+		if (result < GP_OK) {
+			cam->result = result;
+			return;
+		}
+		if (type == GP_EVENT_FILE_ADDED)
+			path = eventdata;
+		else if (type != GP_EVENT_TIMEOUT)
+			/* Keep it for gp_session_wait_for_event */
+			gp_session_push_event (cam, type, eventdata);
+	}
+
+	result = gp_file_new (&dl->files[n]);
+	if (result >= GP_OK)
+		result = gp_camera_file_get (cam->camera, path->folder,
+					     path->name, GP_FILE_TYPE_NORMAL,
+					     dl->files[n], context);
+	if (result < GP_OK && dl->files[n]) {
+		gp_file_unref (dl->files[n]);
+		dl->files[n] = NULL;
+	}
+	free (path);
+	cam->result = result;
+}
+
+/**
+ * Download the next image of all cameras.
+ *
+ * @param session a #CameraSession
+ * @param timeout how long to wait for an image in 1/1000 seconds
+ * @param files array of gp_session_count() entries that receives the
+ *              image of each camera, or NULL for a camera that failed
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Waits on all cameras in parallel for a new image (#GP_EVENT_FILE_ADDED),
+ * e.g. after gp_session_trigger_capture(), and downloads it. Other events
+ * that arrive meanwhile are kept for gp_session_wait_for_event(). A
+ * camera that has no new image within \c timeout reports
+ * #GP_ERROR_TIMEOUT. The caller frees the files with gp_file_unref().
+ *
+ */
+int
+gp_session_download_latest (CameraSession *session, int timeout,
+			    CameraFile **files, GPContext *context)
+{
+	SessionDownload dl;
+
+	CHECK_NULL (session && files);
+
+	dl.timeout = timeout;
+	dl.files   = files;
+	gp_session_run (session, session->count, gp_session_download_job, &dl,
+			context);
+	return (gp_session_first_error (session));
+}
+
+static void
+gp_session_event_job (CameraSession *session, unsigned int n, void *data,
+		      GPContext *context)
+{
+	SessionCamera	*cam = &session->cameras[n];
+	CameraEventType	 type;
+	void		*eventdata = NULL;
+
+	if (cam->events_failed)
+		return;
+	cam->result = gp_camera_wait_for_event (cam->camera, *(int*)data,
+						&type, &eventdata, context);
+	if ((cam->result >= GP_OK) && (type != GP_EVENT_TIMEOUT))
+		cam->result = gp_session_push_event (cam, type, eventdata);
+	if (cam->result < GP_OK)
+		cam->events_failed = SESSION_EVENTS_FAILED;
+}
+
+/**
+ * Wait for an event from any camera.
+ *
+ * @param session a #CameraSession
+ * @param timeout amount of time to wait in 1/1000 seconds
+ * @param n the index of the camera the event came from [out]
+ * @param eventtype received CameraEventType [out]
+ * @param eventdata received event specific data [out]
+ * @param context a #GPContext
+ * @return a gphoto2 error code
+ *
+ * Like gp_camera_wait_for_event(), but for all cameras of the session.
+ * The cameras are polled in parallel, events that several cameras send
+ * at the same time are returned one per call. If no camera sends an
+ * event within \c timeout, \c eventtype is #GP_EVENT_TIMEOUT and \c n
+ * is -1.
+ *
+ * If waiting fails on a camera, its error is returned once with \c n set
+ * to its index, after the events of the other cameras that are already
+ * queued. That camera is then left out of the following waits, until
+ * the session is closed; the others are still waited for.
+ *
+ */
+int
+gp_session_wait_for_event (CameraSession *session, int timeout,
+			   int *n, CameraEventType *eventtype,
+			   void **eventdata, GPContext *context)
+{
+	struct timeval	start, now;
+	unsigned int	i, waiting;
+	int		left, slice;
+
+	CHECK_NULL (session && n && eventtype && eventdata);
+
+	gettimeofday (&start, NULL);
+	for (;;) {
+		for (i = 0; i < session->count; i++) {
+			if (gp_session_pop_event (&session->cameras[i],
+						  eventtype, eventdata)) {
+				*n = i;
+				return (GP_OK);
+			}
+		}
+		waiting = 0;
+		for (i = 0; i < session->count; i++) {
+			SessionCamera *cam = &session->cameras[i];
+
+			if (cam->events_failed == SESSION_EVENTS_FAILED) {
+				cam->events_failed = SESSION_EVENTS_REPORTED;
+				*n = i;
+				*eventtype = GP_EVENT_UNKNOWN;
+				*eventdata = NULL;
+				return (cam->result);
+			}
+			if (!cam->events_failed)
+				waiting++;
+		}
+
+		gettimeofday (&now, NULL);
+		left = timeout - ((now.tv_sec - start.tv_sec) * 1000 +
+				  (now.tv_usec - start.tv_usec) / 1000);
+		if ((left <= 0) || !waiting) {
+			*n = -1;
+			*eventtype = GP_EVENT_TIMEOUT;
+			return (GP_OK);
+		}
+		slice = (left < GP_SESSION_EVENT_SLICE) ?
+			left : GP_SESSION_EVENT_SLICE;
+		gp_session_run (session, session->count, gp_session_event_job,
+				&slice, context);
+	}
+}
@@ -83,6 +83,12 @@ typedef struct _GPPortOperations {
 
         int (*reset)     (GPPort *);
 
+	/* For USB devices: bulk IN read with several transfers in flight */
+	int (*read_queued) (GPPort *, char *, int);
+
+	/* For USB devices: vendor and product ids of the attached devices */
+	int (*list_device_ids) (GPPort *, int *idvendors, int *idproducts, int count);
+
 } GPPortOperations;
 
 typedef GPPortType (* GPPortLibraryType) (void);
@@ -64,6 +64,8 @@ typedef void (* GPLogFunc) (GPLogLevel level, const char *domain, const char *st
 
 int  gp_log_add_func    (GPLogLevel level, GPLogFunc func, void *data);
 int  gp_log_remove_func (int id);
+int  gp_log_set_domain_level (const char *domain, GPLogLevel level);
+int  gp_log_is_enabled  (GPLogLevel level, const char *domain);
 
 /* Logging */
 void gp_log      (GPLogLevel level, const char *domain,
@@ -112,6 +114,8 @@ void gp_log_data (const char *domain, const char *data, unsigned int size);
 /* Stub these functions out if debugging is disabled */
 #define gp_log_add_func(level, func, data) (0)
 #define gp_log_remove_func(id) (0)
+#define gp_log_set_domain_level(domain, level) (0)
+#define gp_log_is_enabled(level, domain) (0)
 #define gp_log(level, domain, format, args...) /**/
 #define gp_logv(level, domain, format, args) /**/
 #define gp_log_data(domain, data, size) /**/
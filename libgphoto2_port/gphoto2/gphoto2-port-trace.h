@@ -0,0 +1,86 @@
+/** \file gphoto2-port-trace.h
+ *
+ * \brief In-memory trace of port and PTP transactions.
+ *
+ * \author Copyright 2013 The gPhoto Developers
+ *
+ * \note
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \note
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \note
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GPHOTO2_PORT_TRACE_H__
+#define __GPHOTO2_PORT_TRACE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief Number of records kept in the trace.
+ *
+ * Older records are overwritten by newer ones.
+ */
+#define GP_TRACE_RECORDS 4096
+
+/**
+ * \brief Kind of a traced operation.
+ */
+typedef enum {
+	GP_TRACE_NONE = 0,		/**< \brief Unused record. */
+	GP_TRACE_PORT_READ,		/**< \brief gp_port_read() */
+	GP_TRACE_PORT_READ_QUEUED,	/**< \brief gp_port_read_queued() */
+	GP_TRACE_PORT_WRITE,		/**< \brief gp_port_write() */
+	GP_TRACE_PORT_CHECK_INT,	/**< \brief gp_port_check_int() */
+	GP_TRACE_PTP_TRANSACTION,	/**< \brief A complete PTP transaction. */
+	GP_TRACE_PTP_REQUEST,		/**< \brief Sending a PTP request. */
+	GP_TRACE_PTP_DATA_OUT,		/**< \brief Sending the PTP data phase. */
+	GP_TRACE_PTP_DATA_IN,		/**< \brief Receiving the PTP data phase. */
+	GP_TRACE_PTP_RESPONSE,		/**< \brief Receiving a PTP response. */
+	GP_TRACE_PTP_EVENT		/**< \brief Receiving a PTP event. */
+} GPTraceOp;
+
+/**
+ * \brief One traced operation.
+ */
+typedef struct {
+	uint64_t	time;		/**< \brief Start in microseconds of a monotonic clock, see gp_trace_now(). */
+	uint32_t	duration;	/**< \brief Duration in microseconds. */
+	uint32_t	size;		/**< \brief Bytes asked for or sent. */
+	int32_t		result;		/**< \brief Bytes transferred or gphoto2 error for port operations, PTP response or error code for PTP ones. */
+	uint32_t	transaction;	/**< \brief PTP transaction id. */
+	uint16_t	op;		/**< \brief A #GPTraceOp. */
+	uint16_t	code;		/**< \brief PTP operation, response or event code. */
+	uint8_t		endpoint;	/**< \brief USB endpoint, 0 if none. */
+} GPTraceRecord;
+
+uint64_t    gp_trace_now      (void);
+void        gp_trace_add      (GPTraceRecord *record);
+int         gp_trace_enable   (int enable);
+int         gp_trace_snapshot (GPTraceRecord *records, int max);
+int         gp_trace_dump     (char **data, unsigned long *size);
+int         gp_trace_decode   (const char *data, unsigned long size,
+			       GPTraceRecord **records, int *count);
+const char *gp_trace_op_name  (GPTraceOp op);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __GPHOTO2_PORT_TRACE_H__ */
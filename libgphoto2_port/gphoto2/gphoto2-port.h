@@ -24,6 +24,8 @@
 #ifndef __GPHOTO2_PORT_H__
 #define __GPHOTO2_PORT_H__
 
+#include <stdint.h>
+
 #include <gphoto2/gphoto2-port-info-list.h>
 
 /* For portability */
@@ -153,6 +155,36 @@ typedef struct _GPPort {
 	GPPortPrivateCore    *pc;	/**< \brief Port library private data pointer. */
 } GPPort;
 
+/**
+ * \brief Number of buckets of #GPPortStats.read_sizes.
+ */
+#define GP_PORT_STATS_BUCKETS 24
+
+/**
+ * \brief Transfer statistics of a port.
+ *
+ * Counted since the port was created or gp_port_reset_stats() was called.
+ * Reads from the interrupt endpoint are counted apart from the other
+ * reads, polls of it that returned nothing are not counted.
+ */
+typedef struct {
+	uint64_t	bytes_read;	/**< \brief Bytes received, not from interrupts. */
+	uint64_t	bytes_written;	/**< \brief Bytes sent. */
+	uint64_t	bytes_interrupt; /**< \brief Bytes received from interrupts. */
+	uint64_t	read_usec;	/**< \brief Time spent in reads, in microseconds. */
+	uint64_t	write_usec;	/**< \brief Time spent in writes, in microseconds. */
+	unsigned int	reads;		/**< \brief Number of other reads. */
+	unsigned int	writes;		/**< \brief Number of writes. */
+	unsigned int	interrupts;	/**< \brief Number of interrupt reads. */
+	unsigned int	errors;		/**< \brief Failed reads and writes, including timeouts. */
+	unsigned int	timeouts;	/**< \brief Reads and writes that timed out. */
+	unsigned int	clear_halts;	/**< \brief Calls of gp_port_usb_clear_halt(). */
+	/** \brief Histogram of the sizes of successful reads: bucket n
+	 * counts reads of 2^n up to 2^(n+1)-1 bytes, bucket 0 includes
+	 * empty reads and the last bucket everything larger. */
+	unsigned int	read_sizes[GP_PORT_STATS_BUCKETS];
+} GPPortStats;
+
 int gp_port_new         (GPPort **port);
 int gp_port_free        (GPPort *port);
 
@@ -166,12 +198,16 @@ int gp_port_reset       (GPPort *port);
 
 int gp_port_write       (GPPort *port, const char *data, int size);
 int gp_port_read        (GPPort *port,       char *data, int size);
+int gp_port_read_queued (GPPort *port,       char *data, int size);
 int gp_port_check_int   (GPPort *port,       char *data, int size);
 int gp_port_check_int_fast (GPPort *port,    char *data, int size);
 
 int gp_port_get_timeout  (GPPort *port, int *timeout);
 int gp_port_set_timeout  (GPPort *port, int  timeout);
 
+int gp_port_get_stats    (GPPort *port, GPPortStats *stats);
+int gp_port_reset_stats  (GPPort *port);
+
 int gp_port_set_settings (GPPort *port, GPPortSettings  settings);
 int gp_port_get_settings (GPPort *port, GPPortSettings *settings);
 
@@ -208,6 +244,7 @@ int gp_port_flush      (GPPort *port, int direction);
 
 int gp_port_usb_find_device (GPPort *port, int idvendor, int idproduct);
 int gp_port_usb_find_device_by_class (GPPort *port, int mainclass, int subclass, int protocol);
+int gp_port_usb_list_device_ids (GPPort *port, int *idvendors, int *idproducts, int count);
 int gp_port_usb_clear_halt  (GPPort *port, int ep);
 int gp_port_usb_msg_write   (GPPort *port, int request, int value,
 			     int index, char *bytes, int size);
@@ -64,6 +64,35 @@ typedef struct {
 static LogFunc *log_funcs = NULL;
 static unsigned int log_funcs_count = 0;
 
+/** Highest level any log function wants, -1 if there is none. */
+static int log_max_level = -1;
+
+/**
+ * \brief Internal per domain log level.
+ *
+ * Messages from domains starting with prefix are passed on only up to
+ * level. Use gp_log_set_domain_level() to set it.
+ */
+typedef struct {
+	char        *prefix;	/**< Internal domain prefix */
+	size_t       len;	/**< Internal length of prefix */
+	GPLogLevel   level;	/**< Internal loglevel */
+} LogDomain;
+
+static LogDomain *log_domains = NULL;
+static unsigned int log_domains_count = 0;
+
+static void
+gp_log_update_max_level (void)
+{
+	unsigned int i;
+
+	log_max_level = -1;
+	for (i = 0; i < log_funcs_count; i++)
+		if ((int)log_funcs[i].level > log_max_level)
+			log_max_level = log_funcs[i].level;
+}
+
 /**
  * \brief Add a function to get logging information
  *
@@ -101,6 +130,7 @@ gp_log_add_func (GPLogLevel level, GPLogFunc func, void *data)
 	log_funcs[log_funcs_count - 1].level = level;
 	log_funcs[log_funcs_count - 1].func = func;
 	log_funcs[log_funcs_count - 1].data = data;
+	gp_log_update_max_level ();
 
 	return (log_funcs_count);
 }
@@ -119,12 +149,88 @@ gp_log_remove_func (int id)
 	if (id < 1 || id > log_funcs_count)
 		return (GP_ERROR_BAD_PARAMETERS);
 
-	memmove (log_funcs + id - 1, log_funcs + id, log_funcs_count - id);
+	memmove (log_funcs + id - 1, log_funcs + id,
+		 sizeof (LogFunc) * (log_funcs_count - id));
 	log_funcs_count--;
+	gp_log_update_max_level ();
+
+	return (GP_OK);
+}
+
+/**
+ * \brief Limit the logging of a domain
+ * \param domain the start of the domains to limit, like "ptp2" or "gphoto2-port"
+ * \param level the maximum level of logging passed on for these domains
+ *
+ * Messages from all domains starting with domain are passed on to the log
+ * functions only up to and including level, and are not even formatted
+ * otherwise. If several limits match a domain, the longest one counts.
+ * Setting a limit for the same domain again replaces it; use #GP_LOG_ALL
+ * to lift it.
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_log_set_domain_level (const char *domain, GPLogLevel level)
+{
+	LogDomain *new_log_domains;
+	unsigned int i;
+
+	if (!domain)
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	for (i = 0; i < log_domains_count; i++)
+		if (!strcmp (log_domains[i].prefix, domain)) {
+			log_domains[i].level = level;
+			return (GP_OK);
+		}
+
+	new_log_domains = realloc (log_domains, sizeof (LogDomain) *
+				   (log_domains_count + 1));
+	if (!new_log_domains)
+		return (GP_ERROR_NO_MEMORY);
+	log_domains = new_log_domains;
+
+	log_domains[log_domains_count].prefix = strdup (domain);
+	if (!log_domains[log_domains_count].prefix)
+		return (GP_ERROR_NO_MEMORY);
+	log_domains[log_domains_count].len = strlen (domain);
+	log_domains[log_domains_count].level = level;
+	log_domains_count++;
 
 	return (GP_OK);
 }
 
+/**
+ * \brief Tell whether a message would be logged
+ * \param level gphoto2 log level
+ * \param domain the log domain
+ *
+ * Checks whether any log function wants messages of the given level from
+ * the given domain. Use it to skip preparing expensive log output.
+ *
+ * \return 1 if the message would be logged, 0 otherwise
+ **/
+int
+gp_log_is_enabled (GPLogLevel level, const char *domain)
+{
+	unsigned int i;
+	size_t best = 0;
+	int limit = -1;
+
+	if ((int)level > log_max_level)
+		return 0;
+	if (!domain)
+		return 1;
+	for (i = 0; i < log_domains_count; i++)
+		if ((log_domains[i].len >= best) &&
+		    !strncmp (domain, log_domains[i].prefix, log_domains[i].len)) {
+			best = log_domains[i].len;
+			limit = log_domains[i].level;
+		}
+	return (limit < 0) || ((int)level <= limit);
+}
+
 /**
  * Width of offset field in characters. Note that HEXDUMP_COMPLETE_LINE 
  * needs to be changed when this value is changed.
@@ -186,6 +292,9 @@ gp_log_data (const char *domain, const char *data, unsigned int size)
 	int index;
 	unsigned char value;
 
+	if (!gp_log_is_enabled (GP_LOG_DATA, domain))
+		return;
+
 	if (!data) {
 		gp_log (GP_LOG_DATA, domain, _("No hexdump (NULL buffer)"));
 		return;
@@ -268,15 +377,14 @@ gp_logv (GPLogLevel level, const char *domain, const char *format,
 #else
 #define xargs args
 #endif
-	int strsize = 1000;
-	char *str;
+	char buf[1000];
+	int strsize = sizeof (buf);
+	char *str = buf;
 	int n;
 
-	if (!log_funcs_count)
+	if (!gp_log_is_enabled (level, domain))
 		return;
 
-	str = malloc(strsize);
-	if (!str) return;
 #ifdef HAVE_VA_COPY
 	va_copy (xargs, args);
 #endif
@@ -285,7 +393,6 @@ gp_logv (GPLogLevel level, const char *domain, const char *format,
 	va_end(xargs);
 #endif
 	if (n+1>strsize) {
-		free (str);
 		str = malloc(n+1);
 		if (!str) {
 			va_end(args);
@@ -304,7 +411,8 @@ gp_logv (GPLogLevel level, const char *domain, const char *format,
 	for (i = 0; i < log_funcs_count; i++)
 		if (log_funcs[i].level >= level)
 			log_funcs[i].func (level, domain, str, log_funcs[i].data);
-	free (str);
+	if (str != buf)
+		free (str);
 }
 
 /**
@@ -341,6 +449,12 @@ gp_log (GPLogLevel level, const char *domain, const char *format, ...)
 #ifdef gp_log_remove_func
 #undef gp_log_remove_func
 #endif
+#ifdef gp_log_set_domain_level
+#undef gp_log_set_domain_level
+#endif
+#ifdef gp_log_is_enabled
+#undef gp_log_is_enabled
+#endif
 #ifdef gp_log_data
 #undef gp_log_data
 #endif
@@ -363,6 +477,18 @@ gp_log_remove_func (int id)
 	return 0;
 }
 
+int
+gp_log_set_domain_level (const char *domain, GPLogLevel level)
+{
+	return 0;
+}
+
+int
+gp_log_is_enabled (GPLogLevel level, const char *domain)
+{
+	return 0;
+}
+
 void
 gp_log_data (const char *domain, const char *data, unsigned int size)
 {
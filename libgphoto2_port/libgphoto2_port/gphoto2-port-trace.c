@@ -0,0 +1,349 @@
+/** \file gphoto2-port-trace.c
+ *
+ * \author Copyright 2013 The gPhoto Developers
+ *
+ * \par License
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * \par
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * \par
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define _BSD_SOURCE
+
+#include "config.h"
+#include <gphoto2/gphoto2-port-trace.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+#endif
+
+#include <gphoto2/gphoto2-port-result.h>
+
+/*
+ * The trace is a ring of GP_TRACE_RECORDS slots shared by all threads.
+ * A writer claims the next slot number with an atomic increment, marks
+ * the slot as busy, fills it in and then stores the slot number + 1 as
+ * its sequence. Readers copy a slot and only keep the copy if the
+ * sequence was the expected one before and after copying, so they never
+ * block writers and never return a half written record.
+ */
+#ifdef HAVE_SYNC_FETCH_AND_ADD
+#  define TRACE_FETCH_ADD(p,v)	__sync_fetch_and_add ((p), (v))
+#  define TRACE_BARRIER()	__sync_synchronize ()
+#  define TRACE_LOCK()
+#  define TRACE_UNLOCK()
+#else
+/* no atomics: writers and readers take turns on a lock instead */
+#  define TRACE_FETCH_ADD(p,v)	((*(p) += (v)) - (v))
+#  define TRACE_BARRIER()
+#  ifdef HAVE_LIBPTHREAD
+#    include <pthread.h>
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+#    define TRACE_LOCK()	pthread_mutex_lock (&trace_lock)
+#    define TRACE_UNLOCK()	pthread_mutex_unlock (&trace_lock)
+#  else
+#    define TRACE_LOCK()
+#    define TRACE_UNLOCK()
+#  endif
+#endif
+
+typedef struct {
+	volatile unsigned long	seq;	/* slot number + 1, 0 while written */
+	GPTraceRecord		record;
+} TraceSlot;
+
+static TraceSlot trace_ring[GP_TRACE_RECORDS];
+static unsigned long trace_next = 0;
+static int trace_enabled = 1;
+
+/* the dump format: a header (magic, version, record size, number of
+ * records, 4 reserved bytes) followed by fixed size little endian records */
+#define TRACE_MAGIC		"GPTR"
+#define TRACE_VERSION		1
+#define TRACE_HEADER_SIZE	16
+#define TRACE_RECORD_SIZE	32
+
+/**
+ * \brief Current time of the trace clock
+ *
+ * \return microseconds of a monotonic clock
+ **/
+uint64_t
+gp_trace_now (void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if (!clock_gettime (CLOCK_MONOTONIC, &ts))
+		return ((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+	{
+		struct timeval tv;
+
+		gettimeofday (&tv, NULL);
+		return ((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+	}
+}
+
+/**
+ * \brief Add a record to the trace
+ *
+ * \param record the record, with time set to gp_trace_now() at the start
+ *	of the operation
+ *
+ * Fills in the duration of the record and stores it in the trace. Where
+ * atomic operations are available this does not lock, and it is cheap
+ * enough to be done for every transfer.
+ **/
+void
+gp_trace_add (GPTraceRecord *record)
+{
+	unsigned long n;
+	TraceSlot *slot;
+
+	if (!trace_enabled || !record)
+		return;
+	record->duration = (uint32_t)(gp_trace_now () - record->time);
+
+	TRACE_LOCK ();
+	n = TRACE_FETCH_ADD (&trace_next, 1);
+	slot = &trace_ring[n % GP_TRACE_RECORDS];
+	slot->seq = 0;
+	TRACE_BARRIER ();
+	slot->record = *record;
+	TRACE_BARRIER ();
+	slot->seq = n + 1;
+	TRACE_UNLOCK ();
+}
+
+/**
+ * \brief Switch tracing on or off
+ *
+ * \param enable 0 to stop recording, 1 to record again
+ *
+ * Tracing is on by default. Switching it off keeps the records so far.
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_trace_enable (int enable)
+{
+	trace_enabled = enable ? 1 : 0;
+	return (GP_OK);
+}
+
+/**
+ * \brief Copy the latest records of the trace
+ *
+ * \param records room for max records
+ * \param max the number of records wanted
+ *
+ * Copies up to max of the latest records, oldest first. Records being
+ * written at the same time are left out.
+ *
+ * \return the number of records copied or a gphoto2 error code
+ **/
+int
+gp_trace_snapshot (GPTraceRecord *records, int max)
+{
+	unsigned long end, n, seq;
+	TraceSlot *slot;
+	int count = 0;
+
+	if (!records || (max < 0))
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	TRACE_LOCK ();
+	end = TRACE_FETCH_ADD (&trace_next, 0);
+	n = (end > GP_TRACE_RECORDS) ? end - GP_TRACE_RECORDS : 0;
+	if (end - n > (unsigned long)max)
+		n = end - max;
+	for (; n < end; n++) {
+		slot = &trace_ring[n % GP_TRACE_RECORDS];
+		seq = slot->seq;
+		TRACE_BARRIER ();
+		records[count] = slot->record;
+		TRACE_BARRIER ();
+		if ((seq != n + 1) || (slot->seq != seq))
+			continue;
+		count++;
+	}
+	TRACE_UNLOCK ();
+	return (count);
+}
+
+static void
+trace_put16 (unsigned char *p, uint16_t v)
+{
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static void
+trace_put32 (unsigned char *p, uint32_t v)
+{
+	trace_put16 (p, v & 0xffff);
+	trace_put16 (p + 2, v >> 16);
+}
+
+static uint16_t
+trace_get16 (const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+trace_get32 (const unsigned char *p)
+{
+	return trace_get16 (p) | ((uint32_t)trace_get16 (p + 2) << 16);
+}
+
+/**
+ * \brief Dump the trace in binary form
+ *
+ * \param data the dump, to be freed by the caller
+ * \param size the size of the dump
+ *
+ * Writes all records of the trace into a compact, byte order independent
+ * format that can be read back with gp_trace_decode(), also on another
+ * machine.
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_trace_dump (char **data, unsigned long *size)
+{
+	GPTraceRecord *records;
+	unsigned char *buf, *p;
+	int i, count;
+
+	if (!data || !size)
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	records = malloc (sizeof (GPTraceRecord) * GP_TRACE_RECORDS);
+	if (!records)
+		return (GP_ERROR_NO_MEMORY);
+	count = gp_trace_snapshot (records, GP_TRACE_RECORDS);
+	buf = calloc (1, TRACE_HEADER_SIZE + count * TRACE_RECORD_SIZE);
+	if (!buf) {
+		free (records);
+		return (GP_ERROR_NO_MEMORY);
+	}
+
+	memcpy (buf, TRACE_MAGIC, 4);
+	trace_put16 (buf + 4, TRACE_VERSION);
+	trace_put16 (buf + 6, TRACE_RECORD_SIZE);
+	trace_put32 (buf + 8, count);
+	/* buf + 12 is reserved */
+	for (i = 0, p = buf + TRACE_HEADER_SIZE; i < count; i++, p += TRACE_RECORD_SIZE) {
+		trace_put32 (p, records[i].time & 0xffffffff);
+		trace_put32 (p + 4, records[i].time >> 32);
+		trace_put32 (p + 8, records[i].duration);
+		trace_put32 (p + 12, records[i].size);
+		trace_put32 (p + 16, records[i].result);
+		trace_put32 (p + 20, records[i].transaction);
+		trace_put16 (p + 24, records[i].op);
+		trace_put16 (p + 26, records[i].code);
+		p[28] = records[i].endpoint;
+	}
+	free (records);
+
+	*data = (char *)buf;
+	*size = TRACE_HEADER_SIZE + count * TRACE_RECORD_SIZE;
+	return (GP_OK);
+}
+
+/**
+ * \brief Read back a dump of the trace
+ *
+ * \param data a dump written by gp_trace_dump()
+ * \param size the size of the dump
+ * \param records the records, to be freed by the caller
+ * \param count the number of records
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_trace_decode (const char *data, unsigned long size,
+		 GPTraceRecord **records, int *count)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned int recsize, n, i;
+
+	if (!data || !records || !count)
+		return (GP_ERROR_BAD_PARAMETERS);
+	if ((size < TRACE_HEADER_SIZE) || memcmp (p, TRACE_MAGIC, 4))
+		return (GP_ERROR_BAD_PARAMETERS);
+	/* later versions may only grow the records */
+	recsize = trace_get16 (p + 6);
+	n = trace_get32 (p + 8);
+	if ((recsize < TRACE_RECORD_SIZE) ||
+	    (n > (size - TRACE_HEADER_SIZE) / recsize))
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	*records = calloc (n ? n : 1, sizeof (GPTraceRecord));
+	if (!*records)
+		return (GP_ERROR_NO_MEMORY);
+	for (i = 0, p += TRACE_HEADER_SIZE; i < n; i++, p += recsize) {
+		(*records)[i].time = trace_get32 (p) |
+				     ((uint64_t)trace_get32 (p + 4) << 32);
+		(*records)[i].duration = trace_get32 (p + 8);
+		(*records)[i].size = trace_get32 (p + 12);
+		(*records)[i].result = (int32_t)trace_get32 (p + 16);
+		(*records)[i].transaction = trace_get32 (p + 20);
+		(*records)[i].op = trace_get16 (p + 24);
+		(*records)[i].code = trace_get16 (p + 26);
+		(*records)[i].endpoint = p[28];
+	}
+	*count = n;
+	return (GP_OK);
+}
+
+/**
+ * \brief Name of a traced operation
+ *
+ * \param op a #GPTraceOp
+ *
+ * \return a short name like "read" or "ptp-request"
+ **/
+const char *
+gp_trace_op_name (GPTraceOp op)
+{
+	switch (op) {
+	case GP_TRACE_PORT_READ:	return "read";
+	case GP_TRACE_PORT_READ_QUEUED:	return "read-queued";
+	case GP_TRACE_PORT_WRITE:	return "write";
+	case GP_TRACE_PORT_CHECK_INT:	return "check-int";
+	case GP_TRACE_PTP_TRANSACTION:	return "ptp-transaction";
+	case GP_TRACE_PTP_REQUEST:	return "ptp-request";
+	case GP_TRACE_PTP_DATA_OUT:	return "ptp-data-out";
+	case GP_TRACE_PTP_DATA_IN:	return "ptp-data-in";
+	case GP_TRACE_PTP_RESPONSE:	return "ptp-response";
+	case GP_TRACE_PTP_EVENT:	return "ptp-event";
+	default:			return "none";
+	}
+}
+
+
+/*
+ * Local Variables:
+ * c-file-style:"linux"
+ * indent-tabs-mode:t
+ * End:
+ */
@@ -33,10 +33,14 @@
 #include <string.h>
 
 #include <ltdl.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include <gphoto2/gphoto2-port-result.h>
 #include <gphoto2/gphoto2-port-library.h>
 #include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-port-trace.h>
 
 #include "gphoto2-port-info.h"
 
@@ -70,6 +74,11 @@ struct _GPPortPrivateCore {
 	struct _GPPortInfo info;	/**< Internal port information of this port. */
 	GPPortOperations *ops;	/**< Internal port operations. */
 	lt_dlhandle lh;		/**< Internal libtool library handle. */
+
+	GPPortStats stats;	/**< Internal transfer statistics. */
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t stats_lock;	/**< Internal lock of the statistics. */
+#endif
 };
 
 /**
@@ -102,6 +111,9 @@ gp_port_new (GPPort **port)
 		return (GP_ERROR_NO_MEMORY);
 	}
 	memset ((*port)->pc, 0, sizeof (GPPortPrivateCore));
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init (&(*port)->pc->stats_lock, NULL);
+#endif
 
         return (GP_OK);
 }
@@ -357,6 +369,9 @@ gp_port_free (GPPort *port)
 		if (port->pc->info.path) free (port->pc->info.path);
 		if (port->pc->info.library_filename) free (port->pc->info.library_filename);
 
+#ifdef HAVE_LIBPTHREAD
+		pthread_mutex_destroy (&port->pc->stats_lock);
+#endif
 		free (port->pc);
 		port->pc = NULL;
 	}
@@ -366,6 +381,76 @@ gp_port_free (GPPort *port)
         return GP_OK;
 }
 
+/* Count a transfer in the statistics of the port. */
+static void
+gp_port_count (GPPort *port, GPTraceOp op, int result, uint64_t usec)
+{
+	GPPortStats *stats = &port->pc->stats;
+	unsigned int bucket;
+
+	if (result < 0) {
+		stats->errors++;
+		if (result == GP_ERROR_TIMEOUT)
+			stats->timeouts++;
+	}
+	if (op == GP_TRACE_PORT_WRITE) {
+		stats->writes++;
+		stats->write_usec += usec;
+		if (result > 0)
+			stats->bytes_written += result;
+		return;
+	}
+	if (op == GP_TRACE_PORT_CHECK_INT) {
+		stats->interrupts++;
+		if (result > 0)
+			stats->bytes_interrupt += result;
+		return;
+	}
+	stats->reads++;
+	stats->read_usec += usec;
+	if (result < 0)
+		return;
+	stats->bytes_read += result;
+	for (bucket = 0; (result >>= 1) && (bucket < GP_PORT_STATS_BUCKETS - 1); bucket++)
+		;
+	stats->read_sizes[bucket]++;
+}
+
+/* Record a transfer in the trace and the statistics. */
+static void
+gp_port_trace (GPPort *port, GPTraceOp op, int size, int result,
+	       uint64_t start)
+{
+	GPTraceRecord record;
+
+	memset (&record, 0, sizeof (record));
+	record.time = start;
+	record.op = op;
+	record.size = size;
+	record.result = result;
+	if (port->type == GP_PORT_USB) {
+		switch (op) {
+		case GP_TRACE_PORT_WRITE:
+			record.endpoint = port->settings.usb.outep;
+			break;
+		case GP_TRACE_PORT_CHECK_INT:
+			record.endpoint = port->settings.usb.intep;
+			break;
+		default:
+			record.endpoint = port->settings.usb.inep;
+			break;
+		}
+	}
+	gp_trace_add (&record);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock (&port->pc->stats_lock);
+#endif
+	gp_port_count (port, op, result, gp_trace_now () - start);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock (&port->pc->stats_lock);
+#endif
+}
+
 /**
  * \brief Writes a specified amount of data to a port.
 
@@ -382,6 +467,7 @@ int
 gp_port_write (GPPort *port, const char *data, int size)
 {
 	int retval;
+	uint64_t start;
 
 	gp_log (GP_LOG_DEBUG, "gphoto2-port", _("Writing %i=0x%x byte(s) "
 		"to port..."), size, size);
@@ -393,7 +479,9 @@ gp_port_write (GPPort *port, const char *data, int size)
 
 	/* Check if we wrote all bytes */
 	CHECK_SUPP (port, "write", port->pc->ops->write);
+	start = gp_trace_now ();
 	retval = port->pc->ops->write (port, data, size);
+	gp_port_trace (port, GP_TRACE_PORT_WRITE, size, retval, start);
 	CHECK_RESULT (retval);
 	if ((port->type != GP_PORT_SERIAL) && (retval != size))
 		gp_log (GP_LOG_DEBUG, "gphoto2-port", ngettext("Could only write %i out of %i byte","Could only write %i out of %i bytes",size), retval, size);
@@ -417,6 +505,7 @@ int
 gp_port_read (GPPort *port, char *data, int size)
 {
         int retval;
+	uint64_t start;
 
 	gp_log (GP_LOG_DEBUG, "gphoto2-port", ngettext("Reading %i=0x%x byte from port...","Reading %i=0x%x bytes from port...", size),
 		size, size);
@@ -426,7 +515,54 @@ gp_port_read (GPPort *port, char *data, int size)
 
 	/* Check if we read as many bytes as expected */
 	CHECK_SUPP (port, "read", port->pc->ops->read);
+	start = gp_trace_now ();
 	retval = port->pc->ops->read (port, data, size);
+	gp_port_trace (port, GP_TRACE_PORT_READ, size, retval, start);
+	CHECK_RESULT (retval);
+	if (retval != size)
+		gp_log (GP_LOG_DEBUG, "gphoto2-port", ngettext(
+			"Could only read %i out of %i byte",
+			"Could only read %i out of %i byte(s)", size), retval, size);
+
+	gp_log_data ("gphoto2-port", data, retval);
+
+	return (retval);
+}
+
+/**
+ * \brief Read data from port with several transfers in flight
+ *
+ * \param port a #GPPort
+ * \param data a pointer to an allocated buffer
+ * \param size the number of bytes that should be read
+ *
+ * Like #gp_port_read, but the port library may split the read into
+ * several transfers that are queued at once, so the bus does not idle
+ * between them. The caller must only ask for data the device is known
+ * to send; a short transfer ends the read early.
+ *
+ * Port libraries without queued read support return
+ * #GP_ERROR_NOT_SUPPORTED, callers should fall back to #gp_port_read.
+ *
+ * \return a gphoto2 error code or the amount of data read
+ **/
+int
+gp_port_read_queued (GPPort *port, char *data, int size)
+{
+        int retval;
+	uint64_t start;
+
+	gp_log (GP_LOG_DEBUG, "gphoto2-port", ngettext("Reading %i=0x%x byte queued from port...","Reading %i=0x%x bytes queued from port...", size),
+		size, size);
+
+	CHECK_NULL (port && data);
+	CHECK_INIT (port);
+
+	CHECK_SUPP (port, "read_queued", port->pc->ops->read_queued);
+	start = gp_trace_now ();
+	retval = port->pc->ops->read_queued (port, data, size);
+	if (retval != GP_ERROR_NOT_SUPPORTED)
+		gp_port_trace (port, GP_TRACE_PORT_READ_QUEUED, size, retval, start);
 	CHECK_RESULT (retval);
 	if (retval != size)
 		gp_log (GP_LOG_DEBUG, "gphoto2-port", ngettext(
@@ -455,6 +591,7 @@ int
 gp_port_check_int (GPPort *port, char *data, int size)
 {
         int retval;
+	uint64_t start;
 
 	gp_log (GP_LOG_DEBUG, "gphoto2-port",
 		ngettext(
@@ -467,7 +604,11 @@ gp_port_check_int (GPPort *port, char *data, int size)
 
 	/* Check if we read as many bytes as expected */
 	CHECK_SUPP (port, "check_int", port->pc->ops->check_int);
+	start = gp_trace_now ();
 	retval = port->pc->ops->check_int (port, data, size, port->timeout);
+	/* polling without result would only flush the trace */
+	if ((retval != 0) && (retval != GP_ERROR_TIMEOUT))
+		gp_port_trace (port, GP_TRACE_PORT_CHECK_INT, size, retval, start);
 	CHECK_RESULT (retval);
 	if (retval != size)
 		gp_log (GP_LOG_DEBUG, "gphoto2-port", _("Could only read %i "
@@ -496,13 +637,17 @@ int
 gp_port_check_int_fast (GPPort *port, char *data, int size)
 {
         int retval;
+	uint64_t start;
 
 	CHECK_NULL (port);
 	CHECK_INIT (port);
 
 	/* Check if we read as many bytes as expected */
 	CHECK_SUPP (port, "check_int", port->pc->ops->check_int);
+	start = gp_trace_now ();
 	retval = port->pc->ops->check_int (port, data, size, FAST_TIMEOUT);
+	if ((retval != 0) && (retval != GP_ERROR_TIMEOUT))
+		gp_port_trace (port, GP_TRACE_PORT_CHECK_INT, size, retval, start);
 	CHECK_RESULT (retval);
 
 #ifdef IGNORE_EMPTY_INTR_READS
@@ -562,6 +707,57 @@ gp_port_set_timeout (GPPort *port, int timeout)
         return GP_OK;
 }
 
+/**
+ * \brief Get the transfer statistics of a port
+ *
+ * \param port a #GPPort
+ * \param stats the statistics
+ *
+ * The statistics can be read at any time, also while another thread
+ * is using the port. They are copied under a lock, so the counters
+ * are consistent with each other.
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_port_get_stats (GPPort *port, GPPortStats *stats)
+{
+	CHECK_NULL (port && stats);
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock (&port->pc->stats_lock);
+#endif
+	*stats = port->pc->stats;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock (&port->pc->stats_lock);
+#endif
+
+	return (GP_OK);
+}
+
+/**
+ * \brief Reset the transfer statistics of a port
+ *
+ * \param port a #GPPort
+ *
+ * \return a gphoto2 error code
+ **/
+int
+gp_port_reset_stats (GPPort *port)
+{
+	CHECK_NULL (port);
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock (&port->pc->stats_lock);
+#endif
+	memset (&port->pc->stats, 0, sizeof (GPPortStats));
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock (&port->pc->stats_lock);
+#endif
+
+	return (GP_OK);
+}
+
 /** Deprecated */
 int gp_port_timeout_set (GPPort *, int);
 int gp_port_timeout_set (GPPort *port, int timeout)
@@ -851,6 +1047,31 @@ gp_port_usb_find_device_by_class (GPPort *port, int mainclass, int subclass, int
         return (GP_OK);
 }
 
+/**
+ * \brief List the ids of the attached USB devices
+ *
+ * \param port a GPPort
+ * \param idvendors array receiving the USB vendor ids
+ * \param idproducts array receiving the USB product ids
+ * \param count number of entries in both arrays
+ *
+ * Enumerates the USB devices the port path refers to, that is one
+ * device for "usb:bus,dev" and all attached devices for "usb:".
+ * This allows callers to look up the attached devices instead of
+ * probing the port for every known vendor:product id pair.
+ *
+ * \return the number of devices stored or a gphoto2 error code
+ */
+int
+gp_port_usb_list_device_ids (GPPort *port, int *idvendors, int *idproducts, int count)
+{
+	CHECK_NULL (port && idvendors && idproducts);
+	CHECK_INIT (port);
+
+	CHECK_SUPP (port, "list_device_ids", port->pc->ops->list_device_ids);
+	return (port->pc->ops->list_device_ids (port, idvendors, idproducts, count));
+}
+
 /**
  * \brief Clear USB endpoint HALT condition
  *
@@ -870,6 +1091,13 @@ gp_port_usb_clear_halt (GPPort *port, int ep)
 	CHECK_INIT (port);
 
 	CHECK_SUPP (port, "clear_halt", port->pc->ops->clear_halt);
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock (&port->pc->stats_lock);
+#endif
+	port->pc->stats.clear_halts++;
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock (&port->pc->stats_lock);
+#endif
         CHECK_RESULT (port->pc->ops->clear_halt (port, ep));
 
         return (GP_OK);
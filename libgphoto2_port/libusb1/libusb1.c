@@ -60,6 +60,10 @@
 
 #define CHECK(result) {int r=(result); if (r<0) return (r);}
 
+/* Queued bulk reads: number of transfers kept in flight and their size */
+#define QUEUE_DEPTH	8
+#define QUEUE_CHUNK	64*1024
+
 struct _GPPortPrivateLibrary {
 	libusb_context *ctx;
 	libusb_device *d;
@@ -479,6 +483,123 @@ gp_port_usb_read(GPPort *port, char *bytes, int size)
         return curread;
 }
 
+static void LIBUSB_CALL
+gp_port_usb_queued_cb (struct libusb_transfer *transfer)
+{
+	*(int*)transfer->user_data = 1;
+}
+
+static int
+gp_port_usb_read_queued(GPPort *port, char *bytes, int size)
+{
+	struct libusb_transfer	*xfers[QUEUE_DEPTH];
+	int			completed[QUEUE_DEPTH];
+	int			i, nrofchunks, next, done, curread = 0, ret = GP_OK;
+
+	if (!port || !port->pl->dh || (size < 0)) {
+		gp_log (GP_LOG_ERROR, "libusb1", "gp_port_usb_read_queued: bad parameters");
+		return GP_ERROR_BAD_PARAMETERS;
+	}
+
+	nrofchunks = (size + QUEUE_CHUNK - 1) / QUEUE_CHUNK;
+	memset (xfers, 0, sizeof(xfers));
+	for (i = 0; i < QUEUE_DEPTH; i++) {
+		xfers[i] = libusb_alloc_transfer (0);
+		if (!xfers[i]) {
+			ret = GP_ERROR_NO_MEMORY;
+			goto out;
+		}
+	}
+
+	/* Transfer n reads chunk n into slot n % QUEUE_DEPTH. Completed
+	 * chunks are consumed in submission order, and the freed slot is
+	 * immediately reused for the next chunk still to be read. */
+	gp_log (GP_LOG_DEBUG, "libusb1", "queued read of %d bytes in %d transfers, timeout %d", size, nrofchunks, port->timeout);
+	for (next = 0; (next < nrofchunks) && (next < QUEUE_DEPTH); next++) {
+		int len = size - next*QUEUE_CHUNK;
+
+		if (len > QUEUE_CHUNK)
+			len = QUEUE_CHUNK;
+		completed[next] = 0;
+		libusb_fill_bulk_transfer (xfers[next], port->pl->dh, port->settings.usb.inep,
+			(unsigned char*)bytes + next*QUEUE_CHUNK, len,
+			gp_port_usb_queued_cb, &completed[next], port->timeout);
+		if (libusb_submit_transfer (xfers[next]) < 0) {
+			completed[next] = 1;
+			ret = GP_ERROR_IO_READ;
+			break;
+		}
+	}
+	done = 0;
+	while ((ret == GP_OK) && (done < next)) {
+		struct libusb_transfer	*xfer = xfers[done % QUEUE_DEPTH];
+		int			*xferdone = &completed[done % QUEUE_DEPTH];
+
+		while (!*xferdone) {
+			if (libusb_handle_events_completed (port->pl->ctx, xferdone) < 0) {
+				ret = GP_ERROR_IO_READ;
+				break;
+			}
+		}
+		if (ret != GP_OK)
+			break;
+		done++;
+		if (xfer->status != LIBUSB_TRANSFER_COMPLETED) {
+			gp_log (GP_LOG_DEBUG, "libusb1", "transfer %d failed with status %d", done-1, xfer->status);
+			if (xfer->status == LIBUSB_TRANSFER_TIMED_OUT)
+				ret = GP_ERROR_TIMEOUT;
+			else
+				ret = GP_ERROR_IO_READ;
+			break;
+		}
+		curread += xfer->actual_length;
+		/* A short transfer ends the data phase, do not wait for more. */
+		if (xfer->actual_length < xfer->length)
+			break;
+		if (next < nrofchunks) {
+			int len = size - next*QUEUE_CHUNK;
+
+			if (len > QUEUE_CHUNK)
+				len = QUEUE_CHUNK;
+			*xferdone = 0;
+			libusb_fill_bulk_transfer (xfer, port->pl->dh, port->settings.usb.inep,
+				(unsigned char*)bytes + next*QUEUE_CHUNK, len,
+				gp_port_usb_queued_cb, xferdone, port->timeout);
+			if (libusb_submit_transfer (xfer) < 0) {
+				*xferdone = 1;
+				ret = GP_ERROR_IO_READ;
+				break;
+			}
+			next++;
+		}
+	}
+
+	/* Cancel and reap whatever is still in flight after an error or
+	 * a short read, the transfers must not outlive this call. */
+	for (; done < next; done++) {
+		int *xferdone = &completed[done % QUEUE_DEPTH];
+
+		if (*xferdone)
+			continue;
+		libusb_cancel_transfer (xfers[done % QUEUE_DEPTH]);
+		while (!*xferdone) {
+			if (libusb_handle_events_completed (port->pl->ctx, xferdone) < 0) {
+				/* still owned by libusb, leak it rather than free it */
+				xfers[done % QUEUE_DEPTH] = NULL;
+				break;
+			}
+		}
+	}
+out:
+	for (i = 0; i < QUEUE_DEPTH; i++)
+		if (xfers[i])
+			libusb_free_transfer (xfers[i]);
+	gp_log (GP_LOG_DEBUG, "libusb1", "queued read ret = %d, read %d", ret, curread);
+	if (ret < GP_OK)
+		return ret;
+	return curread;
+}
+
 static int
 gp_port_usb_reset(GPPort *port)
 {
@@ -1278,6 +1399,39 @@ gp_port_usb_find_device_by_class_lib(GPPort *port, int class, int subclass, int
 	return GP_ERROR_IO_USB_FIND;
 }
 
+static int
+gp_port_usb_list_device_ids_lib(GPPort *port, int *idvendors, int *idproducts, int count)
+{
+	char *s;
+	int d, n = 0, busnr = 0, devnr = 0;
+	GPPortPrivateLibrary *pl;
+
+	if (!port)
+		return (GP_ERROR_BAD_PARAMETERS);
+
+	pl = port->pl;
+
+	s = strchr (port->settings.usb.port,':');
+	if (s && (s[1] != '\0')) { /* usb:%d,%d */
+		if (sscanf (s+1, "%d,%d", &busnr, &devnr) != 2) {
+			devnr = 0;
+			sscanf (s+1, "%d", &busnr);
+		}
+	}
+
+	pl->nrofdevs = load_devicelist (port->pl);
+	for (d = 0; (d < pl->nrofdevs) && (n < count); d++) {
+		if (busnr && (busnr != libusb_get_bus_number (pl->devs[d])))
+			continue;
+		if (devnr && (devnr != libusb_get_device_address (pl->devs[d])))
+			continue;
+		idvendors[n]  = pl->descs[d].idVendor;
+		idproducts[n] = pl->descs[d].idProduct;
+		n++;
+	}
+	return n;
+}
+
 GPPortOperations *
 gp_port_library_operations (void)
 {
@@ -1293,6 +1447,7 @@ gp_port_library_operations (void)
 	ops->open   = gp_port_usb_open;
 	ops->close  = gp_port_usb_close;
 	ops->read   = gp_port_usb_read;
+	ops->read_queued = gp_port_usb_read_queued;
 	ops->reset  = gp_port_usb_reset;
 	ops->write  = gp_port_usb_write;
 	ops->check_int = gp_port_usb_check_int;
@@ -1306,6 +1461,7 @@ gp_port_library_operations (void)
 	ops->msg_class_read   = gp_port_usb_msg_class_read_lib;
 	ops->find_device = gp_port_usb_find_device_lib;
 	ops->find_device_by_class = gp_port_usb_find_device_by_class_lib;
+	ops->list_device_ids = gp_port_usb_list_device_ids_lib;
 
 	return (ops);
 }
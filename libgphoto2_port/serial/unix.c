@@ -200,9 +200,19 @@
 
 #define GP_MODULE "serial"
 
+/* Size of the receive buffer, see gp_port_serial_read */
+#define SERIAL_BUFFER_SIZE 4096
+
 struct _GPPortPrivateLibrary {
 	int fd;       /* Device handle */
 	int baudrate; /* Current speed */
+
+	/* Received bytes not yet passed to the caller */
+	unsigned char buf[SERIAL_BUFFER_SIZE];
+	int buf_start, buf_end;
+
+	/* Position within a PARMRK sequence split between two reads */
+	int parmrk;
 };
 
 static int gp_port_serial_check_speed (GPPort *dev);
@@ -486,6 +496,8 @@ gp_port_serial_close (GPPort *dev)
 	        }
 		dev->pl->fd = 0;
 	}
+	dev->pl->buf_start = dev->pl->buf_end = 0;
+	dev->pl->parmrk = 0;
 
 	/* Unlock the port */
 	path = strchr (dev->settings.serial.port, ':');
@@ -556,12 +568,76 @@ gp_port_serial_write (GPPort *dev, const char *bytes, int size)
 }
 
 
+/*
+ * With parity checking on, the tty marks a byte that failed the check
+ * as 0xff 0x00 <byte> and escapes a received 0xff as 0xff 0xff (see
+ * PARMRK in man tcsetattr). Decodes len received bytes in place and
+ * returns how many are left. Sequences may be split between two reads,
+ * pl->parmrk remembers how far we got into one.
+ */
+static int
+gp_port_serial_unmark (GPPort *dev, unsigned char *data, int len,
+		       int *errors)
+{
+	unsigned char *r = data, *w = data, *end = data + len, *ff;
+
+	while (r < end) {
+		switch (dev->pl->parmrk) {
+		case 0:
+			/* copy everything up to the next mark at once */
+			ff = memchr (r, 0xff, end - r);
+			if (!ff)
+				ff = end;
+			if (w != r)
+				memmove (w, r, ff - r);
+			w += ff - r;
+			r = ff;
+			if (r < end) {
+				dev->pl->parmrk = 1;
+				r++;
+			}
+			break;
+		case 1:
+			if (*r == 0xff) {
+				/* Ok, the camera sent 0xff */
+				*w++ = 0xff;
+				dev->pl->parmrk = 0;
+			} else if (*r == 0x00) {
+				dev->pl->parmrk = 2;
+			} else {
+				gp_port_set_error (dev, _("Unexpected parity "
+					"response sequence 0xff 0x%02x."), *r);
+				(*errors)++;
+				dev->pl->parmrk = 0;
+			}
+			r++;
+			break;
+		default:
+			/* drop the byte that failed the parity check */
+			gp_port_set_error (dev, _("Parity error."));
+			(*errors)++;
+			dev->pl->parmrk = 0;
+			r++;
+			break;
+		}
+	}
+
+	return (w - data);
+}
+
+/*
+ * Reads are served from a buffer that is refilled with everything the
+ * tty has got with a single read(2), so the many small reads of the
+ * serial drivers rarely need a system call. Large reads without parity
+ * checking bypass the buffer.
+ */
 static int
 gp_port_serial_read (GPPort *dev, char *bytes, int size)
 {
+	GPPortPrivateLibrary *pl;
         struct timeval timeout;
         fd_set readfs;          /* file descriptor set */
-        int readen = 0, now;
+        int readen = 0, now, errors, direct;
 
 	if (!dev)
 		return (GP_ERROR_BAD_PARAMETERS);
@@ -573,64 +649,58 @@ gp_port_serial_read (GPPort *dev, char *bytes, int size)
 	/* Make sure we are operating at the specified speed */
 	CHECK (gp_port_serial_check_speed (dev));
 
-        FD_ZERO (&readfs);
-        FD_SET (dev->pl->fd, &readfs);
-
+	pl = dev->pl;
         while (readen < size) {
 
+		/* Anything left from the last read? */
+		if (pl->buf_start < pl->buf_end) {
+			now = pl->buf_end - pl->buf_start;
+			if (now > size - readen)
+				now = size - readen;
+			memcpy (bytes + readen, pl->buf + pl->buf_start, now);
+			pl->buf_start += now;
+			readen += now;
+			continue;
+		}
+		pl->buf_start = pl->buf_end = 0;
+
 		/* Set timeout value within input loop */
                 timeout.tv_usec = (dev->timeout % 1000) * 1000;
                 timeout.tv_sec = (dev->timeout / 1000); 
 
 		/* Any data available? */
-                if (!select (dev->pl->fd + 1, &readfs, NULL, NULL, &timeout))
-                        return GP_ERROR_TIMEOUT;
-		if (!FD_ISSET (dev->pl->fd, &readfs))
+		FD_ZERO (&readfs);
+		FD_SET (pl->fd, &readfs);
+		now = select (pl->fd + 1, &readfs, NULL, NULL, &timeout);
+		if ((now < 0) && (errno == EINTR))
+			continue;
+		if ((now <= 0) || !FD_ISSET (pl->fd, &readfs))
 			return (GP_ERROR_TIMEOUT);
 
-		if (dev->settings.serial.parity != GP_PORT_SERIAL_PARITY_OFF) {
-		    unsigned char ffchar[1];
-		    unsigned char nullchar[1];
-
-		    ffchar[0] = 0xff;
-		    nullchar[0] = 0;
-		    now = read (dev->pl->fd, bytes, 1);
-		    if (now < 0)
-			    return GP_ERROR_IO_READ;
-		    if (!memcmp(bytes,ffchar,1)) {
-			now = read (dev->pl->fd, bytes, 1);
-			if (now < 0)
-				return GP_ERROR_IO_READ;
-
-			/* Parity errors are signaled by the serial layer
-			 * as 0xff 0x00 sequence.
-			 *
-			 * 0xff sent by the camera are escaped as
-			 * 0xff 0xff sequence. 
-			 *
-			 * All other 0xff 0xXX sequences are errors.
-			 *
-			 * cf. man tcsetattr, description of PARMRK.
-			 */
-			if (!memcmp(bytes,nullchar,1)) {
-			    gp_port_set_error (dev, _("Parity error."));
-			    return GP_ERROR_IO_READ;
-			}
-			if (!memcmp(bytes,ffchar,1)) {
-			    gp_port_set_error (dev, _("Unexpected parity response sequence 0xff 0x%02x."), ((unsigned char*)bytes)[0]);
-			    return GP_ERROR_IO_READ;
-			}
-			/* Ok, we read 1 byte and it is 0xff */
-			/* FALLTHROUGH */
-		    }
-		} else {
-		    /* Just read the bytes */
-		    now = read (dev->pl->fd, bytes, size - readen);
-		    if (now < 0)
-			    return GP_ERROR_IO_READ;
+		direct = (dev->settings.serial.parity == GP_PORT_SERIAL_PARITY_OFF) &&
+			 (size - readen >= SERIAL_BUFFER_SIZE);
+		if (direct)
+			now = read (pl->fd, bytes + readen, size - readen);
+		else
+			now = read (pl->fd, pl->buf, SERIAL_BUFFER_SIZE);
+		if ((now < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+			continue;
+		if (now <= 0)
+			return GP_ERROR_IO_READ;
+
+		if (direct) {
+			readen += now;
+			continue;
+		}
+		if (dev->settings.serial.parity == GP_PORT_SERIAL_PARITY_OFF) {
+			pl->buf_end = now;
+			continue;
 		}
-		bytes += now;
-		readen += now;
+
+		errors = 0;
+		pl->buf_end = gp_port_serial_unmark (dev, pl->buf, now, &errors);
+		if (errors)
+			return GP_ERROR_IO_READ;
         }
 
         return readen;
@@ -744,6 +814,12 @@ gp_port_serial_flush (GPPort *dev, int direction)
 	/* Make sure we are operating at the specified speed */
 	CHECK (gp_port_serial_check_speed (dev));
 
+	/* Received but not yet read bytes go as well */
+	if (!direction) {
+		dev->pl->buf_start = dev->pl->buf_end = 0;
+		dev->pl->parmrk = 0;
+	}
+
 #ifdef HAVE_TERMIOS_H
 	if (tcflush (dev->pl->fd, direction ? TCOFLUSH : TCIFLUSH) < 0) {
 		int saved_errno = errno;
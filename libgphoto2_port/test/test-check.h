@@ -0,0 +1,39 @@
+/* test-check.h
+ *
+ * Copyright (C) 2013 The gPhoto Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks shared by the tests, each one fails the test from the function
+ * it is used in by returning 1.
+ */
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+
+#include <gphoto2/gphoto2-port-result.h>
+
+/* automake's exit code for skipped tests */
+#define SKIP 77
+
+#define CHECK(f) {int r = (f); if (r < 0) { printf ("%s:%i: %s failed: %s\n", __FILE__, __LINE__, #f, gp_port_result_as_string (r)); return (1); }}
+#define ASSERT(c) {if (!(c)) { printf ("%s:%i: %s does not hold\n", __FILE__, __LINE__, #c); return (1); }}
+
+#endif /* TEST_CHECK_H */
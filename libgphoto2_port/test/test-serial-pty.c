@@ -0,0 +1,196 @@
+/* test-serial-pty.c
+ *
+ * Copyright (C) 2013 The gPhoto Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Drives the serial port driver over a pseudo terminal: the test plays
+ * the camera on the master side, the port is opened on the slave side.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-port.h>
+#include <gphoto2/gphoto2-port-result.h>
+#include <gphoto2/gphoto2-port-info-list.h>
+
+#include "test-check.h"
+
+static int master = -1;
+
+static int
+send_bytes (const char *data, int size)
+{
+	int sent, n;
+
+	for (sent = 0; sent < size; sent += n) {
+		n = write (master, data + sent, size - sent);
+		if (n < 0)
+			return (-1);
+	}
+	return (0);
+}
+
+static int
+open_port (GPPort **port, const char *path, GPPortSerialParity parity)
+{
+	GPPortInfoList *il;
+	GPPortInfo info;
+	GPPortSettings settings;
+	char name[128];
+	int n;
+
+	snprintf (name, sizeof (name), "serial:%s", path);
+	CHECK (gp_port_info_list_new (&il));
+	CHECK (gp_port_info_list_load (il));
+	CHECK (n = gp_port_info_list_lookup_path (il, name));
+	CHECK (gp_port_info_list_get_info (il, n, &info));
+	CHECK (gp_port_new (port));
+	CHECK (gp_port_set_info (*port, info));
+	gp_port_info_list_free (il);
+
+	CHECK (gp_port_get_settings (*port, &settings));
+	strcpy (settings.serial.port, name);
+	settings.serial.speed = 115200;
+	settings.serial.bits = 8;
+	settings.serial.parity = parity;
+	settings.serial.stopbits = 1;
+	CHECK (gp_port_set_settings (*port, settings));
+	CHECK (gp_port_set_timeout (*port, 200));
+	CHECK (gp_port_open (*port));
+	/* the tty is only put into raw mode on first use */
+	CHECK (gp_port_flush (*port, 0));
+	return (0);
+}
+
+/* Small reads are served from what one read(2) got */
+static int
+test_small_reads (GPPort *port)
+{
+	char data[100], buf[10];
+	int i, j;
+
+	for (i = 0; i < (int)sizeof (data); i++)
+		data[i] = i;
+	ASSERT (!send_bytes (data, sizeof (data)));
+	for (i = 0; i < 10; i++) {
+		CHECK (gp_port_read (port, buf, sizeof (buf)));
+		for (j = 0; j < 10; j++)
+			ASSERT (buf[j] == data[i * 10 + j]);
+	}
+	return (0);
+}
+
+/* Large reads go around the buffer */
+static int
+test_large_read (GPPort *port)
+{
+	static char data[8192], buf[8192];
+	int i;
+
+	for (i = 0; i < (int)sizeof (data); i++)
+		data[i] = (i * 7) & 0xff;
+	ASSERT (!send_bytes (data, sizeof (data)));
+	ASSERT (gp_port_read (port, buf, 1) == 1);
+	ASSERT (gp_port_read (port, buf + 1, sizeof (buf) - 1) == sizeof (buf) - 1);
+	ASSERT (!memcmp (data, buf, sizeof (data)));
+	return (0);
+}
+
+static int
+test_timeout (GPPort *port)
+{
+	char buf[4];
+
+	ASSERT (!send_bytes ("ab", 2));
+	ASSERT (gp_port_read (port, buf, sizeof (buf)) == GP_ERROR_TIMEOUT);
+	CHECK (gp_port_flush (port, 0));
+	return (0);
+}
+
+/* Flushing the input also drops what is buffered */
+static int
+test_flush (GPPort *port)
+{
+	char buf[1];
+
+	ASSERT (!send_bytes ("abcdef", 6));
+	CHECK (gp_port_read (port, buf, 1));
+	ASSERT (buf[0] == 'a');
+	CHECK (gp_port_flush (port, 0));
+	ASSERT (!send_bytes ("xyz", 3));
+	CHECK (gp_port_read (port, buf, 1));
+	ASSERT (buf[0] == 'x');
+	CHECK (gp_port_flush (port, 0));
+	return (0);
+}
+
+/* With parity on, received 0xff bytes arrive escaped as 0xff 0xff */
+static int
+test_parity_escapes (GPPort *port)
+{
+	static char data[3000], buf[3000];
+	int i;
+
+	for (i = 0; i < (int)sizeof (data); i++)
+		data[i] = (i % 3) ? 0xff : i;
+	ASSERT (!send_bytes (data, sizeof (data)));
+	for (i = 0; i < (int)sizeof (buf); i += 300)
+		ASSERT (gp_port_read (port, buf + i, 300) == 300);
+	ASSERT (!memcmp (data, buf, sizeof (data)));
+	return (0);
+}
+
+int
+main (int argc, char **argv)
+{
+	GPPort *port;
+	const char *path;
+
+	master = posix_openpt (O_RDWR | O_NOCTTY);
+	if ((master < 0) || grantpt (master) || unlockpt (master) ||
+	    !(path = ptsname (master))) {
+		printf ("No pseudo terminals, skipping.\n");
+		return (SKIP);
+	}
+
+	if (open_port (&port, path, GP_PORT_SERIAL_PARITY_OFF) ||
+	    test_small_reads (port) || test_large_read (port) ||
+	    test_timeout (port) || test_flush (port))
+		return (1);
+	CHECK (gp_port_close (port));
+	CHECK (gp_port_free (port));
+
+	if (open_port (&port, path, GP_PORT_SERIAL_PARITY_EVEN) ||
+	    test_small_reads (port) || test_parity_escapes (port) ||
+	    test_flush (port))
+		return (1);
+	CHECK (gp_port_close (port));
+	CHECK (gp_port_free (port));
+
+	close (master);
+	return (0);
+}
@@ -0,0 +1,236 @@
+/* test-trace.c
+ *
+ * Copyright (C) 2013 The gPhoto Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Fills the trace ring with known records and checks what snapshots
+ * return, and that a dump decodes to the same records. Then has several
+ * threads add records at once while snapshots are taken.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_LIBPTHREAD
+#  include <pthread.h>
+#endif
+
+#include <gphoto2/gphoto2-port-trace.h>
+#include <gphoto2/gphoto2-port-result.h>
+
+#include "test-check.h"
+
+/* transaction ids of the records added so far */
+static unsigned int added = 0;
+
+static void
+add_records (unsigned int n)
+{
+	GPTraceRecord r;
+
+	for (; n; n--) {
+		added++;
+		memset (&r, 0, sizeof (r));
+		r.time = gp_trace_now () | ((uint64_t)added << 40);
+		r.size = added * 3;
+		r.result = -(int)added;
+		r.transaction = added;
+		r.op = GP_TRACE_PTP_DATA_IN;
+		r.code = added & 0xffff;
+		r.endpoint = 0x81;
+		gp_trace_add (&r);
+	}
+}
+
+static GPTraceRecord records[GP_TRACE_RECORDS];
+
+/* The latest records come back oldest first */
+static int
+test_snapshot (void)
+{
+	int i, n;
+
+	add_records (10);
+	CHECK (n = gp_trace_snapshot (records, 10));
+	ASSERT (n == 10);
+	for (i = 0; i < n; i++)
+		ASSERT (records[i].transaction == added - 9 + i);
+
+	CHECK (n = gp_trace_snapshot (records, 3));
+	ASSERT (n == 3);
+	for (i = 0; i < n; i++)
+		ASSERT (records[i].transaction == added - 2 + i);
+
+	ASSERT (gp_trace_snapshot (records, 0) == 0);
+	ASSERT (gp_trace_snapshot (NULL, 1) == GP_ERROR_BAD_PARAMETERS);
+	return (0);
+}
+
+/* Older records are overwritten once the ring is full */
+static int
+test_wrap (void)
+{
+	int i, n;
+
+	add_records (GP_TRACE_RECORDS + 10);
+	CHECK (n = gp_trace_snapshot (records, GP_TRACE_RECORDS));
+	ASSERT (n == GP_TRACE_RECORDS);
+	for (i = 0; i < n; i++)
+		ASSERT (records[i].transaction == added - GP_TRACE_RECORDS + 1 + i);
+	return (0);
+}
+
+static int
+test_enable (void)
+{
+	int n;
+
+	CHECK (gp_trace_enable (0));
+	add_records (1);
+	added--;
+	CHECK (gp_trace_enable (1));
+	CHECK (n = gp_trace_snapshot (records, 1));
+	ASSERT ((n == 1) && (records[0].transaction == added));
+	return (0);
+}
+
+static int
+test_dump (void)
+{
+	GPTraceRecord *decoded;
+	unsigned long size;
+	char *data;
+	int i, n, count;
+
+	add_records (100);
+	CHECK (n = gp_trace_snapshot (records, GP_TRACE_RECORDS));
+	CHECK (gp_trace_dump (&data, &size));
+	CHECK (gp_trace_decode (data, size, &decoded, &count));
+	ASSERT (count == n);
+	for (i = 0; i < count; i++) {
+		ASSERT (decoded[i].time == records[i].time);
+		ASSERT (decoded[i].duration == records[i].duration);
+		ASSERT (decoded[i].size == records[i].size);
+		ASSERT (decoded[i].result == records[i].result);
+		ASSERT (decoded[i].transaction == records[i].transaction);
+		ASSERT (decoded[i].op == records[i].op);
+		ASSERT (decoded[i].code == records[i].code);
+		ASSERT (decoded[i].endpoint == records[i].endpoint);
+	}
+	free (decoded);
+
+	/* truncated in the records and in the header */
+	ASSERT (gp_trace_decode (data, size - 1, &decoded, &count) == GP_ERROR_BAD_PARAMETERS);
+	ASSERT (gp_trace_decode (data, 15, &decoded, &count) == GP_ERROR_BAD_PARAMETERS);
+	/* no trace at all */
+	data[0] = 'X';
+	ASSERT (gp_trace_decode (data, size, &decoded, &count) == GP_ERROR_BAD_PARAMETERS);
+	free (data);
+	return (0);
+}
+
+#ifdef HAVE_LIBPTHREAD
+/* writers adding at the same time, all their records have to fit */
+#define THREADS		4
+#define THREAD_RECORDS	1000
+
+static void *
+add_thread_records (void *data)
+{
+	unsigned int thread = (unsigned int)(size_t)data, i;
+	GPTraceRecord r;
+
+	for (i = 1; i <= THREAD_RECORDS; i++) {
+		memset (&r, 0, sizeof (r));
+		r.time = gp_trace_now ();
+		r.size = i * 3;
+		r.result = -(int)i;
+		r.transaction = i;
+		r.op = GP_TRACE_PTP_DATA_OUT;
+		r.code = thread;
+		gp_trace_add (&r);
+	}
+	return (NULL);
+}
+
+/* Records of the threads are whole and in order per thread */
+static int
+check_thread_records (int n, unsigned int *counts)
+{
+	unsigned int last[THREADS];
+	int i;
+
+	memset (last, 0, sizeof (last));
+	for (i = 0; i < n; i++) {
+		if (records[i].op != GP_TRACE_PTP_DATA_OUT)
+			continue;
+		ASSERT (records[i].code < THREADS);
+		ASSERT (records[i].size == records[i].transaction * 3);
+		ASSERT (records[i].result == -(int)records[i].transaction);
+		ASSERT (records[i].transaction > last[records[i].code]);
+		last[records[i].code] = records[i].transaction;
+		if (counts)
+			counts[records[i].code]++;
+	}
+	return (0);
+}
+
+static int
+test_threads (void)
+{
+	pthread_t threads[THREADS];
+	unsigned int counts[THREADS];
+	unsigned int i;
+	int n;
+
+	for (i = 0; i < THREADS; i++)
+		ASSERT (!pthread_create (&threads[i], NULL, add_thread_records,
+					 (void *)(size_t)i));
+	for (i = 0; i < 100; i++) {
+		CHECK (n = gp_trace_snapshot (records, GP_TRACE_RECORDS));
+		if (check_thread_records (n, NULL))
+			return (1);
+	}
+	for (i = 0; i < THREADS; i++)
+		ASSERT (!pthread_join (threads[i], NULL));
+
+	memset (counts, 0, sizeof (counts));
+	CHECK (n = gp_trace_snapshot (records, GP_TRACE_RECORDS));
+	if (check_thread_records (n, counts))
+		return (1);
+	for (i = 0; i < THREADS; i++)
+		ASSERT (counts[i] == THREAD_RECORDS);
+	return (0);
+}
+#endif
+
+int
+main (int argc, char **argv)
+{
+	if (test_snapshot () || test_wrap () || test_enable () ||
+	    test_dump ())
+		return (1);
+#ifdef HAVE_LIBPTHREAD
+	if (test_threads ())
+		return (1);
+#endif
+	return (0);
+}
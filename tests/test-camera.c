@@ -0,0 +1,253 @@
+/* test-camera.c
+ *
+ * Copyright © 2013 The gPhoto Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Runs the core camera functions on a "Directory Browse" camera whose
+ * driver functions are faked: single configuration values that the
+ * driver only knows as part of its complete configuration. Then checks
+ * the metrics of the camera as operations are recorded and files are
+ * read through the file cache.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-camera.h>
+#include <gphoto2/gphoto2-abilities-list.h>
+#include <gphoto2/gphoto2-port-info-list.h>
+#include <gphoto2/gphoto2-result.h>
+
+#include "test-check.h"
+
+#define IMAGE	"test-camera.jpg"
+
+/* "single" can be accessed on its own, "custom" only through the tree */
+static char single[32] = "one", custom[32] = "two";
+static int tree_gets, tree_sets;
+
+static int
+faked_get_config (Camera *camera, CameraWidget **window, GPContext *context)
+{
+	CameraWidget *section, *widget;
+
+	tree_gets++;
+	gp_widget_new (GP_WIDGET_WINDOW, "Configuration", window);
+	gp_widget_new (GP_WIDGET_SECTION, "Settings", &section);
+	gp_widget_append (*window, section);
+	gp_widget_new (GP_WIDGET_TEXT, "Single", &widget);
+	gp_widget_set_name (widget, "single");
+	gp_widget_set_value (widget, single);
+	gp_widget_append (section, widget);
+	gp_widget_new (GP_WIDGET_TEXT, "Custom", &widget);
+	gp_widget_set_name (widget, "custom");
+	gp_widget_set_value (widget, custom);
+	gp_widget_append (section, widget);
+	return (GP_OK);
+}
+
+static int
+faked_set_config (Camera *camera, CameraWidget *window, GPContext *context)
+{
+	CameraWidget *widget;
+	char *value;
+
+	tree_sets++;
+	if ((gp_widget_get_child_by_name (window, "custom", &widget) == GP_OK) &&
+	    gp_widget_changed (widget)) {
+		gp_widget_get_value (widget, &value);
+		strncpy (custom, value, sizeof (custom) - 1);
+	}
+	return (GP_OK);
+}
+
+static int
+faked_get_single_config (Camera *camera, const char *name,
+			 CameraWidget **widget, GPContext *context)
+{
+	if (strcmp (name, "single"))
+		return (GP_ERROR_NOT_SUPPORTED);
+	gp_widget_new (GP_WIDGET_TEXT, "Single", widget);
+	gp_widget_set_name (*widget, "single");
+	gp_widget_set_value (*widget, single);
+	return (GP_OK);
+}
+
+static int
+faked_set_single_config (Camera *camera, const char *name,
+			 CameraWidget *widget, GPContext *context)
+{
+	char *value;
+
+	if (strcmp (name, "single"))
+		return (GP_ERROR_NOT_SUPPORTED);
+	gp_widget_get_value (widget, &value);
+	strncpy (single, value, sizeof (single) - 1);
+	return (GP_OK);
+}
+
+static int
+test_single_config (Camera *camera)
+{
+	CameraWidget *widget;
+	char *value;
+
+	camera->functions->get_config = faked_get_config;
+	camera->functions->set_config = faked_set_config;
+	camera->functions->get_single_config = faked_get_single_config;
+	camera->functions->set_single_config = faked_set_single_config;
+
+	/* Known to the driver on its own, the tree is not needed */
+	CHECK (gp_camera_get_single_config (camera, "single", &widget, NULL));
+	CHECK (gp_widget_get_value (widget, &value));
+	ASSERT (!strcmp (value, "one"));
+	CHECK (gp_widget_set_value (widget, "three"));
+	CHECK (gp_camera_set_single_config (camera, "single", widget, NULL));
+	gp_widget_free (widget);
+	ASSERT (!strcmp (single, "three"));
+	ASSERT ((tree_gets == 0) && (tree_sets == 0));
+
+	/* Only part of the tree, looked up and set through it */
+	CHECK (gp_camera_get_single_config (camera, "custom", &widget, NULL));
+	CHECK (gp_widget_get_value (widget, &value));
+	ASSERT (!strcmp (value, "two"));
+	ASSERT (tree_gets == 1);
+	CHECK (gp_widget_set_value (widget, "four"));
+	CHECK (gp_camera_set_single_config (camera, "custom", widget, NULL));
+	ASSERT (!strcmp (custom, "four"));
+	ASSERT ((tree_gets == 2) && (tree_sets == 1));
+
+	/* Not there at all */
+	ASSERT (gp_camera_get_single_config (camera, "none", &widget, NULL) == GP_ERROR_BAD_PARAMETERS);
+	ASSERT (gp_camera_set_single_config (camera, "none", widget, NULL) == GP_ERROR_BAD_PARAMETERS);
+	ASSERT (tree_sets == 1);
+	gp_widget_free (widget);
+	return (0);
+}
+
+static int
+test_metrics (Camera *camera)
+{
+	CameraMetrics *m;
+	CameraFile *file;
+	FILE *f;
+	unsigned int i;
+
+	m = malloc (sizeof (CameraMetrics));
+	ASSERT (m != NULL);
+
+	f = fopen (IMAGE, "wb");
+	ASSERT (f != NULL);
+	ASSERT (fwrite ("not really a jpeg", 17, 1, f) == 1);
+	fclose (f);
+
+	/* Once a downloaded file is cached, it is served from there */
+	CHECK (gp_camera_reset_metrics (camera));
+	for (i = 0; i < 2; i++) {
+		CHECK (gp_file_new (&file));
+		CHECK (gp_camera_file_get (camera, "/", IMAGE, GP_FILE_TYPE_NORMAL,
+					   file, NULL));
+		if (!i)
+			CHECK (gp_filesystem_set_file_noop (camera->fs, "/", IMAGE,
+						GP_FILE_TYPE_NORMAL, file, NULL));
+		gp_file_unref (file);
+	}
+	CHECK (gp_camera_get_metrics (camera, m));
+	ASSERT ((m->cache.misses == 1) && (m->cache.hits == 1));
+	ASSERT ((m->cache.entries == 1) && (m->cache.size == 17));
+	ASSERT (m->nrofoperations == 0);
+
+	/* Operations of the same code add up */
+	CHECK (gp_camera_record_operation (camera, 0x1001, 3, GP_OK, 0));
+	CHECK (gp_camera_record_operation (camera, 0x1002, 1000, GP_ERROR_IO, 2));
+	CHECK (gp_camera_record_operation (camera, 0x1001, 5, GP_OK, 1));
+	CHECK (gp_camera_get_metrics (camera, m));
+	ASSERT (m->nrofoperations == 2);
+	ASSERT ((m->operations[0].code == 0x1001) && (m->operations[0].count == 2));
+	ASSERT ((m->operations[0].errors == 0) && (m->operations[0].retries == 1));
+	ASSERT ((m->operations[0].total_usec == 8) && (m->operations[0].max_usec == 5));
+	ASSERT ((m->operations[0].latency[1] == 1) && (m->operations[0].latency[2] == 1));
+	ASSERT ((m->operations[1].code == 0x1002) && (m->operations[1].errors == 1));
+	ASSERT ((m->operations[1].retries == 2) && (m->operations[1].latency[9] == 1));
+
+	/* Codes beyond the table share its last entry */
+	for (i = 0; i < GP_CAMERA_METRICS_OPERATIONS + 2; i++)
+		CHECK (gp_camera_record_operation (camera, 0x2000 + i, 1, GP_OK, 0));
+	CHECK (gp_camera_get_metrics (camera, m));
+	ASSERT (m->nrofoperations == GP_CAMERA_METRICS_OPERATIONS);
+	ASSERT (m->operations[GP_CAMERA_METRICS_OPERATIONS - 1].code == 0);
+	ASSERT (m->operations[GP_CAMERA_METRICS_OPERATIONS - 1].count == 5);
+
+	/* A reset clears all but what is still cached */
+	CHECK (gp_camera_reset_metrics (camera));
+	CHECK (gp_camera_get_metrics (camera, m));
+	ASSERT (m->nrofoperations == 0);
+	ASSERT ((m->cache.misses == 0) && (m->cache.hits == 0));
+	ASSERT ((m->port.reads == 0) && (m->port.writes == 0));
+
+	unlink (IMAGE);
+	free (m);
+	return (0);
+}
+
+int
+main (int argc, char **argv)
+{
+	CameraAbilitiesList *al;
+	CameraAbilities a;
+	GPPortInfoList *il;
+	GPPortInfo info;
+	Camera *camera;
+	int n;
+
+	CHECK (gp_abilities_list_new (&al));
+	CHECK (gp_abilities_list_load (al, NULL));
+	n = gp_abilities_list_lookup_model (al, "Directory Browse");
+	if (n < 0) {
+		printf ("The directory camlib has not been built, skipping.\n");
+		gp_abilities_list_free (al);
+		return (SKIP);
+	}
+	CHECK (gp_abilities_list_get_abilities (al, n, &a));
+	gp_abilities_list_free (al);
+
+	CHECK (gp_port_info_list_new (&il));
+	CHECK (gp_port_info_list_load (il));
+	CHECK (n = gp_port_info_list_lookup_path (il, "disk:."));
+	CHECK (gp_port_info_list_get_info (il, n, &info));
+
+	CHECK (gp_camera_new (&camera));
+	CHECK (gp_camera_set_abilities (camera, a));
+	CHECK (gp_camera_set_port_info (camera, info));
+	gp_port_info_list_free (il);
+	CHECK (gp_camera_init (camera, NULL));
+
+	if (test_single_config (camera))
+		return (1);
+	if (test_metrics (camera))
+		return (1);
+
+	CHECK (gp_camera_exit (camera, NULL));
+	CHECK (gp_camera_free (camera));
+	return (0);
+}
@@ -0,0 +1,141 @@
+/* test-camlib-cache.c
+ *
+ * Copyright © 2013 The gPhoto Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Loads the camlibs twice through the camlib cache: the second load has
+ * to be served from the cache without rewriting it, give the same list,
+ * and still report progress and honour cancellation.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gphoto2/gphoto2-abilities-list.h>
+#include <gphoto2/gphoto2-context.h>
+#include <gphoto2/gphoto2-result.h>
+
+#include "test-check.h"
+
+#define CACHE "test-camlib-cache.cache"
+
+static float progress_target, progress_current;
+static int progress_started, progress_stopped;
+
+static unsigned int
+start_func (GPContext *context, float target, const char *text, void *data)
+{
+	progress_started++;
+	progress_target = target;
+	progress_current = 0;
+	return (1);
+}
+
+static void
+update_func (GPContext *context, unsigned int id, float current, void *data)
+{
+	progress_current = current;
+}
+
+static void
+stop_func (GPContext *context, unsigned int id, void *data)
+{
+	progress_stopped++;
+}
+
+static GPContextFeedback
+cancel_func (GPContext *context, void *data)
+{
+	return (GP_CONTEXT_FEEDBACK_CANCEL);
+}
+
+static int
+same_abilities (CameraAbilitiesList *a, CameraAbilitiesList *b)
+{
+	CameraAbilities aa, ab;
+	int i, n;
+
+	CHECK (n = gp_abilities_list_count (a));
+	ASSERT (n > 0);
+	ASSERT (gp_abilities_list_count (b) == n);
+	for (i = 0; i < n; i++) {
+		CHECK (gp_abilities_list_get_abilities (a, i, &aa));
+		CHECK (gp_abilities_list_get_abilities (b, i, &ab));
+		ASSERT (!strcmp (aa.model, ab.model));
+		ASSERT (!strcmp (aa.id, ab.id));
+		ASSERT (!strcmp (aa.library, ab.library));
+		ASSERT (aa.usb_vendor == ab.usb_vendor);
+		ASSERT (aa.usb_product == ab.usb_product);
+		ASSERT (aa.operations == ab.operations);
+	}
+	return (0);
+}
+
+int
+main (int argc, char **argv)
+{
+	CameraAbilitiesList *first, *second, *third;
+	GPContext *context;
+	struct stat written, after;
+
+	/* keep the cache of the other tests out of this */
+	unlink (CACHE);
+	setenv ("CAMLIBS_CACHE", CACHE, 1);
+
+	/* Nothing cached yet, every camlib is loaded */
+	CHECK (gp_abilities_list_new (&first));
+	CHECK (gp_abilities_list_load (first, NULL));
+	ASSERT (!stat (CACHE, &written));
+
+	/* Everything comes from the cache, which is left alone */
+	context = gp_context_new ();
+	gp_context_set_progress_funcs (context, start_func, update_func,
+				       stop_func, NULL);
+	CHECK (gp_abilities_list_new (&second));
+	CHECK (gp_abilities_list_load (second, context));
+	ASSERT (!stat (CACHE, &after));
+	ASSERT (written.st_ino == after.st_ino);
+	ASSERT (written.st_mtime == after.st_mtime);
+	if (same_abilities (first, second))
+		return (1);
+
+	/* Cached camlibs count for the progress */
+	ASSERT (progress_started == 1);
+	ASSERT (progress_stopped == 1);
+	ASSERT (progress_target > 0);
+	ASSERT (progress_current == progress_target);
+
+	/* ... and a cancel is noticed while reading them */
+	gp_context_set_cancel_func (context, cancel_func, NULL);
+	CHECK (gp_abilities_list_new (&third));
+	ASSERT (gp_abilities_list_load (third, context) == GP_ERROR_CANCEL);
+	ASSERT (progress_stopped == 2);
+
+	gp_abilities_list_free (first);
+	gp_abilities_list_free (second);
+	gp_abilities_list_free (third);
+	gp_context_unref (context);
+	unlink (CACHE);
+	return (0);
+}
@@ -7,10 +7,12 @@
 #include <gphoto2/gphoto2-filesys.h>
 #include <gphoto2/gphoto2-context.h>
 #include <gphoto2/gphoto2-abilities-list.h>
+#include <gphoto2/gphoto2-session.h>
 
 #include <gphoto2/gphoto2-port.h>
 #include <gphoto2/gphoto2-port-info-list.h>
 #include <gphoto2/gphoto2-port-log.h>
+#include <gphoto2/gphoto2-port-trace.h>
 #include <gphoto2/gphoto2-port-portability.h>
 #include <gphoto2/gphoto2-port-result.h>
 #include <gphoto2/gphoto2-port-version.h>
@@ -0,0 +1,215 @@
+/* test-session.c
+ *
+ * Copyright © 2013 The gPhoto Developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Opens and closes a number of "Directory Browse" cameras at once
+ * through a CameraSession, so that their drivers are loaded and
+ * unloaded from several threads at the same time. Then runs the session
+ * operations on a few of them, with capture and events faked and one
+ * camera failing.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gphoto2/gphoto2-session.h>
+#include <gphoto2/gphoto2-abilities-list.h>
+#include <gphoto2/gphoto2-result.h>
+
+#include "test-check.h"
+
+#define CAMERAS	8
+#define ROUNDS	10
+
+/* cameras with faked capture and events, the one in the middle fails */
+#define FAKED	3
+#define FAILING	1
+#define IMAGE	"test-session.jpg"
+
+static Camera *faked[FAKED];
+/* the event each faked camera sends next, and how often it was asked */
+static CameraEventType pending[FAKED];
+static int waits[FAKED];
+
+static int
+faked_index (Camera *camera)
+{
+	int i;
+
+	for (i = 0; i < FAKED; i++)
+		if (faked[i] == camera)
+			return (i);
+	return (-1);
+}
+
+static int
+faked_trigger_capture (Camera *camera, GPContext *context)
+{
+	return ((faked_index (camera) == FAILING) ? GP_ERROR_IO : GP_OK);
+}
+
+static int
+faked_wait_for_event (Camera *camera, int timeout, CameraEventType *eventtype,
+		      void **eventdata, GPContext *context)
+{
+	CameraFilePath *path;
+	int i = faked_index (camera);
+
+	if (i < 0)
+		return (GP_ERROR_BAD_PARAMETERS);
+	waits[i]++;
+	if (i == FAILING)
+		return (GP_ERROR_IO);
+	*eventtype = pending[i];
+	*eventdata = NULL;
+	pending[i] = GP_EVENT_TIMEOUT;
+	switch (*eventtype) {
+	case GP_EVENT_TIMEOUT:
+		usleep (timeout * 1000);
+		break;
+	case GP_EVENT_FILE_ADDED:
+		path = malloc (sizeof (CameraFilePath));
+		if (!path)
+			return (GP_ERROR_NO_MEMORY);
+		strcpy (path->folder, "/");
+		strcpy (path->name, IMAGE);
+		*eventdata = path;
+		break;
+	default:
+		break;
+	}
+	return (GP_OK);
+}
+
+static int
+test_operations (CameraSession *session)
+{
+	CameraList *list;
+	CameraFile *files[FAKED];
+	CameraEventType type;
+	unsigned long size;
+	const char *data;
+	void *eventdata;
+	FILE *f;
+	int i, n, waited;
+
+	f = fopen (IMAGE, "wb");
+	ASSERT (f != NULL);
+	ASSERT (fwrite ("not really a jpeg", 17, 1, f) == 1);
+	fclose (f);
+
+	CHECK (gp_list_new (&list));
+	for (i = 0; i < FAKED; i++)
+		CHECK (gp_list_append (list, "Directory Browse", "disk:."));
+	CHECK (gp_session_open (session, list, NULL));
+	gp_list_free (list);
+	for (i = 0; i < FAKED; i++) {
+		CHECK (gp_session_get_camera (session, i, &faked[i]));
+		faked[i]->functions->trigger_capture = faked_trigger_capture;
+		faked[i]->functions->wait_for_event = faked_wait_for_event;
+	}
+
+	/* The failing camera does not keep the others from triggering */
+	ASSERT (gp_session_trigger_capture (session, NULL) == GP_ERROR_IO);
+	for (i = 0; i < FAKED; i++)
+		ASSERT (gp_session_get_result (session, i) ==
+			((i == FAILING) ? GP_ERROR_IO : GP_OK));
+
+	/* ... nor from downloading */
+	for (i = 0; i < FAKED; i++)
+		pending[i] = GP_EVENT_FILE_ADDED;
+	ASSERT (gp_session_download_latest (session, 1000, files, NULL) == GP_ERROR_IO);
+	for (i = 0; i < FAKED; i++) {
+		if (i == FAILING) {
+			ASSERT (files[i] == NULL);
+			continue;
+		}
+		CHECK (gp_session_get_result (session, i));
+		ASSERT (files[i] != NULL);
+		CHECK (gp_file_get_data_and_size (files[i], &data, &size));
+		ASSERT ((size == 17) && !memcmp (data, "not really a jpeg", 17));
+		gp_file_unref (files[i]);
+	}
+
+	/* Events of the others come first, then the error, once */
+	for (i = 0; i < FAKED; i++)
+		pending[i] = GP_EVENT_CAPTURE_COMPLETE;
+	waited = waits[FAILING];
+	for (i = 0; i < FAKED; i++) {
+		if (i == FAILING)
+			continue;
+		CHECK (gp_session_wait_for_event (session, 1000, &n, &type, &eventdata, NULL));
+		ASSERT ((n == i) && (type == GP_EVENT_CAPTURE_COMPLETE));
+	}
+	ASSERT (gp_session_wait_for_event (session, 1000, &n, &type, &eventdata, NULL) == GP_ERROR_IO);
+	ASSERT (n == FAILING);
+	CHECK (gp_session_wait_for_event (session, 200, &n, &type, &eventdata, NULL));
+	ASSERT ((n == -1) && (type == GP_EVENT_TIMEOUT));
+	ASSERT (waits[FAILING] == waited + 1);
+
+	CHECK (gp_session_close (session, NULL));
+	unlink (IMAGE);
+	return (0);
+}
+
+int
+main (int argc, char **argv)
+{
+	CameraSession *session;
+	CameraAbilitiesList *al;
+	CameraList *list;
+	Camera *camera;
+	int i, n;
+
+	CHECK (gp_session_new (&session, NULL));
+	CHECK (gp_session_get_abilities_list (session, &al));
+	if (gp_abilities_list_lookup_model (al, "Directory Browse") < 0) {
+		printf ("The directory camlib has not been built, skipping.\n");
+		gp_session_free (session);
+		return (SKIP);
+	}
+
+	CHECK (gp_list_new (&list));
+	for (i = 0; i < CAMERAS; i++)
+		CHECK (gp_list_append (list, "Directory Browse", "disk:."));
+
+	for (n = 0; n < ROUNDS; n++) {
+		CHECK (gp_session_open (session, list, NULL));
+		ASSERT (gp_session_count (session) == CAMERAS);
+		for (i = 0; i < CAMERAS; i++) {
+			CHECK (gp_session_get_result (session, i));
+			CHECK (gp_session_get_camera (session, i, &camera));
+			ASSERT (camera != NULL);
+		}
+		CHECK (gp_session_close (session, NULL));
+		ASSERT (gp_session_count (session) == 0);
+	}
+
+	gp_list_free (list);
+
+	if (test_operations (session))
+		return (1);
+	CHECK (gp_session_free (session));
+	return (0);
+}